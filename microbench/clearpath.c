@@ -0,0 +1,428 @@
+/*
+ *  This file is part of Permafrost Engine. 
+ *  Copyright (C) 2020 Eduard Permyakov 
+ *
+ *  Permafrost Engine is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Permafrost Engine is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ *  Linking this software statically or dynamically with other modules is making 
+ *  a combined work based on this software. Thus, the terms and conditions of 
+ *  the GNU General Public License cover the whole combination. 
+ *  
+ *  As a special exception, the copyright holders of Permafrost Engine give 
+ *  you permission to link Permafrost Engine with independent modules to produce 
+ *  an executable, regardless of the license terms of these independent 
+ *  modules, and to copy and distribute the resulting executable under 
+ *  terms of your choice, provided that you also meet, for each linked 
+ *  independent module, the terms and conditions of the license of that 
+ *  module. An independent module is a module which is not derived from 
+ *  or based on Permafrost Engine. If you modify Permafrost Engine, you may 
+ *  extend this exception to your version of Permafrost Engine, but you are not 
+ *  obliged to do so. If you do not wish to do so, delete this exception 
+ *  statement from your version.
+ *
+ */
+
+/* Compares the SIMD ClearPath kernels against the original scalar 
+ * implementation for growing neighbour counts, and checks that both
+ * produce the same results.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "../src/game/clearpath_simd.h"
+#include "../src/collision.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define EPSILON         (1.0/1024)
+#define MIN_BENCH_SECS  (0.25)
+#define NUM_TEST_POINTS (256)
+#define ARR_SIZE(a)     (sizeof(a)/sizeof(a[0]))
+
+struct VO{
+    vec2_t xz_apex;
+    vec2_t xz_left_side;
+    vec2_t xz_right_side;
+};
+
+struct scenario{
+    struct cp_ent  ent;
+    vec2_t         des_v;
+    size_t         nneighbs;
+    struct cp_ent *neighbs;
+    bool          *dynamic;
+    vec2_t         test_points[NUM_TEST_POINTS];
+};
+
+VEC_TYPE(vec2, vec2_t)
+VEC_IMPL(static inline, vec2, vec2_t)
+
+/*****************************************************************************/
+/* STATIC VARIABLES                                                          */
+/*****************************************************************************/
+
+static uint32_t s_rand_state = 0x2545f491;
+static volatile size_t s_sink;
+
+/*****************************************************************************/
+/* STATIC FUNCTIONS                                                          */
+/*****************************************************************************/
+
+static float rand_float(float min, float max)
+{
+    s_rand_state ^= s_rand_state << 13;
+    s_rand_state ^= s_rand_state >> 17;
+    s_rand_state ^= s_rand_state << 5;
+    return min + (max - min) * ((s_rand_state >> 8) / (float)(1 << 24));
+}
+
+static double now_secs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The reference scalar implementation which the kernels replaced */
+
+static void ref_vo_edges(struct cp_ent ent, struct cp_ent neighb,
+                         vec2_t *out_xz_right, vec2_t *out_xz_left)
+{
+    vec2_t ent_to_nb, right;
+    PFM_Vec2_Sub(&neighb.xz_pos, &ent.xz_pos, &ent_to_nb);
+    PFM_Vec2_Normal(&ent_to_nb, &ent_to_nb);
+
+    right = (vec2_t){-ent_to_nb.raw[1], ent_to_nb.raw[0]};
+    PFM_Vec2_Scale(&right, neighb.radius + ent.radius + CLEARPATH_BUFFER_RADIUS, &right);
+
+    vec2_t right_tangent, left_tangent;
+    PFM_Vec2_Add(&neighb.xz_pos, &right, &right_tangent);
+    PFM_Vec2_Sub(&neighb.xz_pos, &right, &left_tangent);
+
+    PFM_Vec2_Sub(&right_tangent, &ent.xz_pos, out_xz_right);
+    PFM_Vec2_Normal(out_xz_right, out_xz_right);
+
+    PFM_Vec2_Sub(&left_tangent, &ent.xz_pos, out_xz_left);
+    PFM_Vec2_Normal(out_xz_left, out_xz_left);
+}
+
+static struct VO ref_vo(struct cp_ent ent, struct cp_ent neighb)
+{
+    struct VO ret;
+    ref_vo_edges(ent, neighb, &ret.xz_right_side, &ret.xz_left_side);
+    PFM_Vec2_Add(&ent.xz_pos, &neighb.xz_vel, &ret.xz_apex);
+    return ret;
+}
+
+static struct VO ref_hrvo(struct cp_ent ent, struct cp_ent neighb)
+{
+    struct VO rvo, ret;
+    ref_vo_edges(ent, neighb, &rvo.xz_right_side, &rvo.xz_left_side);
+
+    vec2_t apex_off;
+    PFM_Vec2_Add(&ent.xz_vel, &neighb.xz_vel, &apex_off);
+    PFM_Vec2_Scale(&apex_off, 0.5f, &apex_off);
+    PFM_Vec2_Add(&ent.xz_pos, &apex_off, &rvo.xz_apex);
+
+    vec2_t centerline;
+    PFM_Vec2_Add(&rvo.xz_left_side, &rvo.xz_right_side, &centerline);
+
+    vec2_t vo_apex;
+    PFM_Vec2_Add(&ent.xz_pos, &neighb.xz_vel, &vo_apex);
+
+    struct line_2d l1, l2;
+    vec2_t intersec_point;
+    ret.xz_apex = rvo.xz_apex;
+
+    float det = (centerline.x * ent.xz_vel.y) - (centerline.y * ent.xz_vel.x);
+    if(det > EPSILON) {
+
+        l1 = (struct line_2d){rvo.xz_apex, rvo.xz_left_side};
+        l2 = (struct line_2d){vo_apex, rvo.xz_right_side};
+        if(C_InfiniteLineIntersection(l1, l2, &intersec_point))
+            ret.xz_apex = intersec_point;
+
+    }else if(det < -EPSILON) {
+
+        l1 = (struct line_2d){rvo.xz_apex, rvo.xz_right_side};
+        l2 = (struct line_2d){vo_apex, rvo.xz_left_side};
+        if(C_InfiniteLineIntersection(l1, l2, &intersec_point))
+            ret.xz_apex = intersec_point;
+    }
+
+    ret.xz_right_side = rvo.xz_right_side;
+    ret.xz_left_side = rvo.xz_left_side;
+    return ret;
+}
+
+static void ref_build_vos(const struct scenario *sc, struct VO *out)
+{
+    for(int i = 0; i < sc->nneighbs; i++) {
+        out[i] = sc->dynamic[i] ? ref_hrvo(sc->ent, sc->neighbs[i])
+                                : ref_vo(sc->ent, sc->neighbs[i]);
+    }
+}
+
+static void ref_build_rays(const struct VO *vos, size_t n_vos, struct line_2d *out)
+{
+    for(int i = 0; i < n_vos; i++) {
+        out[2*i + 0] = (struct line_2d){vos[i].xz_apex, vos[i].xz_left_side};
+        out[2*i + 1] = (struct line_2d){vos[i].xz_apex, vos[i].xz_right_side};
+    }
+}
+
+static bool ref_inside_pcr(const struct line_2d *vo_lr_pairs, size_t n_rays, vec2_t test)
+{
+    for(int i = 0; i < n_rays; i+=2) {
+
+        const float left_dir_x = vo_lr_pairs[i + 0].dir.raw[0];
+        const float left_dir_z = vo_lr_pairs[i + 0].dir.raw[1];
+
+        vec2_t point_to_test;
+        PFM_Vec2_Sub(&test, (vec2_t*)&vo_lr_pairs[i + 0].point, &point_to_test);
+        PFM_Vec2_Normal(&point_to_test, &point_to_test);
+
+        float left_det = (point_to_test.raw[1] * left_dir_x) - (point_to_test.raw[0] * left_dir_z);
+        if(left_det < EPSILON)
+            continue;
+
+        const float right_dir_x = vo_lr_pairs[i + 1].dir.raw[0];
+        const float right_dir_z = vo_lr_pairs[i + 1].dir.raw[1];
+
+        PFM_Vec2_Sub(&test, (vec2_t*)&vo_lr_pairs[i + 1].point, &point_to_test);
+        PFM_Vec2_Normal(&point_to_test, &point_to_test);
+
+        float right_det = (point_to_test.raw[1] * right_dir_x) - (point_to_test.raw[0] * right_dir_z);
+        if(right_det > -EPSILON)
+            continue;
+
+        return true;
+    }
+    return false;
+}
+
+static size_t ref_xpoints(const struct line_2d *rays, size_t n_rays, vec_vec2_t *inout)
+{
+    size_t ret = 0;
+    for(int i = 0; i < n_rays; i++) {
+        for(int j = 0; j < n_rays; j++) {
+
+            if(i == j) 
+                continue;
+
+            vec2_t isec_point;
+            if(!C_RayRayIntersection2D(rays[i], rays[j], &isec_point))
+                continue;
+
+            if(ref_inside_pcr(rays, n_rays, isec_point))
+                continue;
+
+            vec_vec2_push(inout, isec_point);
+            ret++;
+        }
+    }
+    return ret;
+}
+
+static void scenario_init(struct scenario *sc, size_t nneighbs)
+{
+    sc->ent = (struct cp_ent){
+        .xz_pos = (vec2_t){0.0f, 0.0f},
+        .xz_vel = (vec2_t){rand_float(-1.0f, 1.0f), rand_float(-1.0f, 1.0f)},
+        .radius = 1.0f,
+    };
+    sc->des_v = (vec2_t){rand_float(-1.0f, 1.0f), rand_float(-1.0f, 1.0f)};
+
+    sc->nneighbs = nneighbs;
+    sc->neighbs = malloc(nneighbs * sizeof(struct cp_ent));
+    sc->dynamic = malloc(nneighbs * sizeof(bool));
+
+    /* A dense blob of mostly moving units in the neighbour radius */
+    for(int i = 0; i < nneighbs; i++) {
+
+        float radius = rand_float(0.5f, 1.5f);
+        vec2_t pos;
+        do{
+            pos = (vec2_t){
+                rand_float(-CLEARPATH_NEIGHBOUR_RADIUS, CLEARPATH_NEIGHBOUR_RADIUS),
+                rand_float(-CLEARPATH_NEIGHBOUR_RADIUS, CLEARPATH_NEIGHBOUR_RADIUS)
+            };
+        }while(PFM_Vec2_Len(&pos) < radius + sc->ent.radius 
+            || PFM_Vec2_Len(&pos) > CLEARPATH_NEIGHBOUR_RADIUS);
+
+        struct cp_ent nb = (struct cp_ent){
+            .xz_pos = pos,
+            .xz_vel = (vec2_t){rand_float(-1.0f, 1.0f), rand_float(-1.0f, 1.0f)},
+            .radius = radius,
+        };
+        sc->dynamic[i] = (i % 4 != 3);
+        if(!sc->dynamic[i]) {
+            nb.xz_vel = (vec2_t){0.0f, 0.0f};
+        }
+        sc->neighbs[i] = nb;
+    }
+
+    for(int i = 0; i < NUM_TEST_POINTS; i++) {
+        sc->test_points[i] = (vec2_t){
+            rand_float(-CLEARPATH_NEIGHBOUR_RADIUS, CLEARPATH_NEIGHBOUR_RADIUS),
+            rand_float(-CLEARPATH_NEIGHBOUR_RADIUS, CLEARPATH_NEIGHBOUR_RADIUS)
+        };
+    }
+}
+
+static void scenario_destroy(struct scenario *sc)
+{
+    free(sc->neighbs);
+    free(sc->dynamic);
+}
+
+static void report(const char *name, size_t n, double ref_secs, double simd_secs, bool match)
+{
+    printf("%-12s n=%-4zu  scalar: %10.2f us  simd: %10.2f us  speedup: %5.2fx  %s\n",
+        name, n, ref_secs * 1e6, simd_secs * 1e6, ref_secs / simd_secs,
+        match ? "" : "MISMATCH");
+}
+
+/* Runs the body repeatedly for at least MIN_BENCH_SECS and yields the 
+ * average time for a single run.
+ */
+#define TIME_IT(_out_secs, ...)                                                 \
+    do{                                                                         \
+        size_t _iters = 0;                                                      \
+        double _begin = now_secs(), _elapsed;                                   \
+        do{                                                                     \
+            __VA_ARGS__                                                         \
+            _iters++;                                                           \
+        }while((_elapsed = now_secs() - _begin) < MIN_BENCH_SECS);              \
+        (_out_secs) = _elapsed / _iters;                                        \
+    }while(0)
+
+static bool bench(size_t nneighbs)
+{
+    struct scenario sc;
+    scenario_init(&sc, nneighbs);
+
+    const size_t n_vos = sc.nneighbs, n_rays = n_vos * 2;
+    double ref_secs, simd_secs;
+    bool ret = true, match;
+
+    struct VO ref_vos[n_vos];
+    struct line_2d ref_rays[n_rays];
+
+    float vo_attrs[6][CLEARPATH_SOA_CAP(n_vos)];
+    struct cp_vo_soa vos = {
+        .apex_x  = vo_attrs[0], .apex_z  = vo_attrs[1],
+        .left_x  = vo_attrs[2], .left_z  = vo_attrs[3],
+        .right_x = vo_attrs[4], .right_z = vo_attrs[5],
+    };
+    float ray_attrs[4][CLEARPATH_SOA_CAP(n_rays)];
+    struct cp_ray_soa rays = {
+        .px = ray_attrs[0], .pz = ray_attrs[1],
+        .dx = ray_attrs[2], .dz = ray_attrs[3],
+    };
+
+    /* HRVO and VO construction */
+    TIME_IT(ref_secs, ref_build_vos(&sc, ref_vos); s_sink += (size_t)ref_vos[0].xz_apex.x;);
+    TIME_IT(simd_secs, 
+        G_ClearPath_BuildVOs(sc.ent, sc.neighbs, sc.dynamic, n_vos, &vos);
+        s_sink += (size_t)vos.apex_x[0];
+    );
+
+    match = true;
+    for(int i = 0; i < n_vos; i++) {
+        match &= (ref_vos[i].xz_apex.x == vos.apex_x[i]);
+        match &= (ref_vos[i].xz_apex.z == vos.apex_z[i]);
+        match &= (ref_vos[i].xz_left_side.x == vos.left_x[i]);
+        match &= (ref_vos[i].xz_left_side.z == vos.left_z[i]);
+        match &= (ref_vos[i].xz_right_side.x == vos.right_x[i]);
+        match &= (ref_vos[i].xz_right_side.z == vos.right_z[i]);
+    }
+    report("build_vos", nneighbs, ref_secs, simd_secs, match);
+    ret &= match;
+
+    ref_build_rays(ref_vos, n_vos, ref_rays);
+    G_ClearPath_BuildRays(&vos, &rays);
+
+    /* Point-in-PCR tests */
+    bool ref_inside[NUM_TEST_POINTS], simd_inside[NUM_TEST_POINTS];
+    TIME_IT(ref_secs, 
+        for(int i = 0; i < NUM_TEST_POINTS; i++)
+            ref_inside[i] = ref_inside_pcr(ref_rays, n_rays, sc.test_points[i]);
+    );
+    TIME_IT(simd_secs, 
+        for(int i = 0; i < NUM_TEST_POINTS; i++)
+            simd_inside[i] = (G_ClearPath_FirstInside(&vos, sc.test_points[i]) < n_vos);
+    );
+
+    match = (0 == memcmp(ref_inside, simd_inside, sizeof(ref_inside)));
+    report("inside_pcr", nneighbs, ref_secs / NUM_TEST_POINTS, simd_secs / NUM_TEST_POINTS, match);
+    ret &= match;
+
+    /* Pairwise ray intersections, filtered by the point-in-PCR test. The 
+     * kernel additionally keeps the points which are only admissible when 
+     * some of the furthest neighbours are dropped. */
+    vec_vec2_t ref_points;
+    vec_cp_cand_t simd_cands;
+    vec_vec2_init(&ref_points);
+    vec_cp_cand_init(&simd_cands);
+
+    TIME_IT(ref_secs, 
+        vec_vec2_reset(&ref_points);
+        ref_xpoints(ref_rays, n_rays, &ref_points);
+    );
+    TIME_IT(simd_secs, 
+        vec_cp_cand_reset(&simd_cands);
+        G_ClearPath_XPoints(&vos, &rays, &simd_cands);
+    );
+
+    size_t nmatched = 0;
+    match = true;
+    for(int i = 0; i < vec_size(&simd_cands); i++) {
+
+        const struct cp_cand *cand = &vec_AT(&simd_cands, i);
+        if(cand->first_inside < n_vos)
+            continue;
+        match &= (nmatched < vec_size(&ref_points))
+              && (0 == memcmp(&cand->xz_point, &vec_AT(&ref_points, nmatched), sizeof(vec2_t)));
+        nmatched++;
+    }
+    match &= (nmatched == vec_size(&ref_points));
+    report("xpoints", nneighbs, ref_secs, simd_secs, match);
+    ret &= match;
+
+    vec_vec2_destroy(&ref_points);
+    vec_cp_cand_destroy(&simd_cands);
+    scenario_destroy(&sc);
+    return ret;
+}
+
+/*****************************************************************************/
+/* EXTERN FUNCTIONS                                                          */
+/*****************************************************************************/
+
+int main(int argc, char **argv)
+{
+    const size_t counts[] = {8, 32, 128};
+    bool match = true;
+
+    printf("ClearPath kernels (%d-wide)\n", CLEARPATH_SIMD_WIDTH);
+    for(int i = 0; i < ARR_SIZE(counts); i++)
+        match &= bench(counts[i]);
+
+    return match ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
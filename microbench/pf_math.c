@@ -0,0 +1,394 @@
+/*
+ *  This file is part of Permafrost Engine. 
+ *  Copyright (C) 2020 Eduard Permyakov 
+ *
+ *  Permafrost Engine is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Permafrost Engine is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ *  Linking this software statically or dynamically with other modules is making 
+ *  a combined work based on this software. Thus, the terms and conditions of 
+ *  the GNU General Public License cover the whole combination. 
+ *  
+ *  As a special exception, the copyright holders of Permafrost Engine give 
+ *  you permission to link Permafrost Engine with independent modules to produce 
+ *  an executable, regardless of the license terms of these independent 
+ *  modules, and to copy and distribute the resulting executable under 
+ *  terms of your choice, provided that you also meet, for each linked 
+ *  independent module, the terms and conditions of the license of that 
+ *  module. An independent module is a module which is not derived from 
+ *  or based on Permafrost Engine. If you modify Permafrost Engine, you may 
+ *  extend this exception to your version of Permafrost Engine, but you are not 
+ *  obliged to do so. If you do not wish to do so, delete this exception 
+ *  statement from your version.
+ *
+ */
+
+/* Compares the SIMD fast paths and batch routines of 'pf_math' against 
+ * the original scalar implementation, and checks that both produce the 
+ * same results. The single-precision inverse is checked against the 
+ * double-precision one within a tolerance.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "../src/pf_math.h"
+#include "../src/pf_math_simd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define INVERSE_TOLERANCE (1.0f/4096)
+#define MIN_BENCH_SECS    (0.25)
+#define ARR_SIZE(a)       (sizeof(a)/sizeof(a[0]))
+
+struct scenario{
+    size_t       n;
+    struct SQT  *sqts;
+    mat4x4_t    *mats;
+    vec4_t      *points;
+    mat4x4_t     view_proj;
+};
+
+/*****************************************************************************/
+/* STATIC VARIABLES                                                          */
+/*****************************************************************************/
+
+static uint32_t s_rand_state = 0x2545f491;
+static volatile float s_sink;
+
+/*****************************************************************************/
+/* STATIC FUNCTIONS                                                          */
+/*****************************************************************************/
+
+static float rand_float(float min, float max)
+{
+    s_rand_state ^= s_rand_state << 13;
+    s_rand_state ^= s_rand_state >> 17;
+    s_rand_state ^= s_rand_state << 5;
+    return min + (max - min) * ((s_rand_state >> 8) / (float)(1 << 24));
+}
+
+static double now_secs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The reference scalar implementation which the fast paths replaced */
+
+static void ref_mult4x4(mat4x4_t *op1, mat4x4_t *op2, mat4x4_t *out)
+{
+    for(int r = 0; r < 4; r++) {
+        for(int c = 0; c < 4; c++) {
+            out->cols[c][r] = 0.0f;
+            for(int k = 0; k < 4; k++)
+                out->cols[c][r] += op1->cols[k][r] * op2->cols[c][k]; 
+        }
+    }
+}
+
+static void ref_mult4x1(mat4x4_t *op1, vec4_t *op2, vec4_t *out)
+{
+    for(int r = 0; r < 4; r++) {
+        out->raw[r] = 0.0f;
+        for(int c = 0; c < 4; c++)
+            out->raw[r] += op1->cols[c][r] * op2->raw[c];
+    }
+}
+
+static void ref_rot_from_quat(const quat_t *quat, mat4x4_t *out)
+{
+    PFM_Mat4x4_Identity(out);
+
+    out->cols[0][0]  = 1 - 2*pow(quat->y, 2) - 2*pow(quat->z, 2);
+    out->cols[1][0] = 2*quat->x*quat->y + 2*quat->w*quat->z;
+    out->cols[2][0] = 2*quat->x*quat->z - 2*quat->w*quat->y;
+
+    out->cols[0][1] = 2*quat->x*quat->y - 2*quat->w*quat->z;
+    out->cols[1][1] = 1 - 2*pow(quat->x, 2) - 2*pow(quat->z, 2);
+    out->cols[2][1] = 2*quat->y*quat->z + 2*quat->w*quat->x;
+
+    out->cols[0][2] = 2*quat->x*quat->z + 2*quat->w*quat->y;
+    out->cols[1][2] = 2*quat->y*quat->z - 2*quat->w*quat->x;
+    out->cols[2][2] = 1 - 2*pow(quat->x, 2) - 2*pow(quat->y, 2);
+}
+
+static void ref_mat_from_sqt(const struct SQT *sqt, mat4x4_t *out)
+{
+    mat4x4_t rot, trans, scale;
+    mat4x4_t tmp;
+
+    PFM_Mat4x4_MakeScale(sqt->scale.x, sqt->scale.y, sqt->scale.z, &scale);
+    PFM_Mat4x4_MakeTrans(sqt->trans.x, sqt->trans.y, sqt->trans.z, &trans);
+    ref_rot_from_quat(&sqt->quat_rotation, &rot);
+
+    ref_mult4x4(&rot, &scale, &tmp);
+    ref_mult4x4(&trans, &tmp, out);
+}
+
+static void ref_model_matrix(const struct SQT *sqt, mat4x4_t *out)
+{
+    mat4x4_t trans, scale, rot, tmp;
+
+    PFM_Mat4x4_MakeTrans(sqt->trans.x, sqt->trans.y, sqt->trans.z, &trans);
+    PFM_Mat4x4_MakeScale(sqt->scale.x, sqt->scale.y, sqt->scale.z, &scale);
+    ref_rot_from_quat(&sqt->quat_rotation, &rot);
+
+    ref_mult4x4(&scale, &rot, &tmp);
+    ref_mult4x4(&trans, &tmp, out);
+}
+
+static void ref_normal(mat4x4_t *in, mat4x4_t *out)
+{
+    mat4x4_t inv;
+    PFM_Mat4x4_Inverse(in, &inv);
+    PFM_Mat4x4_Transpose(&inv, out);
+}
+
+static void scenario_init(struct scenario *sc, size_t n)
+{
+    sc->n = n;
+    sc->sqts = malloc(n * sizeof(struct SQT));
+    sc->mats = malloc(n * sizeof(mat4x4_t));
+    sc->points = malloc(n * sizeof(vec4_t));
+
+    for(int i = 0; i < n; i++) {
+
+        quat_t rot = (quat_t){
+            rand_float(-1.0f, 1.0f), rand_float(-1.0f, 1.0f), 
+            rand_float(-1.0f, 1.0f), rand_float(-1.0f, 1.0f)
+        };
+        PFM_Quat_Normal(&rot, &rot);
+
+        sc->sqts[i] = (struct SQT){
+            .scale = {rand_float(0.25f, 4.0f), rand_float(0.25f, 4.0f), rand_float(0.25f, 4.0f)},
+            .quat_rotation = rot,
+            .trans = {rand_float(-512.0f, 512.0f), rand_float(-64.0f, 64.0f), rand_float(-512.0f, 512.0f)},
+        };
+        ref_model_matrix(&sc->sqts[i], &sc->mats[i]);
+        sc->points[i] = (vec4_t){
+            rand_float(-512.0f, 512.0f), rand_float(-64.0f, 64.0f), 
+            rand_float(-512.0f, 512.0f), 1.0f
+        };
+    }
+
+    vec3_t eye = {0.0f, 300.0f, -200.0f}, target = {0.0f, 0.0f, 0.0f}, up = {0.0f, 1.0f, 0.0f};
+    mat4x4_t view, proj;
+    PFM_Mat4x4_MakeLookAt(&eye, &target, &up, &view);
+    PFM_Mat4x4_MakePerspective(DEG_TO_RAD(45.0f), 16.0f/9.0f, 0.1f, 1000.0f, &proj);
+    ref_mult4x4(&proj, &view, &sc->view_proj);
+}
+
+static void scenario_destroy(struct scenario *sc)
+{
+    free(sc->sqts);
+    free(sc->mats);
+    free(sc->points);
+}
+
+static bool mats_equal(const mat4x4_t *a, const mat4x4_t *b, size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        for(int j = 0; j < 16; j++) {
+            if(a[i].raw[j] != b[i].raw[j])
+                return false;
+        }
+    }
+    return true;
+}
+
+static bool mats_close(const mat4x4_t *a, const mat4x4_t *b, size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+
+        float max = 0.0f;
+        for(int j = 0; j < 16; j++)
+            max = fmaxf(max, fabsf(a[i].raw[j]));
+
+        for(int j = 0; j < 16; j++) {
+            if(fabsf(a[i].raw[j] - b[i].raw[j]) > max * INVERSE_TOLERANCE)
+                return false;
+        }
+    }
+    return true;
+}
+
+static void report(const char *name, size_t n, double ref_secs, double simd_secs, bool match)
+{
+    printf("%-14s n=%-5zu  scalar: %10.2f us  simd: %10.2f us  speedup: %5.2fx  %s\n",
+        name, n, ref_secs * 1e6, simd_secs * 1e6, ref_secs / simd_secs,
+        match ? "" : "MISMATCH");
+}
+
+/* Runs the body repeatedly for at least MIN_BENCH_SECS and yields the 
+ * average time for a single run.
+ */
+#define TIME_IT(_out_secs, ...)                                                 \
+    do{                                                                         \
+        size_t _iters = 0;                                                      \
+        double _begin = now_secs(), _elapsed;                                   \
+        do{                                                                     \
+            __VA_ARGS__                                                         \
+            _iters++;                                                           \
+        }while((_elapsed = now_secs() - _begin) < MIN_BENCH_SECS);              \
+        (_out_secs) = _elapsed / _iters;                                        \
+    }while(0)
+
+static bool bench(size_t n)
+{
+    struct scenario sc;
+    scenario_init(&sc, n);
+
+    mat4x4_t *ref_mats = malloc(n * sizeof(mat4x4_t));
+    mat4x4_t *simd_mats = malloc(n * sizeof(mat4x4_t));
+    vec4_t *ref_points = malloc(n * sizeof(vec4_t));
+    vec4_t *simd_points = malloc(n * sizeof(vec4_t));
+
+    double ref_secs, simd_secs;
+    bool ret = true, match;
+
+    /* Pairwise products, as when composing the joint matrices */
+    TIME_IT(ref_secs, 
+        for(int i = 0; i < n; i++)
+            ref_mult4x4(&sc.mats[i], &sc.mats[n - i - 1], &ref_mats[i]);
+        s_sink += ref_mats[0].raw[0];
+    );
+    TIME_IT(simd_secs, 
+        for(int i = 0; i < n; i++)
+            PFM_SIMD_Mat4x4_Mult4x4(&sc.mats[i], &sc.mats[n - i - 1], &simd_mats[i]);
+        s_sink += simd_mats[0].raw[0];
+    );
+    match = mats_equal(ref_mats, simd_mats, n);
+    report("mult4x4", n, ref_secs, simd_secs, match);
+    ret &= match;
+
+    /* View-projection applied to all the model matrices */
+    TIME_IT(ref_secs, 
+        for(int i = 0; i < n; i++)
+            ref_mult4x4(&sc.view_proj, &sc.mats[i], &ref_mats[i]);
+        s_sink += ref_mats[0].raw[0];
+    );
+    TIME_IT(simd_secs, 
+        PFM_Mat4x4_Mult4x4Batch(&sc.view_proj, n, sc.mats, simd_mats);
+        s_sink += simd_mats[0].raw[0];
+    );
+    match = mats_equal(ref_mats, simd_mats, n);
+    report("mult4x4_batch", n, ref_secs, simd_secs, match);
+    ret &= match;
+
+    /* View-projection applied to points */
+    TIME_IT(ref_secs, 
+        for(int i = 0; i < n; i++)
+            ref_mult4x1(&sc.view_proj, &sc.points[i], &ref_points[i]);
+        s_sink += ref_points[0].raw[0];
+    );
+    TIME_IT(simd_secs, 
+        PFM_Mat4x4_Mult4x1Batch(&sc.view_proj, n, sc.points, simd_points);
+        s_sink += simd_points[0].raw[0];
+    );
+    match = (0 == memcmp(ref_points, simd_points, n * sizeof(vec4_t)));
+    report("mult4x1_batch", n, ref_secs, simd_secs, match);
+    ret &= match;
+
+    /* Rotation matrices */
+    TIME_IT(ref_secs, 
+        for(int i = 0; i < n; i++)
+            ref_rot_from_quat(&sc.sqts[i].quat_rotation, &ref_mats[i]);
+        s_sink += ref_mats[0].raw[0];
+    );
+    TIME_IT(simd_secs, 
+        for(int i = 0; i < n; i++)
+            PFM_SIMD_Mat4x4_RotFromQuat(&sc.sqts[i].quat_rotation, &simd_mats[i]);
+        s_sink += simd_mats[0].raw[0];
+    );
+    match = mats_equal(ref_mats, simd_mats, n);
+    report("rot_from_quat", n, ref_secs, simd_secs, match);
+    ret &= match;
+
+    /* Joint transforms (T * R * S) */
+    TIME_IT(ref_secs, 
+        for(int i = 0; i < n; i++)
+            ref_mat_from_sqt(&sc.sqts[i], &ref_mats[i]);
+        s_sink += ref_mats[0].raw[0];
+    );
+    TIME_IT(simd_secs, 
+        PFM_Mat4x4_MakeSQTBatch(n, sc.sqts, simd_mats);
+        s_sink += simd_mats[0].raw[0];
+    );
+    match = mats_equal(ref_mats, simd_mats, n);
+    report("sqt_batch", n, ref_secs, simd_secs, match);
+    ret &= match;
+
+    /* Entity model matrices (T * S * R) */
+    TIME_IT(ref_secs, 
+        for(int i = 0; i < n; i++)
+            ref_model_matrix(&sc.sqts[i], &ref_mats[i]);
+        s_sink += ref_mats[0].raw[0];
+    );
+    TIME_IT(simd_secs, 
+        for(int i = 0; i < n; i++)
+            PFM_SIMD_Mat4x4_MakeTSR(&sc.sqts[i].trans, &sc.sqts[i].quat_rotation, 
+                &sc.sqts[i].scale, &simd_mats[i]);
+        s_sink += simd_mats[0].raw[0];
+    );
+    match = mats_equal(ref_mats, simd_mats, n);
+    report("model_matrix", n, ref_secs, simd_secs, match);
+    ret &= match;
+
+    /* Normal matrices */
+    TIME_IT(ref_secs, 
+        for(int i = 0; i < n; i++)
+            ref_normal(&sc.mats[i], &ref_mats[i]);
+        s_sink += ref_mats[0].raw[0];
+    );
+    TIME_IT(simd_secs, 
+        for(int i = 0; i < n; i++)
+            PFM_SIMD_Mat4x4_Normal(&sc.mats[i], &simd_mats[i]);
+        s_sink += simd_mats[0].raw[0];
+    );
+    match = mats_close(ref_mats, simd_mats, n);
+    report("normal", n, ref_secs, simd_secs, match);
+    ret &= match;
+
+    free(ref_mats);
+    free(simd_mats);
+    free(ref_points);
+    free(simd_points);
+    scenario_destroy(&sc);
+    return ret;
+}
+
+/*****************************************************************************/
+/* EXTERN FUNCTIONS                                                          */
+/*****************************************************************************/
+
+int main(int argc, char **argv)
+{
+    const size_t counts[] = {64, 1024};
+    bool match = true;
+
+#if defined(__SSE__)
+    printf("pf_math fast paths (SSE)\n");
+#else
+    printf("pf_math fast paths (scalar)\n");
+#endif
+    for(int i = 0; i < ARR_SIZE(counts); i++)
+        match &= bench(counts[i]);
+
+    return match ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
@@ -0,0 +1,291 @@
+#
+#  This file is part of Permafrost Engine. 
+#  Copyright (C) 2020 Eduard Permyakov 
+#
+#  Permafrost Engine is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  Permafrost Engine is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+# 
+#  Linking this software statically or dynamically with other modules is making 
+#  a combined work based on this software. Thus, the terms and conditions of 
+#  the GNU General Public License cover the whole combination. 
+#  
+#  As a special exception, the copyright holders of Permafrost Engine give 
+#  you permission to link Permafrost Engine with independent modules to produce 
+#  an executable, regardless of the license terms of these independent 
+#  modules, and to copy and distribute the resulting executable under 
+#  terms of your choice, provided that you also meet, for each linked 
+#  independent module, the terms and conditions of the license of that 
+#  module. An independent module is a module which is not derived from 
+#  or based on Permafrost Engine. If you modify Permafrost Engine, you may 
+#  extend this exception to your version of Permafrost Engine, but you are not 
+#  obliged to do so. If you do not wish to do so, delete this exception 
+#  statement from your version.
+#
+
+# Headless benchmark harness. A scenario script describes the map, scene, 
+# armies and orders, and hands them to 'run'. The simulation is then stepped 
+# as fast as possible for a fixed number of ticks, after which the collected 
+# statistics are written out as JSON and the engine exits.
+#
+# Scenarios are run with:
+#     ./bin/pf --headless ./ scripts/bench/scenarios/<scenario>.py
+# or all at once with 'make bench'. Results are written to 
+# 'bench_results/<scenario name>.json' under the base directory.
+
+import pf
+import math
+
+import rts.units.knight
+import rts.units.berzerker
+import rts.units.anim_combatable as am
+
+UNIT_TYPES = {
+    "knight":    (rts.units.knight.Knight, "assets/models/knight", "knight.pfobj", "Knight", 3.25),
+    "berzerker": (rts.units.berzerker.Berzerker, "assets/models/berzerker", "berzerker.pfobj", "Berzerker", 3.00),
+}
+
+RESULTS_DIR = "bench_results"
+
+def army(unit, faction, count, center, spacing=12.0, orders=None):
+    """
+    Describes a block of 'count' units of type 'unit', arranged in a square grid 
+    around 'center' (an XZ pair). Grid slots that are not pathable are skipped, 
+    growing the block along the Z axis. 'orders' is an optional (action, XZ position) 
+    tuple, where 'action' is one of "move" or "attack".
+    """
+    return {
+        "unit": unit,
+        "faction": faction,
+        "count": count,
+        "center": center,
+        "spacing": spacing,
+        "orders": orders,
+    }
+
+def to_json(obj, indent=0):
+    """
+    The embedded interpreter doesn't ship the 'json' module. This handles the
+    subset of types that make up the results.
+    """
+    pad = "  " * (indent + 1)
+    if obj is None:
+        return "null"
+    if isinstance(obj, bool):
+        return "true" if obj else "false"
+    if isinstance(obj, (int, long)):
+        return str(obj)
+    if isinstance(obj, float):
+        if math.isnan(obj) or math.isinf(obj):
+            return "null"
+        return repr(obj)
+    if isinstance(obj, basestring):
+        return '"' + obj.replace("\\", "\\\\").replace('"', '\\"') + '"'
+    if isinstance(obj, (list, tuple)):
+        if len(obj) == 0:
+            return "[]"
+        items = [pad + to_json(o, indent + 1) for o in obj]
+        return "[\n" + ",\n".join(items) + "\n" + "  " * indent + "]"
+    if isinstance(obj, dict):
+        if len(obj) == 0:
+            return "{}"
+        items = [pad + to_json(str(k)) + ": " + to_json(obj[k], indent + 1) for k in sorted(obj.keys())]
+        return "{\n" + ",\n".join(items) + "\n" + "  " * indent + "}"
+    raise TypeError("Cannot serialize object of type %s" % type(obj))
+
+class Benchmark(object):
+
+    def __init__(self, name, ticks, armies, map=("assets/maps", "plain.pfmap"), 
+        scene=None, factions=None, war=None, warmup_ticks=10):
+
+        self.name = name
+        self.ticks = ticks
+        self.armies = armies
+        self.map = map
+        self.scene = scene
+        self.factions = factions or [("RED", (255, 0, 0, 255)), ("BLUE", (0, 0, 255, 255))]
+        self.war = war or []
+        self.warmup_ticks = warmup_ticks
+
+        self.units = []
+        self.scene_objs = []
+        self.num_spawned = 0
+        self.num_deaths = 0
+
+        self.ticks_elapsed = 0
+        self.frame_ms = []
+        self.subsystems = {}
+
+    def setup(self):
+
+        pf.set_ambient_light_color((1.0, 1.0, 1.0))
+        pf.set_emit_light_color((1.0, 1.0, 1.0))
+        pf.set_emit_light_pos((1664.0, 1024.0, 384.0))
+        pf.settings_set("pf.game.fog_of_war_enabled", False, persist=False)
+        # Takes effect at the next frame boundary, well before the warmup is over. 
+        # The instrumentation is only compiled in for PROFILE (and DEBUG) builds.
+        pf.settings_set("pf.debug.perf_sampling", True, persist=False)
+
+        pf.new_game(self.map[0], self.map[1])
+        if self.scene is not None:
+            self.scene_objs = pf.load_scene(self.scene)
+
+        base = len(pf.get_factions_list())
+        for name, color in self.factions:
+            pf.add_faction(name, color)
+        for fac in range(base, len(pf.get_factions_list())):
+            pf.set_faction_controllable(fac, False)
+        for a, b in self.war:
+            pf.set_diplomacy_state(base + a, base + b, pf.DIPLOMACY_STATE_WAR)
+
+        for spec in self.armies:
+            self.spawn_army(base, spec)
+
+    def spawn_army(self, faction_base, spec):
+
+        cls, path, pfobj, name, sel_radius = UNIT_TYPES[spec["unit"]]
+        ncols = int(math.ceil(math.sqrt(spec["count"])))
+        cx, cz = spec["center"]
+        half = (ncols - 1) * spec["spacing"] / 2.0
+
+        placed = 0
+        slot = 0
+        while placed < spec["count"] and slot < 4 * ncols * ncols:
+
+            x = cx - half + (slot % ncols) * spec["spacing"]
+            z = cz - half + (slot // ncols) * spec["spacing"]
+            slot += 1
+
+            if not pf.map_pos_pathable(x, z):
+                continue
+            y = pf.map_height_at_point(x, z)
+            placed += 1
+
+            unit = cls(path, pfobj, name)
+            unit.pos = (float(x), float(y), float(z))
+            unit.faction_id = faction_base + spec["faction"]
+            unit.selection_radius = sel_radius
+            unit.selectable = True
+            unit.vision_range = 35.0
+            unit.hold_position()
+
+            self.units.append((unit, spec))
+            self.num_spawned += 1
+
+    def issue_orders(self):
+        for unit, spec in self.units:
+            if spec["orders"] is None:
+                continue
+            action, pos = spec["orders"]
+            if action == "move":
+                unit.move(pos)
+            elif action == "attack":
+                unit.attack(pos)
+
+    def accumulate_perf(self, node, path):
+        for child in node["children"]:
+            key = path + "/" + child["name"]
+            entry = self.subsystems.setdefault(key, {"total_ms": 0.0, "max_ms": 0.0, "calls": 0})
+            entry["total_ms"] += child["ms_delta"]
+            entry["max_ms"] = max(entry["max_ms"], child["ms_delta"])
+            entry["calls"] += 1
+            self.accumulate_perf(child, key)
+
+    def on_tick(self, event):
+
+        self.ticks_elapsed += 1
+        if self.ticks_elapsed == self.warmup_ticks:
+            self.issue_orders()
+
+        if self.ticks_elapsed > self.warmup_ticks:
+            self.frame_ms.append(pf.prev_frame_ms())
+            for thread, root in pf.prev_frame_perfstats().items():
+                self.accumulate_perf(root, thread)
+
+        if self.ticks_elapsed == self.warmup_ticks + self.ticks:
+            self.finish()
+
+    def results(self):
+
+        frames = sorted(self.frame_ms)
+        nframes = len(frames)
+        def percentile(p):
+            if nframes == 0:
+                return 0
+            return frames[min(nframes - 1, int(p * nframes))]
+
+        for entry in self.subsystems.values():
+            entry["avg_ms"] = entry["total_ms"] / max(nframes, 1)
+
+        return {
+            "name": self.name,
+            "ticks": self.ticks,
+            "frame_ms": {
+                "avg": float(sum(frames)) / max(nframes, 1),
+                "p50": percentile(0.50),
+                "p95": percentile(0.95),
+                "max": frames[-1] if nframes else 0,
+            },
+            "subsystems": self.subsystems,
+            "nav": pf.get_nav_perfstats(),
+            "clearpath": pf.get_clearpath_perfstats(),
+            "entities": {
+                "units_spawned": self.num_spawned,
+                "units_alive": self.num_spawned - self.num_deaths,
+                "scene_objects": len(self.scene_objs),
+            },
+            "peak_memory_bytes": pf.get_peak_memory(),
+        }
+
+    def finish(self):
+
+        out = to_json(self.results()) + "\n"
+        path = pf.get_basedir() + "/" + RESULTS_DIR + "/" + self.name + ".json"
+        try:
+            f = open(path, "w")
+            f.write(out)
+            f.close()
+            print "[bench] %s: results written to %s" % (self.name, path)
+        except IOError:
+            print "[bench] %s: could not open %s, dumping results:" % (self.name, path)
+            print out
+
+        pf.global_event(pf.SDL_QUIT, None)
+
+def install_death_hooks(bench):
+    """
+    Dead units are kept in the benchmark's unit list rather than the 'rts' 
+    globals. Count the deaths and release the units once their death animation
+    is finished.
+    """
+    def on_death(self, event):
+        bench.num_deaths += 1
+        self.play_anim(self.death_anim(), mode=pf.ANIM_MODE_ONCE_HIDE_ON_FINISH)
+        self.register(pf.EVENT_ANIM_CYCLE_FINISHED, am.AnimCombatable.on_death_anim_finish, self)
+
+    def on_death_anim_finish(self, event):
+        self.unregister(pf.EVENT_ANIM_CYCLE_FINISHED, am.AnimCombatable.on_death_anim_finish)
+        bench.units = [(u, s) for (u, s) in bench.units if u is not self]
+
+    am.AnimCombatable.on_death = on_death
+    am.AnimCombatable.on_death_anim_finish = on_death_anim_finish
+
+def run(bench):
+    """
+    Set up the scenario and fast-forward the simulation clock through it.
+    """
+    install_death_hooks(bench)
+    bench.setup()
+
+    pf.register_event_handler(pf.EVENT_60HZ_TICK, lambda user, event: bench.on_tick(event), None)
+    pf.run_ticks(bench.warmup_ticks + bench.ticks)
+
@@ -49,4 +49,5 @@ EVENT_SHADOWS_SETTING_CHANGED    = 0x2f00a
 EVENT_WATER_REF_SETTING_CHANGED  = 0x2f00b
 EVENT_SESSION_SAVE_REQUESTED     = 0x2f00c
 EVENT_SESSION_LOAD_REQUESTED     = 0x2f00d
+EVENT_FRAMES_AHEAD_SETTING_CHANGED = 0x2f00e
 
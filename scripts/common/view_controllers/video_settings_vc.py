@@ -56,6 +56,7 @@ class VideoSettingsVC(vc.ViewController):
         self.__og_win_on_top_idx = self.view.win_on_top_idx
         self.__og_vsync_ids = self.view.vsync_idx
         self.__og_shadows_ids = self.view.vsync_idx
+        self.__og_frames_ahead_idx = self.view.frames_ahead_idx
         self.__update_res_opts()
         self.__load_selection()
 
@@ -103,6 +104,13 @@ class VideoSettingsVC(vc.ViewController):
             water_reflect_saved = pf.settings_get("pf.video.water_reflection")
             self.view.water_reflect_idx = int(water_reflect_saved == 0)
             self.__og_water_reflect_idx = int(water_reflect_saved == 0)
+
+            frames_ahead_saved = pf.settings_get("pf.video.max_frames_ahead")
+            for i, cand in enumerate(self.view.frames_ahead_opts):
+                if cand == frames_ahead_saved:
+                    self.view.frames_ahead_idx = i
+                    self.__og_frames_ahead_idx = i
+                    break
         except:
             err = sys.exc_info()
             raise err[0], err[1], err[2]
@@ -114,7 +122,8 @@ class VideoSettingsVC(vc.ViewController):
         or self.view.ar_idx != self.__og_ar_idx \
         or self.view.vsync_idx != self.__og_vsync_idx \
         or self.view.shadows_idx != self.__og_shadows_idx \
-        or self.view.water_reflect_idx != self.__og_water_reflect_idx:
+        or self.view.water_reflect_idx != self.__og_water_reflect_idx \
+        or self.view.frames_ahead_idx != self.__og_frames_ahead_idx:
             self.view.dirty = True
         else:
             self.view.dirty = False
@@ -169,6 +178,13 @@ class VideoSettingsVC(vc.ViewController):
             except Exception as e:
                 print("Could not set pf.video.water_reflect_enabled:" + str(e))
 
+        if self.view.frames_ahead_idx != self.__og_frames_ahead_idx:
+            try:
+                pf.settings_set("pf.video.max_frames_ahead", self.view.frames_ahead_opts[self.view.frames_ahead_idx])
+                self.__og_frames_ahead_idx = self.view.frames_ahead_idx
+            except Exception as e:
+                print("Could not set pf.video.max_frames_ahead:" + str(e))
+
         self.__update_res_opts()
         self.__load_selection()
         self.__update_dirty_flag()
@@ -213,8 +229,10 @@ class VideoSettingsVC(vc.ViewController):
         pf.register_ui_event_handler(EVENT_VSYNC_SETTING_CHANGED, VideoSettingsVC.__update_dirty, self)
         pf.register_ui_event_handler(EVENT_SHADOWS_SETTING_CHANGED, VideoSettingsVC.__update_dirty, self)
         pf.register_ui_event_handler(EVENT_WATER_REF_SETTING_CHANGED, VideoSettingsVC.__update_dirty, self)
+        pf.register_ui_event_handler(EVENT_FRAMES_AHEAD_SETTING_CHANGED, VideoSettingsVC.__update_dirty, self)
 
     def deactivate(self):
+        pf.unregister_event_handler(EVENT_FRAMES_AHEAD_SETTING_CHANGED, VideoSettingsVC.__update_dirty)
         pf.unregister_event_handler(EVENT_WATER_REF_SETTING_CHANGED, VideoSettingsVC.__update_dirty)
         pf.unregister_event_handler(EVENT_SHADOWS_SETTING_CHANGED, VideoSettingsVC.__update_dirty)
         pf.unregister_event_handler(EVENT_VSYNC_SETTING_CHANGED, VideoSettingsVC.__update_dirty)
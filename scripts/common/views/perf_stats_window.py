@@ -38,6 +38,8 @@ class PerfStatsWindow(pf.Window):
 
     WIDTH = 600
     HEIGHT = 500
+    TRACE_PATH = "pf_trace.json"
+    TRACE_NFRAMES = 300
 
     def __init__(self):
         vresx, vresy = (1920, 1080)
@@ -54,6 +56,7 @@ class PerfStatsWindow(pf.Window):
         self.paused = False
         self.trace_python = pf.settings_get("pf.debug.trace_python")
         self.trace_gpu = pf.settings_get("pf.debug.trace_gpu")
+        self.perf_sampling = pf.settings_get("pf.debug.perf_sampling")
 
     def frame_perf_tab(self):
 
@@ -92,6 +95,12 @@ class PerfStatsWindow(pf.Window):
             hr=nav_stats["flow_hit_rate"], inv=nav_stats["flow_invalidated"]), \
             (0, 255, 0))
 
+        self.layout_row_dynamic(20, 1)
+        self.label_colored_wrap("[Integration Field Cache]   Used: {used:04d}/{cap:04d}   Hit Rate: {hr:02.03f} Invalidated: {inv:04d}" \
+            .format(used=nav_stats["intf_used"], cap=nav_stats["intf_max"], 
+            hr=nav_stats["intf_hit_rate"], inv=nav_stats["intf_invalidated"]), \
+            (0, 255, 0))
+
         self.layout_row_dynamic(20, 1)
         self.label_colored_wrap("[Dest:Field Mapping Cache] Used: {used:04d}/{cap:04d}   Hit Rate: {hr:02.03f}" \
             .format(used=nav_stats["ffid_used"], cap=nav_stats["ffid_max"], hr=nav_stats["ffid_hit_rate"]), \
@@ -102,6 +111,11 @@ class PerfStatsWindow(pf.Window):
             .format(used=nav_stats["grid_path_used"], cap=nav_stats["grid_path_max"], hr=nav_stats["grid_path_hit_rate"]), \
             (0, 255, 0))
 
+        self.layout_row_dynamic(20, 1)
+        self.label_colored_wrap("[Portal Travel Costs] Resident: {kib:.1f} KiB" \
+            .format(kib=nav_stats["portal_travel_cost_bytes"] / 1024.0), \
+            (0, 255, 0))
+
     def on_chart_click(self, index):
         self.selected_perfstats = self.frame_perfstats[index]
 
@@ -150,12 +164,24 @@ class PerfStatsWindow(pf.Window):
         if old_trace_gpu != self.trace_gpu:
             pf.settings_set("pf.debug.trace_gpu", self.trace_gpu, persist=False)
 
+        self.layout_row_dynamic(20, 1)
+        old_perf_sampling = self.perf_sampling
+        self.perf_sampling = True if self.checkbox("Sample (Profile Builds)", self.perf_sampling) else False
+        if old_perf_sampling != self.perf_sampling:
+            pf.settings_set("pf.debug.perf_sampling", self.perf_sampling, persist=False)
+
         def on_pause_resume():
             self.paused = not self.paused
 
+        def on_capture():
+            if not pf.perf_capture_active():
+                pf.perf_capture_begin(PerfStatsWindow.TRACE_PATH, PerfStatsWindow.TRACE_NFRAMES)
+
         text = lambda p: "Resume " if p else "Pause"
-        self.layout_row_dynamic(30, 1)
+        self.layout_row_dynamic(30, 2)
         self.button_label(text(self.paused), on_pause_resume)
+        capture_text = "Capturing..." if pf.perf_capture_active() else "Capture Trace"
+        self.button_label(capture_text, on_capture)
 
         self.tree(pf.NK_TREE_TAB, "Frame Performance", pf.NK_MINIMIZED, self.frame_perf_tab)
         self.tree(pf.NK_TREE_TAB, "Renderer Info", pf.NK_MINIMIZED, self.render_info_tab)
@@ -38,7 +38,7 @@ from common.constants import *
 class VideoSettingsWindow(pf.Window):
     
     WIDTH = 300
-    HEIGHT = 400
+    HEIGHT = 450
 
     def __init__(self):
         vresx, vresy = (1920, 1080)
@@ -102,6 +102,10 @@ class VideoSettingsWindow(pf.Window):
         ]
         self.__water_reflect_opt_strings = ["On", "Off"]
 
+        self.frames_ahead_idx = 0
+        self.frames_ahead_opts = [1, 2]
+        self.__frames_ahead_opt_strings = ["1 (Lower Latency)", "2 (Higher Throughput)"]
+
         self.dirty = False
 
     def update(self):
@@ -192,3 +196,13 @@ class VideoSettingsWindow(pf.Window):
         if self.water_reflect_idx != old_water_reflect_idx:
             pf.global_event(EVENT_WATER_REF_SETTING_CHANGED, self.water_reflect_opts[self.water_reflect_idx])
 
+        # Max Frames Ahead
+        self.layout_row_dynamic(20, 1)
+        self.label_colored_wrap("Max Frames Ahead Of Renderer:", (255, 255, 255))
+
+        self.layout_row_dynamic(25, 1)
+        old_frames_ahead_idx = self.frames_ahead_idx
+        self.frames_ahead_idx = self.combo_box(self.__frames_ahead_opt_strings, self.frames_ahead_idx, 25, (VideoSettingsWindow.WIDTH - 40, 200))
+        if old_frames_ahead_idx != self.frames_ahead_idx:
+            pf.global_event(EVENT_FRAMES_AHEAD_SETTING_CHANGED, self.frames_ahead_opts[self.frames_ahead_idx])
+
@@ -47,6 +47,9 @@
 
 #define BLEND_MODE_NOBLEND  0
 #define BLEND_MODE_BLUR     1
+/* Geometry spanning multiple tiles, used by the coarse terrain LODs. 
+ * The uv coordinates increase by 1.0 for every tile that is spanned. */
+#define BLEND_MODE_MERGED   2
 
 #define TERRAIN_AMBIENT     float(0.7)
 #define TERRAIN_DIFFUSE     vec3(0.9, 0.9, 0.9)
@@ -183,6 +186,13 @@ float bilinear_interp_unit_square(float tl, float tr, float bl, float br, vec2 c
          + tr * (coord.x) * (coord.y);
 }
 
+/* Map uv coordinates spanning multiple tiles to the [0,1] range of the
+ * tile the fragment is in. */
+vec2 tile_uv(vec2 uv)
+{
+    return uv - max(ceil(uv) - 1.0, 0.0);
+}
+
 /* The tint factor is in the range of [0,1]. It is a color multiplier based on 
  * the fog-of-war state of the current and adjacent tiles. */
 float tint_factor(ivec4 td, vec2 uv)
@@ -249,7 +259,9 @@ vec4 bilinear_interp_vec4
 void main()
 {
     ivec4 td = tile_desc_at(from_vertex.world_pos);
-    float tf = tint_factor(td, from_vertex.uv);
+    float tf = (from_vertex.blend_mode == BLEND_MODE_MERGED) 
+        ? tint_factor(td, tile_uv(from_vertex.uv))
+        : tint_factor(td, from_vertex.uv);
 
     if(tf == 0.0) {
         o_frag_color = vec4(0.0, 0.0, 0.0, 1.0);
@@ -260,6 +272,7 @@ void main()
 
     switch(from_vertex.blend_mode) {
     case BLEND_MODE_NOBLEND:
+    case BLEND_MODE_MERGED:
         tex_color = texture_val(from_vertex.mat_idx, from_vertex.uv);
         break;
     case BLEND_MODE_BLUR:
@@ -68,6 +68,16 @@ uniform vec4 clip_plane0;
  *  +--------------------------------------------------+
  *
  * In total, 3264 floats (13056 bytes) are pushed per instance.
+ *
+ * When 'anim_baked' is set, the joint matrices are replaced by a reference 
+ * into 'anim_baked_buff', which holds the skinning matrices for every frame
+ * of every clip:
+ *
+ *  +--------------------------------------------------+
+ *  | {float, float, float, float} (4 floats)          | (clip base, frame, 
+ *  +--------------------------------------------------+  num joints, unused)
+ *
+ * In total, 196 floats (784 bytes) are pushed per instance.
  */
 
 uniform samplerBuffer attrbuff;
@@ -75,6 +85,9 @@ uniform int attrbuff_offset;
 uniform int attr_stride;
 uniform int attr_offset;
 
+uniform samplerBuffer anim_baked_buff;
+uniform int anim_baked;
+
 /*****************************************************************************/
 /* PROGRAM                                                                   */
 /*****************************************************************************/
@@ -120,6 +133,21 @@ mat4 anim_inv_bind_mats(int joint_idx)
     return read_mat4(base + (16 * joint_idx));
 }
 
+mat4 anim_skin_mat(int joint_idx)
+{
+    if(anim_baked == 0)
+        return anim_curr_pose_mats(joint_idx) * anim_inv_bind_mats(joint_idx);
+
+    vec4 ref = read_vec4(inst_attr_base(in_draw_id) + 176 + 16);
+    int mat_idx = int(ref.x) + int(ref.y) * int(ref.z) + joint_idx;
+    return mat4(
+        texelFetch(anim_baked_buff, mat_idx * 4 + 0),
+        texelFetch(anim_baked_buff, mat_idx * 4 + 1),
+        texelFetch(anim_baked_buff, mat_idx * 4 + 2),
+        texelFetch(anim_baked_buff, mat_idx * 4 + 3)
+    );
+}
+
 void main()
 {
     int base = inst_attr_base(in_draw_id);
@@ -146,15 +174,14 @@ void main()
             int joint_idx = int(w_idx < 3 ? in_joint_indices0[w_idx % 3]
                                           : in_joint_indices1[w_idx % 3]);
 
-            mat4 inv_bind_mat = anim_inv_bind_mats (joint_idx);
-            mat4 pose_mat     = anim_curr_pose_mats(joint_idx);
+            mat4 skin_mat = anim_skin_mat(joint_idx);
 
             float weight = w_idx < 3 ? in_joint_weights0[w_idx % 3]
                                      : in_joint_weights1[w_idx % 3];
             float fraction = weight / tot_weight;
 
-            mat4 bone_mat = fraction * pose_mat * inv_bind_mat;
-            mat3 rot_mat = fraction * mat3(transpose(inverse(pose_mat * inv_bind_mat)));
+            mat4 bone_mat = fraction * skin_mat;
+            mat3 rot_mat = fraction * mat3(transpose(inverse(skin_mat)));
             
             new_pos += (bone_mat * vec4(in_pos, 1.0)).xyz;
         }
@@ -43,6 +43,8 @@
 #include "../lib/public/pf_string.h"
 #include "../render/public/render.h"
 #include "../render/public/render_ctrl.h"
+#include "../clock.h"
+#include "../pf_math_simd.h"
 
 #include <SDL.h>
 
@@ -74,17 +76,9 @@ static const struct anim_clip *a_clip_for_name(const struct entity *ent, const c
 
 static void a_mat_from_sqt(const struct SQT *sqt, mat4x4_t *out)
 {
-    mat4x4_t rot, trans, scale;
-    mat4x4_t tmp;
-
-    PFM_Mat4x4_MakeScale(sqt->scale.x, sqt->scale.y, sqt->scale.z, &scale);
-    PFM_Mat4x4_MakeTrans(sqt->trans.x, sqt->trans.y, sqt->trans.z, &trans);
-    PFM_Mat4x4_RotFromQuat(&sqt->quat_rotation, &rot);
-
     /*  (T * R * S) 
      */
-    PFM_Mat4x4_Mult4x4(&rot, &scale, &tmp);
-    PFM_Mat4x4_Mult4x4(&trans, &tmp, out);
+    PFM_SIMD_Mat4x4_MakeTRS(&sqt->trans, &sqt->quat_rotation, &sqt->scale, out);
 }
 
 static void a_make_bind_mat(int joint_idx, const struct skeleton *skel, mat4x4_t *out)
@@ -105,7 +99,7 @@ static void a_make_bind_mat(int joint_idx, const struct skeleton *skel, mat4x4_t
         mat4x4_t to_parent, to_curr = bind_trans;
 
         a_mat_from_sqt(bind_sqt, &to_parent);
-        PFM_Mat4x4_Mult4x4(&to_parent, &to_curr, &bind_trans);
+        PFM_SIMD_Mat4x4_Mult4x4(&to_parent, &to_curr, &bind_trans);
 
         joint_idx = joint->parent_idx;
     }
@@ -113,34 +107,60 @@ static void a_make_bind_mat(int joint_idx, const struct skeleton *skel, mat4x4_t
     *out = bind_trans;
 }
 
-static void a_make_pose_mat(const struct entity *ent, int joint_idx, const struct skeleton *skel, mat4x4_t *out)
+static void a_make_pose_mat_memo(int joint_idx, const struct skeleton *skel, 
+                                 const mat4x4_t *to_parent, const struct anim_sample *sample, 
+                                 bool *done)
+{
+    if(done[joint_idx])
+        return;
+
+    const struct joint *joint = &skel->joints[joint_idx];
+
+    if(joint->parent_idx >= 0) {
+        /* Compose with the parent's object-space transform, computing it first if needed */
+        a_make_pose_mat_memo(joint->parent_idx, skel, to_parent, sample, done);
+        PFM_SIMD_Mat4x4_Mult4x4(&sample->pose_mats[joint->parent_idx], &to_parent[joint_idx], 
+            &sample->pose_mats[joint_idx]);
+    }else{
+        sample->pose_mats[joint_idx] = to_parent[joint_idx];
+    }
+    done[joint_idx] = true;
+}
+
+/* Returns the object-space pose matrices of all joints for the current frame of
+ * the entity's active clip. The matrices are computed once per sample, with every
+ * joint's transform being derived from its' parent's, and then shared by all
+ * entities using the same animation data.
+ */
+static const mat4x4_t *a_curr_pose_mats(const struct entity *ent, const struct skeleton *skel)
 {
     struct anim_ctx *ctx = ent->anim_ctx;
-    struct anim_sample *sample = &ctx->active->samples[ctx->curr_frame];
+    return A_SamplePoseMats(skel, &ctx->active->samples[ctx->curr_frame]);
+}
 
-    mat4x4_t pose_trans;
-    PFM_Mat4x4_Identity(&pose_trans);
+/*****************************************************************************/
+/* EXTERN FUNCTIONS                                                          */
+/*****************************************************************************/
 
-    /* Same as a_make_bind_mat, except for the current pose. */
-    while(joint_idx >= 0) {
+const mat4x4_t *A_SamplePoseMats(const struct skeleton *skel, struct anim_sample *sample)
+{
+    if(sample->pose_mats_valid)
+        return sample->pose_mats;
 
-        struct joint *joint = &skel->joints[joint_idx];
-        struct SQT   *pose_sqt = &sample->local_joint_poses[joint_idx];
-        mat4x4_t to_parent, to_curr = pose_trans;
+    bool done[skel->num_joints];
+    memset(done, 0, sizeof(done));
 
-        a_mat_from_sqt(pose_sqt, &to_parent);
-        PFM_Mat4x4_Mult4x4(&to_parent, &to_curr, &pose_trans);
+    mat4x4_t to_parent[skel->num_joints];
+    PFM_Mat4x4_MakeSQTBatch(skel->num_joints, sample->local_joint_poses, to_parent);
 
-        joint_idx = joint->parent_idx;
+    for(int j = 0; j < skel->num_joints; j++) {
+        a_make_pose_mat_memo(j, skel, to_parent, sample, done);
     }
 
-    *out = pose_trans;
+    sample->pose_mats_valid = true;
+    return sample->pose_mats;
 }
 
-/*****************************************************************************/
-/* EXTERN FUNCTIONS                                                          */
-/*****************************************************************************/
-
 void A_InitCtx(const struct entity *ent, const char *idle_clip, unsigned key_fps)
 {
     A_SetIdleClip(ent, idle_clip, key_fps);
@@ -169,7 +189,7 @@ void A_SetActiveClip(const struct entity *ent, const char *name,
     ctx->mode = mode;
     ctx->key_fps = key_fps;
     ctx->curr_frame = 0;
-    ctx->curr_frame_start_ticks = SDL_GetTicks();
+    ctx->curr_frame_start_ticks = Clock_Now();
 }
 
 void A_Update(struct entity *ent)
@@ -177,7 +197,7 @@ void A_Update(struct entity *ent)
     struct anim_ctx *ctx = ent->anim_ctx;
 
     float frame_period_secs = 1.0f/ctx->key_fps;
-    uint32_t curr_ticks = SDL_GetTicks();
+    uint32_t curr_ticks = Clock_Now();
     float elapsed_secs = (curr_ticks - ctx->curr_frame_start_ticks)/1000.0f;
 
     if(elapsed_secs > frame_period_secs) {
@@ -207,19 +227,25 @@ void A_Update(struct entity *ent)
 }
 
 void A_GetRenderState(const struct entity *ent, size_t *out_njoints, 
-                      mat4x4_t *out_curr_pose, const mat4x4_t **out_inv_bind_pose)
+                      const mat4x4_t **out_curr_pose, const mat4x4_t **out_inv_bind_pose)
 {
     assert(ent->flags & ENTITY_FLAG_ANIMATED);
     struct anim_data *priv = (struct anim_data*)ent->anim_private;
 
-    for(int j = 0; j < priv->skel.num_joints; j++) {
-        a_make_pose_mat(ent, j, &priv->skel, out_curr_pose + j);
-    }
-
     *out_njoints = priv->skel.num_joints;
+    *out_curr_pose = a_curr_pose_mats(ent, &priv->skel);
     *out_inv_bind_pose = priv->skel.inv_bind_poses;
 }
 
+void A_GetBakedPoseIdx(const struct entity *ent, int *out_clip_base, int *out_frame)
+{
+    assert(ent->flags & ENTITY_FLAG_ANIMATED);
+    struct anim_ctx *ctx = ent->anim_ctx;
+
+    *out_clip_base = ctx->active->baked_base;
+    *out_frame = ctx->curr_frame;
+}
+
 const struct skeleton *A_GetBindSkeleton(const struct entity *ent)
 {
     struct anim_data *priv = ent->anim_private;
@@ -259,11 +285,11 @@ const struct skeleton *A_GetCurrPoseSkeleton(const struct entity *ent)
 
     ret->inv_bind_poses = (void*)((char*)ret->bind_sqts + num_joints * sizeof(struct SQT));
 
+    const mat4x4_t *pose_mats = a_curr_pose_mats(ent, &priv->skel);
     for(int i = 0; i < ret->num_joints; i++) {
     
         /* Update the inverse bind matrices for the current frame */
-        mat4x4_t pose_mat;
-        a_make_pose_mat(ent, i, ret, &pose_mat);
+        mat4x4_t pose_mat = pose_mats[i];
         PFM_Mat4x4_Inverse(&pose_mat, &ret->inv_bind_poses[i]);
     }
 
@@ -290,6 +316,13 @@ const struct aabb *A_GetCurrPoseAABB(const struct entity *ent)
     return &ctx->active->samples[ctx->curr_frame].sample_aabb;
 }
 
+const struct aabb *A_GetMaxPoseAABB(const struct entity *ent)
+{
+    assert(ent->flags & ENTITY_FLAG_COLLISION);
+    struct anim_data *priv = ent->anim_private;
+    return &priv->max_aabb;
+}
+
 void A_AddTimeDelta(const struct entity *ent, uint32_t dt)
 {
     struct anim_ctx *ctx = ent->anim_ctx;
@@ -355,7 +388,7 @@ bool A_SaveState(struct SDL_RWops *stream, const struct entity *ent)
 
     struct attr curr_frame_ticks_elapsed = (struct attr){
         .type = TYPE_INT,
-        .val.as_int = SDL_GetTicks() - ctx->curr_frame_start_ticks
+        .val.as_int = Clock_Now() - ctx->curr_frame_start_ticks
     };
     CHK_TRUE_RET(Attr_Write(stream, &curr_frame_ticks_elapsed, "curr_frame_ticks_elapsed"));
 
@@ -393,7 +426,7 @@ bool A_LoadState(struct SDL_RWops *stream, const struct entity *ent)
 
     CHK_TRUE_RET(Attr_Parse(stream, &attr, true));
     CHK_TRUE_RET(attr.type == TYPE_INT);
-    ctx->curr_frame_start_ticks = SDL_GetTicks() - attr.val.as_int;
+    ctx->curr_frame_start_ticks = Clock_Now() - attr.val.as_int;
 
     return true;
 }
@@ -44,6 +44,9 @@
 #include <string.h>
 
 
+#define MIN(a, b)    ((a) < (b) ? (a) : (b))
+#define MAX(a, b)    ((a) > (b) ? (a) : (b))
+
 /*****************************************************************************/
 /* STATIC FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -155,11 +158,13 @@ size_t al_data_buffsize_from_header(const struct pfobj_hdr *header)
      *    1. a 'struct anim_sample' (for referencing this frame's SQT array)
      *    2. num_joint number of 'struct SQT's (each joint's transform
      *       for the current frame)
+     *    3. num_joint number of 'mat4x4_t's (the cached pose matrices 
+     *       for the current frame)
      */
     for(unsigned as_idx  = 0; as_idx < header->num_as; as_idx++) {
 
         ret += header->frame_counts[as_idx] * 
-               (sizeof(struct anim_sample) + header->num_joints * sizeof(struct SQT));
+               (sizeof(struct anim_sample) + header->num_joints * (sizeof(struct SQT) + sizeof(mat4x4_t)));
     }
 
     return ret;
@@ -194,6 +199,9 @@ size_t A_AL_CtxBuffSize(void)
  *  | struct SQT[num_as * num_joints] |
  *  |    (stored in clip-major order) |
  *  +---------------------------------+
+ *  | mat4x4_t[num_as * num_frames *  |
+ *  |    num_joints] (pose cache)     |
+ *  +---------------------------------+
  *
  */
 
@@ -232,10 +240,13 @@ void *A_AL_PrivFromStream(const struct pfobj_hdr *header, SDL_RWops *stream)
         unused_base += sizeof(struct anim_sample) * header->frame_counts[i];
     }
 
+    int baked_base = 0;
     for(int i = 0; i < header->num_as; i++) {
 
         ret->anims[i].skel = &ret->skel;
         ret->anims[i].num_frames = header->frame_counts[i];
+        ret->anims[i].baked_base = baked_base;
+        baked_base += header->frame_counts[i] * header->num_joints;
 
         for(int f = 0; f < header->frame_counts[i]; f++) {
 
@@ -244,6 +255,15 @@ void *A_AL_PrivFromStream(const struct pfobj_hdr *header, SDL_RWops *stream)
         }
     }
 
+    for(int i = 0; i < header->num_as; i++) {
+        for(int f = 0; f < header->frame_counts[i]; f++) {
+
+            ret->anims[i].samples[f].pose_mats = (void*)unused_base;
+            ret->anims[i].samples[f].pose_mats_valid = false;
+            unused_base += sizeof(mat4x4_t) * header->num_joints;
+        }
+    }
+
     /*---------------------------------------------------------------
      * Then we populate priv members with the file data 
      *---------------------------------------------------------------
@@ -260,6 +280,24 @@ void *A_AL_PrivFromStream(const struct pfobj_hdr *header, SDL_RWops *stream)
             goto fail_parse;
     }
 
+    ret->max_aabb = (struct aabb){0};
+    for(int i = 0; i < header->num_as && header->has_collision; i++) {
+        for(int f = 0; f < ret->anims[i].num_frames; f++) {
+
+            const struct aabb *curr = &ret->anims[i].samples[f].sample_aabb;
+            if(i == 0 && f == 0) {
+                ret->max_aabb = *curr;
+                continue;
+            }
+            ret->max_aabb.x_min = MIN(ret->max_aabb.x_min, curr->x_min);
+            ret->max_aabb.x_max = MAX(ret->max_aabb.x_max, curr->x_max);
+            ret->max_aabb.y_min = MIN(ret->max_aabb.y_min, curr->y_min);
+            ret->max_aabb.y_max = MAX(ret->max_aabb.y_max, curr->y_max);
+            ret->max_aabb.z_min = MIN(ret->max_aabb.z_min, curr->z_min);
+            ret->max_aabb.z_max = MAX(ret->max_aabb.z_max, curr->z_max);
+        }
+    }
+
     A_PrepareInvBindMatrices(&ret->skel);
     return ret;
 
@@ -269,6 +307,38 @@ fail_alloc:
     return NULL;
 }
 
+size_t A_AL_NumBakedSkinMats(void *priv_data)
+{
+    struct anim_data *priv = priv_data;
+    size_t ret = 0;
+
+    for(int i = 0; i < priv->num_anims; i++) {
+        ret += priv->anims[i].num_frames * priv->skel.num_joints;
+    }
+    return ret;
+}
+
+void A_AL_BakeSkinMats(void *priv_data, mat4x4_t *out)
+{
+    struct anim_data *priv = priv_data;
+
+    for(int i = 0; i < priv->num_anims; i++) {
+
+        struct anim_clip *clip = &priv->anims[i];
+        for(int f = 0; f < clip->num_frames; f++) {
+
+            const mat4x4_t *pose_mats = A_SamplePoseMats(&priv->skel, &clip->samples[f]);
+            mat4x4_t *frame_out = out + clip->baked_base + f * priv->skel.num_joints;
+
+            for(int j = 0; j < priv->skel.num_joints; j++) {
+
+                mat4x4_t pose = pose_mats[j];
+                PFM_Mat4x4_Mult4x4(&pose, &priv->skel.inv_bind_poses[j], &frame_out[j]);
+            }
+        }
+    }
+}
+
 void A_AL_DumpPrivate(FILE *stream, void *priv_data)
 {
     struct anim_data *priv = priv_data;
@@ -41,12 +41,18 @@
 #include "../collision.h"
 
 #include <stddef.h>
+#include <stdbool.h>
 
 #define ANIM_NAME_LEN  32
 
 struct anim_sample{
     struct SQT  *local_joint_poses;
     struct aabb  sample_aabb;
+    /* Object-space transform of every joint for this sample. Since frames are 
+     * not interpolated, these are shared by all entities playing this sample.
+     * They are computed the first time they are needed. */
+    mat4x4_t    *pose_mats;
+    bool         pose_mats_valid;
 };
 
 struct anim_clip{
@@ -54,12 +60,17 @@ struct anim_clip{
     struct skeleton    *skel;
     unsigned            num_frames;
     struct anim_sample *samples;
+    /* Index of this clip's first matrix in the baked skinning 
+     * matrices (see A_AL_BakeSkinMats) */
+    int                 baked_base;
 };
 
 struct anim_data{
     unsigned          num_anims;
     struct skeleton   skel;
     struct anim_clip *anims;
+    /* The union of all the samples' AABBs */
+    struct aabb       max_aabb;
 };
 
 #endif
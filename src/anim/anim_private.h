@@ -36,7 +36,10 @@
 #ifndef ANIM_PRIVATE_H
 #define ANIM_PRIVATE_H
 
+#include "../pf_math.h"
+
 struct skeleton;
+struct anim_sample;
 
 /* Computes the inverse bind matrix for each joint based on the 
  * joint's bind SQT. The inverse bind matrix will be used by the vertex
@@ -48,4 +51,9 @@ struct skeleton;
  */
 void A_PrepareInvBindMatrices(const struct skeleton *skel);
 
+/* Returns the object-space pose matrix of every joint for the sample. The
+ * matrices are computed on the first call and cached in the sample. 
+ */
+const mat4x4_t *A_SamplePoseMats(const struct skeleton *skel, struct anim_sample *sample);
+
 #endif
@@ -94,11 +94,23 @@ void                   A_SetActiveClip(const struct entity *ent, const char *nam
 void                   A_Update(struct entity *ent);
 
 /* ---------------------------------------------------------------------------
- * Retreive a copy of the state needed to render an animated entity.
+ * Retreive the state needed to render an animated entity. The returned pose
+ * matrices are shared by all entities showing the same animation frame. They 
+ * are immutable and remain valid for as long as the entity's asset is loaded.
  * ---------------------------------------------------------------------------
  */
 void                   A_GetRenderState(const struct entity *ent, size_t *out_njoints, 
-                                        mat4x4_t *out_curr_pose, const mat4x4_t **out_inv_bind_pose);
+                                        const mat4x4_t **out_curr_pose, 
+                                        const mat4x4_t **out_inv_bind_pose);
+
+/* ---------------------------------------------------------------------------
+ * Get the location of the entity's current skinning matrices within the 
+ * buffer written by 'A_AL_BakeSkinMats'. The matrices for the current frame 
+ * begin at index (clip_base + frame * num_joints).
+ * ---------------------------------------------------------------------------
+ */
+void                   A_GetBakedPoseIdx(const struct entity *ent, int *out_clip_base, 
+                                         int *out_frame);
 
 /* ---------------------------------------------------------------------------
  * Simple utility to get a reference to the skeleton structure in its' default
@@ -125,6 +137,14 @@ const struct skeleton *A_GetCurrPoseSkeleton(const struct entity *ent);
  */
 const struct aabb     *A_GetCurrPoseAABB(const struct entity *ent);
 
+/* ---------------------------------------------------------------------------
+ * Returns a pointer to an AABB that bounds every sample of every clip. The 
+ * pointer should not be freed. This should only be called for entities with 
+ * the COLLISION flag set.
+ * ---------------------------------------------------------------------------
+ */
+const struct aabb     *A_GetMaxPoseAABB(const struct entity *ent);
+
 /* ---------------------------------------------------------------------------
  * Add a time delta (in SDL ticks) to the start time of the previous frame.
  * This is used to shift the timestamps after pausing and resuming the game.
@@ -188,6 +208,20 @@ size_t A_AL_CtxBuffSize(void);
  */
 void  *A_AL_PrivFromStream(const struct pfobj_hdr *header, SDL_RWops *stream);
 
+/* ---------------------------------------------------------------------------
+ * Returns the number of skinning matrices written by 'A_AL_BakeSkinMats'.
+ * ---------------------------------------------------------------------------
+ */
+size_t A_AL_NumBakedSkinMats(void *priv_data);
+
+/* ---------------------------------------------------------------------------
+ * Write the skinning matrix (pose * inverse bind pose) of every joint, for 
+ * every frame of every clip, to the 'out' buffer. The matrices are laid out 
+ * in clip-major, then frame-major order.
+ * ---------------------------------------------------------------------------
+ */
+void   A_AL_BakeSkinMats(void *priv_data, mat4x4_t *out);
+
 /* ---------------------------------------------------------------------------
  * Dumps private animation data in PF Object format.
  * ---------------------------------------------------------------------------
@@ -24,12 +24,6 @@
 
 #define JOINT_NAME_LEN 32
 
-struct SQT{
-    vec3_t scale;
-    quat_t quat_rotation;
-    vec3_t trans;
-};
-
 struct joint{
     char       name[JOINT_NAME_LEN];
     int        parent_idx;
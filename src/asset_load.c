@@ -36,6 +36,7 @@
 #include "asset_load.h"
 #include "entity.h"
 #include "main.h"
+#include "config.h"
 
 #include "render/public/render_al.h"
 #include "anim/public/anim.h"
@@ -180,6 +181,20 @@ static void al_set_ent_defaults(struct entity *ent)
     ent->vision_range = 0.0f;
 }
 
+static void al_bake_skin_mats(void *render_private, void *anim_private)
+{
+#if CONFIG_USE_BATCH_RENDERING && CONFIG_USE_BAKED_ANIM
+    size_t nmats = A_AL_NumBakedSkinMats(anim_private);
+    mat4x4_t *mats = malloc(nmats * sizeof(mat4x4_t));
+    if(!mats)
+        return;
+
+    A_AL_BakeSkinMats(anim_private, mats);
+    R_AL_BakeSkinMats(render_private, mats, nmats);
+    free(mats);
+#endif
+}
+
 /*****************************************************************************/
 /* EXTERN FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -245,6 +260,7 @@ struct entity *AL_EntityFromPFObj(const char *base_path, const char *pfobj_name,
 
         if(header.num_as > 0) {
             res.ent_flags |= ENTITY_FLAG_ANIMATED;
+            al_bake_skin_mats(res.render_private, res.anim_private);
         }
 
         if(!header.has_collision) {
@@ -0,0 +1,134 @@
+/*
+ *  This file is part of Permafrost Engine. 
+ *  Copyright (C) 2020 Eduard Permyakov 
+ *
+ *  Permafrost Engine is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Permafrost Engine is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ *  Linking this software statically or dynamically with other modules is making 
+ *  a combined work based on this software. Thus, the terms and conditions of 
+ *  the GNU General Public License cover the whole combination. 
+ *  
+ *  As a special exception, the copyright holders of Permafrost Engine give 
+ *  you permission to link Permafrost Engine with independent modules to produce 
+ *  an executable, regardless of the license terms of these independent 
+ *  modules, and to copy and distribute the resulting executable under 
+ *  terms of your choice, provided that you also meet, for each linked 
+ *  independent module, the terms and conditions of the license of that 
+ *  module. An independent module is a module which is not derived from 
+ *  or based on Permafrost Engine. If you modify Permafrost Engine, you may 
+ *  extend this exception to your version of Permafrost Engine, but you are not 
+ *  obliged to do so. If you do not wish to do so, delete this exception 
+ *  statement from your version.
+ *
+ */
+
+#include "clock.h"
+#include "config.h"
+#include "event.h"
+#include "main.h"
+
+#include <SDL.h>
+
+
+#define STEP_MS     (1000.0 / CLOCK_TICK_HZ)
+
+/*****************************************************************************/
+/* STATIC VARIABLES                                                          */
+/*****************************************************************************/
+
+static uint64_t s_num_ticks;
+static uint64_t s_pending_ticks;
+static uint64_t s_last_pc;
+static double   s_accum_ms;
+
+/*****************************************************************************/
+/* STATIC FUNCTIONS                                                          */
+/*****************************************************************************/
+
+static void clock_step(void)
+{
+    s_num_ticks++;
+    E_Global_Notify(EVENT_60HZ_TICK, NULL, ES_ENGINE);
+}
+
+/*****************************************************************************/
+/* EXTERN FUNCTIONS                                                          */
+/*****************************************************************************/
+
+bool Clock_Init(void)
+{
+    s_num_ticks = 0;
+    s_pending_ticks = 0;
+    s_accum_ms = 0.0;
+    s_last_pc = SDL_GetPerformanceCounter();
+    return true;
+}
+
+void Clock_Shutdown(void)
+{
+    s_pending_ticks = 0;
+}
+
+void Clock_Update(void)
+{
+    ASSERT_IN_MAIN_THREAD();
+
+    uint64_t curr_pc = SDL_GetPerformanceCounter();
+    double elapsed_ms = (curr_pc - s_last_pc) * 1000.0 / SDL_GetPerformanceFrequency();
+    s_last_pc = curr_pc;
+
+    /* Wall time spent fast-forwarding is not carried over */
+    if(s_pending_ticks > 0) {
+        s_pending_ticks--;
+        clock_step();
+        return;
+    }
+
+    s_accum_ms += elapsed_ms;
+
+    int nsteps = 0;
+    while(s_accum_ms >= STEP_MS && nsteps < CONFIG_MAX_CATCHUP_TICKS) {
+        clock_step();
+        s_accum_ms -= STEP_MS;
+        nsteps++;
+    }
+
+    /* When we are too far behind (ex. after a long stall), drop the 
+     * backlog instead of trying to catch up over the next frames. */
+    if(nsteps == CONFIG_MAX_CATCHUP_TICKS && s_accum_ms >= STEP_MS) {
+        s_accum_ms = 0.0;
+    }
+}
+
+uint32_t Clock_Now(void)
+{
+    return (uint32_t)(s_num_ticks * 1000 / CLOCK_TICK_HZ);
+}
+
+uint64_t Clock_NumTicks(void)
+{
+    return s_num_ticks;
+}
+
+void Clock_RunTicks(uint64_t nticks)
+{
+    ASSERT_IN_MAIN_THREAD();
+    s_pending_ticks += nticks;
+}
+
+uint64_t Clock_PendingTicks(void)
+{
+    return s_pending_ticks;
+}
+
@@ -0,0 +1,69 @@
+/*
+ *  This file is part of Permafrost Engine. 
+ *  Copyright (C) 2020 Eduard Permyakov 
+ *
+ *  Permafrost Engine is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Permafrost Engine is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ *  Linking this software statically or dynamically with other modules is making 
+ *  a combined work based on this software. Thus, the terms and conditions of 
+ *  the GNU General Public License cover the whole combination. 
+ *  
+ *  As a special exception, the copyright holders of Permafrost Engine give 
+ *  you permission to link Permafrost Engine with independent modules to produce 
+ *  an executable, regardless of the license terms of these independent 
+ *  modules, and to copy and distribute the resulting executable under 
+ *  terms of your choice, provided that you also meet, for each linked 
+ *  independent module, the terms and conditions of the license of that 
+ *  module. An independent module is a module which is not derived from 
+ *  or based on Permafrost Engine. If you modify Permafrost Engine, you may 
+ *  extend this exception to your version of Permafrost Engine, but you are not 
+ *  obliged to do so. If you do not wish to do so, delete this exception 
+ *  statement from your version.
+ *
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The simulation clock advances in fixed steps of 1/60th of a second, emitting 
+ * an 'EVENT_60HZ_TICK' for every step. All simulation timing (the lower-rate 
+ * ticks derived from the 60Hz tick, animations) is measured in steps of this 
+ * clock rather than wall time, so that the simulation can be run faster than 
+ * real-time and will advance identically regardless of the frame rate. 
+ *
+ * In the default mode, steps are accumulated from the elapsed wall time. While
+ * a 'Clock_RunTicks' request is pending, exactly one step is taken every frame, 
+ * independent of how much wall time has elapsed.
+ */
+
+#define CLOCK_TICK_HZ   (60)
+
+bool     Clock_Init(void);
+void     Clock_Shutdown(void);
+/* Take all the steps that are due for this frame. Should be called once 
+ * per frame from the main thread. */
+void     Clock_Update(void);
+/* Simulation time in milliseconds */
+uint32_t Clock_Now(void);
+/* The number of steps taken since initialization */
+uint64_t Clock_NumTicks(void);
+/* Take the next 'nticks' steps as fast as possible - one per frame */
+void     Clock_RunTicks(uint64_t nticks);
+uint64_t Clock_PendingTicks(void);
+
+#endif
+
@@ -40,6 +40,16 @@
 #include <SDL.h>
 
 #define CONFIG_USE_BATCH_RENDERING  (false)
+/* When batch rendering is used, upload the skinning matrices of every 
+ * animation frame once at load time and have the shaders index them, 
+ * instead of streaming every instance's joint matrices every frame.
+ */
+#define CONFIG_USE_BAKED_ANIM       (true)
+/* When batch rendering is used, copy all the terrain chunks into a single
+ * vertex buffer and draw the visible chunks of a render pass with a single
+ * multi-draw call, instead of issuing a draw command for every chunk.
+ */
+#define CONFIG_USE_BATCH_TERRAIN    (true)
 
 /* The far end of the camera's clipping frustrum, in OpenGL coordinates */
 #define CONFIG_DRAWDIST             (1000)
@@ -59,13 +69,69 @@
  */
 #define CONFIG_SHADOW_FOV           (160)
 
+/* The distances from the camera to a terrain chunk's bounding box, in OpenGL
+ * coordinates, past which the chunk is drawn with its' coarser levels of detail.
+ * For reference, a chunk is 256 units wide.
+ */
+#define CONFIG_TERRAIN_LOD1_DIST    (192)
+#define CONFIG_TERRAIN_LOD2_DIST    (384)
+/* The number of levels of detail by which the terrain is coarsened when it
+ * is rendered into the shadow map.
+ */
+#define CONFIG_TERRAIN_SHADOW_LOD_BIAS (1)
+
 #define CONFIG_SETTINGS_FILENAME    "pf.conf"
 
 #define CONFIG_LOS_CACHE_SZ         (512)
 #define CONFIG_FLOW_CAHCE_SZ        (512)
+#define CONFIG_INTEGRATION_CACHE_SZ (256)
 #define CONFIG_MAPPING_CACHE_SZ     (512)
 #define CONFIG_GRID_PATH_CACHE_SZ   (8192)
+#define CONFIG_FOG_STENCIL_CACHE_SZ (4096)
+
+/* When set, the per-chunk tile-to-portal travel costs are kept as 16-bit 
+ * fixed-point values and each portal's slice is only computed and allocated 
+ * when it is first queried, instead of eagerly storing a dense float table 
+ * for every possible portal of every chunk.
+ */
+#define CONFIG_LAZY_PORTAL_TRAVEL_COSTS (true)
+
+/* When set, the flow fields for all the chunks along a requested path that 
+ * are missing from the cache are generated in parallel on the worker threads. 
+ * The LOS fields, which depend on the previous chunk's field, are still 
+ * built serially.
+ */
+#define CONFIG_PARALLEL_FIELD_GEN   (true)
+
+/* The maximum amount of time spent servicing asynchronous path requests 
+ * per frame. At least one pending request is serviced every frame.
+ */
+#define CONFIG_PATH_REQ_BUDGET_MS   (2)
+
+/* The maximum number of simulation clock ticks taken in a single frame 
+ * when catching up to the wall clock. Any larger backlog is dropped.
+ */
+#define CONFIG_MAX_CATCHUP_TICKS    (10)
+
+/* When set, the entity positions are indexed by a uniform grid of small 
+ * buckets instead of a point quadtree. Moving an entity within its' bucket 
+ * is then an in-place update.
+ */
+#define CONFIG_POS_USE_GRID         (true)
+
+/* The number of ray pairs that the ClearPath collision avoidance may intersect 
+ * in a single movement tick. It is split evenly between all the moving entities. 
+ * An entity with too many neighbours for its' share will only avoid the nearest 
+ * ones.
+ */
+#define CONFIG_CLEARPATH_TICK_BUDGET (4 * 1024 * 1024)
 
 #define CONFIG_FRAME_STEP_HOTKEY    (SDL_SCANCODE_SPACE)
 
+/* The upper bound for the 'pf.video.max_frames_ahead' setting: the number of 
+ * frames that the simulation thread may get ahead of the render thread. Each
+ * frame adds at most one frame of input latency.
+ */
+#define CONFIG_MAX_FRAMES_AHEAD     (2)
+
 #endif
@@ -36,6 +36,7 @@
 #include "entity.h" 
 #include "game/public/game.h"
 #include "anim/public/anim.h"
+#include "pf_math_simd.h"
 
 #include <assert.h>
 
@@ -51,15 +52,11 @@ static uint32_t s_next_uid = 0;
 
 void Entity_ModelMatrix(const struct entity *ent, mat4x4_t *out)
 {
-    mat4x4_t trans, scale, rot, tmp;
     vec3_t pos = G_Pos_Get(ent->uid);
 
-    PFM_Mat4x4_MakeTrans(pos.x, pos.y, pos.z, &trans);
-    PFM_Mat4x4_MakeScale(ent->scale.x, ent->scale.y, ent->scale.z, &scale);
-    PFM_Mat4x4_RotFromQuat(&ent->rotation, &rot);
-
-    PFM_Mat4x4_Mult4x4(&scale, &rot, &tmp);
-    PFM_Mat4x4_Mult4x4(&trans, &tmp, out);
+    /*  (T * S * R) 
+     */
+    PFM_SIMD_Mat4x4_MakeTSR(&pos, &ent->rotation, &ent->scale, out);
 }
 
 uint32_t Entity_NewUID(void)
@@ -103,7 +100,7 @@ void Entity_CurrentOBB(const struct entity *ent, struct obb *out)
 
     vec4_t obb_verts_homo[8];
     for(int i = 0; i < 8; i++) {
-        PFM_Mat4x4_Mult4x1(&model, identity_verts_homo + i, obb_verts_homo + i);
+        PFM_SIMD_Mat4x4_Mult4x1(&model, identity_verts_homo + i, obb_verts_homo + i);
         out->corners[i] = (vec3_t){
             obb_verts_homo[i].x / obb_verts_homo[i].w,
             obb_verts_homo[i].y / obb_verts_homo[i].w,
@@ -112,7 +109,7 @@ void Entity_CurrentOBB(const struct entity *ent, struct obb *out)
     }
 
     vec4_t obb_center_homo;
-    PFM_Mat4x4_Mult4x1(&model, &identity_center_homo, &obb_center_homo);
+    PFM_SIMD_Mat4x4_Mult4x1(&model, &identity_center_homo, &obb_center_homo);
     out->center = (vec3_t){
         obb_center_homo.x / obb_center_homo.w,
         obb_center_homo.y / obb_center_homo.w,
@@ -146,7 +143,7 @@ vec3_t Entity_TopCenterPointWS(const struct entity *ent)
     vec4_t out_ws_homo;
 
     Entity_ModelMatrix(ent, &model);
-    PFM_Mat4x4_Mult4x1(&model, &top_center_homo, &out_ws_homo);
+    PFM_SIMD_Mat4x4_Mult4x1(&model, &top_center_homo, &out_ws_homo);
 
     return (vec3_t) {
         out_ws_homo.x / out_ws_homo.w,
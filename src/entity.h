@@ -90,7 +90,9 @@ struct ent_anim_rstate{
     mat4x4_t        model;
     size_t          njoints;
     const mat4x4_t *inv_bind_pose; /* static, use shallow copy */
-    mat4x4_t        curr_pose[MAX_JOINTS];
+    const mat4x4_t *curr_pose;     /* shared and immutable, use shallow copy */
+    int             baked_clip_base;
+    int             baked_frame;
 };
 
 struct ent_vis_state{
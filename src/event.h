@@ -79,6 +79,7 @@ enum eventtype{
     EVENT_ENTITY_DEATH,
     EVENT_ATTACK_END,
     EVENT_GAME_SIMSTATE_CHANGED,
+    EVENT_PATH_READY,
 
     EVENT_ENGINE_LAST = 0x1ffff,
 };
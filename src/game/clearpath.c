@@ -42,11 +42,11 @@
  */
 
 #include "clearpath.h"
+#include "clearpath_simd.h"
 #include "public/game.h"
 #include "movement.h"
 #include "../event.h"
 #include "../entity.h"
-#include "../collision.h"
 #include "../settings.h"
 #include "../ui.h"
 #include "../perf.h"
@@ -57,36 +57,35 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdlib.h>
+#include <math.h>
 
 
-#define EPSILON         (1.0/1024)
 #define MAX_SAVED_VOS   (512)
+#define MIN(a, b)       ((a) < (b) ? (a) : (b))
+#define MAX(a, b)       ((a) > (b) ? (a) : (b))
 
 VEC_TYPE(vec2, vec2_t)
 VEC_IMPL(static inline, vec2, vec2_t)
 
+/* Velocity obstacles are kept in SoA form while solving (see clearpath_simd.h).
+ * This is only used for saving the debug state. 
+ */
 struct VO{
     vec2_t xz_apex;
     vec2_t xz_left_side;
     vec2_t xz_right_side;
 };
 
-struct RVO{
-    vec2_t xz_apex;
-    vec2_t xz_left_side;
-    vec2_t xz_right_side;
-};
-
-struct HRVO{
-    vec2_t xz_apex;
-    vec2_t xz_left_side;
-    vec2_t xz_right_side;
+struct nb_dist{
+    float  dist;
+    size_t idx;
 };
 
 struct saved_ctx{
     struct cp_ent cpent;
     vec2_t        ent_des_v;
-    struct HRVO   hrvos[MAX_SAVED_VOS];
+    struct VO     hrvos[MAX_SAVED_VOS];
     struct VO     vos[MAX_SAVED_VOS];
     size_t        n_hrvos;
     size_t        n_vos;
@@ -106,247 +105,83 @@ static struct saved_ctx s_debug_saved;
 /* STATIC FUNCTIONS                                                          */
 /*****************************************************************************/
 
-static void compute_vo_edges(struct cp_ent ent, struct cp_ent neighb,
-                             vec2_t *out_xz_right, vec2_t *out_xz_left)
+static struct VO vo_at(const struct cp_vo_soa *vos, size_t idx)
 {
-    vec2_t ent_to_nb, right;
-    PFM_Vec2_Sub(&neighb.xz_pos, &ent.xz_pos, &ent_to_nb);
-    PFM_Vec2_Normal(&ent_to_nb, &ent_to_nb);
-
-    right = (vec2_t){-ent_to_nb.raw[1], ent_to_nb.raw[0]};
-    PFM_Vec2_Scale(&right, neighb.radius + ent.radius + CLEARPATH_BUFFER_RADIUS, &right);
-
-    vec2_t right_tangent, left_tangent;
-    PFM_Vec2_Add(&neighb.xz_pos, &right, &right_tangent);
-    PFM_Vec2_Sub(&neighb.xz_pos, &right, &left_tangent);
-
-    PFM_Vec2_Sub(&right_tangent, &ent.xz_pos, out_xz_right);
-    PFM_Vec2_Normal(out_xz_right, out_xz_right);
-    assert(fabs(PFM_Vec2_Len(out_xz_right) - 1.0f) < EPSILON);
-
-    PFM_Vec2_Sub(&left_tangent, &ent.xz_pos, out_xz_left);
-    PFM_Vec2_Normal(out_xz_left, out_xz_left);
-    assert(fabs(PFM_Vec2_Len(out_xz_left) - 1.0f) < EPSILON);
-}
-
-static struct VO compute_vo(struct cp_ent ent, struct cp_ent neighb)
-{
-    struct VO ret;
-    compute_vo_edges(ent, neighb, &ret.xz_right_side, &ret.xz_left_side);
-    PFM_Vec2_Add(&ent.xz_pos, &neighb.xz_vel, &ret.xz_apex);
-    return ret;
-}
-
-static struct RVO compute_rvo(struct cp_ent ent, struct cp_ent neighb)
-{
-    struct RVO ret;
-    compute_vo_edges(ent, neighb, &ret.xz_right_side, &ret.xz_left_side);
-
-    vec2_t apex_off;
-    PFM_Vec2_Add(&ent.xz_vel, &neighb.xz_vel, &apex_off);
-    PFM_Vec2_Scale(&apex_off, 0.5f, &apex_off);
-    PFM_Vec2_Add(&ent.xz_pos, &apex_off, &ret.xz_apex);
-
-    return ret;
+    return (struct VO){
+        .xz_apex       = (vec2_t){vos->apex_x[idx], vos->apex_z[idx]},
+        .xz_left_side  = (vec2_t){vos->left_x[idx], vos->left_z[idx]},
+        .xz_right_side = (vec2_t){vos->right_x[idx], vos->right_z[idx]},
+    };
 }
 
-static struct HRVO compute_hrvo(struct cp_ent ent, struct cp_ent neighb)
+static int compare_nb_dist(const void *a, const void *b)
 {
-    struct HRVO ret;
-    struct RVO rvo = compute_rvo(ent, neighb);
-    struct line_2d l1, l2;
-    vec2_t intersec_point;
-
-    vec2_t centerline;
-    PFM_Vec2_Add(&rvo.xz_left_side, &rvo.xz_right_side, &centerline);
-
-    vec2_t vo_apex;
-    PFM_Vec2_Add(&ent.xz_pos, &neighb.xz_vel, &vo_apex);
-
-    float det = (centerline.x * ent.xz_vel.y) - (centerline.y * ent.xz_vel.x);
-    if(det > EPSILON) { /* the entity velocity is left of the RVO centerline */
-
-        l1 = (struct line_2d){rvo.xz_apex, rvo.xz_left_side};
-        l2 = (struct line_2d){vo_apex, rvo.xz_right_side};
-        bool collide = C_InfiniteLineIntersection(l1, l2, &intersec_point);
-        assert(collide);
-        ret.xz_apex = intersec_point;
-
-    }else if(det < -EPSILON) { /* the entity velocity is right of the RVO centerline */
-
-        l1 = (struct line_2d){rvo.xz_apex, rvo.xz_right_side};
-        l2 = (struct line_2d){vo_apex, rvo.xz_left_side};
-        bool collide = C_InfiniteLineIntersection(l1, l2, &intersec_point);
-        assert(collide);
-        ret.xz_apex = intersec_point;
-    
-    }else{ /* The entity velocity is right on the centerline */
-
-        ret.xz_apex = rvo.xz_apex;
-    }
-    
-    ret.xz_right_side = rvo.xz_right_side;
-    ret.xz_left_side = rvo.xz_left_side;
-    return ret;
+    const struct nb_dist *da = a, *db = b;
+    if(da->dist != db->dist)
+        return (da->dist < db->dist) ? -1 : 1;
+    /* Of equally distant neighbours, the first gathered one is dropped first */
+    return (da->idx > db->idx) ? -1 : (da->idx < db->idx);
 }
 
-static size_t compute_all_vos(struct cp_ent ent, vec_cp_ent_t stat_neighbs, 
-                              struct VO *out)
+/* Orders the neighbours from nearest to furthest, such that the active set 
+ * of neighbours is always a prefix of the output. 
+ */
+static void sort_neighbours(vec2_t xz_pos, const vec_cp_ent_t *dyn, const vec_cp_ent_t *stat,
+                            struct cp_ent *out, bool *out_dynamic)
 {
-    size_t ret = 0; 
-
-    for(struct cp_ent *nb = stat_neighbs.array; 
-        nb < stat_neighbs.array + vec_size(&stat_neighbs); nb++) {
-        
-        out[ret++] = compute_vo(ent, *nb);
-    }
-
-    return ret;
-}
+    const size_t ndyn = vec_size(dyn);
+    const size_t n = ndyn + vec_size(stat);
+    struct nb_dist order[n];
 
-static size_t compute_all_hrvos(struct cp_ent ent, vec_cp_ent_t dyn_neighbs, 
-                                struct HRVO *out)
-{
-    size_t ret = 0; 
+    for(size_t i = 0; i < n; i++) {
 
-    for(struct cp_ent *nb = dyn_neighbs.array; 
-        nb < dyn_neighbs.array + vec_size(&dyn_neighbs); nb++) {
-        
-        out[ret++] = compute_hrvo(ent, *nb);
+        vec2_t diff;
+        struct cp_ent nb = (i < ndyn) ? vec_AT(dyn, i) : vec_AT(stat, i - ndyn);
+        PFM_Vec2_Sub(&xz_pos, &nb.xz_pos, &diff);
+        order[i] = (struct nb_dist){PFM_Vec2_Len(&diff), i};
     }
+    qsort(order, n, sizeof(order[0]), compare_nb_dist);
 
-    return ret;
-}
-
-/* Points exactly 'on' the boundary will be considered as 'not inside' of the PCR for our purposes. */
-static bool inside_pcr(const struct line_2d *vo_lr_pairs, size_t n_rays, vec2_t test)
-{
-    assert(n_rays % 2 == 0);
-    for(int i = 0; i < n_rays; i+=2) {
-
-        assert(fabs(PFM_Vec2_Len(&vo_lr_pairs[i + 0].dir) - 1.0f) < EPSILON);
-        const float left_dir_x = vo_lr_pairs[i + 0].dir.raw[0];
-        const float left_dir_z = vo_lr_pairs[i + 0].dir.raw[1];
+    for(size_t i = 0; i < n; i++) {
 
-        vec2_t point_to_test;
-        PFM_Vec2_Sub(&test, (vec2_t*)&vo_lr_pairs[i + 0].point, &point_to_test);
-        PFM_Vec2_Normal(&point_to_test, &point_to_test);
-
-        float left_det = (point_to_test.raw[1] * left_dir_x) - (point_to_test.raw[0] * left_dir_z);
-        bool left_of_vo = (left_det < EPSILON);
-
-        if(left_of_vo)
-            continue;
-
-        assert(fabs(PFM_Vec2_Len(&vo_lr_pairs[i + 1].dir) - 1.0f) < EPSILON);
-        const float right_dir_x = vo_lr_pairs[i + 1].dir.raw[0];
-        const float right_dir_z = vo_lr_pairs[i + 1].dir.raw[1];
-
-        PFM_Vec2_Sub(&test, (vec2_t*)&vo_lr_pairs[i + 1].point, &point_to_test);
-        PFM_Vec2_Normal(&point_to_test, &point_to_test);
-
-        float right_det = (point_to_test.raw[1] * right_dir_x) - (point_to_test.raw[0] * right_dir_z);
-        bool right_of_vo = (right_det > -EPSILON);
-
-        if(right_of_vo)
-            continue;
-
-        assert(!left_of_vo && !right_of_vo);
-        return true;
+        size_t idx = order[i].idx;
+        out[i] = (idx < ndyn) ? vec_AT(dyn, idx) : vec_AT(stat, idx - ndyn);
+        out_dynamic[i] = (idx < ndyn);
     }
-
-    return false;
 }
 
-static void rays_repr(const struct HRVO *hrvos, size_t n_hrvos,
-                      const struct VO *vos, size_t n_vos,
-                      struct line_2d *out)
+static size_t ray_pairs(size_t n_vos)
 {
-    size_t rays_idx  = 0;
-
-    for(int i = 0; i < n_hrvos; i++) {
-         
-        out[rays_idx + 0].point = hrvos[i].xz_apex;
-        out[rays_idx + 0].dir = hrvos[i].xz_left_side;
-
-        out[rays_idx + 1].point = hrvos[i].xz_apex;
-        out[rays_idx + 1].dir = hrvos[i].xz_right_side;
-
-        rays_idx += 2;
-    }
-
-    for(int i = 0; i < n_vos; i++) {
-    
-        out[rays_idx + 0].point = vos[i].xz_apex;
-        out[rays_idx + 0].dir = vos[i].xz_left_side;
-
-        out[rays_idx + 1].point = vos[i].xz_apex;
-        out[rays_idx + 1].dir = vos[i].xz_right_side;
-
-        rays_idx += 2;
-    }
+    return (n_vos == 0) ? 0 : (2 * n_vos) * (2 * n_vos - 1);
 }
 
-static size_t compute_vo_xpoints(struct line_2d *rays, size_t n_rays,
-                                 vec_vec2_t *inout)
+static size_t max_neighbours(size_t pair_budget)
 {
-    size_t ret = 0;
-
-    for(int i = 0; i < n_rays; i++) {
-        for(int j = 0; j < n_rays; j++) {
-
-            if(i == j) 
-                continue;
-
-            vec2_t isec_point;
-            if(!C_RayRayIntersection2D(rays[i], rays[j], &isec_point))
-                continue;
-
-            if(inside_pcr(rays, n_rays, isec_point))
-                continue;
-
-            vec_vec2_push(inout, isec_point);
-            ret++;
-        }
-    }
-
-    return ret;
+    size_t ret = (1.0 + sqrt(1.0 + 4.0 * pair_budget)) / 4.0;
+    while(ret > 0 && ray_pairs(ret) > pair_budget)
+        ret--;
+    return MAX(ret, CLEARPATH_MIN_NEIGHBOURS);
 }
 
-static size_t compute_vdes_proj_points(struct line_2d *rays, size_t n_rays,
-                                       vec2_t des_v, vec_vec2_t *inout)
+static bool cand_admissible(const struct cp_cand *cand, size_t n_active)
 {
-    vec2_t proj;
-    size_t ret = 0;
-
-    for(int i = 0; i < n_rays; i++) {
-    
-        assert(fabs(PFM_Vec2_Len(&rays[i].dir) - 1.0f) < EPSILON);
-
-        float len = PFM_Vec2_Dot(&rays[i].dir, &des_v);
-        PFM_Vec2_Scale(&rays[i].dir, len, &proj);
-        PFM_Vec2_Add(&rays[i].point, &proj, &proj);
-
-        if(!inside_pcr(rays, n_rays, proj)) {
-        
-            vec_vec2_push(inout, proj);
-            ret++;
-        }
-    }
-
-    return ret;
+    return (cand->level < n_active) && (n_active <= cand->first_inside);
 }
 
-static vec2_t compute_vnew(const vec_vec2_t *outside_points, vec2_t des_v, vec2_t ent_xz_pos)
+static vec2_t compute_vnew(const vec_cp_cand_t *cands, size_t n_active, 
+                           vec2_t des_v, vec2_t ent_xz_pos)
 {
     float min_dist = INFINITY, len;
-    vec2_t ret;
+    vec2_t ret = (vec2_t){0.0f};
 
-    for(int i = 0; i < vec_size(outside_points); i++) {
+    for(int i = 0; i < vec_size(cands); i++) {
+
+        if(!cand_admissible(&vec_AT(cands, i), n_active))
+            continue;
 
         /* The points are in worldspace coordinates. Convert them to the entity's 
          * local space to get the adimissible velocities. */
-        vec2_t curr = vec_AT(outside_points, i), diff;
+        vec2_t curr = vec_AT(cands, i).xz_point, diff;
         PFM_Vec2_Sub(&curr, &ent_xz_pos, &curr);
 
         PFM_Vec2_Sub(&des_v, &curr, &diff);
@@ -361,53 +196,34 @@ static vec2_t compute_vnew(const vec_vec2_t *outside_points, vec2_t des_v, vec2_
     return ret;
 }
 
-static void remove_furthest(vec2_t xz_pos, vec_cp_ent_t *dyn_inout, vec_cp_ent_t *stat_inout)
+static void save_debug_state(struct cp_ent cpent, vec2_t ent_des_v, vec2_t v_new,
+                             const struct cp_vo_soa *vos, const bool *dynamic, 
+                             size_t n_active, const vec_cp_cand_t *cands, bool des_v_in_pcr)
 {
-    float max_dist = -INFINITY;
-    vec_cp_ent_t *del_vec = NULL;
-    int del_idx = -1;
-
-    for(int i = 0; i < 2; i++) {
-    
-        vec_cp_ent_t *curr_vec = (i == 0) ? dyn_inout : stat_inout;
-        for(int j = 0; j < vec_size(curr_vec); j++) {
-        
-            float len;
-            vec2_t diff;
-            struct cp_ent *ent = &vec_AT(curr_vec, j);
-
-            PFM_Vec2_Sub(&xz_pos, &ent->xz_pos, &diff);
-            if((len = PFM_Vec2_Len(&diff)) > max_dist) {
-                max_dist = len; 
-                del_vec = curr_vec;
-                del_idx = j;
-            }
-        }
-    }
-
-    if(max_dist > -INFINITY) {
-        assert(del_idx != -1);
-        vec_cp_ent_del(del_vec, del_idx);
-    }
-}
+    s_debug_saved.n_hrvos = 0;
+    s_debug_saved.n_vos = 0;
 
-/* Save the combined HRVO of the first selected entity for debug rendering */
-static bool should_save_debug(uint32_t ent_uid)
-{
-    struct sval setting;
-    ss_e status = Settings_Get("pf.debug.show_first_sel_combined_hrvo", &setting);
-    assert(status == SS_OKAY);
+    for(int i = 0; i < n_active; i++) {
 
-    if(!setting.as_bool)
-        return false;
+        if(dynamic[i] && s_debug_saved.n_hrvos < MAX_SAVED_VOS)
+            s_debug_saved.hrvos[s_debug_saved.n_hrvos++] = vo_at(vos, i);
+        if(!dynamic[i] && s_debug_saved.n_vos < MAX_SAVED_VOS)
+            s_debug_saved.vos[s_debug_saved.n_vos++] = vo_at(vos, i);
+    }
 
-    enum selection_type seltype;
-    const vec_pentity_t *sel = G_Sel_Get(&seltype);
+    vec_vec2_reset(&s_debug_saved.xpoints);
+    for(int i = 0; i < vec_size(cands); i++) {
 
-    if(vec_size(sel) == 0)
-        return false; 
+        if(!cand_admissible(&vec_AT(cands, i), n_active))
+            continue;
+        vec_vec2_push(&s_debug_saved.xpoints, vec_AT(cands, i).xz_point);
+    }
 
-    return true;
+    s_debug_saved.cpent = cpent;
+    s_debug_saved.ent_des_v = ent_des_v;
+    s_debug_saved.v_new = v_new;
+    s_debug_saved.des_v_in_pcr = des_v_in_pcr;
+    s_debug_saved.valid = true;
 }
 
 static void on_render_3d(void *user, void *event)
@@ -538,92 +354,6 @@ static void on_render_3d(void *user, void *event)
     UI_DrawText(strbuff, (struct rect){5,5,200,50}, text_color);
 }
 
-static bool clearpath_new_velocity(struct cp_ent cpent,
-                                   uint32_t ent_uid,
-                                   vec2_t ent_des_v,
-                                   const vec_cp_ent_t dyn_neighbs,
-                                   const vec_cp_ent_t stat_neighbs,
-                                   vec2_t *out)
-{
-    struct HRVO dyn_hrvos[vec_size(&dyn_neighbs)];
-    struct VO stat_vos[vec_size(&stat_neighbs)];
-
-    size_t n_hrvos = compute_all_hrvos(cpent, dyn_neighbs, dyn_hrvos);
-    size_t n_vos = compute_all_vos(cpent, stat_neighbs, stat_vos);
-
-    assert(n_hrvos == vec_size(&dyn_neighbs));
-    assert(n_vos == vec_size(&stat_neighbs));
-
-    /* Following the ClearPath approach, which is applicable to many variations 
-     * of velocity obstacles, we represent the combined hybrid reciprocal velocity 
-     * obstacle as a union of line segments. 
-     */
-    const size_t n_rays = (n_hrvos + n_vos) * 2;
-    struct line_2d rays[n_rays];
-    rays_repr(dyn_hrvos, n_hrvos, stat_vos, n_vos, rays);
-
-    if(should_save_debug(ent_uid)) {
-
-        size_t nsaved_hrvos = n_hrvos <= MAX_SAVED_VOS ? n_hrvos : MAX_SAVED_VOS;
-        memcpy(s_debug_saved.hrvos, dyn_hrvos, nsaved_hrvos * sizeof(struct HRVO));
-        s_debug_saved.n_hrvos = nsaved_hrvos;
-
-        size_t nsaved_vos = n_vos <= MAX_SAVED_VOS ? n_vos : MAX_SAVED_VOS;
-        memcpy(s_debug_saved.vos, stat_vos, nsaved_vos * sizeof(struct VO));
-        s_debug_saved.n_vos = nsaved_vos;
-
-        vec_vec2_reset(&s_debug_saved.xpoints);
-
-        s_debug_saved.cpent = cpent;
-        s_debug_saved.ent_des_v = ent_des_v;
-        s_debug_saved.v_new = ent_des_v;
-        s_debug_saved.valid = true;
-    }
-
-    vec2_t des_v_ws;
-    PFM_Vec2_Add(&cpent.xz_pos, &ent_des_v, &des_v_ws);
-    if(!inside_pcr(rays, n_rays, des_v_ws)) {
-
-        s_debug_saved.des_v_in_pcr = false;
-        *out = ent_des_v;
-        return true;
-    }
-
-    vec_vec2_t xpoints;
-    vec_vec2_init(&xpoints);
-
-    /* The line segments are intersected pairwise and the intersection points 
-     * inside the combined hybrid reciprocal velocity obstacle are discarded. 
-     * The remaining intersection points are permissible new velocities on the 
-     * boundary of the combined hybrid reciprocal velocity obstacle.
-     */
-    compute_vo_xpoints(rays, n_rays, &xpoints); 
-
-    /* In addition we project the preferred velocity (des_v) on to the line 
-     * segments (xz_left_side and xz_right_side of each hrvo) and also retain 
-     * those points that are outside the combined hybrid reciprocal velocity 
-     * obstacle.
-     */
-    compute_vdes_proj_points(rays, n_rays, ent_des_v, &xpoints);
-
-    if(vec_size(&xpoints) == 0) {
-        return false;    
-    }
-
-    vec2_t ret = compute_vnew(&xpoints, ent_des_v, cpent.xz_pos);
-
-    if(should_save_debug(ent_uid)) {
-    
-        vec_vec2_copy(&s_debug_saved.xpoints, &xpoints);
-        s_debug_saved.v_new = ret;
-        s_debug_saved.des_v_in_pcr = true;
-    }
-
-    vec_vec2_destroy(&xpoints);
-    *out = ret;
-    return true;
-}
-
 /*****************************************************************************/
 /* EXTERN FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -641,24 +371,137 @@ void G_ClearPath_Shutdown(void)
     vec_vec2_destroy(&s_debug_saved.xpoints);
 }
 
+bool G_ClearPath_ShouldSaveDebug(uint32_t ent_uid)
+{
+    struct sval setting;
+    ss_e status = Settings_Get("pf.debug.show_first_sel_combined_hrvo", &setting);
+    assert(status == SS_OKAY);
+
+    if(!setting.as_bool)
+        return false;
+
+    enum selection_type seltype;
+    const vec_pentity_t *sel = G_Sel_Get(&seltype);
+
+    if(vec_size(sel) == 0)
+        return false; 
+
+    return (vec_AT(sel, 0)->uid == ent_uid);
+}
+
 vec2_t G_ClearPath_NewVelocity(struct cp_ent cpent,
                                uint32_t ent_uid,
                                vec2_t ent_des_v,
                                vec_cp_ent_t dyn_neighbs,
-                               vec_cp_ent_t stat_neighbs)
+                               vec_cp_ent_t stat_neighbs,
+                               size_t pair_budget,
+                               bool save_debug,
+                               struct cp_stats *inout_stats)
 {
     PERF_ENTER();
 
-    do{
-        vec2_t ret;
-        bool found = clearpath_new_velocity(cpent, ent_uid, ent_des_v, dyn_neighbs, stat_neighbs, &ret);
-        if(found)
-            PERF_RETURN(ret);
+    const size_t n_neighbs = vec_size(&dyn_neighbs) + vec_size(&stat_neighbs);
+    const size_t n_active = MIN(n_neighbs, max_neighbours(pair_budget));
 
-        remove_furthest(cpent.xz_pos, &dyn_neighbs, &stat_neighbs);
+    struct cp_ent neighbs[n_neighbs];
+    bool dynamic[n_neighbs];
+    sort_neighbours(cpent.xz_pos, &dyn_neighbs, &stat_neighbs, neighbs, dynamic);
+
+    /* When there are too many neighbours to fit in the work budget, only the 
+     * nearest ones are avoided.
+     */
+    float vo_attrs[6][CLEARPATH_SOA_CAP(n_active)];
+    struct cp_vo_soa vos = {
+        .apex_x  = vo_attrs[0], .apex_z  = vo_attrs[1],
+        .left_x  = vo_attrs[2], .left_z  = vo_attrs[3],
+        .right_x = vo_attrs[4], .right_z = vo_attrs[5],
+    };
+    G_ClearPath_BuildVOs(cpent, neighbs, dynamic, n_active, &vos);
+
+    /* Following the ClearPath approach, which is applicable to many variations 
+     * of velocity obstacles, we represent the combined hybrid reciprocal velocity 
+     * obstacle as a union of line segments. 
+     */
+    float ray_attrs[4][CLEARPATH_SOA_CAP(n_active * 2)];
+    struct cp_ray_soa rays = {
+        .px = ray_attrs[0], .pz = ray_attrs[1],
+        .dx = ray_attrs[2], .dz = ray_attrs[3],
+    };
+    G_ClearPath_BuildRays(&vos, &rays);
+
+    /* When no admissible velocity is found, the furthest neighbour is dropped 
+     * from the active set and the search is repeated, until either all the 
+     * dynamic or all the static neighbours have been dropped. Since the active 
+     * set is always a prefix of the neighbours sorted by distance, each 
+     * candidate velocity is admissible for a contiguous range of active set 
+     * sizes. So the candidates are generated once for the full set and the
+     * largest active set which has an admissible velocity is found directly.
+     */
+    size_t first_dyn = n_neighbs, first_stat = n_neighbs;
+    for(int i = n_neighbs - 1; i >= 0; i--) {
+        if(dynamic[i])
+            first_dyn = i;
+        else
+            first_stat = i;
+    }
+    const size_t min_active = MAX(first_dyn, first_stat) + 1;
+
+    vec2_t des_v_ws;
+    PFM_Vec2_Add(&cpent.xz_pos, &ent_des_v, &des_v_ws);
+    const size_t des_v_first_inside = G_ClearPath_FirstInside(&vos, des_v_ws);
+
+    vec_cp_cand_t cands;
+    vec_cp_cand_init(&cands);
+    size_t n_solved = des_v_first_inside;
+    size_t n_pairs = 0;
+
+    if(des_v_first_inside < n_active) {
+
+        /* The line segments are intersected pairwise and the intersection points 
+         * inside the combined hybrid reciprocal velocity obstacle are discarded. 
+         * The remaining intersection points are permissible new velocities on the 
+         * boundary of the combined hybrid reciprocal velocity obstacle.
+         */
+        G_ClearPath_XPoints(&vos, &rays, &cands);
+
+        /* In addition we project the preferred velocity (des_v) on to the line 
+         * segments (xz_left_side and xz_right_side of each hrvo) and also retain 
+         * those points that are outside the combined hybrid reciprocal velocity 
+         * obstacle.
+         */
+        G_ClearPath_ProjPoints(&vos, &rays, ent_des_v, &cands);
+        n_pairs = ray_pairs(n_active);
+
+        for(int i = 0; i < vec_size(&cands); i++) {
+            n_solved = MAX(n_solved, vec_AT(&cands, i).first_inside);
+        }
+        n_solved = MIN(n_solved, n_active);
+    }
+
+    const bool found = (n_solved == n_active) || (n_solved >= min_active);
+    const size_t n_last = found ? n_solved 
+                        : (min_active <= n_active) ? min_active : n_active;
+    const bool des_v_in_pcr = (des_v_first_inside < n_last);
+
+    vec2_t ret = (vec2_t){0.0f, 0.0f};
+    if(found) {
+        ret = des_v_in_pcr ? compute_vnew(&cands, n_solved, ent_des_v, cpent.xz_pos) 
+                           : ent_des_v;
+    }
+
+    if(save_debug) {
+        save_debug_state(cpent, ent_des_v, ret, &vos, dynamic, n_last, &cands, des_v_in_pcr);
+    }
+    vec_cp_cand_destroy(&cands);
 
-    }while(vec_size(&dyn_neighbs) > 0 && vec_size(&stat_neighbs) > 0);
+    const unsigned iterations = n_active - n_last + 1;
+    inout_stats->solved++;
+    inout_stats->iterations += iterations;
+    inout_stats->max_iterations = MAX(inout_stats->max_iterations, iterations);
+    inout_stats->degraded += (n_active < n_neighbs);
+    inout_stats->failed += !found;
+    inout_stats->ray_pairs += n_pairs;
 
-    PERF_RETURN((vec2_t){0.0f, 0.0f});
+    PERF_RETURN(ret);
 }
 
@@ -36,15 +36,22 @@
 #ifndef CLEARPATH_H
 #define CLEARPATH_H
 
+#include "public/game.h"
 #include "../pf_math.h"
 #include "../lib/public/vec.h"
 
+#include <stddef.h>
+
 
 #define CLEARPATH_NEIGHBOUR_RADIUS (10.0f)
 /* This is added to the entity's radius so that it will take wider turns 
  * and leave this as a buffer between it and the obstacle.
  */
 #define CLEARPATH_BUFFER_RADIUS    (0.0f)
+/* The number of nearest neighbours which are always avoided, regardless 
+ * of the work budget. 
+ */
+#define CLEARPATH_MIN_NEIGHBOURS   (16)
 
 struct map;
 
@@ -60,11 +67,24 @@ VEC_IMPL(static inline, cp_ent, struct cp_ent)
 void G_ClearPath_Init(const struct map *map);
 void G_ClearPath_Shutdown(void);
 
+/* Returns true if the debug state (combined HRVO, intersection points) 
+ * should be saved for the entity. This must be queried from the main thread.
+ */
+bool   G_ClearPath_ShouldSaveDebug(uint32_t ent_uid);
+
+/* Safe to call from worker threads, so long as no more than a single 
+ * concurrent call has 'save_debug' set. At most 'pair_budget' ray pairs 
+ * are intersected, by only avoiding the nearest neighbours when there are 
+ * too many of them. The counters for the call are added to 'inout_stats'.
+ */
 vec2_t G_ClearPath_NewVelocity(struct cp_ent ent,
                                uint32_t ent_uid,
                                vec2_t ent_des_v,
                                vec_cp_ent_t dyn_neighbs,
-                               vec_cp_ent_t stat_neighbs);
+                               vec_cp_ent_t stat_neighbs,
+                               size_t pair_budget,
+                               bool save_debug,
+                               struct cp_stats *inout_stats);
 
 #endif
 
@@ -0,0 +1,455 @@
+/*
+ *  This file is part of Permafrost Engine. 
+ *  Copyright (C) 2020 Eduard Permyakov 
+ *
+ *  Permafrost Engine is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Permafrost Engine is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ *  Linking this software statically or dynamically with other modules is making 
+ *  a combined work based on this software. Thus, the terms and conditions of 
+ *  the GNU General Public License cover the whole combination. 
+ *  
+ *  As a special exception, the copyright holders of Permafrost Engine give 
+ *  you permission to link Permafrost Engine with independent modules to produce 
+ *  an executable, regardless of the license terms of these independent 
+ *  modules, and to copy and distribute the resulting executable under 
+ *  terms of your choice, provided that you also meet, for each linked 
+ *  independent module, the terms and conditions of the license of that 
+ *  module. An independent module is a module which is not derived from 
+ *  or based on Permafrost Engine. If you modify Permafrost Engine, you may 
+ *  extend this exception to your version of Permafrost Engine, but you are not 
+ *  obliged to do so. If you do not wish to do so, delete this exception 
+ *  statement from your version.
+ *
+ */
+
+#include "clearpath_simd.h"
+
+#include <string.h>
+#include <math.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* The kernels perform the exact same sequence of floating-point operations 
+ * as the scalar velocity obstacle construction and the line intersection 
+ * routines in collision.c, one element per lane. As such, their results 
+ * are bit-for-bit identical to those of the scalar code.
+ */
+
+#define EPSILON         (1.0f/1024)
+/* Must match the EPSILON of collision.c */
+#define LINE_EPSILON    (1.0f/1000000.0f)
+#define W               (CLEARPATH_SIMD_WIDTH)
+#define MIN(a, b)       ((a) < (b) ? (a) : (b))
+#define MAX(a, b)       ((a) > (b) ? (a) : (b))
+#define LANES(n)        ((n) >= W ? ((1u << W) - 1) : ((1u << (n)) - 1))
+
+#if defined(__AVX__)
+
+typedef __m256 vf_t;
+typedef __m256 vm_t;
+
+#define VF_SET1(x)          _mm256_set1_ps(x)
+#define VF_LOAD(p)          _mm256_loadu_ps(p)
+#define VF_STORE(p, a)      _mm256_storeu_ps(p, a)
+#define VF_ADD(a, b)        _mm256_add_ps(a, b)
+#define VF_SUB(a, b)        _mm256_sub_ps(a, b)
+#define VF_MUL(a, b)        _mm256_mul_ps(a, b)
+#define VF_DIV(a, b)        _mm256_div_ps(a, b)
+#define VF_SQRT(a)          _mm256_sqrt_ps(a)
+#define VF_ABS(a)           _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a)
+#define VF_NEG(a)           _mm256_xor_ps(_mm256_set1_ps(-0.0f), a)
+#define VF_LT(a, b)         _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define VF_GT(a, b)         _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define VF_SELECT(m, a, b)  _mm256_blendv_ps(b, a, m)
+#define VM_OR(a, b)         _mm256_or_ps(a, b)
+#define VM_ANDNOT(a, b)     _mm256_andnot_ps(a, b)
+#define VM_BITS(m)          ((unsigned)_mm256_movemask_ps(m))
+
+#elif defined(__SSE2__)
+
+typedef __m128 vf_t;
+typedef __m128 vm_t;
+
+#define VF_SET1(x)          _mm_set1_ps(x)
+#define VF_LOAD(p)          _mm_loadu_ps(p)
+#define VF_STORE(p, a)      _mm_storeu_ps(p, a)
+#define VF_ADD(a, b)        _mm_add_ps(a, b)
+#define VF_SUB(a, b)        _mm_sub_ps(a, b)
+#define VF_MUL(a, b)        _mm_mul_ps(a, b)
+#define VF_DIV(a, b)        _mm_div_ps(a, b)
+#define VF_SQRT(a)          _mm_sqrt_ps(a)
+#define VF_ABS(a)           _mm_andnot_ps(_mm_set1_ps(-0.0f), a)
+#define VF_NEG(a)           _mm_xor_ps(_mm_set1_ps(-0.0f), a)
+#define VF_LT(a, b)         _mm_cmplt_ps(a, b)
+#define VF_GT(a, b)         _mm_cmpgt_ps(a, b)
+#define VF_SELECT(m, a, b)  _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b))
+#define VM_OR(a, b)         _mm_or_ps(a, b)
+#define VM_ANDNOT(a, b)     _mm_andnot_ps(a, b)
+#define VM_BITS(m)          ((unsigned)_mm_movemask_ps(m))
+
+#else
+
+typedef float    vf_t;
+typedef unsigned vm_t;
+
+#define VF_SET1(x)          (x)
+#define VF_LOAD(p)          (*(p))
+#define VF_STORE(p, a)      (*(p) = (a))
+#define VF_ADD(a, b)        ((a) + (b))
+#define VF_SUB(a, b)        ((a) - (b))
+#define VF_MUL(a, b)        ((a) * (b))
+#define VF_DIV(a, b)        ((a) / (b))
+#define VF_SQRT(a)          sqrtf(a)
+#define VF_ABS(a)           fabsf(a)
+#define VF_NEG(a)           (-(a))
+#define VF_LT(a, b)         ((unsigned)((a) < (b)))
+#define VF_GT(a, b)         ((unsigned)((a) > (b)))
+#define VF_SELECT(m, a, b)  ((m) ? (a) : (b))
+#define VM_OR(a, b)         ((a) | (b))
+#define VM_ANDNOT(a, b)     (~(a) & (b))
+#define VM_BITS(m)          (m)
+
+#endif
+
+/*****************************************************************************/
+/* STATIC FUNCTIONS                                                          */
+/*****************************************************************************/
+
+static inline void store_lanes(float *dst, vf_t val, size_t count)
+{
+    if(count == W) {
+        VF_STORE(dst, val);
+        return;
+    }
+    float tmp[W];
+    VF_STORE(tmp, val);
+    memcpy(dst, tmp, count * sizeof(float));
+}
+
+static inline void normalize(vf_t *x, vf_t *z)
+{
+    vf_t len = VF_SQRT(VF_ADD(VF_MUL(*x, *x), VF_MUL(*z, *z)));
+    *x = VF_DIV(*x, len);
+    *z = VF_DIV(*z, len);
+}
+
+/* Lane-wise equivalent of C_InfiniteLineIntersection */
+static inline vm_t line_isect(vf_t p1x, vf_t p1z, vf_t d1x, vf_t d1z,
+                              vf_t p2x, vf_t p2z, vf_t d2x, vf_t d2z,
+                              vf_t *out_x, vf_t *out_z)
+{
+    const vf_t eps = VF_SET1(LINE_EPSILON);
+    const vf_t nan = VF_SET1(NAN);
+
+    vf_t s1 = VF_SELECT(VF_LT(VF_ABS(d1x), eps), nan, VF_DIV(d1z, d1x));
+    vf_t s2 = VF_SELECT(VF_LT(VF_ABS(d2x), eps), nan, VF_DIV(d2z, d2x));
+    vf_t sdiff = VF_SUB(s1, s2);
+
+    vf_t num = VF_SUB(VF_ADD(VF_SUB(VF_MUL(s1, p1x), VF_MUL(s2, p2x)), p2z), p1z);
+    *out_x = VF_DIV(num, sdiff);
+    *out_z = VF_ADD(VF_MUL(s2, VF_SUB(*out_x, p2x)), p2z);
+
+    /* Returns the lanes where the lines are parallel or coincident */
+    return VF_LT(VF_ABS(sdiff), eps);
+}
+
+/* Lane-wise equivalent of C_RayRayIntersection2D */
+static inline vm_t ray_isect(vf_t p1x, vf_t p1z, vf_t d1x, vf_t d1z,
+                             vf_t p2x, vf_t p2z, vf_t d2x, vf_t d2z,
+                             vf_t *out_x, vf_t *out_z)
+{
+    const vf_t zero = VF_SET1(0.0f);
+    vm_t miss = line_isect(p1x, p1z, d1x, d1z, p2x, p2z, d2x, d2z, out_x, out_z);
+
+    miss = VM_OR(miss, VF_LT(VF_DIV(VF_SUB(*out_x, p1x), d1x), zero));
+    miss = VM_OR(miss, VF_LT(VF_DIV(VF_SUB(*out_z, p1z), d1z), zero));
+    miss = VM_OR(miss, VF_LT(VF_DIV(VF_SUB(*out_x, p2x), d2x), zero));
+    miss = VM_OR(miss, VF_LT(VF_DIV(VF_SUB(*out_z, p2z), d2z), zero));
+
+    /* Returns the lanes where the rays are NOT intersecting */
+    return miss;
+}
+
+static void build_vos(struct cp_ent ent, const struct cp_ent *neighbs, 
+                      const bool *dynamic, size_t n, struct cp_vo_soa *out)
+{
+    const vf_t ent_x = VF_SET1(ent.xz_pos.x);
+    const vf_t ent_z = VF_SET1(ent.xz_pos.z);
+    const vf_t ent_vx = VF_SET1(ent.xz_vel.x);
+    const vf_t ent_vz = VF_SET1(ent.xz_vel.z);
+    const vf_t ent_r = VF_SET1(ent.radius);
+    const vf_t buff_r = VF_SET1(CLEARPATH_BUFFER_RADIUS);
+    const vf_t half = VF_SET1(0.5f);
+    const vf_t eps = VF_SET1(EPSILON);
+    const vf_t neg_eps = VF_SET1(-EPSILON);
+
+    for(size_t i = 0; i < n; i += W) {
+
+        const size_t count = MIN(W, n - i);
+        float nxs[W] = {0}, nzs[W] = {0}, nvxs[W] = {0}, nvzs[W] = {0}, nrs[W] = {0};
+        float dyns[W] = {0};
+        bool any_dynamic = false;
+
+        for(int j = 0; j < count; j++) {
+            nxs[j] = neighbs[i + j].xz_pos.x;
+            nzs[j] = neighbs[i + j].xz_pos.z;
+            nvxs[j] = neighbs[i + j].xz_vel.x;
+            nvzs[j] = neighbs[i + j].xz_vel.z;
+            nrs[j] = neighbs[i + j].radius;
+            dyns[j] = dynamic[i + j] ? 1.0f : 0.0f;
+            any_dynamic |= dynamic[i + j];
+        }
+
+        vf_t nx = VF_LOAD(nxs), nz = VF_LOAD(nzs);
+        vf_t nvx = VF_LOAD(nvxs), nvz = VF_LOAD(nvzs);
+
+        vf_t to_nb_x = VF_SUB(nx, ent_x);
+        vf_t to_nb_z = VF_SUB(nz, ent_z);
+        normalize(&to_nb_x, &to_nb_z);
+
+        vf_t scale = VF_ADD(VF_ADD(VF_LOAD(nrs), ent_r), buff_r);
+        vf_t right_x = VF_MUL(VF_NEG(to_nb_z), scale);
+        vf_t right_z = VF_MUL(to_nb_x, scale);
+
+        vf_t rside_x = VF_SUB(VF_ADD(nx, right_x), ent_x);
+        vf_t rside_z = VF_SUB(VF_ADD(nz, right_z), ent_z);
+        normalize(&rside_x, &rside_z);
+
+        vf_t lside_x = VF_SUB(VF_SUB(nx, right_x), ent_x);
+        vf_t lside_z = VF_SUB(VF_SUB(nz, right_z), ent_z);
+        normalize(&lside_x, &lside_z);
+
+        vf_t vo_apex_x = VF_ADD(ent_x, nvx);
+        vf_t vo_apex_z = VF_ADD(ent_z, nvz);
+        vf_t apex_x = vo_apex_x, apex_z = vo_apex_z;
+
+        if(any_dynamic) {
+
+            vf_t rvo_apex_x = VF_ADD(ent_x, VF_MUL(VF_ADD(ent_vx, nvx), half));
+            vf_t rvo_apex_z = VF_ADD(ent_z, VF_MUL(VF_ADD(ent_vz, nvz), half));
+
+            vf_t cl_x = VF_ADD(lside_x, rside_x);
+            vf_t cl_z = VF_ADD(lside_z, rside_z);
+            vf_t det = VF_SUB(VF_MUL(cl_x, ent_vz), VF_MUL(cl_z, ent_vx));
+
+            /* When the entity velocity is left of the RVO centerline, the apex is 
+             * at the intersection of the RVO's left side and the VO's right side. 
+             * When it is to the right, it is the other way around.
+             */
+            vm_t left = VF_GT(det, eps);
+            vm_t off_center = VM_OR(left, VF_LT(det, neg_eps));
+
+            vf_t d1x = VF_SELECT(left, lside_x, rside_x);
+            vf_t d1z = VF_SELECT(left, lside_z, rside_z);
+            vf_t d2x = VF_SELECT(left, rside_x, lside_x);
+            vf_t d2z = VF_SELECT(left, rside_z, lside_z);
+
+            vf_t isec_x, isec_z;
+            vm_t parallel = line_isect(rvo_apex_x, rvo_apex_z, d1x, d1z, 
+                vo_apex_x, vo_apex_z, d2x, d2z, &isec_x, &isec_z);
+
+            vm_t use_isec = VM_ANDNOT(parallel, off_center);
+            vf_t hrvo_apex_x = VF_SELECT(use_isec, isec_x, rvo_apex_x);
+            vf_t hrvo_apex_z = VF_SELECT(use_isec, isec_z, rvo_apex_z);
+
+            vm_t hybrid = VF_GT(VF_LOAD(dyns), half);
+            apex_x = VF_SELECT(hybrid, hrvo_apex_x, vo_apex_x);
+            apex_z = VF_SELECT(hybrid, hrvo_apex_z, vo_apex_z);
+        }
+
+        store_lanes(out->apex_x + i, apex_x, count);
+        store_lanes(out->apex_z + i, apex_z, count);
+        store_lanes(out->left_x + i, lside_x, count);
+        store_lanes(out->left_z + i, lside_z, count);
+        store_lanes(out->right_x + i, rside_x, count);
+        store_lanes(out->right_z + i, rside_z, count);
+    }
+}
+
+static inline unsigned lowest_bit(unsigned mask)
+{
+    unsigned ret = 0;
+    while(!(mask & (1u << ret)))
+        ret++;
+    return ret;
+}
+
+/* Returns the index of the first velocity obstacle containing the point */
+static size_t first_inside(const struct cp_vo_soa *vos, float x, float z)
+{
+    const vf_t test_x = VF_SET1(x);
+    const vf_t test_z = VF_SET1(z);
+    const vf_t eps = VF_SET1(EPSILON);
+    const vf_t neg_eps = VF_SET1(-EPSILON);
+
+    for(size_t i = 0; i < vos->n; i += W) {
+
+        vf_t to_test_x = VF_SUB(test_x, VF_LOAD(vos->apex_x + i));
+        vf_t to_test_z = VF_SUB(test_z, VF_LOAD(vos->apex_z + i));
+        normalize(&to_test_x, &to_test_z);
+
+        vf_t left_det = VF_SUB(VF_MUL(to_test_z, VF_LOAD(vos->left_x + i)), 
+                               VF_MUL(to_test_x, VF_LOAD(vos->left_z + i)));
+        vf_t right_det = VF_SUB(VF_MUL(to_test_z, VF_LOAD(vos->right_x + i)), 
+                                VF_MUL(to_test_x, VF_LOAD(vos->right_z + i)));
+
+        vm_t outside = VM_OR(VF_LT(left_det, eps), VF_GT(right_det, neg_eps));
+        unsigned inside = ~VM_BITS(outside) & LANES(vos->n - i);
+        if(inside)
+            return i + lowest_bit(inside);
+    }
+    return vos->n;
+}
+
+/* A candidate which is inside of one of the velocity obstacles it was derived 
+ * from (or of a nearer one) stays inside for all the active sets containing it.
+ */
+static bool push_cand(const struct cp_vo_soa *vos, float x, float z, size_t level, 
+                      vec_cp_cand_t *inout)
+{
+    size_t first = first_inside(vos, x, z);
+    if(first <= level)
+        return false;
+
+    vec_cp_cand_push(inout, (struct cp_cand){
+        .xz_point = (vec2_t){x, z},
+        .level = level,
+        .first_inside = first,
+    });
+    return true;
+}
+
+static void zero_pad(float *arr, size_t n)
+{
+    size_t cap = CLEARPATH_SOA_CAP(n);
+    memset(arr + n, 0, (cap - n) * sizeof(float));
+}
+
+/*****************************************************************************/
+/* EXTERN FUNCTIONS                                                          */
+/*****************************************************************************/
+
+void G_ClearPath_BuildVOs(struct cp_ent ent, const struct cp_ent *neighbs, 
+                          const bool *dynamic, size_t n, struct cp_vo_soa *out)
+{
+    build_vos(ent, neighbs, dynamic, n, out);
+    out->n = n;
+
+    zero_pad(out->apex_x, out->n);
+    zero_pad(out->apex_z, out->n);
+    zero_pad(out->left_x, out->n);
+    zero_pad(out->left_z, out->n);
+    zero_pad(out->right_x, out->n);
+    zero_pad(out->right_z, out->n);
+}
+
+void G_ClearPath_BuildRays(const struct cp_vo_soa *vos, struct cp_ray_soa *out)
+{
+    for(size_t i = 0; i < vos->n; i++) {
+
+        out->px[2*i + 0] = vos->apex_x[i];
+        out->pz[2*i + 0] = vos->apex_z[i];
+        out->dx[2*i + 0] = vos->left_x[i];
+        out->dz[2*i + 0] = vos->left_z[i];
+
+        out->px[2*i + 1] = vos->apex_x[i];
+        out->pz[2*i + 1] = vos->apex_z[i];
+        out->dx[2*i + 1] = vos->right_x[i];
+        out->dz[2*i + 1] = vos->right_z[i];
+    }
+    out->n = vos->n * 2;
+
+    zero_pad(out->px, out->n);
+    zero_pad(out->pz, out->n);
+    zero_pad(out->dx, out->n);
+    zero_pad(out->dz, out->n);
+}
+
+size_t G_ClearPath_FirstInside(const struct cp_vo_soa *vos, vec2_t test)
+{
+    return first_inside(vos, test.x, test.z);
+}
+
+size_t G_ClearPath_XPoints(const struct cp_vo_soa *vos, const struct cp_ray_soa *rays, 
+                           vec_cp_cand_t *inout)
+{
+    size_t ret = 0;
+
+    for(size_t i = 0; i < rays->n; i++) {
+
+        const vf_t p1x = VF_SET1(rays->px[i]);
+        const vf_t p1z = VF_SET1(rays->pz[i]);
+        const vf_t d1x = VF_SET1(rays->dx[i]);
+        const vf_t d1z = VF_SET1(rays->dz[i]);
+
+        for(size_t j = 0; j < rays->n; j += W) {
+
+            vf_t isec_x, isec_z;
+            vm_t miss = ray_isect(p1x, p1z, d1x, d1z,
+                VF_LOAD(rays->px + j), VF_LOAD(rays->pz + j), 
+                VF_LOAD(rays->dx + j), VF_LOAD(rays->dz + j),
+                &isec_x, &isec_z);
+
+            unsigned hits = ~VM_BITS(miss) & LANES(rays->n - j);
+            if(i >= j && i < j + W)
+                hits &= ~(1u << (i - j));
+            if(!hits)
+                continue;
+
+            float xs[W], zs[W];
+            VF_STORE(xs, isec_x);
+            VF_STORE(zs, isec_z);
+
+            for(int k = 0; k < W; k++) {
+
+                if(!(hits & (1u << k)))
+                    continue;
+                ret += push_cand(vos, xs[k], zs[k], MAX(i, j + k) / 2, inout);
+            }
+        }
+    }
+
+    return ret;
+}
+
+size_t G_ClearPath_ProjPoints(const struct cp_vo_soa *vos, const struct cp_ray_soa *rays, 
+                              vec2_t des_v, vec_cp_cand_t *inout)
+{
+    const vf_t vx = VF_SET1(des_v.x);
+    const vf_t vz = VF_SET1(des_v.z);
+    size_t ret = 0;
+
+    for(size_t i = 0; i < rays->n; i += W) {
+
+        vf_t dx = VF_LOAD(rays->dx + i);
+        vf_t dz = VF_LOAD(rays->dz + i);
+        vf_t len = VF_ADD(VF_MUL(dx, vx), VF_MUL(dz, vz));
+
+        float xs[W], zs[W];
+        VF_STORE(xs, VF_ADD(VF_LOAD(rays->px + i), VF_MUL(dx, len)));
+        VF_STORE(zs, VF_ADD(VF_LOAD(rays->pz + i), VF_MUL(dz, len)));
+
+        const size_t count = MIN(W, rays->n - i);
+        for(int k = 0; k < count; k++) {
+            ret += push_cand(vos, xs[k], zs[k], (i + k) / 2, inout);
+        }
+    }
+
+    return ret;
+}
+
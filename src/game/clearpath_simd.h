@@ -0,0 +1,130 @@
+/*
+ *  This file is part of Permafrost Engine. 
+ *  Copyright (C) 2020 Eduard Permyakov 
+ *
+ *  Permafrost Engine is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Permafrost Engine is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ *  Linking this software statically or dynamically with other modules is making 
+ *  a combined work based on this software. Thus, the terms and conditions of 
+ *  the GNU General Public License cover the whole combination. 
+ *  
+ *  As a special exception, the copyright holders of Permafrost Engine give 
+ *  you permission to link Permafrost Engine with independent modules to produce 
+ *  an executable, regardless of the license terms of these independent 
+ *  modules, and to copy and distribute the resulting executable under 
+ *  terms of your choice, provided that you also meet, for each linked 
+ *  independent module, the terms and conditions of the license of that 
+ *  module. An independent module is a module which is not derived from 
+ *  or based on Permafrost Engine. If you modify Permafrost Engine, you may 
+ *  extend this exception to your version of Permafrost Engine, but you are not 
+ *  obliged to do so. If you do not wish to do so, delete this exception 
+ *  statement from your version.
+ *
+ */
+
+#ifndef CLEARPATH_SIMD_H
+#define CLEARPATH_SIMD_H
+
+#include "clearpath.h"
+#include "../pf_math.h"
+#include "../lib/public/vec.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The kernels are processing this many velocity obstacles or rays at a time. 
+ * The width is selected at compile-time from the target's instruction set. 
+ */
+#if defined(__AVX__)
+#define CLEARPATH_SIMD_WIDTH (8)
+#elif defined(__SSE2__)
+#define CLEARPATH_SIMD_WIDTH (4)
+#else
+#define CLEARPATH_SIMD_WIDTH (1)
+#endif
+
+/* The number of floats that must be allocated for every array of a 'cp_vo_soa' 
+ * or 'cp_ray_soa' holding 'n' elements. The padding lanes are always zeroed.
+ */
+#define CLEARPATH_SOA_CAP(n) \
+    ((((n) + CLEARPATH_SIMD_WIDTH - 1) / CLEARPATH_SIMD_WIDTH) * CLEARPATH_SIMD_WIDTH)
+
+/* A set of velocity obstacles, each being bounded by a left and right 
+ * ray sharing a common apex, in structure-of-arrays form. The directions 
+ * are normalized. 
+ */
+struct cp_vo_soa{
+    size_t n;
+    float *apex_x, *apex_z;
+    float *left_x, *left_z;
+    float *right_x, *right_z;
+};
+
+/* The rays bounding a 'cp_vo_soa', as (left, right) pairs in the same 
+ * order as the velocity obstacles. 
+ */
+struct cp_ray_soa{
+    size_t n;
+    float *px, *pz;
+    float *dx, *dz;
+};
+
+/* A candidate new velocity, as a worldspace point on the boundary of some of 
+ * the velocity obstacles. Taking the first 'k' velocity obstacles to be the 
+ * active set, the candidate is admissible when: level < k <= first_inside
+ */
+struct cp_cand{
+    vec2_t   xz_point;
+    uint32_t level;         /* The highest index of the VOs it was derived from */
+    uint32_t first_inside;  /* The lowest index of the VOs containing it, or 'n' */
+};
+
+VEC_TYPE(cp_cand, struct cp_cand)
+VEC_IMPL(static inline, cp_cand, struct cp_cand)
+
+/* Writes the velocity obstacles induced by the 'n' neighbours to 'out'. 
+ * Dynamic neighbours induce HRVOs and static neighbours induce VOs. The 
+ * arrays of 'out' must have a capacity of at least CLEARPATH_SOA_CAP(n).
+ */
+void   G_ClearPath_BuildVOs(struct cp_ent ent, const struct cp_ent *neighbs, 
+                            const bool *dynamic, size_t n, struct cp_vo_soa *out);
+
+/* The arrays of 'out' must have a capacity of at least 
+ * CLEARPATH_SOA_CAP(2 * vos->n).
+ */
+void   G_ClearPath_BuildRays(const struct cp_vo_soa *vos, struct cp_ray_soa *out);
+
+/* Returns the index of the first velocity obstacle containing the point, or 
+ * 'vos->n' if there is none. Points exactly 'on' the boundary are considered 
+ * as 'not inside'. 
+ */
+size_t G_ClearPath_FirstInside(const struct cp_vo_soa *vos, vec2_t test);
+
+/* Appends the pairwise intersection points of the rays to 'inout', skipping 
+ * those which are not admissible for any active set. Returns the number of 
+ * appended candidates.
+ */
+size_t G_ClearPath_XPoints(const struct cp_vo_soa *vos, const struct cp_ray_soa *rays, 
+                           vec_cp_cand_t *inout);
+
+/* Appends the projections of 'des_v' onto the rays to 'inout', skipping 
+ * those which are not admissible for any active set. Returns the number 
+ * of appended candidates.
+ */
+size_t G_ClearPath_ProjPoints(const struct cp_vo_soa *vos, const struct cp_ray_soa *rays, 
+                              vec2_t des_v, vec_cp_cand_t *inout);
+
+#endif
+
@@ -36,6 +36,7 @@
 #include "combat.h"
 #include "game_private.h"
 #include "movement.h"
+#include "position.h"
 #include "../event.h"
 #include "../entity.h"
 #include "../main.h"
@@ -115,6 +116,10 @@ KHASH_MAP_INIT_INT(state, struct combatstate)
 static khash_t(state) *s_entity_state_table;
 /* For saving/restoring state */
 static vec_pentity_t   s_dying_ents;
+/* The neighbours of every combatable entity, rebuilt at the start of every tick */
+static struct pos_ntable *s_neighbours;
+/* False when the table could not be built for the current tick */
+static bool               s_neighbours_valid;
 
 /*****************************************************************************/
 /* STATIC FUNCTIONS                                                          */
@@ -191,13 +196,27 @@ static struct entity *closest_enemy_in_range(const struct entity *ent)
     float min_dist = FLT_MAX;
     struct entity *ret = NULL;
 
-    struct entity *near_ents[128];
-    int num_near = G_Pos_EntsInCircle(G_Pos_GetXZ(ent->uid), 
-        ENEMY_TARGET_ACQUISITION_RANGE, near_ents, ARR_SIZE(near_ents));
+    struct pos_neighbour buff[128];
+    const struct pos_neighbour *near_ents;
+    size_t num_near;
+
+    if(s_neighbours_valid) {
+        num_near = G_Pos_NTableGet(s_neighbours, ent->uid, &near_ents);
+    }else{
+        /* Fall back to querying the spatial index directly */
+        struct entity *ents[ARR_SIZE(buff)];
+        num_near = G_Pos_EntsInCircle(G_Pos_GetXZ(ent->uid), 
+            ENEMY_TARGET_ACQUISITION_RANGE, ents, ARR_SIZE(ents));
+        for(int i = 0; i < num_near; i++) {
+            buff[i] = (struct pos_neighbour){ents[i], G_Pos_GetXZ(ents[i]->uid)};
+        }
+        near_ents = buff;
+    }
+    vec2_t ent_xz_pos = G_Pos_GetXZ(ent->uid);
 
     for(int i = 0; i < num_near; i++) {
 
-        struct entity *curr = near_ents[i];
+        struct entity *curr = near_ents[i].ent;
         if(curr == ent)
             continue;
         if(!(curr->flags & ENTITY_FLAG_COMBATABLE))
@@ -207,12 +226,16 @@ static struct entity *closest_enemy_in_range(const struct entity *ent)
         if(!enemies(ent, curr))
             continue;
 
+        /* The entity may have been removed since the table was built */
         struct combatstate *cs = combatstate_get(curr->uid);
-        assert(cs);
+        if(!cs)
+            continue;
         if(cs->state == STATE_DEATH_ANIM_PLAYING)
             continue;
    
-        float dist = ents_distance(ent, curr);
+        vec2_t delta, curr_xz_pos = near_ents[i].xz_pos;
+        PFM_Vec2_Sub(&ent_xz_pos, &curr_xz_pos, &delta);
+        float dist = PFM_Vec2_Len(&delta) - ent->selection_radius - curr->selection_radius;
         if(dist < min_dist) {
             min_dist = dist; 
             ret = curr;
@@ -243,6 +266,7 @@ static void entity_turn_to_target(struct entity *ent, const struct entity *targe
     PFM_Vec2_Sub(&tar_pos_xz, &ent_pos_xz, &ent_to_target);
     PFM_Vec2_Normal(&ent_to_target, &ent_to_target);
     ent->rotation = quat_from_vec(ent_to_target);
+    G_UpdateBounds(ent);
 }
 
 static void on_death_anim_finish(void *user, void *event)
@@ -298,6 +322,11 @@ static void on_attack_anim_finish(void *user, void *event)
     }
 }
 
+static bool ent_combatable(const struct entity *ent, void *arg)
+{
+    return (ent->flags & ENTITY_FLAG_COMBATABLE);
+}
+
 static void on_30hz_tick(void *user, void *event)
 {
     PERF_ENTER();
@@ -306,6 +335,9 @@ static void on_30hz_tick(void *user, void *event)
     struct entity *curr;
     (void)key;
 
+    s_neighbours_valid = G_Pos_NTableBuild(s_neighbours, ENEMY_TARGET_ACQUISITION_RANGE, 
+        ent_combatable, NULL);
+
     kh_foreach(G_GetDynamicEntsSet(), key, curr, {
 
         if(!(curr->flags & ENTITY_FLAG_COMBATABLE))
@@ -434,6 +466,10 @@ bool G_Combat_Init(void)
 {
     if(NULL == (s_entity_state_table = kh_init(state)))
         return false;
+    if(NULL == (s_neighbours = G_Pos_NTableNew())) {
+        kh_destroy(state, s_entity_state_table);
+        return false;
+    }
 
     vec_pentity_init(&s_dying_ents);
     E_Global_Register(EVENT_30HZ_TICK, on_30hz_tick, NULL, G_RUNNING);
@@ -444,6 +480,7 @@ void G_Combat_Shutdown(void)
 {
     E_Global_Unregister(EVENT_30HZ_TICK, on_30hz_tick);
     vec_pentity_destroy(&s_dying_ents);
+    G_Pos_NTableFree(s_neighbours);
     kh_destroy(state, s_entity_state_table);
 }
 
@@ -0,0 +1,402 @@
+/*
+ *  This file is part of Permafrost Engine. 
+ *  Copyright (C) 2020 Eduard Permyakov 
+ *
+ *  Permafrost Engine is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Permafrost Engine is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ *  Linking this software statically or dynamically with other modules is making 
+ *  a combined work based on this software. Thus, the terms and conditions of 
+ *  the GNU General Public License cover the whole combination. 
+ *  
+ *  As a special exception, the copyright holders of Permafrost Engine give 
+ *  you permission to link Permafrost Engine with independent modules to produce 
+ *  an executable, regardless of the license terms of these independent 
+ *  modules, and to copy and distribute the resulting executable under 
+ *  terms of your choice, provided that you also meet, for each linked 
+ *  independent module, the terms and conditions of the license of that 
+ *  module. An independent module is a module which is not derived from 
+ *  or based on Permafrost Engine. If you modify Permafrost Engine, you may 
+ *  extend this exception to your version of Permafrost Engine, but you are not 
+ *  obliged to do so. If you do not wish to do so, delete this exception 
+ *  statement from your version.
+ *
+ */
+
+#include "cull.h"
+#include "selection.h"
+#include "public/game.h"
+#include "../entity.h"
+#include "../collision.h"
+#include "../sched.h"
+#include "../perf.h"
+#include "../anim/public/anim.h"
+#include "../map/public/map.h"
+#include "../map/public/tile.h"
+#include "../lib/public/khash.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+
+#define MIN(a, b)           ((a) < (b) ? (a) : (b))
+#define MAX(a, b)           ((a) > (b) ? (a) : (b))
+#define BUCKET_HALF_HEIGHT  (10000.0f)
+
+/* An entity is cached as 'static' when its' OBB can only change through an 
+ * explicit G_Cull_Update call (i.e. it is not moving and not animating). 
+ */
+#define IS_STAT(ent)        (((ent)->flags & ENTITY_FLAG_STATIC) && !((ent)->flags & ENTITY_FLAG_ANIMATED))
+
+struct bucket{
+    vec_pentity_t dynamic;
+    vec_pentity_t stat;
+    vec_obb_t     stat_obbs;
+    /* The union of the OBBs in 'stat_obbs' */
+    struct aabb   stat_bounds;
+    bool          stat_dirty;
+};
+
+struct loc{
+    int  bucket;
+    int  idx;
+    bool stat;
+};
+
+KHASH_MAP_INIT_INT(loc, struct loc)
+
+/*****************************************************************************/
+/* STATIC VARIABLES                                                          */
+/*****************************************************************************/
+
+static struct map_resolution  s_res;
+static vec3_t                 s_map_pos;
+static float                  s_chunk_x_len;
+static float                  s_chunk_z_len;
+/* One bucket per chunk, in row-major order, followed by a single bucket for 
+ * all the entities positioned outside the map bounds. 
+ */
+static struct bucket         *s_buckets;
+static size_t                 s_nbuckets;
+static khash_t(loc)          *s_locs;
+/* An upper bound on the distance between an entity's position and any point 
+ * of its' OBB. Buckets are tested with their extents grown by this margin, so 
+ * that entities straddling a chunk boundary are never rejected. It is never 
+ * shrunk. 
+ */
+static float                  s_max_radius;
+
+/*****************************************************************************/
+/* STATIC FUNCTIONS                                                          */
+/*****************************************************************************/
+
+static int bucket_for_pos(vec2_t xz)
+{
+    int c = floorf((s_map_pos.x - xz.x) / s_chunk_x_len);
+    int r = floorf((xz.z - s_map_pos.z) / s_chunk_z_len);
+
+    if(r < 0 || r >= s_res.chunk_h || c < 0 || c >= s_res.chunk_w)
+        return s_nbuckets - 1;
+    return r * s_res.chunk_w + c;
+}
+
+static float ent_radius(const struct entity *ent)
+{
+    const struct aabb *aabb = (ent->flags & ENTITY_FLAG_ANIMATED) ? A_GetMaxPoseAABB(ent)
+                                                                  : &ent->identity_aabb;
+    float dx = MAX(fabsf(aabb->x_min), fabsf(aabb->x_max));
+    float dy = MAX(fabsf(aabb->y_min), fabsf(aabb->y_max));
+    float dz = MAX(fabsf(aabb->z_min), fabsf(aabb->z_max));
+    float scale = MAX(MAX(fabsf(ent->scale.x), fabsf(ent->scale.y)), fabsf(ent->scale.z));
+
+    return sqrtf(dx*dx + dy*dy + dz*dz) * scale;
+}
+
+static void bucket_remove(const struct loc *loc)
+{
+    struct bucket *bucket = &s_buckets[loc->bucket];
+    vec_pentity_t *vec = loc->stat ? &bucket->stat : &bucket->dynamic;
+
+    assert(loc->idx < vec_size(vec));
+    vec_pentity_del(vec, loc->idx);
+
+    if(loc->stat) {
+        vec_obb_del(&bucket->stat_obbs, loc->idx);
+        bucket->stat_dirty = true;
+    }
+
+    /* The last element has been swapped into the freed slot */
+    if(loc->idx < vec_size(vec)) {
+        const struct entity *moved = vec_AT(vec, loc->idx);
+        khiter_t k = kh_get(loc, s_locs, moved->uid);
+        assert(k != kh_end(s_locs));
+        kh_val(s_locs, k).idx = loc->idx;
+    }
+}
+
+static bool bucket_insert(struct entity *ent, struct loc *out)
+{
+    vec2_t xz = G_Pos_GetXZ(ent->uid);
+    struct bucket *bucket = &s_buckets[bucket_for_pos(xz)];
+
+    out->bucket = bucket - s_buckets;
+    out->stat = IS_STAT(ent);
+
+    if(!out->stat) {
+        out->idx = vec_size(&bucket->dynamic);
+        return vec_pentity_push(&bucket->dynamic, ent);
+    }
+
+    struct obb obb;
+    Entity_CurrentOBB(ent, &obb);
+
+    out->idx = vec_size(&bucket->stat);
+    if(!vec_pentity_push(&bucket->stat, ent))
+        return false;
+    if(!vec_obb_push(&bucket->stat_obbs, obb)) {
+        vec_pentity_pop(&bucket->stat);
+        return false;
+    }
+    bucket->stat_dirty = true;
+    return true;
+}
+
+static void bucket_update_stat_bounds(struct bucket *bucket)
+{
+    if(!bucket->stat_dirty)
+        return;
+
+    struct aabb ret = (struct aabb){
+        .x_min = INFINITY, .x_max = -INFINITY,
+        .y_min = INFINITY, .y_max = -INFINITY,
+        .z_min = INFINITY, .z_max = -INFINITY,
+    };
+
+    for(int i = 0; i < vec_size(&bucket->stat_obbs); i++) {
+        const struct obb *obb = &vec_AT(&bucket->stat_obbs, i);
+        for(int j = 0; j < 8; j++) {
+            ret.x_min = MIN(ret.x_min, obb->corners[j].x);
+            ret.x_max = MAX(ret.x_max, obb->corners[j].x);
+            ret.y_min = MIN(ret.y_min, obb->corners[j].y);
+            ret.y_max = MAX(ret.y_max, obb->corners[j].y);
+            ret.z_min = MIN(ret.z_min, obb->corners[j].z);
+            ret.z_max = MAX(ret.z_max, obb->corners[j].z);
+        }
+    }
+
+    bucket->stat_bounds = ret;
+    bucket->stat_dirty = false;
+}
+
+static struct aabb bucket_bounds(int idx)
+{
+    assert(idx < s_nbuckets - 1);
+    int r = idx / s_res.chunk_w;
+    int c = idx % s_res.chunk_w;
+
+    return (struct aabb){
+        .x_min = s_map_pos.x - (c + 1) * s_chunk_x_len - s_max_radius,
+        .x_max = s_map_pos.x - c * s_chunk_x_len + s_max_radius,
+        .y_min = -BUCKET_HALF_HEIGHT,
+        .y_max =  BUCKET_HALF_HEIGHT,
+        .z_min = s_map_pos.z + r * s_chunk_z_len - s_max_radius,
+        .z_max = s_map_pos.z + (r + 1) * s_chunk_z_len + s_max_radius,
+    };
+}
+
+static int frust_mask_aabb(const struct frustum *frusta, size_t nfrusta, 
+                           int inmask, const struct aabb *aabb)
+{
+    int ret = 0;
+    for(int i = 0; i < nfrusta; i++) {
+        if(!(inmask & (1 << i)))
+            continue;
+        if(C_FrustumAABBIntersectionFast(&frusta[i], aabb) != VOLUME_INTERSEC_OUTSIDE)
+            ret |= (1 << i);
+    }
+    return ret;
+}
+
+static int frust_mask_obb(const struct frustum *frusta, size_t nfrusta, 
+                          int inmask, const struct obb *obb)
+{
+    int ret = 0;
+    for(int i = 0; i < nfrusta; i++) {
+        if(!(inmask & (1 << i)))
+            continue;
+        if(C_FrustumOBBIntersectionFast(&frusta[i], obb) != VOLUME_INTERSEC_OUTSIDE)
+            ret |= (1 << i);
+    }
+    return ret;
+}
+
+/*****************************************************************************/
+/* EXTERN FUNCTIONS                                                          */
+/*****************************************************************************/
+
+bool G_Cull_Init(const struct map *map)
+{
+    ASSERT_IN_MAIN_THREAD();
+
+    M_GetResolution(map, &s_res);
+    s_map_pos = M_GetPos(map);
+    s_chunk_x_len = s_res.tile_w * X_COORDS_PER_TILE;
+    s_chunk_z_len = s_res.tile_h * Z_COORDS_PER_TILE;
+    s_max_radius = 0.0f;
+
+    s_nbuckets = s_res.chunk_w * s_res.chunk_h + 1;
+    s_buckets = calloc(s_nbuckets, sizeof(struct bucket));
+    if(!s_buckets)
+        goto fail_buckets;
+
+    if(NULL == (s_locs = kh_init(loc)))
+        goto fail_locs;
+
+    for(int i = 0; i < s_nbuckets; i++) {
+        vec_pentity_init(&s_buckets[i].dynamic);
+        vec_pentity_init(&s_buckets[i].stat);
+        vec_obb_init(&s_buckets[i].stat_obbs);
+        s_buckets[i].stat_dirty = true;
+    }
+    return true;
+
+fail_locs:
+    free(s_buckets);
+fail_buckets:
+    return false;
+}
+
+void G_Cull_Shutdown(void)
+{
+    ASSERT_IN_MAIN_THREAD();
+
+    for(int i = 0; i < s_nbuckets; i++) {
+        vec_pentity_destroy(&s_buckets[i].dynamic);
+        vec_pentity_destroy(&s_buckets[i].stat);
+        vec_obb_destroy(&s_buckets[i].stat_obbs);
+    }
+    free(s_buckets);
+    kh_destroy(loc, s_locs);
+
+    s_buckets = NULL;
+    s_nbuckets = 0;
+    s_locs = NULL;
+}
+
+void G_Cull_Update(const struct entity *ent)
+{
+    ASSERT_IN_MAIN_THREAD();
+
+    if(!s_locs)
+        return;
+
+    khiter_t k = kh_get(loc, s_locs, ent->uid);
+    if(k != kh_end(s_locs)) {
+        struct loc loc = kh_val(s_locs, k);
+        bucket_remove(&loc);
+    }else{
+        int ret;
+        k = kh_put(loc, s_locs, ent->uid, &ret);
+        if(ret == -1)
+            return;
+    }
+
+    s_max_radius = MAX(s_max_radius, ent_radius(ent));
+
+    /* The index only hands out the entities owned by the game state */
+    struct loc loc;
+    if(!bucket_insert((struct entity*)ent, &loc)) {
+        kh_del(loc, s_locs, k);
+        return;
+    }
+    kh_val(s_locs, k) = loc;
+}
+
+void G_Cull_Remove(uint32_t uid)
+{
+    ASSERT_IN_MAIN_THREAD();
+
+    if(!s_locs)
+        return;
+
+    khiter_t k = kh_get(loc, s_locs, uid);
+    if(k == kh_end(s_locs))
+        return;
+
+    struct loc loc = kh_val(s_locs, k);
+    kh_del(loc, s_locs, k);
+    bucket_remove(&loc);
+}
+
+void G_Cull_Visit(const struct frustum *frusta, size_t nfrusta, cull_visit_t visit, void *arg)
+{
+    PERF_ENTER();
+    ASSERT_IN_MAIN_THREAD();
+    assert(nfrusta <= sizeof(int) * 8);
+
+    const int all = (1 << nfrusta) - 1;
+
+    for(int i = 0; i < s_nbuckets; i++) {
+
+        struct bucket *bucket = &s_buckets[i];
+        if(vec_size(&bucket->dynamic) == 0 && vec_size(&bucket->stat) == 0)
+            continue;
+
+        /* The entities outside the map bounds are always tested individually */
+        int bmask = all;
+        if(i < s_nbuckets - 1) {
+            struct aabb bounds = bucket_bounds(i);
+            bmask = frust_mask_aabb(frusta, nfrusta, all, &bounds);
+        }
+        if(!bmask)
+            continue;
+
+        for(int j = 0; j < vec_size(&bucket->dynamic); j++) {
+
+            struct entity *curr = vec_AT(&bucket->dynamic, j);
+            if(curr->flags & ENTITY_FLAG_INVISIBLE)
+                continue;
+
+            struct obb obb;
+            Entity_CurrentOBB(curr, &obb);
+
+            int mask = frust_mask_obb(frusta, nfrusta, bmask, &obb);
+            if(mask)
+                visit(curr, &obb, mask, arg);
+        }
+
+        if(vec_size(&bucket->stat) == 0)
+            continue;
+
+        bucket_update_stat_bounds(bucket);
+        int smask = frust_mask_aabb(frusta, nfrusta, bmask, &bucket->stat_bounds);
+        if(!smask)
+            continue;
+
+        for(int j = 0; j < vec_size(&bucket->stat); j++) {
+
+            struct entity *curr = vec_AT(&bucket->stat, j);
+            if(curr->flags & ENTITY_FLAG_INVISIBLE)
+                continue;
+
+            const struct obb *obb = &vec_AT(&bucket->stat_obbs, j);
+            int mask = frust_mask_obb(frusta, nfrusta, smask, obb);
+            if(mask)
+                visit(curr, obb, mask, arg);
+        }
+    }
+
+    PERF_RETURN_VOID();
+}
+
@@ -41,13 +41,17 @@
 #include "../settings.h"
 #include "../render/public/render.h"
 #include "../render/public/render_ctrl.h"
-#include "../lib/public/pqueue.h"
+#include "../lib/public/bqueue.h"
 #include "../lib/public/khash.h"
+#include "../lib/public/lru_cache.h"
+#include "../lib/public/vec.h"
 #include "../lib/public/attr.h"
 #include "../map/public/map.h"
 #include "../map/public/tile.h"
+#include "../config.h"
 
 #include <stdint.h>
+#include <string.h>
 #include <assert.h>
 #include <SDL.h>
 
@@ -70,11 +74,30 @@ enum fog_state{
     STATE_VISIBLE,
 };
 
-PQUEUE_TYPE(td, struct tile_desc)
-PQUEUE_IMPL(static, td, struct tile_desc)
+/* The offset of a visible tile from the tile the vision originates from */
+struct stencil_off{
+    int16_t dr, dc;
+};
+
+VEC_TYPE(soff, struct stencil_off)
+VEC_PROTOTYPES(static, soff, struct stencil_off)
+VEC_IMPL(static, soff, struct stencil_off)
+
+/* The set of tiles visible from an origin tile for a specific vision radius */
+struct fog_stencil{
+    int        origin_height;
+    vec_soff_t offsets;
+};
+
+BQUEUE_TYPE(td, struct tile_desc)
+BQUEUE_IMPL(static, td, struct tile_desc)
 
 KHASH_SET_INIT_INT(uid)
 
+LRU_CACHE_TYPE(stencil, struct fog_stencil)
+LRU_CACHE_PROTOTYPES(static, stencil, struct fog_stencil)
+LRU_CACHE_IMPL(static, stencil, struct fog_stencil)
+
 /*****************************************************************************/
 /* STATIC VARIABLES                                                          */
 /*****************************************************************************/
@@ -88,6 +111,9 @@ static uint32_t         *s_fog_state;
 static uint8_t          *s_vision_refcnts[MAX_FACTIONS];
 /* Cache all the entities that have been explored by the player, for faster queries */
 static khash_t(uid)     *s_explored_cache;
+/* Visibility stencils, keyed by origin tile and radius. The origin height is 
+ * stored in the entry and checked on lookup. */
+static lru(stencil)      s_stencil_cache;
 
 /*****************************************************************************/
 /* STATIC FUNCTIONS                                                          */
@@ -209,7 +235,7 @@ static void wf_create_blocked_line(int xrad, int zrad, bool wf[][xrad * 2 + 1],
     struct map_resolution res;
     M_GetResolution(s_map, &res);
 
-    struct tile_desc corner;
+    struct tile_desc corner = origin;
     M_Tile_RelativeDesc(res, &corner, delta_c, delta_r);
 
     vec2_t origin_center = tile_center_pos(origin);
@@ -264,22 +290,9 @@ void td_delta(struct tile_desc a, struct tile_desc b, int *out_dr, int *out_dc)
     *out_dc = bc - ac;
 }
 
-static void fog_update_visible(int faction_id, vec2_t xz_pos, float radius, int delta)
+static void fog_compute_stencil(struct tile_desc origin, int origin_height, float radius, 
+                                vec_soff_t *out)
 {
-    if(radius == 0.0f)
-        return;
-
-    struct map_resolution res;
-    M_GetResolution(s_map, &res);
-
-    struct tile_desc origin;
-    bool status = M_Tile_DescForPoint2D(res, M_GetPos(s_map), xz_pos, &origin);
-    assert(status);
-
-    struct tile *tile;
-    M_TileForDesc(s_map, origin, &tile);
-    int origin_height = M_Tile_BaseHeight(tile);
-
     const int tile_x_radius = ceil(radius / X_COORDS_PER_TILE);
     const int tile_z_radius = ceil(radius / Z_COORDS_PER_TILE);
     assert(tile_x_radius && tile_z_radius);
@@ -294,17 +307,24 @@ static void fog_update_visible(int faction_id, vec2_t xz_pos, float radius, int
     bool visited[2 * tile_x_radius  + 1][2 * tile_z_radius + 1];
     memset(visited, 0, sizeof(visited));
 
-    pq_td_t frontier;
-    pq_td_init(&frontier);
+    /* The wavefront is expanded in order of increasing distance from the origin. 
+     * As the tiles are square, the squared tile distance (an integer) gives the 
+     * same ordering as the Euclidean distance and can be used as a bucket key. */
+    assert(X_COORDS_PER_TILE == Z_COORDS_PER_TILE);
+    const unsigned span = tile_x_radius * tile_x_radius + tile_z_radius * tile_z_radius + 1;
+
+    bq_td_t frontier;
+    if(!bq_td_init(&frontier, span))
+        return;
 
-    pq_td_push(&frontier, 0.0f, origin);
+    bq_td_push(&frontier, 0, origin);
     visited[tile_x_radius][tile_z_radius] = true;
-    update_tile(faction_id, origin, delta);
+    vec_soff_push(out, (struct stencil_off){0, 0});
 
-    while(pq_size(&frontier) > 0) {
+    while(bq_size(&frontier) > 0) {
 
         struct tile_desc curr;
-        pq_td_pop(&frontier, &curr);
+        bq_td_pop(&frontier, &curr, NULL);
 
         struct tile_desc neighbs[8];
         size_t num_neighbs = neighbours(curr, neighbs);
@@ -338,12 +358,178 @@ static void fog_update_visible(int faction_id, vec2_t xz_pos, float radius, int
             if(td_los_blocked(neighbs[i], origin_height))
                 continue;
 
-            update_tile(faction_id, neighbs[i], delta);
-            pq_td_push(&frontier, PFM_Vec2_Len(&origin_delta), neighbs[i]);
+            vec_soff_push(out, (struct stencil_off){dr, dc});
+            bq_td_push(&frontier, dr * dr + dc * dc, neighbs[i]);
         }
     }
 
-    pq_td_destroy(&frontier);
+    bq_td_destroy(&frontier);
+}
+
+static uint64_t stencil_key(struct tile_desc origin, float radius)
+{
+    uint32_t radius_bits;
+    memcpy(&radius_bits, &radius, sizeof(radius_bits));
+    return (((uint64_t)td_index(origin)) << 32) | radius_bits;
+}
+
+static void on_stencil_evict(struct fog_stencil *victim)
+{
+    vec_soff_destroy(&victim->offsets);
+}
+
+/* The returned stencil is owned by the cache and remains valid until 
+ * it is evicted. The two most recently fetched stencils will never be
+ * evicted by a subsequent fetch. */
+static struct fog_stencil fog_stencil_get(struct tile_desc origin, float radius)
+{
+    struct tile *tile;
+    M_TileForDesc(s_map, origin, &tile);
+    int origin_height = M_Tile_BaseHeight(tile);
+
+    uint64_t key = stencil_key(origin, radius);
+    struct fog_stencil ret;
+
+    if(lru_stencil_get(&s_stencil_cache, key, &ret)
+    && ret.origin_height == origin_height)
+        return ret;
+
+    ret.origin_height = origin_height;
+    vec_soff_init(&ret.offsets);
+    fog_compute_stencil(origin, origin_height, radius, &ret.offsets);
+
+    lru_stencil_put(&s_stencil_cache, key, &ret);
+    return ret;
+}
+
+static bool td_for_global(int r, int c, struct tile_desc *out)
+{
+    struct map_resolution res;
+    M_GetResolution(s_map, &res);
+
+    if(r < 0 || r >= res.chunk_h * res.tile_h)
+        return false;
+    if(c < 0 || c >= res.chunk_w * res.tile_w)
+        return false;
+
+    *out = (struct tile_desc){
+        .chunk_r = r / res.tile_h,
+        .chunk_c = c / res.tile_w,
+        .tile_r  = r % res.tile_h,
+        .tile_c  = c % res.tile_w,
+    };
+    return true;
+}
+
+static void fog_apply_stencil(int faction_id, struct tile_desc origin, 
+                              const struct fog_stencil *stencil, int delta)
+{
+    struct map_resolution res;
+    M_GetResolution(s_map, &res);
+
+    int origin_r = origin.chunk_r * res.tile_h + origin.tile_r;
+    int origin_c = origin.chunk_c * res.tile_w + origin.tile_c;
+
+    for(int i = 0; i < vec_size(&stencil->offsets); i++) {
+
+        struct stencil_off off = vec_AT(&stencil->offsets, i);
+        struct tile_desc td;
+        bool status = td_for_global(origin_r + off.dr, origin_c + off.dc, &td);
+        assert(status);
+        update_tile(faction_id, td, delta);
+    }
+}
+
+static bool fog_origin_for_pos(vec2_t xz_pos, struct tile_desc *out)
+{
+    struct map_resolution res;
+    M_GetResolution(s_map, &res);
+    return M_Tile_DescForPoint2D(res, M_GetPos(s_map), xz_pos, out);
+}
+
+static void fog_update_visible(int faction_id, vec2_t xz_pos, float radius, int delta)
+{
+    if(radius == 0.0f)
+        return;
+
+    struct tile_desc origin;
+    bool status = fog_origin_for_pos(xz_pos, &origin);
+    assert(status);
+
+    struct fog_stencil stencil = fog_stencil_get(origin, radius);
+    fog_apply_stencil(faction_id, origin, &stencil, delta);
+}
+
+/* Move the vision from one position to another, only touching the tiles 
+ * that differ between the two footprints. 
+ */
+static void fog_move_visible(int faction_id, vec2_t old_xz_pos, vec2_t new_xz_pos, float radius)
+{
+    if(radius == 0.0f)
+        return;
+
+    struct tile_desc old_origin, new_origin;
+    bool status = fog_origin_for_pos(old_xz_pos, &old_origin);
+    assert(status);
+    status = fog_origin_for_pos(new_xz_pos, &new_origin);
+    assert(status);
+    (void)status;
+
+    int dr, dc;
+    td_delta(old_origin, new_origin, &dr, &dc);
+    if(dr == 0 && dc == 0)
+        return;
+
+    struct fog_stencil old_stencil = fog_stencil_get(old_origin, radius);
+    struct fog_stencil new_stencil = fog_stencil_get(new_origin, radius);
+
+    const int tile_x_radius = ceil(radius / X_COORDS_PER_TILE);
+    const int tile_z_radius = ceil(radius / Z_COORDS_PER_TILE);
+
+    /* The footprints don't overlap - there is nothing to save */
+    if(abs(dr) > 2 * tile_z_radius || abs(dc) > 2 * tile_x_radius) {
+        fog_apply_stencil(faction_id, old_origin, &old_stencil, -1);
+        fog_apply_stencil(faction_id, new_origin, &new_stencil, +1);
+        return;
+    }
+
+    /* Accumulate the net change for every tile in the bounding box of both 
+     * footprints, relative to the old origin. */
+    const int min_r = MIN(-tile_z_radius, dr - tile_z_radius);
+    const int min_c = MIN(-tile_x_radius, dc - tile_x_radius);
+    const int nrows = 2 * tile_z_radius + 1 + abs(dr);
+    const int ncols = 2 * tile_x_radius + 1 + abs(dc);
+
+    int8_t net[nrows][ncols];
+    memset(net, 0, sizeof(net));
+
+    for(int i = 0; i < vec_size(&old_stencil.offsets); i++) {
+        struct stencil_off off = vec_AT(&old_stencil.offsets, i);
+        net[off.dr - min_r][off.dc - min_c] -= 1;
+    }
+
+    for(int i = 0; i < vec_size(&new_stencil.offsets); i++) {
+        struct stencil_off off = vec_AT(&new_stencil.offsets, i);
+        net[dr + off.dr - min_r][dc + off.dc - min_c] += 1;
+    }
+
+    struct map_resolution res;
+    M_GetResolution(s_map, &res);
+
+    int origin_r = old_origin.chunk_r * res.tile_h + old_origin.tile_r;
+    int origin_c = old_origin.chunk_c * res.tile_w + old_origin.tile_c;
+
+    for(int r = 0; r < nrows; r++) {
+    for(int c = 0; c < ncols; c++) {
+
+        if(!net[r][c])
+            continue;
+
+        struct tile_desc td;
+        status = td_for_global(origin_r + min_r + r, origin_c + min_c + c, &td);
+        assert(status);
+        update_tile(faction_id, td, net[r][c]);
+    }}
 }
 
 static bool fog_obj_matches(uint16_t fac_mask, const struct obb *obj, enum fog_state *states, size_t nstates)
@@ -416,6 +602,9 @@ bool G_Fog_Init(const struct map *map)
     if(!s_explored_cache)
         goto fail;
 
+    if(!lru_stencil_init(&s_stencil_cache, CONFIG_FOG_STENCIL_CACHE_SZ, on_stencil_evict))
+        goto fail;
+
     s_map = map;
     E_Global_Register(EVENT_RENDER_3D, on_render_3d, NULL, G_RUNNING | G_PAUSED_UI_RUNNING | G_PAUSED_FULL);
     return true;
@@ -432,6 +621,7 @@ fail:
 void G_Fog_Shutdown(void)
 {
     E_Global_Unregister(EVENT_RENDER_3D, on_render_3d);
+    lru_stencil_destroy(&s_stencil_cache);
     kh_destroy(uid, s_explored_cache);
     free(s_fog_state);
     s_fog_state = NULL;
@@ -452,6 +642,18 @@ void G_Fog_RemoveVision(vec2_t xz_pos, int faction_id, float radius)
     fog_update_visible(faction_id, xz_pos, radius, -1);
 }
 
+void G_Fog_MoveVision(vec2_t old_xz_pos, vec2_t new_xz_pos, int faction_id, float radius)
+{
+    fog_move_visible(faction_id, old_xz_pos, new_xz_pos, radius);
+}
+
+void G_Fog_InvalidateStencils(void)
+{
+    if(!s_map)
+        return;
+    lru_stencil_clear(&s_stencil_cache);
+}
+
 void G_Fog_UpdateVisionRange(vec2_t xz_pos, int faction_id, float old, float new)
 {
     G_Fog_RemoveVision(xz_pos, faction_id, old);
@@ -49,6 +49,8 @@ void G_Fog_Shutdown(void);
 
 void G_Fog_AddVision(vec2_t xz_pos, int faction_id, float radius);
 void G_Fog_RemoveVision(vec2_t xz_pos, int faction_id, float radius);
+void G_Fog_MoveVision(vec2_t old_xz_pos, vec2_t new_xz_pos, int faction_id, float radius);
+void G_Fog_InvalidateStencils(void);
 
 void G_Fog_UpdateVisionState(void);
 void G_Fog_ClearExploredCache(void);
@@ -43,6 +43,7 @@
 #include "clearpath.h"
 #include "position.h"
 #include "fog_of_war.h"
+#include "cull.h"
 #include "../render/public/render.h"
 #include "../render/public/render_ctrl.h"
 #include "../anim/public/anim.h"
@@ -60,6 +61,9 @@
 #include "../main.h"
 #include "../ui.h"
 #include "../perf.h"
+#include "../sched.h"
+#include "../clock.h"
+#include "../pf_math_simd.h"
 
 #include <assert.h> 
 
@@ -81,6 +85,28 @@
             return false;     \
     }while(0)
 
+enum{
+    CULL_CAM,
+    CULL_LIGHT,
+};
+
+struct cull_arg{
+    uint16_t pm;
+};
+
+/* A part of the frame's render commands that is recorded into its' own 
+ * command sub-buffer, potentially by a worker thread. */
+struct render_job{
+    void (*record)(struct render_input *in);
+    int    subbuf;
+};
+
+struct render_jobs{
+    struct render_input *in;
+    size_t               njobs;
+    struct render_job    jobs[4];
+};
+
 VEC_IMPL(extern, obb, struct obb)
 __KHASH_IMPL(entity, extern, khint32_t, struct entity*, 1, kh_int_hash_func, kh_int_hash_equal)
 
@@ -140,7 +166,7 @@ static void g_init_map(void)
     G_Move_Init(s_gs.map);
     G_Combat_Init();
     G_ClearPath_Init(s_gs.map);
-    G_Pos_Init(s_gs.map);
+    G_Pos_Init(s_gs.map, CONFIG_POS_USE_GRID ? POS_INDEX_GRID : POS_INDEX_QUADTREE);
     G_Fog_Init(s_gs.map);
     N_FC_ClearAll();
     N_FC_ClearStats();
@@ -191,16 +217,15 @@ static void g_shadow_pass(struct render_input *in)
     
         struct ent_anim_rstate *curr = &vec_AT(&in->light_vis_anim, i);
 
-        mat4x4_t model, normal;
-        PFM_Mat4x4_Inverse(&curr->model, &model);
-        PFM_Mat4x4_Transpose(&model, &normal);
+        mat4x4_t normal;
+        PFM_SIMD_Mat4x4_Normal(&curr->model, &normal);
 
         R_PushCmd((struct rcmd){
             .func = R_GL_SetAnimUniforms,
             .nargs = 4,
             .args = {
                 (void*)curr->inv_bind_pose, 
-                R_PushArg(curr->curr_pose, sizeof(curr->curr_pose)),
+                (void*)curr->curr_pose,
                 R_PushArg(&normal, sizeof(normal)),
                 R_PushArg(&curr->njoints, sizeof(curr->njoints)),
             },
@@ -252,16 +277,15 @@ static void g_draw_pass(struct render_input *in)
     
         struct ent_anim_rstate *curr = &vec_AT(&in->cam_vis_anim, i);
 
-        mat4x4_t model, normal;
-        PFM_Mat4x4_Inverse(&curr->model, &model);
-        PFM_Mat4x4_Transpose(&model, &normal);
+        mat4x4_t normal;
+        PFM_SIMD_Mat4x4_Normal(&curr->model, &normal);
 
         R_PushCmd((struct rcmd){
             .func = R_GL_SetAnimUniforms,
             .nargs = 4,
             .args = {
                 (void*)curr->inv_bind_pose, 
-                R_PushArg(curr->curr_pose, sizeof(curr->curr_pose)),
+                (void*)curr->curr_pose,
                 R_PushArg(&normal, sizeof(normal)),
                 R_PushArg(&curr->njoints, sizeof(curr->njoints)),
             },
@@ -279,7 +303,7 @@ static void g_draw_pass(struct render_input *in)
 #endif
 }
 
-static void g_render_healthbars(void)
+static void g_render_healthbars(struct render_input *in)
 {
     PERF_ENTER();
     size_t max_ents = vec_size(&s_gs.visible);
@@ -311,12 +335,42 @@ static void g_render_healthbars(void)
             R_PushArg(&num_combat_visible, sizeof(num_combat_visible)),
             R_PushArg(ent_health_pc, sizeof(ent_health_pc)),
             R_PushArg(ent_top_pos_ws, sizeof(ent_top_pos_ws)),
-            R_PushArg(ACTIVE_CAM, g_sizeof_camera),
+            R_PushArg(in->cam, g_sizeof_camera),
         },
     });
     PERF_RETURN_VOID();
 }
 
+static void g_defer_recording(struct render_jobs *jobs, void (*record)(struct render_input*))
+{
+    int subbuf = -1;
+    if(jobs->njobs < ARR_SIZE(jobs->jobs)) {
+        subbuf = R_SubBufReserve();
+    }
+
+    if(subbuf < 0) {
+        record(jobs->in);
+        return;
+    }
+
+    jobs->jobs[jobs->njobs++] = (struct render_job){
+        .record = record,
+        .subbuf = subbuf
+    };
+}
+
+static void g_record_jobs(void *arg, int thread_idx, size_t begin, size_t end)
+{
+    struct render_jobs *jobs = arg;
+
+    for(size_t i = begin; i < end; i++) {
+    
+        R_SubBufBegin(jobs->jobs[i].subbuf);
+        jobs->jobs[i].record(jobs->in);
+        R_SubBufEnd();
+    }
+}
+
 static void g_make_draw_list(vec_pentity_t ents, vec_rstat_t *out_stat, vec_ranim_t *out_anim)
 {
     struct map_resolution res;
@@ -337,7 +391,8 @@ static void g_make_draw_list(vec_pentity_t ents, vec_rstat_t *out_stat, vec_rani
                 .render_private = curr->render_private, 
                 .model = model
             };
-            A_GetRenderState(curr, &rstate.njoints, rstate.curr_pose, &rstate.inv_bind_pose);
+            A_GetRenderState(curr, &rstate.njoints, &rstate.curr_pose, &rstate.inv_bind_pose);
+            A_GetBakedPoseIdx(curr, &rstate.baked_clip_base, &rstate.baked_frame);
             vec_ranim_push(out_anim, rstate);
         }else{
         
@@ -579,6 +634,26 @@ static bool g_ent_visible(uint16_t playermask, const struct entity *ent, const s
     return G_Fog_ObjVisible(playermask, obb);
 }
 
+static void g_cull_visit(struct entity *ent, const struct obb *obb, int frust_mask, void *arg)
+{
+    const struct cull_arg *carg = arg;
+    bool vis = false;
+
+    /* Note that there may be some false positives due to using the fast frustum cull. */
+    if((frust_mask & (1 << CULL_CAM))
+    && (vis = g_ent_visible(carg->pm, ent, obb))) {
+
+        vec_pentity_push(&s_gs.visible, ent);
+        vec_obb_push(&s_gs.visible_obbs, *obb);
+    }
+
+    if((frust_mask & (1 << CULL_LIGHT))
+    && (vis || (ent->flags & ENTITY_FLAG_STATIC))) {
+
+        vec_pentity_push(&s_gs.light_visible, ent);
+    }
+}
+
 /*****************************************************************************/
 /* EXTERN FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -590,7 +665,9 @@ bool G_Init(void)
     vec_pentity_init(&s_gs.visible);
     vec_pentity_init(&s_gs.light_visible);
     vec_obb_init(&s_gs.visible_obbs);
-    vec_pentity_init(&s_gs.deleted);
+
+    for(int i = 0; i < NUM_RENDER_WS; i++)
+        vec_pentity_init(&s_gs.deleted[i]);
 
     s_gs.active = kh_init(entity);
     if(!s_gs.active)
@@ -603,12 +680,12 @@ bool G_Init(void)
     if(!g_init_cameras())
         goto fail_cams; 
 
-    if(!R_InitWS(&s_gs.ws[0]))
-        goto fail_ws;
-
-    if(!R_InitWS(&s_gs.ws[1])) {
-        R_DestroyWS(&s_gs.ws[0]);
-        goto fail_ws;
+    for(int i = 0; i < NUM_RENDER_WS; i++) {
+        if(!R_InitWS(&s_gs.ws[i])) {
+            for(int j = 0; j < i; j++)
+                R_DestroyWS(&s_gs.ws[j]);
+            goto fail_ws;
+        }
     }
 
     G_ClearState();
@@ -795,9 +872,12 @@ bool G_NewGameWithMap(SDL_RWops *stream, bool update_navgrid)
     G_ClearState();
 
     size_t copysize = AL_MapShallowCopySize(stream);
-    s_gs.prev_tick_map = malloc(copysize);
-    if(!s_gs.prev_tick_map)
-        PERF_RETURN(false);
+    for(int i = 0; i < NUM_RENDER_WS; i++) {
+        s_gs.prev_tick_maps[i] = malloc(copysize);
+        if(!s_gs.prev_tick_maps[i])
+            PERF_RETURN(false);
+    }
+    s_gs.prev_tick_map = s_gs.prev_tick_maps[s_gs.curr_ws_idx];
 
     s_gs.map = AL_MapFromPFMapStream(stream, update_navgrid);
     if(!s_gs.map)
@@ -856,12 +936,15 @@ void G_ClearState(void)
     }
 
     if(s_gs.prev_tick_map) {
-        /* The render thread still owns the previous tick map. Wait 
-         * for it to complete before we free the buffer. */
+        /* The render thread still owns the previous tick maps. Wait 
+         * for it to complete before we free the buffers. */
         Engine_WaitRenderWorkDone();
-        free((void*)s_gs.prev_tick_map);
         s_gs.prev_tick_map = NULL;
     }
+    for(int i = 0; i < NUM_RENDER_WS; i++) {
+        free(s_gs.prev_tick_maps[i]);
+        s_gs.prev_tick_maps[i] = NULL;
+    }
 
     for(int i = 0; i < NUM_CAMERAS; i++) {
         g_reset_camera(s_gs.cameras[i]);
@@ -877,8 +960,8 @@ void G_ClearState(void)
 void G_ClearRenderWork(void)
 {
     Engine_WaitRenderWorkDone();
-    R_ClearWS(&s_gs.ws[0]);
-    R_ClearWS(&s_gs.ws[1]);
+    for(int i = 0; i < NUM_RENDER_WS; i++)
+        R_ClearWS(&s_gs.ws[i]);
 }
 
 void G_GetMinimapPos(float *out_x, float *out_y)
@@ -947,6 +1030,19 @@ bool G_MapHeightAtPoint(vec2_t xz, float *out_height)
     return true;
 }
 
+bool G_MapPositionPathable(vec2_t xz)
+{
+    ASSERT_IN_MAIN_THREAD();
+
+    if(!s_gs.map)
+        return false;
+
+    if(!M_PointInsideMap(s_gs.map, xz))
+        return false;
+
+    return M_NavPositionPathable(s_gs.map, xz);
+}
+
 bool G_PointInsideMap(vec2_t xz)
 {
     ASSERT_IN_MAIN_THREAD();
@@ -1015,8 +1111,8 @@ void G_Shutdown(void)
 
     G_ClearState();
 
-    R_DestroyWS(&s_gs.ws[0]);
-    R_DestroyWS(&s_gs.ws[1]);
+    for(int i = 0; i < NUM_RENDER_WS; i++)
+        R_DestroyWS(&s_gs.ws[i]);
 
     R_PushCmd((struct rcmd){ R_GL_WaterShutdown, 0 });
     G_Timer_Shutdown();
@@ -1030,7 +1126,9 @@ void G_Shutdown(void)
     vec_pentity_destroy(&s_gs.light_visible);
     vec_pentity_destroy(&s_gs.visible);
     vec_obb_destroy(&s_gs.visible_obbs);
-    vec_pentity_destroy(&s_gs.deleted);
+
+    for(int i = 0; i < NUM_RENDER_WS; i++)
+        vec_pentity_destroy(&s_gs.deleted[i]);
 }
 
 void G_Update(void)
@@ -1056,38 +1154,24 @@ void G_Update(void)
     struct frustum light_frust;
     R_LightFrustum(s_gs.light_pos, pos, dir, &light_frust);
 
-    uint16_t pm = g_player_mask();
+    if(s_gs.ss == G_RUNNING) {
 
-    uint32_t key;
-    struct entity *curr;
-    (void)key;
-
-    kh_foreach(s_gs.active, key, curr, {
-
-        if(s_gs.ss == G_RUNNING && curr->flags & ENTITY_FLAG_ANIMATED)
-            A_Update(curr);
-
-        if(curr->flags & ENTITY_FLAG_INVISIBLE)
-            continue;
-
-        bool vis = false;
-        struct obb obb;
-        Entity_CurrentOBB(curr, &obb);
-
-        /* Note that there may be some false positives due to using the fast frustum cull. */
-        if(C_FrustumOBBIntersectionFast(&cam_frust, &obb) != VOLUME_INTERSEC_OUTSIDE
-        && (vis = g_ent_visible(pm, curr, &obb))) {
-
-            vec_pentity_push(&s_gs.visible, curr);
-            vec_obb_push(&s_gs.visible_obbs, obb);
-        }
+        uint32_t key;
+        struct entity *curr;
+        (void)key;
 
-        if(C_FrustumOBBIntersectionFast(&light_frust, &obb) != VOLUME_INTERSEC_OUTSIDE 
-        && (vis || (curr->flags & ENTITY_FLAG_STATIC))) {
+        kh_foreach(s_gs.active, key, curr, {
+            if(curr->flags & ENTITY_FLAG_ANIMATED)
+                A_Update(curr);
+        });
+    }
 
-            vec_pentity_push(&s_gs.light_visible, curr);
-        }
-    });
+    struct cull_arg arg = (struct cull_arg){ .pm = g_player_mask() };
+    const struct frustum frusta[] = {
+        [CULL_CAM] = cam_frust, 
+        [CULL_LIGHT] = light_frust
+    };
+    G_Cull_Visit(frusta, ARR_SIZE(frusta), g_cull_visit, &arg);
 
     G_Sel_Update(ACTIVE_CAM, &s_gs.visible, &s_gs.visible_obbs);
 
@@ -1107,7 +1191,15 @@ void G_Render(void)
     g_create_render_input(&in);
     struct render_input *rcopy = g_push_render_input(in);
 
-    G_RenderMapAndEntities(rcopy);
+    /* The recording of the heavier passes is deferred to the end of the 
+     * frame, where it is done in parallel. The commands still execute in 
+     * the order in which the passes are deferred here. */
+    struct render_jobs jobs = (struct render_jobs){ .in = rcopy };
+
+    if(rcopy->shadows) {
+        g_defer_recording(&jobs, g_shadow_pass);
+    }
+    g_defer_recording(&jobs, g_draw_pass);
 
     struct sval refract_setting;
     status = Settings_Get("pf.video.water_refraction", &refract_setting);
@@ -1160,7 +1252,7 @@ void G_Render(void)
     assert(status == SS_OKAY);
 
     if(hb_setting.as_bool) {
-        g_render_healthbars();
+        g_defer_recording(&jobs, g_render_healthbars);
     }
 
     if(s_gs.map) {
@@ -1168,6 +1260,8 @@ void G_Render(void)
         R_PushCmd((struct rcmd){ R_GL_MapInvalidate, 0 });
     }
 
+    Sched_ParallelFor(jobs.njobs, 1, g_record_jobs, &jobs);
+
     PERF_RETURN_VOID();
 }
 
@@ -1266,12 +1360,22 @@ void G_SetStatic(struct entity *ent, bool on)
         G_Move_AddEntity(ent);
         ent->flags &= ~ENTITY_FLAG_STATIC;
     }
+    G_Cull_Update(ent);
+}
+
+void G_UpdateBounds(const struct entity *ent)
+{
+    ASSERT_IN_MAIN_THREAD();
+
+    if(!G_EntityForUID(ent->uid))
+        return;
+    G_Cull_Update(ent);
 }
 
 void G_SafeFree(struct entity *ent)
 {
     ASSERT_IN_MAIN_THREAD();
-    vec_pentity_push(&s_gs.deleted, ent);
+    vec_pentity_push(&s_gs.deleted[s_gs.curr_ws_idx], ent);
 }
 
 bool G_AddFaction(const char *name, vec3_t color)
@@ -1442,7 +1546,12 @@ bool G_UpdateTile(const struct tile_desc *desc, const struct tile *tile)
 
     if(!s_gs.map)
         return false;
-    return M_AL_UpdateTile(s_gs.map, desc, tile);
+    if(!M_AL_UpdateTile(s_gs.map, desc, tile))
+        return false;
+
+    /* The cached vision stencils may be stale after a height change */
+    G_Fog_InvalidateStencils();
+    return true;
 }
 
 bool G_GetTile(const struct tile_desc *desc, struct tile *out)
@@ -1465,7 +1574,7 @@ const khash_t(entity) *G_GetDynamicEntsSet(void)
 
 const khash_t(entity) *G_GetAllEntsSet(void)
 {
-    ASSERT_IN_MAIN_THREAD();
+    ASSERT_IN_MAIN_OR_WORKER_THREAD();
 
     return s_gs.active;
 }
@@ -1477,7 +1586,7 @@ void G_SetSimState(enum simstate ss)
     if(ss == s_gs.ss)
         return;
 
-    uint32_t curr_tick = SDL_GetTicks();
+    uint32_t curr_tick = Clock_Now();
     if(ss == G_RUNNING) {
     
         uint32_t key;
@@ -1538,6 +1647,8 @@ void G_Zombiefy(struct entity *ent)
     ent->flags |= ENTITY_FLAG_INVISIBLE;
     ent->flags |= ENTITY_FLAG_STATIC;
     ent->flags |= ENTITY_FLAG_ZOMBIE;
+
+    G_Cull_Update(ent);
 }
 
 struct entity *G_EntityForUID(uint32_t uid)
@@ -1555,33 +1666,36 @@ struct render_workspace *G_GetSimWS(void)
     return &s_gs.ws[s_gs.curr_ws_idx];
 }
 
-struct render_workspace *G_GetRenderWS(void)
-{
-    ASSERT_IN_RENDER_THREAD();
-
-    return &s_gs.ws[(s_gs.curr_ws_idx + 1) % 2];
-}
-
 void G_SwapBuffers(void)
 {
     ASSERT_IN_MAIN_THREAD();
 
-    int sim_idx = s_gs.curr_ws_idx;
-    int render_idx = (sim_idx + 1) % 2;
+    /* Snapshot the map for the workspace that was just recorded - the 
+     * commands in it reference this copy and the render thread will 
+     * read it while processing them. */
+    if(s_gs.map) {
+        M_AL_ShallowCopy((struct map*)s_gs.prev_tick_maps[s_gs.curr_ws_idx], s_gs.map);
+    }
 
-    if(s_gs.map)
-        M_AL_ShallowCopy((struct map*)s_gs.prev_tick_map, s_gs.map);
+    /* The caller guarantees that the render thread is done with the oldest 
+     * workspace in the ring, which is the one we're moving on to. */
+    int next_idx = (s_gs.curr_ws_idx + 1) % NUM_RENDER_WS;
+    vec_pentity_t *deleted = &s_gs.deleted[next_idx];
 
-    for(int i = 0; i < vec_size(&s_gs.deleted); i++) {
+    for(int i = 0; i < vec_size(deleted); i++) {
 
-        struct entity *curr = vec_AT(&s_gs.deleted, i);
+        struct entity *curr = vec_AT(deleted, i);
         AL_EntityFree(curr);
     }
-    vec_pentity_reset(&s_gs.deleted);
+    vec_pentity_reset(deleted);
+
+    assert(queue_size(s_gs.ws[next_idx].commands) == 0);
+    R_ClearWS(&s_gs.ws[next_idx]);
+    s_gs.curr_ws_idx = next_idx;
 
-    assert(queue_size(s_gs.ws[render_idx].commands) == 0);
-    R_ClearWS(&s_gs.ws[render_idx]);
-    s_gs.curr_ws_idx = render_idx;
+    if(s_gs.map) {
+        s_gs.prev_tick_map = s_gs.prev_tick_maps[next_idx];
+    }
 }
 
 const struct map *G_GetPrevTickMap(void)
@@ -41,11 +41,15 @@
 #include "../render/public/render_ctrl.h"
 #include "faction.h"
 #include "selection.h"
+#include "../config.h"
 
 #include <stdint.h>
 
 
-#define NUM_CAMERAS  2
+#define NUM_CAMERAS     2
+/* One workspace for the frame being recorded, plus one for each of the frames
+ * that may be queued up for, or being processed by, the render thread */
+#define NUM_RENDER_WS   (CONFIG_MAX_FRAMES_AHEAD + 1)
 
 struct gamestate{
     enum simstate           ss;
@@ -115,25 +119,29 @@ struct gamestate{
     enum diplomacy_state    diplomacy_table[MAX_FACTIONS][MAX_FACTIONS];
     /*-------------------------------------------------------------------------
      * The index indo the 'ws' field, where the rendering commands are stored.
-     * The previous frame workspace is owned by the render thread. The render
-     * and simulatino workspaces are swapped at the end of every frame.
+     * The workspaces form a ring: the ones of the previous frames are owned by 
+     * the render thread until it is done processing them. The simulation moves 
+     * on to the next workspace at the end of every frame.
      *-------------------------------------------------------------------------
      */
     int                     curr_ws_idx;
-    struct render_workspace ws[2];
+    struct render_workspace ws[NUM_RENDER_WS];
     /*-------------------------------------------------------------------------
-     * A readonly snapshot (copy) of the map from the previous simulation tick. 
-     * This is used by the render thread for making certain queries like size,
-     * height at a point, etc.
+     * Readonly snapshots (copies) of the map from the previous simulation tick,
+     * one per workspace. These are used by the render thread for making certain 
+     * queries like size, height at a point, etc. 'prev_tick_map' points to the 
+     * snapshot of the workspace currently being recorded.
      *-------------------------------------------------------------------------
      */
     const struct map       *prev_tick_map;
+    void                   *prev_tick_maps[NUM_RENDER_WS];
     /*-------------------------------------------------------------------------
-     * Entities currently scheduled for deletion. They are safe to delete once
-     * the render thread has finished its' work.
+     * Entities scheduled for deletion during the recording of each workspace. 
+     * They are safe to delete once the render thread has finished processing 
+     * that workspace.
      *-------------------------------------------------------------------------
      */
-    vec_pentity_t           deleted;
+    vec_pentity_t           deleted[NUM_RENDER_WS];
 };
 
 #endif
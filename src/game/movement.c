@@ -37,6 +37,7 @@
 #include "game_private.h"
 #include "combat.h"
 #include "clearpath.h"
+#include "position.h"
 #include "public/game.h"
 #include "../config.h"
 #include "../camera.h"
@@ -48,6 +49,7 @@
 #include "../settings.h"
 #include "../ui.h"
 #include "../perf.h"
+#include "../sched.h"
 #include "../script/public/script.h"
 #include "../render/public/render.h"
 #include "../map/public/map.h"
@@ -68,6 +70,7 @@
 
 #define SIGNUM(x)    (((x) > 0) - ((x) < 0))
 #define MIN(a, b)    ((a) < (b) ? (a) : (b))
+#define MAX(a, b)    ((a) > (b) ? (a) : (b))
 #define ARR_SIZE(a)  (sizeof(a)/sizeof(a[0]))
 #define STR(a)       #a
 
@@ -95,6 +98,9 @@ enum arrival_state{
     /* The navigation system was unable to guide the entity closer
      * to the goal. It stops and waits. */
     STATE_WAITING,
+    /* The path to the flock's destination is still being computed. The 
+     * entity keeps its' current velocity until it is ready. */
+    STATE_PATH_PENDING,
 };
 
 struct movestate{
@@ -124,11 +130,30 @@ struct flock{
     khash_t(entity) *ents;
     vec2_t           target_xz; 
     dest_id_t        dest_id;
+    /* The most recent path request made on behalf of this flock. Set to
+     * PATH_TICKET_INVALID once it has been serviced. */
+    path_ticket_t    ticket;
 };
 
 VEC_TYPE(flock, struct flock)
 VEC_IMPL(static inline, flock, struct flock)
 
+/* The inputs for computing the new velocity of a single entity. These are 
+ * gathered on the main thread, since the navigation queries may touch the 
+ * field caches. The ClearPath computations can then be spread across the 
+ * worker threads.
+ */
+struct cp_work{
+    struct entity    *ent;
+    struct movestate *ms;
+    struct cp_ent     cpent;
+    vec2_t            vpref;
+    bool              save_debug;
+};
+
+VEC_TYPE(cp_work, struct cp_work)
+VEC_IMPL(static inline, cp_work, struct cp_work)
+
 /* Parameters controlling steering/flocking behaviours */
 #define SEPARATION_FORCE_SCALE          (0.6f)
 #define MOVE_ARRIVE_FORCE_SCALE         (0.5f)
@@ -140,10 +165,16 @@ VEC_IMPL(static inline, flock, struct flock)
 #define ADJACENCY_SEP_DIST              (5.0f)
 #define ALIGN_NEIGHBOUR_RADIUS          (10.0f)
 #define SEPARATION_NEIGHB_RADIUS        (30.0f)
+/* The neighbour table must cover the largest of the per-entity query radii */
+#define NEIGHBOUR_TABLE_RADIUS          (MAX(SEPARATION_NEIGHB_RADIUS, CLEARPATH_NEIGHBOUR_RADIUS))
 
 #define COLLISION_MAX_SEE_AHEAD         (10.0f)
 #define WAIT_TICKS                      (60)
 
+/* The number of entities claimed by a thread at a time during the 
+ * parallel ClearPath computation */
+#define CLEARPATH_GRAIN                 (16)
+
 /*****************************************************************************/
 /* STATIC VARIABLES                                                          */
 /*****************************************************************************/
@@ -156,6 +187,20 @@ static vec_pentity_t           s_move_markers;
 static vec_flock_t             s_flocks;
 static khash_t(state)         *s_entity_state_table;
 
+static vec_cp_work_t           s_cp_work;
+/* The neighbours of every moving entity, rebuilt at the start of every tick */
+static struct pos_ntable       *s_neighbours;
+/* False when the table could not be built for the current tick */
+static bool                    s_neighbours_valid;
+/* Per-thread neighbour scratch buffers for the ClearPath computation */
+static vec_cp_ent_t            s_dyn_scratch[MAX_WORKER_THREADS + 1];
+static vec_cp_ent_t            s_stat_scratch[MAX_WORKER_THREADS + 1];
+/* Per-thread ClearPath counters for the current tick, and their running totals */
+static struct cp_stats         s_cp_thread_stats[MAX_WORKER_THREADS + 1];
+static struct cp_stats         s_cp_stats;
+/* The number of ray pairs each entity may intersect in the current tick */
+static size_t                  s_cp_pair_budget;
+
 /* Store the most recently issued move command location for debug rendering */
 static bool                    s_last_cmd_dest_valid = false;
 static dest_id_t               s_last_cmd_dest;
@@ -165,6 +210,7 @@ static const char *s_state_str[] = {
     [STATE_ARRIVED]      = STR(STATE_ARRIVED),
     [STATE_SEEK_ENEMIES] = STR(STATE_SEEK_ENEMIES),
     [STATE_WAITING]      = STR(STATE_WAITING),
+    [STATE_PATH_PENDING] = STR(STATE_PATH_PENDING),
 };
 
 /*****************************************************************************/
@@ -340,6 +386,85 @@ static void remove_from_flocks(const struct entity *ent)
     assert(NULL == flock_for_ent(ent));
 }
 
+/* Make a path request for every distinct chunk that the flock's entities are 
+ * currently in. Since the requests are serviced in order, only the last ticket 
+ * needs to be kept. If the requests could not be made, the entities are set 
+ * to start moving right away, and the paths will be requested synchronously. 
+ */
+static path_ticket_t request_flock_paths(const struct flock *flock)
+{
+    if(kh_size(flock->ents) == 0)
+        return PATH_TICKET_INVALID;
+
+    path_ticket_t ret = PATH_TICKET_INVALID;
+    struct tile_desc srcs[kh_size(flock->ents)];
+    size_t nsrcs = 0;
+
+    uint32_t key;
+    struct entity *curr;
+    (void)key;
+
+    kh_foreach(flock->ents, key, curr, {
+
+        vec2_t pos_xz = G_Pos_GetXZ(curr->uid);
+        struct tile_desc td;
+        if(!M_DescForPoint2D(s_map, pos_xz, &td))
+            continue;
+        if(same_chunk_as_any_in_set(td, srcs, nsrcs))
+            continue;
+        srcs[nsrcs++] = td;
+
+        path_ticket_t ticket = M_NavRequestPathAsync(s_map, pos_xz, flock->target_xz);
+        if(ticket == PATH_TICKET_INVALID) {
+            ret = PATH_TICKET_INVALID;
+            break;
+        }
+        ret = ticket;
+    });
+
+    if(ret == PATH_TICKET_INVALID) {
+        kh_foreach(flock->ents, key, curr, {
+            struct movestate *ms = movestate_get(curr);
+            assert(ms);
+            if(ms->state == STATE_PATH_PENDING)
+                ms->state = STATE_MOVING;
+        });
+    }
+    return ret;
+}
+
+static void on_path_ready(void *user, void *event)
+{
+    path_ticket_t ticket = (uintptr_t)event;
+
+    for(int i = 0; i < vec_size(&s_flocks); i++) {
+
+        struct flock *curr_flock = &vec_AT(&s_flocks, i);
+        if(curr_flock->ticket == PATH_TICKET_INVALID)
+            continue;
+        /* The tickets are serviced in order. Compare them by their difference so
+         * that the flock's last request is still recognized when the counter wraps. */
+        if((int32_t)(curr_flock->ticket - ticket) > 0)
+            continue;
+
+        uint32_t key;
+        struct entity *curr;
+        (void)key;
+
+        kh_foreach(curr_flock->ents, key, curr, {
+
+            struct movestate *ms = movestate_get(curr);
+            assert(ms);
+            if(ms->state != STATE_PATH_PENDING)
+                continue;
+
+            ms->state = STATE_MOVING;
+            E_Entity_Notify(EVENT_PATH_READY, curr->uid, event, ES_ENGINE);
+        });
+        curr_flock->ticket = PATH_TICKET_INVALID;
+    }
+}
+
 static bool make_flock_from_selection(const vec_pentity_t *sel, vec2_t target_xz, bool attack)
 {
     if(vec_size(sel) == 0)
@@ -384,12 +509,15 @@ static bool make_flock_from_selection(const vec_pentity_t *sel, vec2_t target_xz
         }
 
         flock_add(&new_flock, curr_ent);
-        ms->state = STATE_MOVING;
+        ms->state = STATE_PATH_PENDING;
     }
 
-    /* The flow fields will be computed on-demand during the next movement update tick */
+    /* Request the paths for the flock's entities in the background. Any fields 
+     * which are still missing once the requests are serviced will be computed 
+     * on-demand during the movement update ticks. */
     new_flock.target_xz = target_xz;
     new_flock.dest_id = M_NavDestIDForPos(s_map, target_xz);
+    new_flock.ticket = request_flock_paths(&new_flock);
 
     if(kh_size(new_flock.ents) > 0) {
 
@@ -403,6 +531,9 @@ static bool make_flock_from_selection(const vec_pentity_t *sel, vec2_t target_xz
 
             kh_foreach(new_flock.ents, key, curr, { flock_add(merge_flock, curr); });
             kh_destroy(entity, new_flock.ents);
+
+            if(new_flock.ticket != PATH_TICKET_INVALID)
+                merge_flock->ticket = new_flock.ticket;
         
         }else{
             vec_flock_push(&s_flocks, new_flock);
@@ -452,9 +583,9 @@ static void move_marker_add(vec3_t pos, bool attack)
     assert(ent);
     ent->flags |= ENTITY_FLAG_STATIC;
     ent->flags |= ENTITY_FLAG_MARKER;
+    ent->scale = (vec3_t){2.0f, 2.0f, 2.0f};
     G_AddEntity(ent, pos);
 
-    ent->scale = (vec3_t){2.0f, 2.0f, 2.0f};
     E_Entity_Register(EVENT_ANIM_FINISHED, ent->uid, on_marker_anim_finish, ent, G_RUNNING);
 
     A_InitCtx(ent, "Converge", 48);
@@ -554,6 +685,7 @@ static void on_render_3d(void *user, void *event)
                 break;
             case STATE_ARRIVED:
             case STATE_WAITING:
+            case STATE_PATH_PENDING:
                 break;
             case STATE_SEEK_ENEMIES:
                 M_NavRenderVisibleEnemySeekField(s_map, cam, ent->faction_id);
@@ -767,29 +899,52 @@ static vec2_t cohesion_force(const struct entity *ent, const struct flock *flock
     return ret;
 }
 
+/* Returns the entities within 'radius' of 'ent'. These are taken from the 
+ * neighbour table, unless it could not be built for the current tick. Then, 
+ * the spatial index is queried directly and the results are written to 'buff'.
+ */
+static size_t near_entities(const struct entity *ent, float radius, 
+                            struct pos_neighbour *buff, size_t maxout, 
+                            const struct pos_neighbour **out)
+{
+    if(s_neighbours_valid)
+        return G_Pos_NTableGet(s_neighbours, ent->uid, out);
+
+    struct entity *ents[maxout];
+    int ret = G_Pos_EntsInCircle(G_Pos_GetXZ(ent->uid), radius, ents, maxout);
+
+    for(int i = 0; i < ret; i++) {
+        buff[i] = (struct pos_neighbour){ents[i], G_Pos_GetXZ(ents[i]->uid)};
+    }
+    *out = buff;
+    return ret;
+}
+
 /* Separation is a behaviour that causes agents to steer away from nearby agents.
  */
 static vec2_t separation_force(const struct entity *ent, float buffer_dist)
 {
     vec2_t ret = (vec2_t){0.0f};
-    struct entity *near_ents[128];
-    int num_near = G_Pos_EntsInCircle(G_Pos_GetXZ(ent->uid), 
-        SEPARATION_NEIGHB_RADIUS, near_ents, ARR_SIZE(near_ents));
+    struct pos_neighbour buff[128];
+    const struct pos_neighbour *near_ents;
+    size_t num_near = near_entities(ent, SEPARATION_NEIGHB_RADIUS, buff, ARR_SIZE(buff), &near_ents);
+    vec2_t ent_xz_pos = G_Pos_GetXZ(ent->uid);
 
     for(int i = 0; i < num_near; i++) {
 
-        struct entity *curr = near_ents[i];
+        struct entity *curr = near_ents[i].ent;
         if(curr == ent)
             continue;
         if(curr->flags & ENTITY_FLAG_STATIC)
             continue;
 
         vec2_t diff;
-        vec2_t ent_xz_pos = G_Pos_GetXZ(ent->uid);
-        vec2_t curr_xz_pos = G_Pos_GetXZ(curr->uid);
+        vec2_t curr_xz_pos = near_ents[i].xz_pos;
+        PFM_Vec2_Sub(&curr_xz_pos, &ent_xz_pos, &diff);
+        if(PFM_Vec2_Len(&diff) > SEPARATION_NEIGHB_RADIUS)
+            continue;
 
         float radius = ent->selection_radius + curr->selection_radius + buffer_dist;
-        PFM_Vec2_Sub(&curr_xz_pos, &ent_xz_pos, &diff);
 
         /* Exponential decay with y=1 when diff = radius*0.85 
          * Use smooth decay curves in order to curb the 'toggling' or oscillating 
@@ -1070,12 +1225,19 @@ static void entity_update(struct entity *ent, vec2_t new_vel)
         break;
     }
     case STATE_ARRIVED:
+    case STATE_PATH_PENDING:
         break;
     default: 
         assert(0);
     }
 }
 
+static bool ent_moving(const struct entity *ent, void *arg)
+{
+    struct movestate *ms = movestate_get(ent);
+    return (ms && !ent_still(ms));
+}
+
 static void find_neighbours(const struct entity *ent,
                             vec_cp_ent_t *out_dyn,
                             vec_cp_ent_t *out_stat)
@@ -1087,12 +1249,13 @@ static void find_neighbours(const struct entity *ent,
      * meaning they will not perform collision avoidance maneuvers of
      * their own. */
 
-    struct entity *near_ents[512];
-    int num_near = G_Pos_EntsInCircle(G_Pos_GetXZ(ent->uid), 
-        CLEARPATH_NEIGHBOUR_RADIUS, near_ents, ARR_SIZE(near_ents));
+    struct pos_neighbour buff[512];
+    const struct pos_neighbour *near_ents;
+    size_t num_near = near_entities(ent, CLEARPATH_NEIGHBOUR_RADIUS, buff, ARR_SIZE(buff), &near_ents);
+    vec2_t ent_xz_pos = G_Pos_GetXZ(ent->uid);
 
     for(int i = 0; i < num_near; i++) {
-        struct entity *curr = near_ents[i];
+        struct entity *curr = near_ents[i].ent;
 
         if(curr->uid == ent->uid)
             continue;
@@ -1103,10 +1266,17 @@ static void find_neighbours(const struct entity *ent,
         if(curr->selection_radius == 0.0f)
             continue;
 
+        vec2_t diff;
+        vec2_t curr_xz_pos = near_ents[i].xz_pos;
+        PFM_Vec2_Sub(&curr_xz_pos, &ent_xz_pos, &diff);
+        if(PFM_Vec2_Len(&diff) > CLEARPATH_NEIGHBOUR_RADIUS)
+            continue;
+
+        /* The neighbour may have been removed since the table was built */
         struct movestate *ms = movestate_get(curr);
-        assert(ms);
+        if(!ms)
+            continue;
 
-        vec2_t curr_xz_pos = G_Pos_GetXZ(curr->uid);
         struct cp_ent newdesc = (struct cp_ent) {
             .xz_pos = curr_xz_pos,
             .xz_vel = ms->velocity,
@@ -1150,18 +1320,63 @@ static void disband_empty_flocks(void)
     }
 }
 
+/* Runs on the worker threads. The position and movestate tables must not be 
+ * modified until all the work is done. Each entity writes only to its' own 
+ * movestate. Note that 'velocity' is only updated after all the new velocities 
+ * have been computed, so the neighbours' velocities read here are stable.
+ */
+static void clearpath_work(void *arg, int thread_idx, size_t begin, size_t end)
+{
+    const struct cp_work *work = arg;
+    vec_cp_ent_t *dyn = &s_dyn_scratch[thread_idx];
+    vec_cp_ent_t *stat = &s_stat_scratch[thread_idx];
+
+    for(size_t i = begin; i < end; i++) {
+
+        const struct cp_work *curr = &work[i];
+        struct movestate *ms = curr->ms;
+
+        vec_cp_ent_reset(dyn);
+        vec_cp_ent_reset(stat);
+        find_neighbours(curr->ent, dyn, stat);
+
+        ms->vnew = G_ClearPath_NewVelocity(curr->cpent, curr->ent->uid, curr->vpref, 
+            *dyn, *stat, s_cp_pair_budget, curr->save_debug, &s_cp_thread_stats[thread_idx]);
+        update_vel_hist(ms, ms->vnew);
+
+        vec2_t vel_diff;
+        PFM_Vec2_Sub(&ms->vnew, &ms->velocity, &vel_diff);
+
+        PFM_Vec2_Add(&ms->velocity, &vel_diff, &ms->vnew);
+        vec2_truncate(&ms->vnew, curr->ent->max_speed / MOVE_TICK_RES);
+    }
+}
+
+static void merge_cp_stats(void)
+{
+    for(int i = 0; i < ARR_SIZE(s_cp_thread_stats); i++) {
+
+        const struct cp_stats *curr = &s_cp_thread_stats[i];
+        s_cp_stats.solved += curr->solved;
+        s_cp_stats.iterations += curr->iterations;
+        s_cp_stats.max_iterations = MAX(s_cp_stats.max_iterations, curr->max_iterations);
+        s_cp_stats.degraded += curr->degraded;
+        s_cp_stats.failed += curr->failed;
+        s_cp_stats.ray_pairs += curr->ray_pairs;
+    }
+}
+
 static void on_20hz_tick(void *user, void *event)
 {
     PERF_ENTER();
 
-    vec_cp_ent_t dyn, stat;
-    vec_cp_ent_init(&dyn);
-    vec_cp_ent_init(&stat);
-
     uint32_t key;
     struct entity *curr;
+    (void)key;
 
     disband_empty_flocks();
+    vec_cp_work_reset(&s_cp_work);
+    s_neighbours_valid = G_Pos_NTableBuild(s_neighbours, NEIGHBOUR_TABLE_RADIUS, ent_moving, NULL);
 
     kh_foreach(G_GetDynamicEntsSet(), key, curr, {
 
@@ -1173,9 +1388,17 @@ static void on_20hz_tick(void *user, void *event)
 
         struct flock *flock = flock_for_ent(curr);
         vec2_t vpref = (vec2_t){-1,-1};
-        ms->vdes = ent_desired_velocity(curr);
+
+        /* Don't query the navigation system until the path is ready, as 
+         * that would generate the missing fields synchronously. */
+        if(ms->state != STATE_PATH_PENDING)
+            ms->vdes = ent_desired_velocity(curr);
 
         switch(ms->state) {
+        case STATE_PATH_PENDING:
+            assert(flock);
+            vpref = ms->velocity;
+            break;
         case STATE_SEEK_ENEMIES: 
             assert(!flock);
             vpref = enemy_seek_vpref(curr);
@@ -1186,25 +1409,26 @@ static void on_20hz_tick(void *user, void *event)
         }
         assert(vpref.x != -1 || vpref.z != -1);
 
-        struct cp_ent curr_cp = (struct cp_ent) {
-            .xz_pos = G_Pos_GetXZ(curr->uid),
-            .xz_vel = ms->velocity,
-            .radius = curr->selection_radius,
-        };
-
-        vec_cp_ent_reset(&dyn);
-        vec_cp_ent_reset(&stat);
-        find_neighbours(curr, &dyn, &stat);
-
-        ms->vnew = G_ClearPath_NewVelocity(curr_cp, key, vpref, dyn, stat);
-        update_vel_hist(ms, ms->vnew);
+        vec_cp_work_push(&s_cp_work, (struct cp_work){
+            .ent = curr,
+            .ms = ms,
+            .cpent = (struct cp_ent) {
+                .xz_pos = G_Pos_GetXZ(curr->uid),
+                .xz_vel = ms->velocity,
+                .radius = curr->selection_radius,
+            },
+            .vpref = vpref,
+            .save_debug = G_ClearPath_ShouldSaveDebug(curr->uid),
+        });
+    });
 
-        vec2_t vel_diff;
-        PFM_Vec2_Sub(&ms->vnew, &ms->velocity, &vel_diff);
+    /* The tick's ClearPath work budget is split evenly between the entities, 
+     * so that the results don't depend on the order they are processed in. */
+    s_cp_pair_budget = CONFIG_CLEARPATH_TICK_BUDGET / MAX(vec_size(&s_cp_work), 1);
+    memset(s_cp_thread_stats, 0, sizeof(s_cp_thread_stats));
 
-        PFM_Vec2_Add(&ms->velocity, &vel_diff, &ms->vnew);
-        vec2_truncate(&ms->vnew, curr->max_speed / MOVE_TICK_RES);
-    });
+    Sched_ParallelFor(vec_size(&s_cp_work), CLEARPATH_GRAIN, clearpath_work, s_cp_work.array);
+    merge_cp_stats();
 
     kh_foreach(G_GetDynamicEntsSet(), key, curr, {
     
@@ -1214,9 +1438,6 @@ static void on_20hz_tick(void *user, void *event)
         entity_update(curr, ms->vnew);
     });
 
-    vec_cp_ent_destroy(&dyn);
-    vec_cp_ent_destroy(&stat);
-
     PERF_RETURN_VOID();
 }
 
@@ -1232,10 +1453,26 @@ bool G_Move_Init(const struct map *map)
     }
     vec_pentity_init(&s_move_markers);
     vec_flock_init(&s_flocks);
+    vec_cp_work_init(&s_cp_work);
+
+    if(NULL == (s_neighbours = G_Pos_NTableNew())) {
+        vec_cp_work_destroy(&s_cp_work);
+        vec_flock_destroy(&s_flocks);
+        vec_pentity_destroy(&s_move_markers);
+        kh_destroy(state, s_entity_state_table);
+        return false;
+    }
+
+    for(int i = 0; i < ARR_SIZE(s_dyn_scratch); i++) {
+        vec_cp_ent_init(&s_dyn_scratch[i]);
+        vec_cp_ent_init(&s_stat_scratch[i]);
+    }
+    memset(&s_cp_stats, 0, sizeof(s_cp_stats));
 
     E_Global_Register(SDL_MOUSEBUTTONDOWN, on_mousedown, NULL, G_RUNNING);
     E_Global_Register(EVENT_RENDER_3D, on_render_3d, NULL, G_RUNNING | G_PAUSED_FULL | G_PAUSED_UI_RUNNING);
     E_Global_Register(EVENT_20HZ_TICK, on_20hz_tick, NULL, G_RUNNING);
+    E_Global_Register(EVENT_PATH_READY, on_path_ready, NULL, G_RUNNING | G_PAUSED_FULL | G_PAUSED_UI_RUNNING);
 
     s_map = map;
     return true;
@@ -1245,6 +1482,7 @@ void G_Move_Shutdown(void)
 {
     s_map = NULL;
 
+    E_Global_Unregister(EVENT_PATH_READY, on_path_ready);
     E_Global_Unregister(EVENT_20HZ_TICK, on_20hz_tick);
     E_Global_Unregister(EVENT_RENDER_3D, on_render_3d);
     E_Global_Unregister(SDL_MOUSEBUTTONDOWN, on_mousedown);
@@ -1255,6 +1493,13 @@ void G_Move_Shutdown(void)
         G_SafeFree(vec_AT(&s_move_markers, i));
     }
 
+    for(int i = 0; i < ARR_SIZE(s_dyn_scratch); i++) {
+        vec_cp_ent_destroy(&s_dyn_scratch[i]);
+        vec_cp_ent_destroy(&s_stat_scratch[i]);
+    }
+
+    G_Pos_NTableFree(s_neighbours);
+    vec_cp_work_destroy(&s_cp_work);
     vec_flock_destroy(&s_flocks);
     vec_pentity_destroy(&s_move_markers);
     kh_destroy(state, s_entity_state_table);
@@ -1340,7 +1585,7 @@ void G_Move_SetDest(const struct entity *ent, vec2_t dest_xz)
             entity_unblock(ent);
             E_Entity_Notify(EVENT_MOTION_START, ent->uid, NULL, ES_ENGINE);
         }
-        ms->state = STATE_MOVING;
+        ms->state = (fl->ticket != PATH_TICKET_INVALID) ? STATE_PATH_PENDING : STATE_MOVING;
         assert(flock_for_ent(ent));
         return;
     }
@@ -1424,6 +1669,11 @@ void G_Move_UpdateSelectionRadius(const struct entity *ent, float sel_radius)
     ms->last_stop_radius = sel_radius;
 }
 
+void G_Move_GetClearPathStats(struct cp_stats *out)
+{
+    *out = s_cp_stats;
+}
+
 bool G_Move_SaveState(struct SDL_RWops *stream)
 {
     /* save flock info */
@@ -1487,9 +1737,11 @@ bool G_Move_SaveState(struct SDL_RWops *stream)
         };
         CHK_TRUE_RET(Attr_Write(stream, &uid, "uid"));
 
+        /* The pending path requests are not saved. The paths will be 
+         * requested again once the entity starts moving. */
         struct attr state = (struct attr){
             .type = TYPE_INT,
-            .val.as_int = curr.state
+            .val.as_int = (curr.state == STATE_PATH_PENDING) ? STATE_MOVING : curr.state
         };
         CHK_TRUE_RET(Attr_Write(stream, &state, "state"));
 
@@ -1584,6 +1836,7 @@ bool G_Move_LoadState(struct SDL_RWops *stream)
         CHK_TRUE_JMP(Attr_Parse(stream, &attr, true), fail_flock);
         CHK_TRUE_JMP(attr.type == TYPE_INT, fail_flock);
         new_flock.dest_id = attr.val.as_int;
+        new_flock.ticket = PATH_TICKET_INVALID;
 
         vec_flock_push(&s_flocks, new_flock);
         continue;
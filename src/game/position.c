@@ -33,40 +33,94 @@
  *
  */
 
+#include "position.h"
 #include "game_private.h"
 #include "movement.h"
 #include "fog_of_war.h"
+#include "cull.h"
 #include "public/game.h"
 #include "../main.h"
 #include "../pf_math.h"
 #include "../perf.h"
+#include "../sched.h"
 #include "../lib/public/quadtree.h"
 #include "../lib/public/khash.h"
+#include "../lib/public/vec.h"
 #include "../map/public/map.h"
 #include "../map/public/tile.h"
 
 #include <assert.h>
 #include <float.h>
+#include <stdlib.h>
+#include <math.h>
 
 
 QUADTREE_TYPE(ent, uint32_t)
 QUADTREE_PROTOTYPES(static, ent, uint32_t)
 QUADTREE_IMPL(static, ent, uint32_t)
 
-KHASH_MAP_INIT_INT(pos, vec3_t)
+struct pos_rec{
+    vec3_t pos;
+    int    slot; /* Index of the entity within its' grid cell */
+};
+
+KHASH_MAP_INIT_INT(pos, struct pos_rec)
+
+/* The entities in a single cell of the grid are kept in parallel arrays 
+ * so that the range tests only touch the tightly-packed coordinates. */
+struct pos_cell{
+    size_t          nents;
+    size_t          capacity;
+    float          *xs;
+    float          *zs;
+    struct entity **ents;
+};
+
+struct pos_grid{
+    float            xmin, xmax;
+    float            zmin, zmax;
+    float            cell_len;
+    int              nrows, ncols;
+    struct pos_cell *cells;
+    size_t           nrecs;
+};
+
+struct pos_nrange{
+    size_t begin;
+    size_t count;
+};
+
+KHASH_MAP_INIT_INT(nrange, struct pos_nrange)
+
+VEC_TYPE(nb, struct pos_neighbour)
+VEC_IMPL(static inline, nb, struct pos_neighbour)
+
+struct pos_ntable{
+    /* Maps an entity to its' range of the neighbours array */
+    khash_t(nrange) *ranges;
+    vec_nb_t         neighbours;
+};
 
 #define POSBUF_INIT_SIZE (16384)
 #define MAX_SEARCH_ENTS  (8192)
 #define MAX(a, b)        ((a) < (b) ? (a) : (b))
 #define ARR_SIZE(a)      (sizeof(a)/sizeof(a[0]))
+#define CLAMP(a, min, max) ((a) < (min) ? (min) : ((a) > (max) ? (max) : (a)))
+
+/* The side length of a grid cell, in tiles */
+#define CELL_TILES       (4)
+#define CELL_INIT_CAP    (8)
 
 /*****************************************************************************/
 /* STATIC VARIABLES                                                          */
 /*****************************************************************************/
 
-static khash_t(pos) *s_postable;
-/* The quadtree is always synchronized with the postable, at function call boundaries */
-static qt_ent_t      s_postree;
+static enum pos_index  s_index_type;
+static khash_t(pos)   *s_postable;
+/* The spatial index is always synchronized with the postable, at function 
+ * call boundaries. Only the one selected at initialization time is used. */
+static qt_ent_t        s_postree;
+static struct pos_grid s_posgrid;
 
 /*****************************************************************************/
 /* STATIC FUNCTIONS                                                          */
@@ -77,6 +131,383 @@ static bool any_ent(const struct entity *ent, void *arg)
     return true;
 }
 
+static bool grid_init(struct pos_grid *grid, float xmin, float xmax, 
+                      float zmin, float zmax, float cell_len)
+{
+    grid->xmin = xmin;
+    grid->xmax = xmax;
+    grid->zmin = zmin;
+    grid->zmax = zmax;
+    grid->cell_len = cell_len;
+    grid->ncols = (int)ceilf((xmax - xmin) / cell_len);
+    grid->nrows = (int)ceilf((zmax - zmin) / cell_len);
+    if(grid->ncols < 1) grid->ncols = 1;
+    if(grid->nrows < 1) grid->nrows = 1;
+    grid->nrecs = 0;
+
+    grid->cells = calloc(grid->nrows * grid->ncols, sizeof(struct pos_cell));
+    return (grid->cells != NULL);
+}
+
+static void grid_destroy(struct pos_grid *grid)
+{
+    for(int i = 0; i < grid->nrows * grid->ncols; i++) {
+        struct pos_cell *cell = &grid->cells[i];
+        free(cell->xs);
+        free(cell->zs);
+        free(cell->ents);
+    }
+    free(grid->cells);
+    grid->cells = NULL;
+}
+
+static int grid_col(const struct pos_grid *grid, float x)
+{
+    int ret = (x - grid->xmin) / grid->cell_len;
+    return CLAMP(ret, 0, grid->ncols - 1);
+}
+
+static int grid_row(const struct pos_grid *grid, float z)
+{
+    int ret = (z - grid->zmin) / grid->cell_len;
+    return CLAMP(ret, 0, grid->nrows - 1);
+}
+
+/* Positions outside the grid's bounds are kept in the nearest border cell */
+static int grid_cell_idx(const struct pos_grid *grid, float x, float z)
+{
+    return grid_row(grid, z) * grid->ncols + grid_col(grid, x);
+}
+
+static bool grid_cell_reserve(struct pos_cell *cell, size_t cap)
+{
+    if(cell->capacity >= cap)
+        return true;
+
+    size_t new_cap = cell->capacity ? cell->capacity * 2 : CELL_INIT_CAP;
+    while(new_cap < cap)
+        new_cap *= 2;
+
+    float *xs = realloc(cell->xs, new_cap * sizeof(float));
+    if(!xs)
+        return false;
+    cell->xs = xs;
+
+    float *zs = realloc(cell->zs, new_cap * sizeof(float));
+    if(!zs)
+        return false;
+    cell->zs = zs;
+
+    struct entity **ents = realloc(cell->ents, new_cap * sizeof(struct entity*));
+    if(!ents)
+        return false;
+    cell->ents = ents;
+
+    cell->capacity = new_cap;
+    return true;
+}
+
+static bool grid_insert(struct pos_grid *grid, struct entity *ent, vec3_t pos, int *out_slot)
+{
+    struct pos_cell *cell = &grid->cells[grid_cell_idx(grid, pos.x, pos.z)];
+    if(!grid_cell_reserve(cell, cell->nents + 1))
+        return false;
+
+    cell->xs[cell->nents] = pos.x;
+    cell->zs[cell->nents] = pos.z;
+    cell->ents[cell->nents] = ent;
+    *out_slot = cell->nents++;
+    grid->nrecs++;
+    return true;
+}
+
+/* The last entity of the cell is moved into the vacated slot. Its' record 
+ * must be updated to point to the new slot. */
+static void grid_remove(struct pos_grid *grid, vec3_t pos, int slot)
+{
+    struct pos_cell *cell = &grid->cells[grid_cell_idx(grid, pos.x, pos.z)];
+    assert(slot >= 0 && slot < cell->nents);
+
+    int last = cell->nents - 1;
+    if(slot != last) {
+
+        cell->xs[slot] = cell->xs[last];
+        cell->zs[slot] = cell->zs[last];
+        cell->ents[slot] = cell->ents[last];
+
+        khiter_t k = kh_get(pos, s_postable, cell->ents[slot]->uid);
+        assert(k != kh_end(s_postable));
+        kh_val(s_postable, k).slot = slot;
+    }
+    cell->nents--;
+    grid->nrecs--;
+}
+
+static int grid_inrange_rect(const struct pos_grid *grid, float xmin, float xmax, 
+                             float zmin, float zmax, struct entity **out, size_t maxout)
+{
+    int ret = 0;
+    int rmin = grid_row(grid, zmin), rmax = grid_row(grid, zmax);
+    int cmin = grid_col(grid, xmin), cmax = grid_col(grid, xmax);
+
+    for(int r = rmin; r <= rmax; r++) {
+    for(int c = cmin; c <= cmax; c++) {
+
+        const struct pos_cell *cell = &grid->cells[r * grid->ncols + c];
+        for(int i = 0; i < cell->nents; i++) {
+
+            if(ret == maxout)
+                return ret;
+
+            float x = cell->xs[i], z = cell->zs[i];
+            if(x < xmin || x > xmax || z < zmin || z > zmax)
+                continue;
+            out[ret++] = cell->ents[i];
+        }
+    }}
+    return ret;
+}
+
+static int grid_inrange_circle(const struct pos_grid *grid, float x, float z, float range, 
+                               struct entity **out, size_t maxout)
+{
+    int ret = 0;
+    const float range_sq = range * range;
+    int rmin = grid_row(grid, z - range), rmax = grid_row(grid, z + range);
+    int cmin = grid_col(grid, x - range), cmax = grid_col(grid, x + range);
+
+    for(int r = rmin; r <= rmax; r++) {
+    for(int c = cmin; c <= cmax; c++) {
+
+        const struct pos_cell *cell = &grid->cells[r * grid->ncols + c];
+        for(int i = 0; i < cell->nents; i++) {
+
+            if(ret == maxout)
+                return ret;
+
+            float dx = cell->xs[i] - x;
+            float dz = cell->zs[i] - z;
+            if(dx * dx + dz * dz > range_sq)
+                continue;
+            out[ret++] = cell->ents[i];
+        }
+    }}
+    return ret;
+}
+
+static struct entity *ent_for_uid(const khash_t(entity) *ents, uint32_t uid)
+{
+    khiter_t k = kh_get(entity, ents, uid);
+    assert(k != kh_end(ents));
+    return kh_val(ents, k);
+}
+
+static bool grid_append_circle(const struct pos_grid *grid, float x, float z, float range, 
+                               vec_nb_t *out)
+{
+    const float range_sq = range * range;
+    int rmin = grid_row(grid, z - range), rmax = grid_row(grid, z + range);
+    int cmin = grid_col(grid, x - range), cmax = grid_col(grid, x + range);
+
+    for(int r = rmin; r <= rmax; r++) {
+    for(int c = cmin; c <= cmax; c++) {
+
+        const struct pos_cell *cell = &grid->cells[r * grid->ncols + c];
+        for(int i = 0; i < cell->nents; i++) {
+
+            float dx = cell->xs[i] - x;
+            float dz = cell->zs[i] - z;
+            if(dx * dx + dz * dz > range_sq)
+                continue;
+
+            struct pos_neighbour nb = (struct pos_neighbour){
+                cell->ents[i], 
+                (vec2_t){cell->xs[i], cell->zs[i]}
+            };
+            if(!vec_nb_push(out, nb))
+                return false;
+        }
+    }}
+    return true;
+}
+
+static bool ntable_add(struct pos_ntable *tab, uint32_t uid, size_t begin)
+{
+    int status;
+    khiter_t k = kh_put(nrange, tab->ranges, uid, &status);
+    if(status == -1)
+        return false;
+
+    kh_val(tab->ranges, k) = (struct pos_nrange){
+        begin, 
+        vec_size(&tab->neighbours) - begin
+    };
+    return true;
+}
+
+/* Walk the grid cell by cell, so that the entities in neighbouring cells
+ * are likely to still be cached when the next entity is visited. */
+static bool ntable_build_grid(struct pos_ntable *tab, float radius, 
+                              bool (*predicate)(const struct entity *ent, void *arg), void *arg)
+{
+    const struct pos_grid *grid = &s_posgrid;
+
+    for(int i = 0; i < grid->nrows * grid->ncols; i++) {
+
+        const struct pos_cell *cell = &grid->cells[i];
+        for(int j = 0; j < cell->nents; j++) {
+
+            const struct entity *curr = cell->ents[j];
+            if(curr->flags & ENTITY_FLAG_STATIC)
+                continue;
+            if(!predicate(curr, arg))
+                continue;
+
+            size_t begin = vec_size(&tab->neighbours);
+            if(!grid_append_circle(grid, cell->xs[j], cell->zs[j], radius, &tab->neighbours))
+                return false;
+            if(!ntable_add(tab, curr->uid, begin))
+                return false;
+        }
+    }
+    return true;
+}
+
+static bool ntable_build_quadtree(struct pos_ntable *tab, float radius, 
+                                  bool (*predicate)(const struct entity *ent, void *arg), void *arg)
+{
+    const khash_t(entity) *ents = G_GetAllEntsSet();
+    size_t cap = 512;
+    uint32_t *ent_ids = malloc(cap * sizeof(uint32_t));
+    if(!ent_ids)
+        return false;
+
+    uint32_t key;
+    struct entity *curr;
+    (void)key;
+
+    kh_foreach(G_GetDynamicEntsSet(), key, curr, {
+
+        if(!predicate(curr, arg))
+            continue;
+
+        vec2_t xz_pos = G_Pos_GetXZ(curr->uid);
+        int nents;
+
+        /* Grow the buffer until the results are no longer truncated */
+        while((nents = qt_ent_inrange_circle(&s_postree, 
+            xz_pos.x, xz_pos.z, radius, ent_ids, cap)) == cap) {
+
+            uint32_t *grown = realloc(ent_ids, cap * 2 * sizeof(uint32_t));
+            if(!grown)
+                goto fail;
+            ent_ids = grown;
+            cap *= 2;
+        }
+
+        size_t begin = vec_size(&tab->neighbours);
+        for(int i = 0; i < nents; i++) {
+
+            struct pos_neighbour nb = (struct pos_neighbour){
+                ent_for_uid(ents, ent_ids[i]),
+                G_Pos_GetXZ(ent_ids[i])
+            };
+            if(!vec_nb_push(&tab->neighbours, nb))
+                goto fail;
+        }
+        if(!ntable_add(tab, curr->uid, begin))
+            goto fail;
+    });
+
+    free(ent_ids);
+    return true;
+
+fail:
+    free(ent_ids);
+    return false;
+}
+
+static bool pos_index_insert(const struct entity *ent, vec3_t pos, int *out_slot)
+{
+    switch(s_index_type) {
+    case POS_INDEX_QUADTREE:
+        *out_slot = -1;
+        return qt_ent_insert(&s_postree, pos.x, pos.z, ent->uid);
+    case POS_INDEX_GRID:
+        return grid_insert(&s_posgrid, (struct entity*)ent, pos, out_slot);
+    default: assert(0);
+    }
+    return false;
+}
+
+static void pos_index_delete(uint32_t uid, const struct pos_rec *rec)
+{
+    switch(s_index_type) {
+    case POS_INDEX_QUADTREE: {
+        bool ret = qt_ent_delete(&s_postree, rec->pos.x, rec->pos.z, uid);
+        assert(ret);
+        (void)ret;
+        break;
+    }
+    case POS_INDEX_GRID:
+        grid_remove(&s_posgrid, rec->pos, rec->slot);
+        break;
+    default: assert(0);
+    }
+}
+
+/* When the entity stays in the same grid cell, its' coordinates are 
+ * updated in-place. Otherwise, it is removed and re-inserted. */
+static bool pos_index_move(const struct entity *ent, struct pos_rec *rec, vec3_t new_pos)
+{
+    if(s_index_type == POS_INDEX_GRID) {
+
+        int old_idx = grid_cell_idx(&s_posgrid, rec->pos.x, rec->pos.z);
+        int new_idx = grid_cell_idx(&s_posgrid, new_pos.x, new_pos.z);
+
+        if(old_idx == new_idx) {
+            struct pos_cell *cell = &s_posgrid.cells[old_idx];
+            assert(cell->ents[rec->slot] == ent);
+            cell->xs[rec->slot] = new_pos.x;
+            cell->zs[rec->slot] = new_pos.z;
+            return true;
+        }
+    }
+
+    pos_index_delete(ent->uid, rec);
+    return pos_index_insert(ent, new_pos, &rec->slot);
+}
+
+static size_t pos_index_size(void)
+{
+    switch(s_index_type) {
+    case POS_INDEX_QUADTREE: return s_postree.nrecs;
+    case POS_INDEX_GRID:     return s_posgrid.nrecs;
+    default: assert(0);
+    }
+    return 0;
+}
+
+static int pos_index_inrange_circle(vec2_t xz_point, float range, struct entity **out, size_t maxout)
+{
+    if(s_index_type == POS_INDEX_GRID)
+        return grid_inrange_circle(&s_posgrid, xz_point.x, xz_point.z, range, out, maxout);
+
+    uint32_t ent_ids[maxout];
+    const khash_t(entity) *ents = G_GetAllEntsSet();
+    for(int i = 0; i < maxout; i++)
+        ent_ids[i] = (uint32_t)-1;
+
+    int ret = qt_ent_inrange_circle(&s_postree, 
+        xz_point.x, xz_point.z, range, ent_ids, maxout);
+
+    for(int i = 0; i < ret; i++) {
+        assert(ent_ids[i] != (uint32_t)-1);
+        out[i] = ent_for_uid(ents, ent_ids[i]);
+    }
+    return ret;
+}
+
 /*****************************************************************************/
 /* EXTERN FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -85,54 +516,68 @@ bool G_Pos_Set(const struct entity *ent, vec3_t pos)
 {
     ASSERT_IN_MAIN_THREAD();
 
+    /* The spatial and cull indices hold on to the entity pointer. Entities not
+     * owned by the game state (e.g. ones kept alive by a script across a call
+     * to G_ClearState) would never be removed from them. */
+    if(!G_EntityForUID(ent->uid))
+        return false;
+
     khiter_t k = kh_get(pos, s_postable, ent->uid);
     bool overwrite = (k != kh_end(s_postable));
+    vec3_t old_pos = {0};
 
     if(overwrite) {
-        vec3_t old_pos = kh_val(s_postable, k);
-        bool ret = qt_ent_delete(&s_postree, old_pos.x, old_pos.z, ent->uid);
-        assert(ret);
-
-        G_Fog_RemoveVision((vec2_t){old_pos.x, old_pos.z}, ent->faction_id, ent->vision_range);
-    }
-
-    if(!qt_ent_insert(&s_postree, pos.x, pos.z, ent->uid))
-        return false;
+        old_pos = kh_val(s_postable, k).pos;
+        if(!pos_index_move(ent, &kh_val(s_postable, k), pos)) {
+            G_Fog_RemoveVision((vec2_t){old_pos.x, old_pos.z}, ent->faction_id, ent->vision_range);
+            return false;
+        }
+    }else{
+        int slot;
+        if(!pos_index_insert(ent, pos, &slot))
+            return false;
 
-    if(!overwrite) {
         int ret;
-        kh_put(pos, s_postable, ent->uid, &ret); 
+        k = kh_put(pos, s_postable, ent->uid, &ret); 
         if(ret == -1) {
-            qt_ent_delete(&s_postree, pos.x, pos.z, ent->uid);
+            pos_index_delete(ent->uid, &(struct pos_rec){pos, slot});
             return false;
         }
-        k = kh_get(pos, s_postable, ent->uid);
+        kh_val(s_postable, k).slot = slot;
     }
 
-    kh_val(s_postable, k) = pos;
-    assert(kh_size(s_postable) == s_postree.nrecs);
+    kh_val(s_postable, k).pos = pos;
+    assert(kh_size(s_postable) == pos_index_size());
 
     G_Move_UpdatePos(ent, (vec2_t){pos.x, pos.z});
-    G_Fog_AddVision((vec2_t){pos.x, pos.z}, ent->faction_id, ent->vision_range);
+
+    if(overwrite) {
+        G_Fog_MoveVision((vec2_t){old_pos.x, old_pos.z}, (vec2_t){pos.x, pos.z}, 
+            ent->faction_id, ent->vision_range);
+    }else{
+        G_Fog_AddVision((vec2_t){pos.x, pos.z}, ent->faction_id, ent->vision_range);
+    }
+
+    G_Cull_Update(ent);
     return true; 
 }
 
 vec3_t G_Pos_Get(uint32_t uid)
 {
-    ASSERT_IN_MAIN_THREAD();
+    ASSERT_IN_MAIN_OR_WORKER_THREAD();
 
     khiter_t k = kh_get(pos, s_postable, uid);
     assert(k != kh_end(s_postable));
-    return kh_val(s_postable, k);
+    return kh_val(s_postable, k).pos;
 }
 
 vec2_t G_Pos_GetXZ(uint32_t uid)
 {
-    ASSERT_IN_MAIN_THREAD();
+    ASSERT_IN_MAIN_OR_WORKER_THREAD();
 
     khiter_t k = kh_get(pos, s_postable, uid);
     assert(k != kh_end(s_postable));
-    vec3_t pos = kh_val(s_postable, k);
+    vec3_t pos = kh_val(s_postable, k).pos;
     return (vec2_t){pos.x, pos.z};
 }
 
@@ -143,15 +588,16 @@ void G_Pos_Delete(uint32_t uid)
     khiter_t k = kh_get(pos, s_postable, uid);
     assert(k != kh_end(s_postable));
 
-    vec3_t pos = kh_val(s_postable, k);
+    struct pos_rec rec = kh_val(s_postable, k);
     kh_del(pos, s_postable, k);
 
-    bool ret = qt_ent_delete(&s_postree, pos.x, pos.z, uid);
-    assert(ret);
-    assert(kh_size(s_postable) == s_postree.nrecs);
+    pos_index_delete(uid, &rec);
+    assert(kh_size(s_postable) == pos_index_size());
+
+    G_Cull_Remove(uid);
 }
 
-bool G_Pos_Init(const struct map *map)
+bool G_Pos_Init(const struct map *map, enum pos_index type)
 {
     ASSERT_IN_MAIN_THREAD();
 
@@ -170,21 +616,48 @@ bool G_Pos_Init(const struct map *map)
     float zmin = center.z - (res.tile_h * res.chunk_h * Z_COORDS_PER_TILE) / 2.0f;
     float zmax = center.z + (res.tile_h * res.chunk_h * Z_COORDS_PER_TILE) / 2.0f;
 
-    qt_ent_init(&s_postree, xmin, xmax, zmin, zmax);
-    if(!qt_ent_reserve(&s_postree, POSBUF_INIT_SIZE)) {
-        kh_destroy(pos, s_postable);
-        return false;
+    s_index_type = type;
+    switch(type) {
+    case POS_INDEX_QUADTREE:
+        qt_ent_init(&s_postree, xmin, xmax, zmin, zmax);
+        if(!qt_ent_reserve(&s_postree, POSBUF_INIT_SIZE))
+            goto fail_index;
+        break;
+    case POS_INDEX_GRID:
+        if(!grid_init(&s_posgrid, xmin, xmax, zmin, zmax, CELL_TILES * X_COORDS_PER_TILE))
+            goto fail_index;
+        break;
+    default: assert(0);
     }
 
+    if(!G_Cull_Init(map))
+        goto fail_cull;
+
     return true;
+
+fail_cull:
+    if(type == POS_INDEX_QUADTREE) {
+        qt_ent_destroy(&s_postree);
+    }else{
+        grid_destroy(&s_posgrid);
+    }
+fail_index:
+    kh_destroy(pos, s_postable);
+    return false;
 }
 
 void G_Pos_Shutdown(void)
 {
     ASSERT_IN_MAIN_THREAD();
 
+    G_Cull_Shutdown();
     kh_destroy(pos, s_postable);
-    qt_ent_destroy(&s_postree);
+
+    switch(s_index_type) {
+    case POS_INDEX_QUADTREE: qt_ent_destroy(&s_postree); break;
+    case POS_INDEX_GRID:     grid_destroy(&s_posgrid);   break;
+    default: assert(0);
+    }
 }
 
 int G_Pos_EntsInRect(vec2_t xz_min, vec2_t xz_max, struct entity **out, size_t maxout)
@@ -202,19 +675,27 @@ int G_Pos_EntsInRectWithPred(vec2_t xz_min, vec2_t xz_max, struct entity **out,
     PERF_ENTER();
     ASSERT_IN_MAIN_THREAD();
 
-    uint32_t ent_ids[maxout];
-    const khash_t(entity) *ents = G_GetAllEntsSet();
+    struct entity *cands[maxout];
+    int ntotal;
 
-    int ntotal = qt_ent_inrange_rect(&s_postree, 
-        xz_min.x, xz_max.x, xz_min.z, xz_max.z, ent_ids, maxout);
-    int ret = 0;
+    if(s_index_type == POS_INDEX_GRID) {
+        ntotal = grid_inrange_rect(&s_posgrid, 
+            xz_min.x, xz_max.x, xz_min.z, xz_max.z, cands, maxout);
+    }else{
+        uint32_t ent_ids[maxout];
+        const khash_t(entity) *ents = G_GetAllEntsSet();
 
-    for(int i = 0; i < ntotal; i++) {
+        ntotal = qt_ent_inrange_rect(&s_postree, 
+            xz_min.x, xz_max.x, xz_min.z, xz_max.z, ent_ids, maxout);
+        for(int i = 0; i < ntotal; i++) {
+            cands[i] = ent_for_uid(ents, ent_ids[i]);
+        }
+    }
 
-        khiter_t k = kh_get(entity, ents, ent_ids[i]);
-        assert(k != kh_end(s_postable));
-        struct entity *curr = kh_val(ents, k);
+    int ret = 0;
+    for(int i = 0; i < ntotal; i++) {
 
+        struct entity *curr = cands[i];
         if(!predicate(curr, arg))
             continue;
 
@@ -226,22 +707,9 @@ int G_Pos_EntsInRectWithPred(vec2_t xz_min, vec2_t xz_max, struct entity **out,
 int G_Pos_EntsInCircle(vec2_t xz_point, float range, struct entity **out, size_t maxout)
 {
     PERF_ENTER();
-    ASSERT_IN_MAIN_THREAD();
+    ASSERT_IN_MAIN_OR_WORKER_THREAD();
 
-    uint32_t ent_ids[maxout];
-    const khash_t(entity) *ents = G_GetAllEntsSet();
-    for(int i = 0; i < maxout; i++)
-        ent_ids[i] = (uint32_t)-1;
-
-    int ret = qt_ent_inrange_circle(&s_postree, 
-        xz_point.x, xz_point.z, range, ent_ids, maxout);
-
-    for(int i = 0; i < ret; i++) {
-        assert(ent_ids[i] != (uint32_t)-1);
-        khiter_t k = kh_get(entity, ents, ent_ids[i]);
-        assert(k != kh_end(s_postable));
-        out[i] = kh_val(ents, k);
-    }
+    int ret = pos_index_inrange_circle(xz_point, range, out, maxout);
     PERF_RETURN(ret);
 }
 
@@ -252,24 +720,22 @@ struct entity *G_Pos_NearestWithPred(vec2_t xz_point,
     PERF_ENTER();
     ASSERT_IN_MAIN_THREAD();
 
-    uint32_t ent_ids[MAX_SEARCH_ENTS];
-    const khash_t(entity) *ents = G_GetAllEntsSet();
+    struct entity *cands[MAX_SEARCH_ENTS];
 
-    const float qt_len = MAX(s_postree.xmax - s_postree.xmin, s_postree.ymax - s_postree.ymin);
+    const float index_len = (s_index_type == POS_INDEX_GRID)
+        ? MAX(s_posgrid.xmax - s_posgrid.xmin, s_posgrid.zmax - s_posgrid.zmin)
+        : MAX(s_postree.xmax - s_postree.xmin, s_postree.ymax - s_postree.ymin);
     float len = (TILES_PER_CHUNK_WIDTH * X_COORDS_PER_TILE) / 8.0f;
 
-    while(len < qt_len) {
+    while(len < index_len) {
         float min_dist = FLT_MAX;
         struct entity *ret = NULL;
 
-        int num_cands = qt_ent_inrange_circle(&s_postree, xz_point.x, xz_point.z,
-            len, ent_ids, ARR_SIZE(ent_ids));
+        int num_cands = pos_index_inrange_circle(xz_point, len, cands, ARR_SIZE(cands));
 
         for(int i = 0; i < num_cands; i++) {
         
-            khiter_t k = kh_get(entity, ents, ent_ids[i]);
-            assert(k != kh_end(s_postable));
-            struct entity *curr = kh_val(ents, k);
+            struct entity *curr = cands[i];
 
             vec2_t delta, can_pos_xz = G_Pos_GetXZ(curr->uid);
             PFM_Vec2_Sub(&xz_point, &can_pos_xz, &delta);
@@ -295,3 +761,68 @@ struct entity *G_Pos_Nearest(vec2_t xz_point)
     return G_Pos_NearestWithPred(xz_point, any_ent, NULL);
 }
 
+struct pos_ntable *G_Pos_NTableNew(void)
+{
+    struct pos_ntable *ret = malloc(sizeof(struct pos_ntable));
+    if(!ret)
+        return NULL;
+
+    ret->ranges = kh_init(nrange);
+    if(!ret->ranges) {
+        free(ret);
+        return NULL;
+    }
+    vec_nb_init(&ret->neighbours);
+    return ret;
+}
+
+void G_Pos_NTableFree(struct pos_ntable *tab)
+{
+    vec_nb_destroy(&tab->neighbours);
+    kh_destroy(nrange, tab->ranges);
+    free(tab);
+}
+
+bool G_Pos_NTableBuild(struct pos_ntable *tab, float radius, 
+                       bool (*predicate)(const struct entity *ent, void *arg), void *arg)
+{
+    PERF_ENTER();
+    ASSERT_IN_MAIN_THREAD();
+
+    kh_clear(nrange, tab->ranges);
+    vec_nb_reset(&tab->neighbours);
+
+    bool ret;
+    switch(s_index_type) {
+    case POS_INDEX_QUADTREE: 
+        ret = ntable_build_quadtree(tab, radius, predicate, arg); 
+        break;
+    case POS_INDEX_GRID:
+        ret = ntable_build_grid(tab, radius, predicate, arg);
+        break;
+    default: assert(0);
+    }
+
+    if(!ret) {
+        kh_clear(nrange, tab->ranges);
+        vec_nb_reset(&tab->neighbours);
+    }
+    PERF_RETURN(ret);
+}
+
+size_t G_Pos_NTableGet(const struct pos_ntable *tab, uint32_t uid, 
+                       const struct pos_neighbour **out)
+{
+    ASSERT_IN_MAIN_OR_WORKER_THREAD();
+
+    khiter_t k = kh_get(nrange, tab->ranges, uid);
+    if(k == kh_end(tab->ranges)) {
+        *out = NULL;
+        return 0;
+    }
+
+    struct pos_nrange range = kh_val(tab->ranges, k);
+    *out = &vec_AT(&tab->neighbours, range.begin);
+    return range.count;
+}
+
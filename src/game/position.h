@@ -36,11 +36,46 @@
 #ifndef POSITION_H
 #define POSITION_H
 
+#include "../pf_math.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
 struct map;
+struct entity;
+struct pos_ntable;
+
+struct pos_neighbour{
+    struct entity *ent;
+    vec2_t         xz_pos;
+};
 
-bool G_Pos_Init(const struct map *map);
+enum pos_index{
+    /* A point quadtree over the entire map */
+    POS_INDEX_QUADTREE,
+    /* A uniform grid of fixed-size cells, each holding a bucket of entities */
+    POS_INDEX_GRID,
+};
+
+bool G_Pos_Init(const struct map *map, enum pos_index type);
 void G_Pos_Shutdown(void);
 void G_Pos_Delete(uint32_t uid);
 
+/* A neighbour table holds the list of entities within a fixed radius of every 
+ * one of a set of dynamic entities. It is built with a single sweep over the 
+ * spatial index, so that the per-entity queries made during a tick can be 
+ * answered without searching the index again. The lists are not capped in 
+ * size. The table is only valid until the next position update.
+ */
+struct pos_ntable *G_Pos_NTableNew(void);
+void               G_Pos_NTableFree(struct pos_ntable *tab);
+/* Only the dynamic entities for which the predicate returns true get a list */
+bool               G_Pos_NTableBuild(struct pos_ntable *tab, float radius, 
+                                     bool (*predicate)(const struct entity *ent, void *arg), void *arg);
+/* Returns the number of neighbours of the entity, including the entity itself */
+size_t             G_Pos_NTableGet(const struct pos_ntable *tab, uint32_t uid, 
+                                   const struct pos_neighbour **out);
+
 #endif
 
@@ -121,6 +121,7 @@ void   G_SetMinimapSize(int size);
 void   G_SetMinimapResizeMask(int mask);
 bool   G_MouseOverMinimap(void);
 bool   G_MapHeightAtPoint(vec2_t xz, float *out_height);
+bool   G_MapPositionPathable(vec2_t xz);
 bool   G_PointInsideMap(vec2_t xz);
 
 void   G_BakeNavDataForScene(void);
@@ -129,6 +130,9 @@ bool   G_AddEntity(struct entity *ent, vec3_t pos);
 bool   G_RemoveEntity(struct entity *ent);
 void   G_StopEntity(const struct entity *ent);
 void   G_SetStatic(struct entity *ent, bool on);
+/* Must be called after changing the scale or rotation of an entity outside of 
+ * the game simulation, so that its' cached bounds used for culling are refreshed. */
+void   G_UpdateBounds(const struct entity *ent);
 
 /* Wrapper around AL_EntityFree to defer the call until the render thread 
  * (which owns some part of entity resources) finishes its' work. */
@@ -156,7 +160,6 @@ enum simstate G_GetSimState(void);
 void          G_SetLightPos(vec3_t pos);
 
 struct render_workspace *G_GetSimWS(void);
-struct render_workspace *G_GetRenderWS(void);
 const struct map        *G_GetPrevTickMap(void);
 
 bool   G_SaveGlobalState(SDL_RWops *stream);
@@ -187,10 +190,27 @@ const vec_pentity_t  *G_Sel_Get(enum selection_type *out_type);
 /* GAME MOVEMENT                                                             */
 /*###########################################################################*/
 
+struct cp_stats{
+    /* The number of ClearPath velocity computations */
+    unsigned long solved;
+    /* The number of active neighbour sets evaluated, from the full set down to 
+     * the one that had an admissible velocity */
+    unsigned long iterations;
+    unsigned      max_iterations;
+    /* The number of computations which only avoided the nearest neighbours 
+     * due to the work budget */
+    unsigned long degraded;
+    /* The number of computations without an admissible velocity */
+    unsigned long failed;
+    unsigned long ray_pairs;
+};
+
 void G_Move_SetMoveOnLeftClick(void);
 void G_Move_SetAttackOnLeftClick(void);
 void G_Move_SetDest(const struct entity *ent, vec2_t dest_xz);
 void G_Move_UpdateSelectionRadius(const struct entity *ent, float sel_radius);
+/* The counters are accumulated since the map was loaded */
+void G_Move_GetClearPathStats(struct cp_stats *out);
 
 
 /*###########################################################################*/
@@ -0,0 +1,203 @@
+/*
+ *  This file is part of Permafrost Engine. 
+ *  Copyright (C) 2020 Eduard Permyakov 
+ *
+ *  Permafrost Engine is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Permafrost Engine is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ *  Linking this software statically or dynamically with other modules is making 
+ *  a combined work based on this software. Thus, the terms and conditions of 
+ *  the GNU General Public License cover the whole combination. 
+ *  
+ *  As a special exception, the copyright holders of Permafrost Engine give 
+ *  you permission to link Permafrost Engine with independent modules to produce 
+ *  an executable, regardless of the license terms of these independent 
+ *  modules, and to copy and distribute the resulting executable under 
+ *  terms of your choice, provided that you also meet, for each linked 
+ *  independent module, the terms and conditions of the license of that 
+ *  module. An independent module is a module which is not derived from 
+ *  or based on Permafrost Engine. If you modify Permafrost Engine, you may 
+ *  extend this exception to your version of Permafrost Engine, but you are not 
+ *  obliged to do so. If you do not wish to do so, delete this exception 
+ *  statement from your version.
+ *
+ */
+#ifndef BQUEUE_H
+#define BQUEUE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+
+/* A monotone integer priority queue (Dial's algorithm). Items are kept in a
+ * circular array of 'span' buckets indexed by (priority % span) and the queue
+ * only ever scans forward from the last popped priority. As such, at any time
+ * all pushed priorities must lie in the range [min, min + span), where 'min' is
+ * the priority of the last popped item. For a Dijkstra search where each edge
+ * costs at most C, a span of C+1 is sufficient. Pushing a priority lower than
+ * that of the last popped item is permitted - it is treated as being equal to
+ * it. Items sharing a bucket are popped in LIFO order. Push and pop are O(1)
+ * amortized, with the pop having to skip over at most 'span' empty buckets.
+ */
+
+/***********************************************************************************************/
+
+#define BQUEUE_TYPE(name, type)                                                                 \
+                                                                                                \
+    typedef struct bq_##name##_node_s {                                                         \
+        unsigned priority;                                                                      \
+        int next;                                                                               \
+        type data;                                                                              \
+    } bq_##name##_node_t;                                                                       \
+                                                                                                \
+    typedef struct bq_##name##_s {                                                              \
+        bq_##name##_node_t *nodes;                                                              \
+        size_t capacity;                                                                        \
+        int free_head;                                                                          \
+        int *buckets;                                                                           \
+        unsigned span;                                                                          \
+        unsigned min;                                                                           \
+        size_t size;                                                                            \
+    } bq_##name##_t;                                                                            \
+
+/***********************************************************************************************/
+
+#define bq(name)                                                                                \
+    bq_##name##_t
+
+/***********************************************************************************************/
+
+#define bq_size(bqueue)                                                                         \
+    ((bqueue)->size)
+
+/***********************************************************************************************/
+
+#define BQUEUE_PROTOTYPES(scope, name, type)                                                    \
+                                                                                                \
+    scope bool bq_##name##_init    (bq(name) *bqueue, unsigned span);                           \
+    scope void bq_##name##_destroy (bq(name) *bqueue);                                          \
+    scope void bq_##name##_clear   (bq(name) *bqueue);                                          \
+    scope bool bq_##name##_push    (bq(name) *bqueue, unsigned in_prio, type in);               \
+    scope bool bq_##name##_pop     (bq(name) *bqueue, type *out, unsigned *out_prio);
+
+/***********************************************************************************************/
+
+#define BQUEUE_IMPL(scope, name, type)                                                          \
+                                                                                                \
+    scope bool bq_##name##_init(bq(name) *bqueue, unsigned span)                                \
+    {                                                                                           \
+        assert(span > 0);                                                                       \
+        bqueue->buckets = malloc(span * sizeof(int));                                           \
+        if(!bqueue->buckets)                                                                    \
+            return false;                                                                       \
+        for(unsigned i = 0; i < span; i++)                                                      \
+            bqueue->buckets[i] = -1;                                                            \
+                                                                                                \
+        bqueue->nodes = NULL;                                                                   \
+        bqueue->capacity = 0;                                                                   \
+        bqueue->free_head = -1;                                                                 \
+        bqueue->span = span;                                                                    \
+        bqueue->min = 0;                                                                        \
+        bqueue->size = 0;                                                                       \
+        return true;                                                                            \
+    }                                                                                           \
+                                                                                                \
+    scope void bq_##name##_destroy(bq(name) *bqueue)                                            \
+    {                                                                                           \
+        free(bqueue->nodes);                                                                    \
+        free(bqueue->buckets);                                                                  \
+    }                                                                                           \
+                                                                                                \
+    scope void bq_##name##_clear(bq(name) *bqueue)                                              \
+    {                                                                                           \
+        for(unsigned i = 0; i < bqueue->span; i++)                                              \
+            bqueue->buckets[i] = -1;                                                            \
+        /* Thread all the allocated nodes onto the free list */                                 \
+        for(size_t i = 0; i < bqueue->capacity; i++)                                            \
+            bqueue->nodes[i].next = (i + 1 < bqueue->capacity) ? (int)(i + 1) : -1;             \
+        bqueue->free_head = bqueue->capacity ? 0 : -1;                                          \
+        bqueue->min = 0;                                                                        \
+        bqueue->size = 0;                                                                       \
+    }                                                                                           \
+                                                                                                \
+    scope bool bq_##name##_push(bq(name) *bqueue, unsigned in_prio, type in)                    \
+    {                                                                                           \
+        if(bqueue->free_head == -1) {                                                           \
+                                                                                                \
+            size_t old_cap = bqueue->capacity;                                                  \
+            size_t new_cap = old_cap ? old_cap * 2 : 64;                                        \
+            if(new_cap > INT_MAX)                                                               \
+                return false;                                                                   \
+            bq_##name##_node_t *new_nodes = realloc(bqueue->nodes,                              \
+                new_cap * sizeof(bq_##name##_node_t));                                          \
+            if(!new_nodes)                                                                      \
+                return false;                                                                   \
+                                                                                                \
+            for(size_t i = old_cap; i < new_cap; i++)                                           \
+                new_nodes[i].next = (i + 1 < new_cap) ? (int)(i + 1) : -1;                      \
+            bqueue->nodes = new_nodes;                                                          \
+            bqueue->capacity = new_cap;                                                         \
+            bqueue->free_head = old_cap;                                                        \
+        }                                                                                       \
+                                                                                                \
+        if(bqueue->size == 0 || in_prio < bqueue->min) {                                        \
+            /* An empty queue may be re-based anywhere */                                       \
+            if(bqueue->size == 0)                                                               \
+                bqueue->min = in_prio;                                                          \
+            else                                                                                \
+                in_prio = bqueue->min;                                                          \
+        }                                                                                       \
+        assert(in_prio - bqueue->min < bqueue->span);                                           \
+                                                                                                \
+        int idx = bqueue->free_head;                                                            \
+        bq_##name##_node_t *node = &bqueue->nodes[idx];                                         \
+        bqueue->free_head = node->next;                                                         \
+                                                                                                \
+        unsigned bucket = in_prio % bqueue->span;                                               \
+        node->priority = in_prio;                                                               \
+        node->data = in;                                                                        \
+        node->next = bqueue->buckets[bucket];                                                   \
+        bqueue->buckets[bucket] = idx;                                                          \
+        bqueue->size++;                                                                         \
+        return true;                                                                            \
+    }                                                                                           \
+                                                                                                \
+    scope bool bq_##name##_pop(bq(name) *bqueue, type *out, unsigned *out_prio)                 \
+    {                                                                                           \
+        if(bqueue->size == 0)                                                                   \
+            return false;                                                                       \
+                                                                                                \
+        unsigned bucket = bqueue->min % bqueue->span;                                           \
+        while(bqueue->buckets[bucket] == -1) {                                                  \
+            bqueue->min++;                                                                      \
+            bucket = (bucket + 1 == bqueue->span) ? 0 : bucket + 1;                             \
+        }                                                                                       \
+                                                                                                \
+        int idx = bqueue->buckets[bucket];                                                      \
+        bq_##name##_node_t *node = &bqueue->nodes[idx];                                         \
+        bqueue->buckets[bucket] = node->next;                                                   \
+                                                                                                \
+        *out = node->data;                                                                      \
+        if(out_prio)                                                                            \
+            *out_prio = node->priority;                                                         \
+                                                                                                \
+        node->next = bqueue->free_head;                                                         \
+        bqueue->free_head = idx;                                                                \
+        bqueue->size--;                                                                         \
+        return true;                                                                            \
+    }                                                                                           \
+
+#endif
+
@@ -50,6 +50,8 @@
 #include "settings.h"
 #include "session.h"
 #include "perf.h"
+#include "sched.h"
+#include "clock.h"
 
 #include <stdbool.h>
 #include <assert.h>
@@ -76,6 +78,7 @@ unsigned long              g_frame_idx = 0;
 
 SDL_threadID               g_main_thread_id;   /* write-once */
 SDL_threadID               g_render_thread_id; /* write-once */
+bool                       g_headless = false; /* write-once */
 
 /*****************************************************************************/
 /* STATIC VARIABLES                                                          */
@@ -92,6 +95,13 @@ static vec_event_t         s_prev_tick_events;
 
 static SDL_Thread         *s_render_thread;
 static struct render_sync_state s_rstate;
+/* The total number of submissions made to the render thread */
+static uint64_t            s_nsubmitted = 0;
+/* The number of frames the simulation may get ahead of the render thread */
+static int                 s_max_frames_ahead = 1;
+
+/* Target rate of the headless main loop. 0 means 'as fast as possible' */
+static int                 s_headless_fps = 0;
 
 /*****************************************************************************/
 /* STATIC FUNCTIONS                                                          */
@@ -123,11 +133,6 @@ static void process_sdl_events(void)
             }
             break;
 
-        case SDL_USEREVENT:
-            if(event.user.code == 0) {
-                E_Global_Notify(EVENT_60HZ_TICK, NULL, ES_ENGINE); 
-            }
-            break;
         default: 
             break;
         }
@@ -144,7 +149,9 @@ static void on_user_quit(void *user, void *event)
 
 static bool rstate_init(struct render_sync_state *rstate)
 {
-    rstate->start = false;
+    rstate->qhead = 0;
+    rstate->nqueued = 0;
+    rstate->quit = false;
 
     rstate->sq_lock = SDL_CreateMutex();
     if(!rstate->sq_lock)
@@ -154,7 +161,7 @@ static bool rstate_init(struct render_sync_state *rstate)
     if(!rstate->sq_cond)
         goto fail_sq_cond;
 
-    rstate->done = false;
+    rstate->ncompleted = 0;
 
     rstate->done_lock = SDL_CreateMutex();
     if(!rstate->done_lock)
@@ -197,27 +204,51 @@ static int render_thread_quit(void)
     return ret;
 }
 
-static void render_thread_start_work(void)
+static void render_thread_submit(struct render_workspace *ws)
 {
     SDL_LockMutex(s_rstate.sq_lock);
-    s_rstate.start = true;
+    assert(s_rstate.nqueued < MAX_QUEUED_WS);
+    int tail = (s_rstate.qhead + s_rstate.nqueued) % MAX_QUEUED_WS;
+    s_rstate.queued[tail] = ws;
+    s_rstate.nqueued++;
+    s_nsubmitted++;
     SDL_CondSignal(s_rstate.sq_cond);
     SDL_UnlockMutex(s_rstate.sq_lock);
 }
 
-void wait_render_work_done(void)
+/* Block until no more than 'max_pending' of the submissions are still 
+ * queued up or being processed by the render thread. */
+static void wait_render_work(uint64_t max_pending)
 {
     PERF_ENTER();
 
     SDL_LockMutex(s_rstate.done_lock);
-    while(!s_rstate.done)
+    while(s_nsubmitted - s_rstate.ncompleted > max_pending)
         SDL_CondWait(s_rstate.done_cond, s_rstate.done_lock);
-    s_rstate.done = false;
     SDL_UnlockMutex(s_rstate.done_lock);
 
     PERF_RETURN_VOID();
 }
 
+/* Hand the commands recorded during this frame over to the render thread 
+ * and move on to the next workspace. The simulation only blocks when it is 
+ * more than 'pf.video.max_frames_ahead' frames ahead of the render thread, 
+ * which bounds the added input latency. */
+static void submit_frame(void)
+{
+    /* Make sure the workspace we're about to move on to is no longer in use */
+    if(!g_headless) {
+        wait_render_work(s_max_frames_ahead - 1);
+    }
+
+    struct render_workspace *ws = G_GetSimWS();
+    G_SwapBuffers();
+
+    if(!g_headless) {
+        render_thread_submit(ws);
+    }
+}
+
 static void fs_on_key_press(void *user, void *event)
 {
     SDL_KeyboardEvent *key = &((SDL_Event*)event)->key;
@@ -241,6 +272,28 @@ static void frame_step_commit(const struct sval *new_val)
     }
 }
 
+static bool frames_ahead_validate(const struct sval *new_val)
+{
+    if(new_val->type != ST_TYPE_INT)
+        return false;
+    return (new_val->as_int >= 1 && new_val->as_int <= CONFIG_MAX_FRAMES_AHEAD);
+}
+
+static void frames_ahead_commit(const struct sval *new_val)
+{
+    s_max_frames_ahead = new_val->as_int;
+}
+
+static bool perf_sampling_validate(const struct sval *new_val)
+{
+    return (new_val->type == ST_TYPE_BOOL);
+}
+
+static void perf_sampling_commit(const struct sval *new_val)
+{
+    Perf_SetSamplingEnabled(new_val->as_bool);
+}
+
 /* Fills the framebuffer with the loading screen using SDL's software renderer. 
  * Used to set a loading screen immediately, even before the rendering subsystem 
  * is initialized, */
@@ -309,6 +362,32 @@ static void engine_create_settings(void)
         .commit = frame_step_commit,
     });
     assert(status == SS_OKAY);
+
+    /* Only has an effect in profiling builds */
+    status = Settings_Create((struct setting){
+        .name = "pf.debug.perf_sampling",
+        .val = (struct sval) {
+            .type = ST_TYPE_BOOL,
+            .as_bool = false 
+        },
+        .prio = 0,
+        .validate = perf_sampling_validate,
+        .commit = perf_sampling_commit,
+    });
+    assert(status == SS_OKAY);
+
+    status = Settings_Create((struct setting){
+        .name = "pf.video.max_frames_ahead",
+        .val = (struct sval) {
+            .type = ST_TYPE_INT,
+            .as_int = 1
+        },
+        .prio = 0,
+        .validate = frames_ahead_validate,
+        .commit = frames_ahead_commit,
+    });
+    assert(status == SS_OKAY);
+    (void)status;
 }
 
 static bool engine_init(char **argv)
@@ -337,6 +416,12 @@ static bool engine_init(char **argv)
             Settings_GetFile(), status);
     }
 
+    /* When headless, SDL's 'dummy' video driver gives us a window for 
+     * window and input queries without requiring a display or GPU. */
+    if(g_headless) {
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+    }
+
     if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0) {
         fprintf(stderr, "Failed to initialize SDL: %s\n", SDL_GetError());
         goto fail_sdl;
@@ -361,15 +446,24 @@ static bool engine_init(char **argv)
         extra_flags = setting.as_bool ? SDL_WINDOW_ALWAYS_ON_TOP : 0;
     }
 
-    s_window = SDL_CreateWindow(
-        "Permafrost Engine",
-        SDL_WINDOWPOS_UNDEFINED, 
-        SDL_WINDOWPOS_UNDEFINED,
-        res[0], 
-        res[1], 
-        SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | wf | extra_flags);
-
-    early_loading_screen();
+    if(g_headless) {
+        s_window = SDL_CreateWindow(
+            "Permafrost Engine",
+            SDL_WINDOWPOS_UNDEFINED, 
+            SDL_WINDOWPOS_UNDEFINED,
+            res[0], 
+            res[1], 
+            SDL_WINDOW_HIDDEN);
+    }else{
+        s_window = SDL_CreateWindow(
+            "Permafrost Engine",
+            SDL_WINDOWPOS_UNDEFINED, 
+            SDL_WINDOWPOS_UNDEFINED,
+            res[0], 
+            res[1], 
+            SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | wf | extra_flags);
+        early_loading_screen();
+    }
     stbi_set_flip_vertically_on_load(true);
 
     if(!rstate_init(&s_rstate)) {
@@ -383,30 +477,41 @@ static bool engine_init(char **argv)
         .in_height = res[1],
     };
 
-    s_rstate.arg = &rarg;
-    s_render_thread = R_Run(&s_rstate);
+    if(!g_headless) {
 
-    if(!s_render_thread) {
-        fprintf(stderr, "Failed to start the render thread.\n");
-        goto fail_rthread;
-    }
-    g_render_thread_id = SDL_GetThreadID(s_render_thread);
+        s_rstate.arg = &rarg;
+        s_render_thread = R_Run(&s_rstate);
+
+        if(!s_render_thread) {
+            fprintf(stderr, "Failed to start the render thread.\n");
+            goto fail_rthread;
+        }
+        g_render_thread_id = SDL_GetThreadID(s_render_thread);
 
-    render_thread_start_work();
-    wait_render_work_done();
+        render_thread_submit(NULL);
+        wait_render_work(0);
 
-    if(!rarg.out_success)
-        goto fail_render_init;
+        if(!rarg.out_success)
+            goto fail_render_init;
+    }
 
     Perf_RegisterThread(g_main_thread_id, "main");
-    Perf_RegisterThread(g_render_thread_id, "render");
+    if(!g_headless) {
+        Perf_RegisterThread(g_render_thread_id, "render");
+    }
+
+    if(!Sched_Init()) {
+        fprintf(stderr, "Failed to initialize scheduling module.\n");
+        goto fail_sched;
+    }
 
     if(!AL_Init()) {
         fprintf(stderr, "Failed to initialize asset-loading module.\n");
         goto fail_al;
     }
 
-    if(!Cursor_InitAll(argv[1])) {
+    /* The dummy video driver has no cursor support */
+    if(!g_headless && !Cursor_InitAll(argv[1])) {
         fprintf(stderr, "Failed to initialize cursor module\n");
         goto fail_cursor;
     }
@@ -417,6 +522,11 @@ static bool engine_init(char **argv)
         goto fail_event;
     }
 
+    if(!Clock_Init()) {
+        fprintf(stderr, "Failed to initialize simulation clock\n");
+        goto fail_clock;
+    }
+
     if(!G_Init()) {
         fprintf(stderr, "Failed to initialize game subsystem\n");
         goto fail_game;
@@ -457,6 +567,8 @@ fail_script:
 fail_nuklear:
     G_Shutdown();
 fail_game:
+    Clock_Shutdown();
+fail_clock:
     E_Shutdown();
 fail_event:
 fail_render:
@@ -464,8 +576,12 @@ fail_render:
 fail_cursor:
     AL_Shutdown();
 fail_al:
+    Sched_Shutdown();
+fail_sched:
 fail_render_init:
-    render_thread_quit();
+    if(!g_headless) {
+        render_thread_quit();
+    }
 fail_rthread:
     rstate_destroy(&s_rstate);
 fail_rstate:
@@ -487,9 +603,11 @@ static void engine_shutdown(void)
     /* Execute the last batch of commands that may have been queued by the 
      * shutdown routines. 
      */
-    render_thread_start_work();
-    wait_render_work_done();
-    render_thread_quit();
+    if(!g_headless) {
+        render_thread_submit(G_GetSimWS());
+        wait_render_work(0);
+        render_thread_quit();
+    }
 
     /* 'Game' must shut down after 'Scripting'. There are still 
      * references to game entities in the Python interpreter that should get
@@ -498,9 +616,11 @@ static void engine_shutdown(void)
      */
     G_Shutdown(); 
     N_Shutdown();
+    Sched_Shutdown();
 
     Cursor_FreeAll();
     AL_Shutdown();
+    Clock_Shutdown();
     E_Shutdown();
     Perf_Shutdown();
 
@@ -513,6 +633,46 @@ static void engine_shutdown(void)
     Settings_Shutdown();
 }
 
+/* Strips the engine option flags from the argument list, leaving only the 
+ * positional arguments in 'out_argv'. */
+static bool parse_args(int argc, char **argv, char **out_argv, int *out_argc)
+{
+    int nout = 0;
+    for(int i = 0; i < argc; i++) {
+
+        if(i == 0 || 0 != strncmp(argv[i], "--", 2)) {
+            out_argv[nout++] = argv[i];
+            continue;
+        }
+
+        if(0 == strcmp(argv[i], "--headless")) {
+            g_headless = true;
+        }else if(0 == strncmp(argv[i], "--headless-fps=", strlen("--headless-fps="))) {
+            g_headless = true;
+            s_headless_fps = atoi(argv[i] + strlen("--headless-fps="));
+            if(s_headless_fps < 0)
+                return false;
+        }else{
+            return false;
+        }
+    }
+    out_argv[nout] = NULL;
+    *out_argc = nout;
+    return true;
+}
+
+static void headless_throttle(uint32_t tick_start)
+{
+    if(s_headless_fps == 0)
+        return;
+
+    uint32_t period = 1000 / s_headless_fps;
+    uint32_t elapsed = SDL_GetTicks() - tick_start;
+    if(elapsed < period) {
+        SDL_Delay(period - elapsed);
+    }
+}
+
 /*****************************************************************************/
 /* EXTERN FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -541,35 +701,35 @@ void Engine_SetDispMode(enum pf_window_flags wf)
 
 void Engine_WinDrawableSize(int *out_w, int *out_h)
 {
+    if(g_headless) {
+        SDL_GetWindowSize(s_window, out_w, out_h);
+        return;
+    }
     SDL_GL_GetDrawableSize(s_window, out_w, out_h);
 }
 
 void Engine_FlushRenderWorkQueue(void)
 {
     assert(g_frame_idx == 0);
-    G_SwapBuffers();
 
-    render_thread_start_work();
-    wait_render_work_done();
+    if(!g_headless) {
+        wait_render_work(0);
+    }
 
+    struct render_workspace *ws = G_GetSimWS();
     G_SwapBuffers();
+
+    if(!g_headless) {
+        render_thread_submit(ws);
+        wait_render_work(0);
+    }
 }
 
 void Engine_WaitRenderWorkDone(void)
 {
-    PERF_ENTER();
-    if(s_quit) {
-        PERF_RETURN_VOID();
-    }
-
-    /* Wait for the render thread to finish, but don't yet clear/ack the 'done' flag */
-    SDL_LockMutex(s_rstate.done_lock);
-    while(!s_rstate.done) {
-        SDL_CondWait(s_rstate.done_cond, s_rstate.done_lock);
-    }
-    SDL_UnlockMutex(s_rstate.done_lock);
-
-    PERF_RETURN_VOID();
+    if(g_headless)
+        return;
+    wait_render_work(0);
 }
 
 void Engine_ClearPendingEvents(void)
@@ -603,11 +763,15 @@ int main(int argc, char **argv)
     LocalFree(argv_wide);
 #endif
 
-    if(argc != 3) {
-        printf("Usage: %s [base directory path (containing 'assets', 'shaders' and 'scripts' folders)] [script path]\n", argv[0]);
+    char *pos_argv[argc + 1];
+    int pos_argc;
+
+    if(!parse_args(argc, argv, pos_argv, &pos_argc) || pos_argc != 3) {
+        printf("Usage: %s [--headless | --headless-fps=<N>] [base directory path (containing 'assets', 'shaders' and 'scripts' folders)] [script path]\n", argv[0]);
         ret = EXIT_FAILURE;
         goto fail_args;
     }
+    argv = pos_argv;
 
     g_basepath = argv[1];
 
@@ -620,13 +784,18 @@ int main(int argc, char **argv)
 
     /* Run the first frame of the simulation, and prepare the buffers for rendering. */
     G_Update();
-    G_Render();
-    UI_Render();
-    G_SwapBuffers();
+    if(!g_headless) {
+        G_Render();
+        UI_Render();
+    }else{
+        UI_DiscardFrame();
+    }
+    submit_frame();
     Perf_FinishTick();
 
     while(!s_quit) {
 
+        uint32_t tick_start = SDL_GetTicks();
         Perf_BeginTick();
         enum simstate curr_ss = G_GetSimState();
         bool prev_step_frame = s_step_frame;
@@ -636,18 +805,20 @@ int main(int argc, char **argv)
             G_SetSimState(G_RUNNING);
         }
 
-        render_thread_start_work();
-
         process_sdl_events();
+        Clock_Update();
         E_ServiceQueue();
         Session_ServiceRequests();
         G_Update();
-        G_Render();
-        UI_Render();
 
-        wait_render_work_done();
+        if(!g_headless) {
+            G_Render();
+            UI_Render();
+        }else{
+            UI_DiscardFrame();
+        }
 
-        G_SwapBuffers();
+        submit_frame();
         Perf_FinishTick();
 
         if(prev_step_frame) {
@@ -656,6 +827,10 @@ int main(int argc, char **argv)
         }
 
         ++g_frame_idx;
+
+        if(g_headless) {
+            headless_throttle(tick_start);
+        }
     }
 
     ss_e status;
@@ -38,12 +38,16 @@
 
 #include <SDL.h>
 #include <assert.h>
+#include <stdbool.h>
 
 extern const char    *g_basepath;      /* readonly */
 extern unsigned       g_last_frame_ms; /* readonly */
 extern unsigned long  g_frame_idx;     /* readonly */
 extern SDL_threadID   g_main_thread_id;   /* readonly */
 extern SDL_threadID   g_render_thread_id; /* readonly */
+/* Set when the engine is running without a window, GL context or render thread. 
+ * Render commands are discarded and only the simulation is stepped. */
+extern bool           g_headless;         /* readonly */
 
 
 #define ASSERT_IN_RENDER_THREAD() \
@@ -72,7 +76,7 @@ void Engine_WinDrawableSize(int *out_w, int *out_h);
  * execute rendering code serially.
  */
 void Engine_FlushRenderWorkQueue(void);
-/* Wait for the current batch of render command to finish */
+/* Wait for the render thread to finish all the submitted work */
 void Engine_WaitRenderWorkDone(void);
 void Engine_ClearPendingEvents(void);
 
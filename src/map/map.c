@@ -43,6 +43,7 @@
 #include "../camera.h"
 #include "../collision.h"
 #include "../settings.h"
+#include "../config.h"
 
 #include <string.h>
 #include <assert.h>
@@ -81,6 +82,26 @@ static void m_aabb_for_chunk(const struct map *map, struct chunkpos p, struct aa
     assert(out->z_max >= out->z_min);
 }
 
+/* Chunks further away from the camera are drawn with a coarser level of detail. 
+ * The distance is measured to the closest point of the chunk's bounding box. */
+static int m_lod_for_chunk(const struct aabb *chunk_aabb, vec3_t cam_pos, enum render_pass pass)
+{
+    float dx = MAX(MAX(chunk_aabb->x_min - cam_pos.x, 0.0f), cam_pos.x - chunk_aabb->x_max);
+    float dy = MAX(MAX(chunk_aabb->y_min - cam_pos.y, 0.0f), cam_pos.y - chunk_aabb->y_max);
+    float dz = MAX(MAX(chunk_aabb->z_min - cam_pos.z, 0.0f), cam_pos.z - chunk_aabb->z_max);
+    float dist_sq = dx*dx + dy*dy + dz*dz;
+
+    int ret = 0;
+    if(dist_sq > CONFIG_TERRAIN_LOD2_DIST * CONFIG_TERRAIN_LOD2_DIST)
+        ret = 2;
+    else if(dist_sq > CONFIG_TERRAIN_LOD1_DIST * CONFIG_TERRAIN_LOD1_DIST)
+        ret = 1;
+
+    if(pass == RENDER_PASS_DEPTH)
+        ret += CONFIG_TERRAIN_SHADOW_LOD_BIAS;
+    return MIN(ret, TERRAIN_NUM_LODS - 1);
+}
+
 /*****************************************************************************/
 /* EXTERN FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -153,6 +174,7 @@ void M_RenderVisibleMap(const struct map *map, const struct camera *cam,
     struct frustum frustum;
     Camera_MakeFrustum(cam, &frustum);
     vec2_t pos = (vec2_t){map->pos.x, map->pos.z};
+    vec3_t cam_pos = Camera_GetPos(cam);
 
     R_PushCmd((struct rcmd){ 
         .func = R_GL_MapBegin, 
@@ -163,6 +185,13 @@ void M_RenderVisibleMap(const struct map *map, const struct camera *cam,
         },
     });
 
+#if CONFIG_USE_BATCH_RENDERING && CONFIG_USE_BATCH_TERRAIN
+    void    *vis_rprivates[map->width * map->height];
+    mat4x4_t vis_models[map->width * map->height];
+    int      vis_lods[map->width * map->height];
+    size_t   nvis = 0;
+#endif
+
     for(int r = 0; r < map->height; r++) {
     for(int c = 0; c < map->width;  c++) {
 
@@ -180,31 +209,58 @@ void M_RenderVisibleMap(const struct map *map, const struct camera *cam,
         mat4x4_t chunk_model;
         const struct pfchunk *chunk = &map->chunks[r * map->width + c];
         M_ModelMatrixForChunk(map, (struct chunkpos) {r, c}, &chunk_model);
-
+        int lod = m_lod_for_chunk(&chunk_aabb, cam_pos, pass);
+
+#if CONFIG_USE_BATCH_RENDERING && CONFIG_USE_BATCH_TERRAIN
+        vis_rprivates[nvis] = chunk->render_private;
+        vis_models[nvis] = chunk_model;
+        vis_lods[nvis] = lod;
+        nvis++;
+#else
         switch(pass) {
         case RENDER_PASS_DEPTH: 
             R_PushCmd((struct rcmd){
-                .func = R_GL_RenderDepthMap,
-                .nargs = 2,
+                .func = R_GL_RenderDepthMapLOD,
+                .nargs = 3,
                 .args = {
                     chunk->render_private,
                     R_PushArg(&chunk_model, sizeof(chunk_model)),
+                    R_PushArg(&lod, sizeof(lod)),
                 },
             });
             break;
         case RENDER_PASS_REGULAR:
             R_PushCmd((struct rcmd){
-                .func = R_GL_Draw,
-                .nargs = 2,
+                .func = R_GL_DrawLOD,
+                .nargs = 3,
                 .args = {
                     chunk->render_private,
                     R_PushArg(&chunk_model, sizeof(chunk_model)),
+                    R_PushArg(&lod, sizeof(lod)),
                 },
             });
             break;
         default: assert(0);
         }
+#endif
     }}
+
+#if CONFIG_USE_BATCH_RENDERING && CONFIG_USE_BATCH_TERRAIN
+    if(nvis > 0) {
+        R_PushCmd((struct rcmd){
+            .func = R_GL_Batch_DrawMap,
+            .nargs = 6,
+            .args = {
+                R_PushArg(vis_rprivates, nvis * sizeof(void*)),
+                R_PushArg(vis_models, nvis * sizeof(mat4x4_t)),
+                R_PushArg(vis_lods, nvis * sizeof(int)),
+                R_PushArg(&nvis, sizeof(nvis)),
+                R_PushArg(&shadows, sizeof(shadows)),
+                R_PushArg(&pass, sizeof(pass)),
+            },
+        });
+    }
+#endif
     R_PushCmd((struct rcmd){ R_GL_MapEnd, 0 });
 }
 
@@ -417,6 +473,11 @@ bool M_NavRequestPath(const struct map *map, vec2_t xz_src, vec2_t xz_dest,
     return N_RequestPath(map->nav_private, xz_src, xz_dest, map->pos, out_dest_id);
 }
 
+path_ticket_t M_NavRequestPathAsync(const struct map *map, vec2_t xz_src, vec2_t xz_dest)
+{
+    return N_RequestPathAsync(map->nav_private, xz_src, xz_dest, map->pos);
+}
+
 void M_NavRenderVisiblePathFlowField(const struct map *map, const struct camera *cam, dest_id_t id)
 {
     struct frustum frustum;
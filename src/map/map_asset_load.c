@@ -54,6 +54,7 @@
 #define MINIMAP_DFLT_SZ (256)
 #define PFMAP_VER       (1.0f)
 #define CHK_TRUE(_pred, _label) do{ if(!(_pred)) goto _label; }while(0)
+#define ARR_SIZE(a)     (sizeof(a)/sizeof(a[0]))
 
 /*****************************************************************************/
 /* STATIC FUNCTIONS                                                          */
@@ -309,6 +310,10 @@ bool M_AL_UpdateTile(struct map *map, const struct tile_desc *desc, const struct
     struct map_resolution res;
     M_GetResolution(map, &res);
 
+    /* The neighbouring tiles span at most 4 chunks */
+    struct chunkpos updated[4];
+    size_t nupdated = 0;
+
     for(int dr = -1; dr <= 1; dr++) {
     for(int dc = -1; dc <= 1; dc++) {
     
@@ -326,9 +331,36 @@ bool M_AL_UpdateTile(struct map *map, const struct tile_desc *desc, const struct
                     R_PushArg(&curr, sizeof(curr)),
                 },
             });
+
+            bool seen = false;
+            for(int i = 0; i < nupdated; i++) {
+                if(updated[i].r == curr.chunk_r && updated[i].c == curr.chunk_c)
+                    seen = true;
+            }
+            if(!seen) {
+                assert(nupdated < ARR_SIZE(updated));
+                updated[nupdated++] = (struct chunkpos){curr.chunk_r, curr.chunk_c};
+            }
         }
     }}
 
+    /* Rebuild the levels of detail of each chunk once, after all the tiles 
+     * have been updated */
+    for(int i = 0; i < nupdated; i++) {
+
+        struct pfchunk *chunk = &map->chunks[updated[i].r * map->width + updated[i].c];
+        R_PushCmd((struct rcmd){
+            .func = R_GL_TileChunkUpdateLODs,
+            .nargs = 4,
+            .args = {
+                chunk->render_private,
+                (void*)G_GetPrevTickMap(),
+                R_PushArg(&updated[i].r, sizeof(int)),
+                R_PushArg(&updated[i].c, sizeof(int)),
+            },
+        });
+    }
+
     return true;
 }
 
@@ -232,6 +232,14 @@ void   M_NavUpdateIslandsField(const struct map *map);
 bool   M_NavRequestPath(const struct map *map, vec2_t xz_src, vec2_t xz_dest, 
                         dest_id_t *out_dest_id);
 
+/* ------------------------------------------------------------------------
+ * Queues a path request and returns a ticket for it immediately. An 
+ * EVENT_PATH_READY event with the ticket as the argument is posted once
+ * the request has been serviced. Returns PATH_TICKET_INVALID on failure.
+ * ------------------------------------------------------------------------
+ */
+path_ticket_t M_NavRequestPathAsync(const struct map *map, vec2_t xz_src, vec2_t xz_dest);
+
 /* ------------------------------------------------------------------------
  * Render the flow field that will steer entities towards a particular 
  * destination over the map surface.
@@ -173,7 +173,7 @@ static void rc_find_intersection(void)
 
             /* If the ray hits the AABB, perform the second level check:
              * Check if it intersects the exact triangle mesh of the tile. */
-            vec3_t tile_mesh[VERTS_PER_TILE];
+            vec3_t tile_mesh[INDICES_PER_TILE];
             mat4x4_t model;
 
             M_ModelMatrixForChunk(s_ctx.map, (struct chunkpos){cts[i].chunk_r, cts[i].chunk_c}, &model);
@@ -317,7 +317,7 @@ bool AStar_PortalGraphPath(struct tile_desc start_tile, const struct portal *fin
 
         if(N_PortalReachableFromTile(port, tile_coord, chunk)) {
 
-            float cost = chunk->portal_travel_costs[i][tile_coord.r][tile_coord.c];
+            float cost = N_PortalTravelCost(chunk, i, tile_coord);
             if(cost != FLT_MAX) {
             
                 kh_put_val(key_float, running_cost, portal_to_key(port), cost);
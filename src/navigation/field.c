@@ -35,10 +35,11 @@
 
 #include "field.h"
 #include "nav_private.h"
+#include "fieldcache.h"
 #include "../entity.h"
 #include "../map/public/tile.h"
 #include "../game/public/game.h"
-#include "../lib/public/pqueue.h"
+#include "../lib/public/bqueue.h"
 
 #include <string.h>
 #include <assert.h>
@@ -50,8 +51,12 @@
 #define MAX_ENTS_PER_CHUNK  (4096)
 #define IDX(r, width, c)    ((r) * (width) + (c))
 
-PQUEUE_TYPE(coord, struct coord)
-PQUEUE_IMPL(static, coord, struct coord)
+/* Tile costs are 8-bit, so no relaxation can push a tile more than 
+ * UINT8_MAX past the one currently being expanded. */
+#define FRONTIER_SPAN       (UINT8_MAX + 1)
+
+BQUEUE_TYPE(coord, struct coord)
+BQUEUE_IMPL(static, coord, struct coord)
 
 struct box_xz{
     float x_min, x_max;
@@ -335,13 +340,18 @@ static void pad_wavefront(struct LOS_field *out_los)
     }}
 }
 
-static void build_integration_field(pq_coord_t *frontier, const struct nav_chunk *chunk, 
+static void build_integration_field(bq_coord_t *frontier, const struct nav_chunk *chunk, 
                                     float inout[FIELD_RES_R][FIELD_RES_C])
 {
-    while(pq_size(frontier) > 0) {
+    while(bq_size(frontier) > 0) {
 
         struct coord curr;
-        pq_coord_pop(frontier, &curr);
+        unsigned prio;
+        bq_coord_pop(frontier, &curr, &prio);
+
+        /* Stale entry - the tile was re-pushed with a lower cost and already expanded */
+        if(prio > inout[curr.r][curr.c])
+            continue;
 
         struct coord neighbours[8];
         uint8_t neighbour_costs[8];
@@ -353,8 +363,7 @@ static void build_integration_field(pq_coord_t *frontier, const struct nav_chunk
             if(total_cost < inout[neighbours[i].r][neighbours[i].c]) {
 
                 inout[neighbours[i].r][neighbours[i].c] = total_cost;
-                if(!pq_coord_contains(frontier, neighbours[i]))
-                    pq_coord_push(frontier, total_cost, neighbours[i]);
+                bq_coord_push(frontier, total_cost, neighbours[i]);
             }
         }
     }
@@ -363,13 +372,18 @@ static void build_integration_field(pq_coord_t *frontier, const struct nav_chunk
 /* same as 'build_integration_field' but only impassable tiles 
  * will be added to the frontier 
  */
-static void build_integration_field_nonpass(pq_coord_t *frontier, const struct nav_chunk *chunk, 
+static void build_integration_field_nonpass(bq_coord_t *frontier, const struct nav_chunk *chunk, 
                                             float inout[FIELD_RES_R][FIELD_RES_C])
 {
-    while(pq_size(frontier) > 0) {
+    while(bq_size(frontier) > 0) {
 
         struct coord curr;
-        pq_coord_pop(frontier, &curr);
+        unsigned prio;
+        bq_coord_pop(frontier, &curr, &prio);
+
+        /* Stale entry - the tile was re-pushed with a lower cost and already expanded */
+        if(prio > inout[curr.r][curr.c])
+            continue;
 
         struct coord neighbours[8];
         uint8_t neighbour_costs[8];
@@ -384,8 +398,7 @@ static void build_integration_field_nonpass(pq_coord_t *frontier, const struct n
             if(total_cost < inout[neighbours[i].r][neighbours[i].c]) {
 
                 inout[neighbours[i].r][neighbours[i].c] = total_cost;
-                if(!pq_coord_contains(frontier, neighbours[i]))
-                    pq_coord_push(frontier, total_cost, neighbours[i]);
+                bq_coord_push(frontier, total_cost, neighbours[i]);
             }
         }
     }
@@ -800,6 +813,61 @@ static size_t passable_frontier(const struct nav_chunk *chunk, struct coord star
     return ret;
 }
 
+/* Fetch the integration field for a portal or tile target from the cache, 
+ * building and caching it on a miss. The field for a portal mask target is 
+ * the element-wise minimum of the fields of the individual portals, as it 
+ * is the result of a multi-source Dijkstra from the union of their tiles. 
+ * Fields for enemy targets depend on the entity positions and are always 
+ * built from scratch. A field that failed to build is never cached.
+ */
+static bool integration_field_cached(struct coord chunk_coord, const struct nav_private *priv,
+                                     struct field_target target, struct integration_field *out)
+{
+    switch(target.type) {
+    case TARGET_PORTAL:
+    case TARGET_TILE: {
+
+        ff_id_t id = N_FlowField_ID(chunk_coord, target);
+        if(N_FC_GetIntegrationField(id, out))
+            return true;
+
+        if(!N_IntegrationFieldBuild(chunk_coord, priv, target, out))
+            return false;
+        N_FC_PutIntegrationField(id, out);
+        return true;
+    }
+    case TARGET_PORTALMASK: {
+
+        const struct nav_chunk *chunk = &priv->chunks[IDX(chunk_coord.r, priv->width, chunk_coord.c)];
+
+        for(int r = 0; r < FIELD_RES_R; r++)
+            for(int c = 0; c < FIELD_RES_C; c++)
+                out->field[r][c] = INFINITY;
+
+        for(int i = 0; i < chunk->num_portals; i++) {
+
+            if(!(target.portalmask & (((uint64_t)1) << i)))
+                continue;
+
+            struct field_target port_target = (struct field_target){
+                .type = TARGET_PORTAL,
+                .port = &chunk->portals[i]
+            };
+            struct integration_field port_field;
+            if(!integration_field_cached(chunk_coord, priv, port_target, &port_field))
+                return false;
+
+            for(int r = 0; r < FIELD_RES_R; r++)
+                for(int c = 0; c < FIELD_RES_C; c++)
+                    out->field[r][c] = MIN(out->field[r][c], port_field.field[r][c]);
+        }
+        return true;
+    }
+    default:
+        return N_IntegrationFieldBuild(chunk_coord, priv, target, out);
+    }
+}
+
 /*****************************************************************************/
 /* EXTERN FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -847,17 +915,17 @@ void N_FlowFieldInit(struct coord chunk_coord, const void *nav_private, struct f
     out->chunk = chunk_coord;
 }
 
-void N_FlowFieldUpdate(struct coord chunk_coord, const struct nav_private *priv,
-                       struct field_target target, struct flow_field *inout_flow)
+bool N_IntegrationFieldBuild(struct coord chunk_coord, const struct nav_private *priv,
+                             struct field_target target, struct integration_field *out)
 {
     const struct nav_chunk *chunk = &priv->chunks[IDX(chunk_coord.r, priv->width, chunk_coord.c)];
-    pq_coord_t frontier;
-    pq_coord_init(&frontier);
-
-    float integration_field[FIELD_RES_R][FIELD_RES_C];
     for(int r = 0; r < FIELD_RES_R; r++)
         for(int c = 0; c < FIELD_RES_C; c++)
-            integration_field[r][c] = INFINITY;
+            out->field[r][c] = INFINITY;
+
+    bq_coord_t frontier;
+    if(!bq_coord_init(&frontier, FRONTIER_SPAN))
+        return false;
 
     struct coord init_frontier[FIELD_RES_R * FIELD_RES_C];
     size_t ninit = initial_frontier(target, chunk, priv, false, init_frontier, ARR_SIZE(init_frontier));
@@ -865,27 +933,46 @@ void N_FlowFieldUpdate(struct coord chunk_coord, const struct nav_private *priv,
     for(int i = 0; i < ninit; i++) {
 
         struct coord curr = init_frontier[i];
-        pq_coord_push(&frontier, 0.0f, curr); 
-        integration_field[curr.r][curr.c] = 0.0f;
+        bq_coord_push(&frontier, 0, curr); 
+        out->field[curr.r][curr.c] = 0.0f;
     }
 
+    build_integration_field(&frontier, chunk, out->field);
+    bq_coord_destroy(&frontier);
+    return true;
+}
+
+void N_FlowFieldFromIntegration(struct coord chunk_coord, const struct nav_private *priv,
+                                struct field_target target, struct integration_field *intf,
+                                struct flow_field *inout_flow)
+{
+    const struct nav_chunk *chunk = &priv->chunks[IDX(chunk_coord.r, priv->width, chunk_coord.c)];
+
     inout_flow->target = target;
-    build_integration_field(&frontier, chunk, integration_field);
-    build_flow_field(integration_field, inout_flow);
-    fixup_field(target, integration_field, inout_flow, chunk);
+    build_flow_field(intf->field, inout_flow);
+    fixup_field(target, intf->field, inout_flow, chunk);
+}
 
-    pq_coord_destroy(&frontier);
+bool N_FlowFieldUpdate(struct coord chunk_coord, const struct nav_private *priv,
+                       struct field_target target, struct flow_field *inout_flow)
+{
+    struct integration_field intf;
+    if(!integration_field_cached(chunk_coord, priv, target, &intf))
+        return false;
+    N_FlowFieldFromIntegration(chunk_coord, priv, target, &intf, inout_flow);
+    return true;
 }
 
-void N_LOSFieldCreate(dest_id_t id, struct coord chunk_coord, struct tile_desc target,
+bool N_LOSFieldCreate(dest_id_t id, struct coord chunk_coord, struct tile_desc target,
                       const struct nav_private *priv, vec3_t map_pos, 
                       struct LOS_field *out_los, const struct LOS_field *prev_los)
 {
     out_los->chunk = chunk_coord;
     memset(out_los->field, 0x00, sizeof(out_los->field));
 
-    pq_coord_t frontier;
-    pq_coord_init(&frontier);
+    bq_coord_t frontier;
+    if(!bq_coord_init(&frontier, FRONTIER_SPAN))
+        return false;
     const struct nav_chunk *chunk = &priv->chunks[chunk_coord.r * priv->width + chunk_coord.c];
 
     float integration_field[FIELD_RES_R][FIELD_RES_C];
@@ -896,7 +983,7 @@ void N_LOSFieldCreate(dest_id_t id, struct coord chunk_coord, struct tile_desc t
     /* Case 1: LOS for the destination chunk */
     if(chunk_coord.r == target.chunk_r && chunk_coord.c == target.chunk_c) {
 
-        pq_coord_push(&frontier, 0.0f, (struct coord){target.tile_r, target.tile_c});
+        bq_coord_push(&frontier, 0, (struct coord){target.tile_r, target.tile_c});
         integration_field[target.tile_r][target.tile_c] = 0.0f;
         assert(NULL == prev_los);
 
@@ -920,7 +1007,7 @@ void N_LOSFieldCreate(dest_id_t id, struct coord chunk_coord, struct tile_desc t
                 }
                 if(out_los->field[0][c].visible) {
 
-                    pq_coord_push(&frontier, 0.0f, (struct coord){0, c});
+                    bq_coord_push(&frontier, 0, (struct coord){0, c});
                     integration_field[0][c] = 0.0f; 
                 }
             }
@@ -936,7 +1023,7 @@ void N_LOSFieldCreate(dest_id_t id, struct coord chunk_coord, struct tile_desc t
                 }
                 if(out_los->field[FIELD_RES_R-1][c].visible) {
 
-                    pq_coord_push(&frontier, 0.0f, (struct coord){FIELD_RES_R-1, c});
+                    bq_coord_push(&frontier, 0, (struct coord){FIELD_RES_R-1, c});
                     integration_field[FIELD_RES_R-1][c] = 0.0f;
                 }
             }
@@ -952,7 +1039,7 @@ void N_LOSFieldCreate(dest_id_t id, struct coord chunk_coord, struct tile_desc t
                 }
                 if(out_los->field[r][0].visible) {
 
-                    pq_coord_push(&frontier, 0.0f, (struct coord){r, 0});
+                    bq_coord_push(&frontier, 0, (struct coord){r, 0});
                     integration_field[r][0] = 0.0f;
                 }
             }
@@ -968,7 +1055,7 @@ void N_LOSFieldCreate(dest_id_t id, struct coord chunk_coord, struct tile_desc t
                 }
                 if(out_los->field[r][FIELD_RES_C-1].visible) {
 
-                    pq_coord_push(&frontier, 0.0f, (struct coord){r, FIELD_RES_C-1});
+                    bq_coord_push(&frontier, 0, (struct coord){r, FIELD_RES_C-1});
                     integration_field[r][FIELD_RES_C-1] = 0.0f;
                 }
             }
@@ -977,10 +1064,14 @@ void N_LOSFieldCreate(dest_id_t id, struct coord chunk_coord, struct tile_desc t
         }
     }
 
-    while(pq_size(&frontier) > 0) {
+    while(bq_size(&frontier) > 0) {
 
         struct coord curr;
-        pq_coord_pop(&frontier, &curr);
+        unsigned prio;
+        bq_coord_pop(&frontier, &curr, &prio);
+
+        if(prio > integration_field[curr.r][curr.c])
+            continue;
 
         struct coord neighbours[8];
         uint8_t neighbour_costs[8];
@@ -1009,13 +1100,12 @@ void N_LOSFieldCreate(dest_id_t id, struct coord chunk_coord, struct tile_desc t
                 if(new_cost < integration_field[neighbours[i].r][neighbours[i].c]) {
 
                     integration_field[nr][nc] = new_cost;
-                    if(!pq_coord_contains(&frontier, neighbours[i]))
-                        pq_coord_push(&frontier, new_cost, neighbours[i]);
+                    bq_coord_push(&frontier, new_cost, neighbours[i]);
                 }
             }
         }
     }
-    pq_coord_destroy(&frontier);
+    bq_coord_destroy(&frontier);
 
     /* Add a single tile-wide padding of invisible tiles around the wavefront. This is 
      * because we want to be conservative and not mark any tiles visible from which we
@@ -1023,16 +1113,18 @@ void N_LOSFieldCreate(dest_id_t id, struct coord chunk_coord, struct tile_desc t
      * the ray going over impassable terrain. This is a nice property for the movement
      * code. */
     pad_wavefront(out_los);
+    return true;
 }
 
-void N_FlowFieldUpdateToNearestPathable(const struct nav_chunk *chunk, struct coord start, 
+bool N_FlowFieldUpdateToNearestPathable(const struct nav_chunk *chunk, struct coord start, 
                                         struct flow_field *inout_flow)
 {
     struct coord init_frontier[FIELD_RES_R * FIELD_RES_C];
     size_t ninit = passable_frontier(chunk, start, init_frontier, ARR_SIZE(init_frontier));
 
-    pq_coord_t frontier;
-    pq_coord_init(&frontier);
+    bq_coord_t frontier;
+    if(!bq_coord_init(&frontier, FRONTIER_SPAN))
+        return false;
 
     float integration_field[FIELD_RES_R][FIELD_RES_C];
     for(int r = 0; r < FIELD_RES_R; r++)
@@ -1042,7 +1134,7 @@ void N_FlowFieldUpdateToNearestPathable(const struct nav_chunk *chunk, struct co
     for(int i = 0; i < ninit; i++) {
 
         struct coord curr = init_frontier[i];
-        pq_coord_push(&frontier, 0.0f, curr); 
+        bq_coord_push(&frontier, 0, curr); 
         integration_field[curr.r][curr.c] = 0.0f;
     }
 
@@ -1058,17 +1150,19 @@ void N_FlowFieldUpdateToNearestPathable(const struct nav_chunk *chunk, struct co
         inout_flow->field[r][c].dir_idx = flow_dir(integration_field, (struct coord){r, c});
     }}
 
-    pq_coord_destroy(&frontier);
+    bq_coord_destroy(&frontier);
+    return true;
 }
 
-void N_FlowFieldUpdateIslandToNearest(uint16_t local_iid, const struct nav_private *priv,
+bool N_FlowFieldUpdateIslandToNearest(uint16_t local_iid, const struct nav_private *priv,
                                       struct flow_field *inout_flow)
 {
     struct coord chunk_coord = inout_flow->chunk;
     const struct nav_chunk *chunk = &priv->chunks[IDX(chunk_coord.r, priv->width, chunk_coord.c)];
 
-    pq_coord_t frontier;
-    pq_coord_init(&frontier);
+    bq_coord_t frontier;
+    if(!bq_coord_init(&frontier, FRONTIER_SPAN))
+        return false;
 
     struct coord init_frontier[FIELD_RES_R * FIELD_RES_C];
     size_t ninit = initial_frontier(inout_flow->target, chunk, priv, false, init_frontier, ARR_SIZE(init_frontier));
@@ -1123,7 +1217,7 @@ void N_FlowFieldUpdateIslandToNearest(uint16_t local_iid, const struct nav_priva
     for(int i = 0; i < new_ninit; i++) {
 
         struct coord curr = new_init_frontier[i];
-        pq_coord_push(&frontier, 0.0f, curr); 
+        bq_coord_push(&frontier, 0, curr); 
         integration_field[curr.r][curr.c] = 0.0f;
     }
 
@@ -1131,6 +1225,7 @@ void N_FlowFieldUpdateIslandToNearest(uint16_t local_iid, const struct nav_priva
     build_flow_field(integration_field, inout_flow);
     fixup_field(inout_flow->target, integration_field, inout_flow, chunk);
 
-    pq_coord_destroy(&frontier);
+    bq_coord_destroy(&frontier);
+    return true;
 }
 
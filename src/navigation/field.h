@@ -82,6 +82,10 @@ struct flow_field{
     }field[FIELD_RES_R][FIELD_RES_C];
 };
 
+struct integration_field{
+    float field[FIELD_RES_R][FIELD_RES_C];
+};
+
 enum flow_dir{
     FD_NONE = 0,
     FD_NW,
@@ -98,9 +102,37 @@ extern vec2_t g_flow_dir_lookup[];
 
 ff_id_t N_FlowField_ID(struct coord chunk, struct field_target target);
 void    N_FlowFieldInit(struct coord chunk_coord, const void *nav_private, struct flow_field *out);
-void    N_FlowFieldUpdate(struct coord chunk_coord, const struct nav_private *priv,
+
+/* ------------------------------------------------------------------------
+ * Set the directions of the flow field for the target, using (and adding
+ * to) the cached integration fields. Returns false if the field could not
+ * be built, in which case nothing is cached and the output must not be 
+ * cached by the caller either. The same goes for the other builders that
+ * return a bool.
+ * ------------------------------------------------------------------------
+ */
+bool    N_FlowFieldUpdate(struct coord chunk_coord, const struct nav_private *priv,
                           struct field_target target, struct flow_field *inout_flow);
 
+/* ------------------------------------------------------------------------
+ * Build the integration field (the cost of the cheapest path from every 
+ * tile to the target) for a chunk. This does not touch the field cache, 
+ * so it is safe to call from worker threads. 'N_FlowFieldUpdate' will 
+ * look up cached integration fields instead, and cache the new ones.
+ * ------------------------------------------------------------------------
+ */
+bool    N_IntegrationFieldBuild(struct coord chunk_coord, const struct nav_private *priv,
+                                struct field_target target, struct integration_field *out);
+
+/* ------------------------------------------------------------------------
+ * Set the directions of the flow field from an integration field built for
+ * the same chunk and target. This does not touch the field cache.
+ * ------------------------------------------------------------------------
+ */
+void    N_FlowFieldFromIntegration(struct coord chunk_coord, const struct nav_private *priv,
+                                   struct field_target target, struct integration_field *intf,
+                                   struct flow_field *inout_flow);
+
 /* ------------------------------------------------------------------------
  * Update all tiles with a specific local island ID from the
  * 'local_islands' field for the chunk. The new directions will guide to
@@ -109,7 +141,7 @@ void    N_FlowFieldUpdate(struct coord chunk_coord, const struct nav_private *pr
  * island (local_iid), the field will remain unchanged.
  * ------------------------------------------------------------------------
  */
-void    N_FlowFieldUpdateIslandToNearest(uint16_t local_iid, const struct nav_private *priv,
+bool    N_FlowFieldUpdateIslandToNearest(uint16_t local_iid, const struct nav_private *priv,
                                          struct flow_field *inout_flow);
 
 /* ------------------------------------------------------------------------
@@ -120,7 +152,7 @@ void    N_FlowFieldUpdateIslandToNearest(uint16_t local_iid, const struct nav_pr
  * somehow end up on an impassable one.
  * ------------------------------------------------------------------------
  */
-void    N_FlowFieldUpdateToNearestPathable(const struct nav_chunk *chunk, struct coord start, 
+bool    N_FlowFieldUpdateToNearestPathable(const struct nav_chunk *chunk, struct coord start, 
                                            struct flow_field *inout_flow);
 
 /* ------------------------------------------------------------------------
@@ -133,7 +165,7 @@ void    N_FlowFieldUpdateToNearestPathable(const struct nav_chunk *chunk, struct
  * NULL) and and moving backwards along the path back to the 'source' chunk.
  * ------------------------------------------------------------------------
  */
-void    N_LOSFieldCreate(dest_id_t id, struct coord chunk_coord, struct tile_desc target,
+bool    N_LOSFieldCreate(dest_id_t id, struct coord chunk_coord, struct tile_desc target,
                          const struct nav_private *priv, vec3_t map_pos, 
                          struct LOS_field *out_los, const struct LOS_field *prev_los);
 
@@ -34,6 +34,7 @@
  */
 
 #include "fieldcache.h"
+#include "nav_private.h"
 #include "../lib/public/lru_cache.h"
 #include "../lib/public/khash.h"
 #include "../lib/public/vec.h"
@@ -51,6 +52,10 @@ LRU_CACHE_TYPE(flow, struct flow_field)
 LRU_CACHE_PROTOTYPES(static, flow, struct flow_field)
 LRU_CACHE_IMPL(static, flow, struct flow_field)
 
+LRU_CACHE_TYPE(intf, struct integration_field)
+LRU_CACHE_PROTOTYPES(static, intf, struct integration_field)
+LRU_CACHE_IMPL(static, intf, struct integration_field)
+
 LRU_CACHE_TYPE(ffid, ff_id_t)
 LRU_CACHE_PROTOTYPES(static, ffid, ff_id_t)
 LRU_CACHE_IMPL(static, ffid, ff_id_t)
@@ -71,6 +76,10 @@ KHASH_MAP_INIT_INT64(idvec, vec_id_t)
 
 static lru(los)          s_los_cache;       /* key: (dest_id, chunk coord) */
 static lru(flow)         s_flow_cache;      /* key: (ffid) */
+/* Integration fields are only kept for portal and tile targets. Since they are 
+ * independent of the path's destination, they can be shared by all the flow 
+ * fields with the same (chunk, target) and re-derived into a flow field cheaply. */
+static lru(intf)         s_intf_cache;      /* key: (ffid) */
 /* The ffid cache maps a (dest_id, chunk coordinate) tuple to a flow field ID,
  * which could be used to retreive the relevant field from the flow cache. 
  * The reason for this is that the same flow field chunk can be shared between
@@ -81,6 +90,7 @@ static lru(grid_path)    s_grid_path_cache; /* key: (chunk coord, tile start coo
 /* The following structures are maintained for efficient invalidation of entries:*/
 static khash_t(idvec)   *s_chunk_ffield_map; /* key: (chunk coord) */
 static khash_t(idvec)   *s_chunk_lfield_map; /* key: (chunk coord) */
+static khash_t(idvec)   *s_chunk_ifield_map; /* key: (chunk coord) */
 
 static struct priv_fc_stats{
     unsigned los_query;
@@ -89,6 +99,9 @@ static struct priv_fc_stats{
     unsigned flow_query;
     unsigned flow_hit;
     unsigned flow_invalidated;
+    unsigned intf_query;
+    unsigned intf_hit;
+    unsigned intf_invalidated;
     unsigned ffid_query;
     unsigned ffid_hit;
     unsigned grid_path_query;
@@ -133,6 +146,11 @@ uint64_t grid_path_key(struct coord local_start, struct coord local_dest,
          |  (( ((uint64_t)chunk.c)       & 0xffff) << 48));
 }
 
+static struct coord ffid_chunk(ff_id_t ffid)
+{
+    return (struct coord){(ffid >> 8) & 0xff, ffid & 0xff};
+}
+
 static void on_grid_path_evict(struct grid_path_desc *victim)
 {
     vec_coord_destroy(&victim->path);
@@ -190,6 +208,9 @@ bool N_FC_Init(void)
     if(!lru_flow_init(&s_flow_cache, CONFIG_FLOW_CAHCE_SZ, NULL))
         goto fail_flow;
 
+    if(!lru_intf_init(&s_intf_cache, CONFIG_INTEGRATION_CACHE_SZ, NULL))
+        goto fail_intf;
+
     if(!lru_ffid_init(&s_ffid_cache, CONFIG_MAPPING_CACHE_SZ, NULL))
         goto fail_ffid;
 
@@ -202,8 +223,13 @@ bool N_FC_Init(void)
     if(NULL == (s_chunk_lfield_map = kh_init(idvec)))
         goto fail_chunk_lfield;
 
+    if(NULL == (s_chunk_ifield_map = kh_init(idvec)))
+        goto fail_chunk_ifield;
+
     return true;
 
+fail_chunk_ifield:
+    kh_destroy(idvec, s_chunk_lfield_map);
 fail_chunk_lfield:
     kh_destroy(idvec, s_chunk_ffield_map);
 fail_chunk_ffield:
@@ -211,6 +237,8 @@ fail_chunk_ffield:
 fail_grid_path:
     lru_ffid_destroy(&s_ffid_cache);
 fail_ffid:
+    lru_intf_destroy(&s_intf_cache);
+fail_intf:
     lru_flow_destroy(&s_flow_cache);
 fail_flow:
     lru_los_destroy(&s_los_cache);
@@ -222,6 +250,7 @@ void N_FC_Shutdown(void)
 {
     lru_los_destroy(&s_los_cache);
     lru_flow_destroy(&s_flow_cache);
+    lru_intf_destroy(&s_intf_cache);
     lru_ffid_destroy(&s_ffid_cache);
     lru_grid_path_destroy(&s_grid_path_cache);
 
@@ -230,12 +259,16 @@ void N_FC_Shutdown(void)
 
     destroy_all_entries(s_chunk_lfield_map);
     kh_destroy(idvec, s_chunk_lfield_map);
+
+    destroy_all_entries(s_chunk_ifield_map);
+    kh_destroy(idvec, s_chunk_ifield_map);
 }
 
 void N_FC_ClearAll(void)
 {
     lru_los_clear(&s_los_cache);
     lru_flow_clear(&s_flow_cache);
+    lru_intf_clear(&s_intf_cache);
     lru_ffid_clear(&s_ffid_cache);
     lru_grid_path_clear(&s_grid_path_cache);
 
@@ -244,6 +277,9 @@ void N_FC_ClearAll(void)
 
     destroy_all_entries(s_chunk_lfield_map);
     kh_clear(idvec, s_chunk_lfield_map);
+
+    destroy_all_entries(s_chunk_ifield_map);
+    kh_clear(idvec, s_chunk_ifield_map);
 }
 
 void N_FC_ClearStats(void)
@@ -265,6 +301,12 @@ void N_FC_GetStats(struct fc_stats *out_stats)
         : ((float)s_perfstats.flow_hit) / s_perfstats.flow_query;
     out_stats->flow_invalidated = s_perfstats.flow_invalidated;
 
+    out_stats->intf_used = s_intf_cache.used;
+    out_stats->intf_max = s_intf_cache.capacity;
+    out_stats->intf_hit_rate = !s_perfstats.intf_query ? 0
+        : ((float)s_perfstats.intf_hit) / s_perfstats.intf_query;
+    out_stats->intf_invalidated = s_perfstats.intf_invalidated;
+
     out_stats->ffid_used = s_ffid_cache.used;
     out_stats->ffid_max = s_ffid_cache.capacity;
     out_stats->ffid_hit_rate = !s_perfstats.ffid_hit ? 0
@@ -274,6 +316,8 @@ void N_FC_GetStats(struct fc_stats *out_stats)
     out_stats->grid_path_max = s_grid_path_cache.capacity;
     out_stats->grid_path_hit_rate = !s_perfstats.grid_path_hit ? 0
         : ((float)s_perfstats.grid_path_hit) / s_perfstats.grid_path_query;
+
+    out_stats->portal_travel_cost_bytes = N_PortalTravelCostBytes();
 }
 
 bool N_FC_ContainsLOSField(dest_id_t id, struct coord chunk_coord)
@@ -316,9 +360,27 @@ const struct flow_field *N_FC_FlowFieldAt(ff_id_t ffid)
 void N_FC_PutFlowField(ff_id_t ffid, const struct flow_field *ff)
 {
     lru_flow_put(&s_flow_cache, ffid, ff);
+    field_map_add(s_chunk_ffield_map, key_for_chunk(ffid_chunk(ffid)), ffid);
+}
 
-    struct coord chunk = (struct coord){(ffid >> 8) & 0xff, ffid & 0xff};
-    field_map_add(s_chunk_ffield_map, key_for_chunk(chunk), ffid);
+bool N_FC_ContainsIntegrationField(ff_id_t ffid)
+{
+    return lru_intf_contains(&s_intf_cache, ffid);
+}
+
+bool N_FC_GetIntegrationField(ff_id_t ffid, struct integration_field *out)
+{
+    bool ret = lru_intf_get(&s_intf_cache, ffid, out);
+
+    s_perfstats.intf_query++;
+    s_perfstats.intf_hit += !!ret;
+    return ret;
+}
+
+void N_FC_PutIntegrationField(ff_id_t ffid, const struct integration_field *intf)
+{
+    lru_intf_put(&s_intf_cache, ffid, intf);
+    field_map_add(s_chunk_ifield_map, key_for_chunk(ffid_chunk(ffid)), ffid);
 }
 
 bool N_FC_GetDestFFMapping(dest_id_t id, struct coord chunk_coord, ff_id_t *out_ff)
@@ -388,6 +450,18 @@ void N_FC_InvalidateAllAtChunk(struct coord chunk)
         vec_id_destroy(keys);
         kh_del(idvec, s_chunk_ffield_map, k);
     }
+
+    k = kh_get(idvec, s_chunk_ifield_map, key);
+    if(k != kh_end(s_chunk_ifield_map)) {
+
+        vec_id_t *keys = &kh_val(s_chunk_ifield_map, k);
+        for(int i = 0; i < vec_size(keys); i++) {
+            bool found = lru_intf_remove(&s_intf_cache, vec_AT(keys, i));
+            s_perfstats.intf_invalidated += !!found;
+        }
+        vec_id_destroy(keys);
+        kh_del(idvec, s_chunk_ifield_map, k);
+    }
 }
 
 void N_FC_InvalidateAllThroughChunk(struct coord chunk)
@@ -51,7 +51,7 @@
 bool N_FC_Init(void);
 void N_FC_Shutdown(void);
 
-/* Invalidate all LOS and Flow fields for a particular chunk 
+/* Invalidate all LOS, Flow and Integration fields for a particular chunk 
  */
 void N_FC_InvalidateAllAtChunk(struct coord chunk);
 
@@ -83,6 +83,13 @@ const struct flow_field *N_FC_FlowFieldAt(ff_id_t ffid);
 bool N_FC_ContainsFlowField(ff_id_t ffid);
 void N_FC_PutFlowField(ff_id_t ffid, const struct flow_field *ff);
 
+/* Integration fields are keyed by the ID of the flow field with the same 
+ * chunk and target. Only portal and tile targets are cached. 
+ */
+bool N_FC_ContainsIntegrationField(ff_id_t ffid);
+bool N_FC_GetIntegrationField(ff_id_t ffid, struct integration_field *out);
+void N_FC_PutIntegrationField(ff_id_t ffid, const struct integration_field *intf);
+
 bool N_FC_GetDestFFMapping(dest_id_t id, struct coord chunk_coord, ff_id_t *out_ff);
 void N_FC_PutDestFFMapping(dest_id_t dest_id, struct coord chunk_coord, ff_id_t ffid);
 
@@ -48,6 +48,7 @@
 #include "../event.h"
 #include "../main.h"
 #include "../perf.h"
+#include "../sched.h"
 #include "../lib/public/queue.h"
 
 #include <stdlib.h>
@@ -66,6 +67,8 @@
 #define CLAMP(a, min, max)       (MIN(MAX((a), (min)), (max)))
 
 #define EPSILON                  (1.0f / 1024)
+/* Don't bother waking up the workers for fewer missing flow fields */
+#define PARALLEL_FIELD_GEN_MIN_JOBS (2)
 
 #define FOREACH_PORTAL(_priv, _local, ...)                                                      \
     do{                                                                                         \
@@ -92,6 +95,25 @@ struct cost_coord{
 QUEUE_TYPE(cc, struct cost_coord)
 QUEUE_IMPL(static, cc, struct cost_coord)
 
+/* A flow field which is missing from the cache and can be generated 
+ * independently of all the other fields of a path. */
+struct ff_job{
+    struct coord             chunk;
+    struct field_target      target;
+    ff_id_t                  id;
+    bool                     ok;
+    struct integration_field intf;
+    struct flow_field        ff;
+};
+
+VEC_TYPE(ff_job, struct ff_job)
+VEC_IMPL(static inline, ff_job, struct ff_job)
+
+struct ff_job_arg{
+    const struct nav_private *priv;
+    vec_ff_job_t              jobs;
+};
+
 enum edge_type{
     EDGE_BOT   = (1 << 0),
     EDGE_LEFT  = (1 << 1),
@@ -101,12 +123,28 @@ enum edge_type{
 
 KHASH_SET_INIT_INT(coord)
 
+struct path_req{
+    path_ticket_t  ticket;
+    void          *nav_private;
+    vec2_t         xz_src;
+    vec2_t         xz_dest;
+    vec3_t         map_pos;
+};
+
+QUEUE_TYPE(path_req, struct path_req)
+QUEUE_IMPL(static, path_req, struct path_req)
+
 /*****************************************************************************/
 /* STATIC VARIABLES                                                          */
 /*****************************************************************************/
 
-static khash_t(coord) *s_dirty_chunks;
-static bool            s_local_islands_dirty = false;
+static khash_t(coord)  *s_dirty_chunks;
+static bool             s_local_islands_dirty = false;
+/* The total number of bytes holding portal travel costs, for all chunks */
+static size_t           s_ptc_bytes = 0;
+/* Asynchronous path requests, serviced in FIFO order */
+static queue(path_req)  s_path_reqs;
+static path_ticket_t    s_next_ticket = 1;
 
 /*****************************************************************************/
 /* STATIC FUNCTIONS                                                          */
@@ -913,57 +951,122 @@ done:
     return ret; 
 }
 
-static void n_build_portal_travel_index(struct nav_chunk *chunk)
+/* Compute the cost of travelling to the portal from every tile in the chunk. 
+ * Tiles from which the portal cannot be reached get a cost of FLT_MAX.
+ */
+static void n_portal_travel_flood(const struct nav_chunk *chunk, int port_idx,
+                                  float out_costs[FIELD_RES_R][FIELD_RES_C])
 {
     queue_cc_t frontier;
     queue_cc_init(&frontier, 1024);
 
-    for(int pi = 0; pi < chunk->num_portals; pi++) {
-
-        bool visited[FIELD_RES_R][FIELD_RES_C] = {0};
-        assert(queue_size(frontier) == 0);
+    bool visited[FIELD_RES_R][FIELD_RES_C] = {0};
 
-        for(int r = 0; r < FIELD_RES_R; r++) {
-        for(int c = 0; c < FIELD_RES_C; c++) {
+    for(int r = 0; r < FIELD_RES_R; r++) {
+    for(int c = 0; c < FIELD_RES_C; c++) {
 
-            chunk->portal_travel_costs[pi][r][c] = FLT_MAX;
-        }}
+        out_costs[r][c] = FLT_MAX;
+    }}
 
-        const struct portal *port = &chunk->portals[pi];
-        for(int r = port->endpoints[0].r; r <= port->endpoints[1].r; r++) {
-        for(int c = port->endpoints[0].c; c <= port->endpoints[1].c; c++) {
+    const struct portal *port = &chunk->portals[port_idx];
+    for(int r = port->endpoints[0].r; r <= port->endpoints[1].r; r++) {
+    for(int c = port->endpoints[0].c; c <= port->endpoints[1].c; c++) {
 
-            struct cost_coord cc = (struct cost_coord){0.0f, (struct coord){r,c}};
-            queue_cc_push(&frontier, &cc);
-            visited[r][c] = true;
-        }}
+        struct cost_coord cc = (struct cost_coord){0.0f, (struct coord){r,c}};
+        queue_cc_push(&frontier, &cc);
+        visited[r][c] = true;
+    }}
 
-        while(queue_size(frontier) > 0) {
+    while(queue_size(frontier) > 0) {
 
-            struct cost_coord curr;
-            queue_cc_pop(&frontier, &curr);
+        struct cost_coord curr;
+        queue_cc_pop(&frontier, &curr);
 
-            chunk->portal_travel_costs[pi][curr.coord.r][curr.coord.c] = curr.cost;
+        out_costs[curr.coord.r][curr.coord.c] = curr.cost;
 
-            struct coord neighbours[8];
-            float costs[8];
-            int num_neighbours = N_GridNeighbours(chunk->cost_base, curr.coord, neighbours, costs);
+        struct coord neighbours[8];
+        float costs[8];
+        int num_neighbours = N_GridNeighbours(chunk->cost_base, curr.coord, neighbours, costs);
 
-            for(int i = 0; i < num_neighbours; i++) {
+        for(int i = 0; i < num_neighbours; i++) {
 
-                if(visited[neighbours[i].r][neighbours[i].c])
-                    continue;
+            if(visited[neighbours[i].r][neighbours[i].c])
+                continue;
 
-                struct cost_coord cc = (struct cost_coord){curr.cost + costs[i], neighbours[i]};
-                queue_cc_push(&frontier, &cc);
-                visited[neighbours[i].r][neighbours[i].c] = true;
-            }
+            struct cost_coord cc = (struct cost_coord){curr.cost + costs[i], neighbours[i]};
+            queue_cc_push(&frontier, &cc);
+            visited[neighbours[i].r][neighbours[i].c] = true;
         }
     }
 
     queue_cc_destroy(&frontier);
 }
 
+#if CONFIG_LAZY_PORTAL_TRAVEL_COSTS
+
+static void n_free_portal_travel_index(struct nav_chunk *chunk)
+{
+    for(int i = 0; i < MAX_PORTALS_PER_CHUNK; i++) {
+
+        if(!chunk->portal_travel_costs[i])
+            continue;
+
+        free(chunk->portal_travel_costs[i]);
+        chunk->portal_travel_costs[i] = NULL;
+        s_ptc_bytes -= FIELD_RES_R * FIELD_RES_C * sizeof(uint16_t);
+    }
+}
+
+static void n_build_portal_travel_index(struct nav_chunk *chunk)
+{
+    /* The slices will get built on demand */
+    n_free_portal_travel_index(chunk);
+}
+
+static const uint16_t *n_portal_travel_slice(struct nav_chunk *chunk, int port_idx)
+{
+    if(chunk->portal_travel_costs[port_idx])
+        return chunk->portal_travel_costs[port_idx];
+
+    uint16_t *slice = malloc(FIELD_RES_R * FIELD_RES_C * sizeof(uint16_t));
+    if(!slice)
+        return NULL;
+
+    float costs[FIELD_RES_R][FIELD_RES_C];
+    n_portal_travel_flood(chunk, port_idx, costs);
+
+    for(int r = 0; r < FIELD_RES_R; r++) {
+    for(int c = 0; c < FIELD_RES_C; c++) {
+
+        uint16_t *out = &slice[IDX(r, FIELD_RES_C, c)];
+        if(costs[r][c] == FLT_MAX) {
+            *out = PTC_UNREACHABLE;
+        }else{
+            *out = MIN(lroundf(costs[r][c] * PTC_FIXED_SCALE), PTC_UNREACHABLE - 1);
+        }
+    }}
+
+    chunk->portal_travel_costs[port_idx] = slice;
+    s_ptc_bytes += FIELD_RES_R * FIELD_RES_C * sizeof(uint16_t);
+    return slice;
+}
+
+#else
+
+static void n_free_portal_travel_index(struct nav_chunk *chunk)
+{
+    s_ptc_bytes -= sizeof(chunk->portal_travel_costs);
+}
+
+static void n_build_portal_travel_index(struct nav_chunk *chunk)
+{
+    for(int pi = 0; pi < chunk->num_portals; pi++) {
+        n_portal_travel_flood(chunk, pi, chunk->portal_travel_costs[pi]);
+    }
+}
+
+#endif
+
 static const struct portal *n_closest_reachable_portal(const struct nav_chunk *chunk, struct coord start)
 {
     const struct portal *ret = NULL;
@@ -972,7 +1075,7 @@ static const struct portal *n_closest_reachable_portal(const struct nav_chunk *c
     for(int i = 0; i < chunk->num_portals; i++) {
 
         const struct portal *curr = &chunk->portals[i];
-        float cost = chunk->portal_travel_costs[i][start.r][start.c];
+        float cost = N_PortalTravelCost(chunk, i, start);
 
         if(cost < min_cost) {
             ret = curr;
@@ -1072,14 +1175,168 @@ static bool n_normally_reachable(const struct nav_chunk *chunk, struct coord a,
 {
     for(int i = 0; i < chunk->num_portals; i++) {
     
-        bool areach = (chunk->portal_travel_costs[i][a.r][a.c] != FLT_MAX);
-        bool breach = (chunk->portal_travel_costs[i][b.r][b.c] != FLT_MAX);
+        bool areach = (N_PortalTravelCost(chunk, i, a) != FLT_MAX);
+        bool breach = (N_PortalTravelCost(chunk, i, b) != FLT_MAX);
         if(areach != breach)
             return false;
     }
     return true;
 }
 
+/* Get the chunk and the flow field target for the hop from the (i-1)th to 
+ * the ith node of a portal path, which is traversed backwards. Returns false
+ * if no flow field is needed for this hop. 
+ */
+static bool n_path_hop(const vec_portal_t *path, int i, struct tile_desc src_desc,
+                       struct tile_desc dst_desc, const struct portal *dst_port,
+                       struct coord *out_chunk, struct field_target *out_target)
+{
+    const struct portal *curr_node = vec_AT(path, i - 1);
+    const struct portal *next_hop = vec_AT(path, i);
+
+    /* If the very first hop takes us into another chunk, that means that the 'nearest portal'
+     * to the source borders the 'next' chunk already. In this case, we must remember to
+     * still generate a flow field for the current chunk steering to this portal. */
+    if(i == 1 && (next_hop->chunk.r != src_desc.chunk_r || next_hop->chunk.c != src_desc.chunk_c))
+        next_hop = vec_AT(path, 0);
+
+    if(curr_node->connected == next_hop)
+        return false;
+
+    /* Since we are moving from 'closest portal' to 'closest portal', it 
+     * may be possible that the very last hop takes us from another portal in the 
+     * destination chunk to the destination portal. This is not needed and will
+     * overwrite the destination flow field made earlier. */
+    if(curr_node->chunk.r == dst_desc.chunk_r 
+    && curr_node->chunk.c == dst_desc.chunk_c
+    && next_hop == dst_port)
+        return false;
+
+    *out_chunk = curr_node->chunk;
+    *out_target = (struct field_target){
+        .type = TARGET_PORTAL,
+        .port = next_hop
+    };
+    return true;
+}
+
+/* Runs on the worker threads. Generating a flow field for a portal target 
+ * only reads the navigation data, which is not modified for the duration 
+ * of the parallel section. 
+ */
+static void n_ff_job_work(void *arg, int thread_idx, size_t begin, size_t end)
+{
+    struct ff_job_arg *jarg = arg;
+
+    for(size_t i = begin; i < end; i++) {
+
+        struct ff_job *job = &vec_AT(&jarg->jobs, i);
+        job->ok = N_IntegrationFieldBuild(job->chunk, jarg->priv, job->target, &job->intf);
+        if(!job->ok)
+            continue;
+        N_FlowFieldInit(job->chunk, jarg->priv, &job->ff);
+        N_FlowFieldFromIntegration(job->chunk, jarg->priv, job->target, &job->intf, &job->ff);
+    }
+}
+
+/* Find all the flow fields along the path that are missing from the cache 
+ * and generate them in parallel. The results are added to the cache, such 
+ * that the serial pass over the path will only have to create the mappings 
+ * and the LOS fields. Chunks that are visited more than once by the path, or 
+ * which already have a field mapped for this destination, derive their field 
+ * from a previous one and are left to the serial pass.
+ */
+static void n_gen_path_fields(const struct nav_private *priv, const vec_portal_t *path, 
+                              dest_id_t dest, struct tile_desc src_desc, 
+                              struct tile_desc dst_desc, const struct portal *dst_port)
+{
+    PERF_ENTER();
+
+    struct ff_job_arg arg = (struct ff_job_arg){ .priv = priv };
+    vec_ff_job_init(&arg.jobs);
+
+    for(int i = vec_size(path)-1; i > 0; i--) {
+
+        struct coord chunk;
+        struct field_target target;
+        if(!n_path_hop(path, i, src_desc, dst_desc, dst_port, &chunk, &target))
+            continue;
+
+        /* Flow fields can be derived cheaply from cached integration fields */
+        ff_id_t id = N_FlowField_ID(chunk, target);
+        if(N_FC_ContainsFlowField(id) || N_FC_ContainsIntegrationField(id))
+            continue;
+
+        ff_id_t exist_id;
+        if(N_FC_GetDestFFMapping(dest, chunk, &exist_id) && N_FC_ContainsFlowField(exist_id))
+            continue;
+
+        bool dup = false;
+        for(int j = 0; j < vec_size(&arg.jobs); j++) {
+            const struct ff_job *curr = &vec_AT(&arg.jobs, j);
+            if(curr->chunk.r == chunk.r && curr->chunk.c == chunk.c) {
+                dup = true;
+                break;
+            }
+        }
+        if(dup)
+            continue;
+
+        struct ff_job job = (struct ff_job){
+            .chunk = chunk,
+            .target = target,
+            .id = id
+        };
+        if(!vec_ff_job_push(&arg.jobs, job))
+            break;
+    }
+
+    if(vec_size(&arg.jobs) >= PARALLEL_FIELD_GEN_MIN_JOBS) {
+
+        Sched_ParallelFor(vec_size(&arg.jobs), 1, n_ff_job_work, &arg);
+        for(int i = 0; i < vec_size(&arg.jobs); i++) {
+            const struct ff_job *curr = &vec_AT(&arg.jobs, i);
+            /* Left to the serial pass */
+            if(!curr->ok)
+                continue;
+            N_FC_PutIntegrationField(curr->id, &curr->intf);
+            N_FC_PutFlowField(curr->id, &curr->ff);
+        }
+    }
+
+    vec_ff_job_destroy(&arg.jobs);
+    PERF_RETURN_VOID();
+}
+
+/* Service the queued path requests for up to CONFIG_PATH_REQ_BUDGET_MS. At 
+ * least one request is always serviced, so that the queue is guaranteed to 
+ * drain. The completion of each request is announced with an EVENT_PATH_READY 
+ * event carrying its' ticket. 
+ */
+static void n_service_path_requests(void *nav_private)
+{
+    PERF_ENTER();
+
+    const uint64_t start = SDL_GetPerformanceCounter();
+    const uint64_t budget = SDL_GetPerformanceFrequency() * CONFIG_PATH_REQ_BUDGET_MS / 1000;
+
+    struct path_req req;
+    while(queue_path_req_pop(&s_path_reqs, &req)) {
+
+        if(req.nav_private == nav_private) {
+
+            dest_id_t dest_id;
+            N_RequestPath(req.nav_private, req.xz_src, req.xz_dest, req.map_pos, &dest_id);
+        }
+        E_Global_Notify(EVENT_PATH_READY, (void*)(uintptr_t)req.ticket, ES_ENGINE);
+
+        if(SDL_GetPerformanceCounter() - start >= budget)
+            break;
+    }
+
+    PERF_RETURN_VOID();
+}
+
 /*****************************************************************************/
 /* EXTERN FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -1092,6 +1349,11 @@ bool N_Init(void)
     if((s_dirty_chunks = kh_init(coord)) == NULL)
         return false;
 
+    if(!queue_path_req_init(&s_path_reqs, 64)) {
+        kh_destroy(coord, s_dirty_chunks);
+        return false;
+    }
+
     return true;
 }
 
@@ -1125,11 +1387,13 @@ void N_Update(void *nav_private)
         n_update_components(priv);
 
     kh_clear(coord, s_dirty_chunks);
+    n_service_path_requests(nav_private);
     PERF_RETURN_VOID();
 }
 
 void N_Shutdown(void)
 {
+    queue_path_req_destroy(&s_path_reqs);
     kh_destroy(coord, s_dirty_chunks);
     N_FC_Shutdown();
 }
@@ -1158,6 +1422,12 @@ void *N_BuildForMapData(size_t w, size_t h, size_t chunk_w, size_t chunk_h,
         const struct tile *curr_tiles = chunk_tiles[IDX(chunk_r, ret->width, chunk_c)];
         curr_chunk->num_portals = 0;
 
+#if CONFIG_LAZY_PORTAL_TRAVEL_COSTS
+        memset(curr_chunk->portal_travel_costs, 0, sizeof(curr_chunk->portal_travel_costs));
+#else
+        s_ptc_bytes += sizeof(curr_chunk->portal_travel_costs);
+#endif
+
         for(int tile_r = 0; tile_r < chunk_h; tile_r++) {
         for(int tile_c = 0; tile_c < chunk_w; tile_c++) {
 
@@ -1183,6 +1453,16 @@ fail_alloc:
 void N_FreePrivate(void *nav_private)
 {
     assert(nav_private);
+    struct nav_private *priv = nav_private;
+
+    for(int chunk_r = 0; chunk_r < priv->height; chunk_r++){
+    for(int chunk_c = 0; chunk_c < priv->width;  chunk_c++){
+
+        n_free_portal_travel_index(&priv->chunks[IDX(chunk_r, priv->width, chunk_c)]);
+    }}
+
+    /* The pending requests for this map will never be serviced */
+    queue_path_req_clear(&s_path_reqs);
     free(nav_private);
 }
 
@@ -1673,7 +1953,8 @@ bool N_RequestPath(void *nav_private, vec2_t xz_src, vec2_t xz_dest,
         
             struct coord chunk = (struct coord){dst_desc.chunk_r, dst_desc.chunk_c};
             N_FlowFieldInit(chunk, priv, &ff);
-            N_FlowFieldUpdate(chunk, priv, target, &ff);
+            if(!N_FlowFieldUpdate(chunk, priv, target, &ff))
+                PERF_RETURN(false);
             N_FC_PutFlowField(id, &ff);
         }
 
@@ -1684,7 +1965,8 @@ bool N_RequestPath(void *nav_private, vec2_t xz_src, vec2_t xz_dest,
     if(!N_FC_ContainsLOSField(ret, (struct coord){dst_desc.chunk_r, dst_desc.chunk_c})) {
 
         struct LOS_field lf;
-        N_LOSFieldCreate(ret, (struct coord){dst_desc.chunk_r, dst_desc.chunk_c}, dst_desc, priv, map_pos, &lf, NULL);
+        if(!N_LOSFieldCreate(ret, (struct coord){dst_desc.chunk_r, dst_desc.chunk_c}, dst_desc, priv, map_pos, &lf, NULL))
+            PERF_RETURN(false);
         N_FC_PutLOSField(ret, (struct coord){dst_desc.chunk_r, dst_desc.chunk_c}, &lf);
     }
 
@@ -1729,37 +2011,19 @@ bool N_RequestPath(void *nav_private, vec2_t xz_src, vec2_t xz_dest,
 
     struct coord prev_los_coord = (struct coord){dst_desc.chunk_r, dst_desc.chunk_c};
 
+#if CONFIG_PARALLEL_FIELD_GEN
+    n_gen_path_fields(priv, &path, ret, src_desc, dst_desc, dst_port);
+#endif
+
     /* Traverse the portal path _backwards_ and generate the required fields, if they are not already 
      * cached. Add the results to the fieldcache. */
     for(int i = vec_size(&path)-1; i > 0; i--) {
 
-        const struct portal *curr_node = vec_AT(&path, i - 1);
-        const struct portal *next_hop = vec_AT(&path, i);
-
-        /* If the very first hop takes us into another chunk, that means that the 'nearest portal'
-         * to the source borders the 'next' chunk already. In this case, we must remember to
-         * still generate a flow field for the current chunk steering to this portal. */
-        if(i == 1 && (next_hop->chunk.r != src_desc.chunk_r || next_hop->chunk.c != src_desc.chunk_c))
-            next_hop = vec_AT(&path, 0);
-
-        if(curr_node->connected == next_hop)
-            continue;
-
-        /* Since we are moving from 'closest portal' to 'closest portal', it 
-         * may be possible that the very last hop takes us from another portal in the 
-         * destination chunk to the destination portal. This is not needed and will
-         * overwrite the destination flow field made earlier. */
-        if(curr_node->chunk.r == dst_desc.chunk_r 
-        && curr_node->chunk.c == dst_desc.chunk_c
-        && next_hop == dst_port)
+        struct coord chunk_coord;
+        struct field_target target;
+        if(!n_path_hop(&path, i, src_desc, dst_desc, dst_port, &chunk_coord, &target))
             continue;
 
-        struct coord chunk_coord = curr_node->chunk;
-        struct field_target target = (struct field_target){
-            .type = TARGET_PORTAL,
-            .port = next_hop
-        };
-
         ff_id_t new_id = N_FlowField_ID(chunk_coord, target);
         ff_id_t exist_id;
         struct flow_field ff;
@@ -1777,7 +2041,8 @@ bool N_RequestPath(void *nav_private, vec2_t xz_src, vec2_t xz_dest,
             const struct flow_field *exist_ff  = N_FC_FlowFieldAt(exist_id);
             memcpy(&ff, exist_ff, sizeof(struct flow_field));
 
-            N_FlowFieldUpdate(chunk_coord, priv, target, &ff);
+            if(!N_FlowFieldUpdate(chunk_coord, priv, target, &ff))
+                goto fail;
             /* We set the updated flow field for the new (least recently used) key. Since in 
              * this case more than one flowfield ID maps to the same field but we only keep 
              * one of the IDs, it may be possible that the same flowfield will be redundantly 
@@ -1792,7 +2057,8 @@ bool N_RequestPath(void *nav_private, vec2_t xz_src, vec2_t xz_dest,
         if(!N_FC_ContainsFlowField(new_id)) {
         
             N_FlowFieldInit(chunk_coord, priv, &ff);
-            N_FlowFieldUpdate(chunk_coord, priv, target, &ff);
+            if(!N_FlowFieldUpdate(chunk_coord, priv, target, &ff))
+                goto fail;
             N_FC_PutFlowField(new_id, &ff);
         }
 
@@ -1811,7 +2077,8 @@ bool N_RequestPath(void *nav_private, vec2_t xz_src, vec2_t xz_dest,
             assert(prev_los->chunk.r == prev_los_coord.r && prev_los->chunk.c == prev_los_coord.c);
 
             struct LOS_field lf;
-            N_LOSFieldCreate(ret, chunk_coord, dst_desc, priv, map_pos, &lf, prev_los);
+            if(!N_LOSFieldCreate(ret, chunk_coord, dst_desc, priv, map_pos, &lf, prev_los))
+                goto fail;
             N_FC_PutLOSField(ret, chunk_coord, &lf);
         }
 
@@ -1821,6 +2088,29 @@ bool N_RequestPath(void *nav_private, vec2_t xz_src, vec2_t xz_dest,
 
     *out_dest_id = ret; 
     PERF_RETURN(true);
+
+fail:
+    vec_portal_destroy(&path);
+    PERF_RETURN(false);
+}
+
+path_ticket_t N_RequestPathAsync(void *nav_private, vec2_t xz_src, vec2_t xz_dest, vec3_t map_pos)
+{
+    struct path_req req = (struct path_req){
+        .ticket = s_next_ticket,
+        .nav_private = nav_private,
+        .xz_src = xz_src,
+        .xz_dest = xz_dest,
+        .map_pos = map_pos,
+    };
+
+    if(!queue_path_req_push(&s_path_reqs, &req))
+        return PATH_TICKET_INVALID;
+
+    /* Skip the invalid ticket on wraparound */
+    if(++s_next_ticket == PATH_TICKET_INVALID)
+        s_next_ticket++;
+    return req.ticket;
 }
 
 vec2_t N_DesiredPointSeekVelocity(dest_id_t id, vec2_t curr_pos, vec2_t xz_dest, 
@@ -1883,9 +2173,10 @@ vec2_t N_DesiredPointSeekVelocity(dest_id_t id, vec2_t curr_pos, vec2_t xz_dest,
     if(local_iid == ISLAND_NONE) {
 
         struct flow_field exist_ff = *ff;
-        N_FlowFieldUpdateToNearestPathable(chunk, (struct coord){tile.tile_r, tile.tile_c}, &exist_ff);
-        N_FC_PutFlowField(ffid, &exist_ff);
-        ff = N_FC_FlowFieldAt(ffid);
+        if(N_FlowFieldUpdateToNearestPathable(chunk, (struct coord){tile.tile_r, tile.tile_c}, &exist_ff)) {
+            N_FC_PutFlowField(ffid, &exist_ff);
+            ff = N_FC_FlowFieldAt(ffid);
+        }
         goto ff_found;
     }
 
@@ -1896,8 +2187,8 @@ vec2_t N_DesiredPointSeekVelocity(dest_id_t id, vec2_t curr_pos, vec2_t xz_dest,
      *      due to blockers).
      */
     struct flow_field exist_ff = *ff;
-    N_FlowFieldUpdateIslandToNearest(local_iid, priv, &exist_ff);
-    N_FC_PutFlowField(ffid, &exist_ff);
+    if(N_FlowFieldUpdateIslandToNearest(local_iid, priv, &exist_ff))
+        N_FC_PutFlowField(ffid, &exist_ff);
 
     /*   4. If the direction is still FD_NONE, that means that the
      *      entity is at its' destination of maximally close to it.
@@ -1958,7 +2249,8 @@ vec2_t N_DesiredEnemySeekVelocity(vec2_t curr_pos, void *nav_private, vec3_t map
         && target_tile.chunk_c == curr_tile.chunk_c) {
         
             N_FlowFieldInit(chunk, priv, &ff);
-            N_FlowFieldUpdate(chunk, priv, target, &ff);
+            if(!N_FlowFieldUpdate(chunk, priv, target, &ff))
+                return (vec2_t){0.0f, 0.0f};
             N_FC_PutFlowField(ffid, &ff);
             done = true;
         }
@@ -1975,7 +2267,8 @@ vec2_t N_DesiredEnemySeekVelocity(vec2_t curr_pos, void *nav_private, vec3_t map
             };
 
             N_FlowFieldInit(chunk, priv, &ff);
-            N_FlowFieldUpdate(chunk, priv, pm_target, &ff);
+            if(!N_FlowFieldUpdate(chunk, priv, pm_target, &ff))
+                return (vec2_t){0.0f, 0.0f};
             N_FC_PutFlowField(ffid, &ff);
             done = true;
         }
@@ -2014,10 +2307,12 @@ vec2_t N_DesiredEnemySeekVelocity(vec2_t curr_pos, void *nav_private, vec3_t map
             };
 
             N_FlowFieldInit(chunk, priv, &ff);
-            N_FlowFieldUpdate(chunk, priv, portal_target, &ff);
-            N_FC_PutFlowField(ffid, &ff);
-
+            bool built = N_FlowFieldUpdate(chunk, priv, portal_target, &ff);
             vec_portal_destroy(&path);
+
+            if(!built)
+                return (vec2_t){0.0f, 0.0f};
+            N_FC_PutFlowField(ffid, &ff);
         }
 
         assert(N_FC_ContainsFlowField(ffid));
@@ -2033,10 +2328,10 @@ vec2_t N_DesiredEnemySeekVelocity(vec2_t curr_pos, void *nav_private, vec3_t map
         uint16_t local_iid = nchunk->local_islands[curr_tile.tile_r][curr_tile.tile_c];
 
         struct flow_field exist_ff = *pff;
-        N_FlowFieldUpdateIslandToNearest(local_iid, priv, &exist_ff);
-        N_FC_PutFlowField(ffid, &exist_ff);
-
-        dir_idx = exist_ff.field[curr_tile.tile_r][curr_tile.tile_c].dir_idx;
+        if(N_FlowFieldUpdateIslandToNearest(local_iid, priv, &exist_ff)) {
+            N_FC_PutFlowField(ffid, &exist_ff);
+            dir_idx = exist_ff.field[curr_tile.tile_r][curr_tile.tile_c].dir_idx;
+        }
     }
 
     return g_flow_dir_lookup[dir_idx];
@@ -2219,6 +2514,34 @@ bool N_PortalReachableFromTile(const struct portal *port, struct coord tile, con
     return false;
 }
 
+float N_PortalTravelCost(const struct nav_chunk *chunk, int port_idx, struct coord tile)
+{
+    assert(port_idx >= 0 && port_idx < chunk->num_portals);
+
+#if CONFIG_LAZY_PORTAL_TRAVEL_COSTS
+    /* The slices are a cache that is populated on demand - the 
+     * chunk is only logically const. */
+    const uint16_t *slice = n_portal_travel_slice((struct nav_chunk*)chunk, port_idx);
+    if(!slice) {
+        float costs[FIELD_RES_R][FIELD_RES_C];
+        n_portal_travel_flood(chunk, port_idx, costs);
+        return costs[tile.r][tile.c];
+    }
+
+    uint16_t val = slice[IDX(tile.r, FIELD_RES_C, tile.c)];
+    if(val == PTC_UNREACHABLE)
+        return FLT_MAX;
+    return ((float)val) / PTC_FIXED_SCALE;
+#else
+    return chunk->portal_travel_costs[port_idx][tile.r][tile.c];
+#endif
+}
+
+size_t N_PortalTravelCostBytes(void)
+{
+    return s_ptc_bytes;
+}
+
 int N_GridNeighbours(const uint8_t cost_field[FIELD_RES_R][FIELD_RES_C], struct coord coord, 
                      struct coord out_neighbours[static 8], float out_costs[static 8])
 {
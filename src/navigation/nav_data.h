@@ -36,6 +36,8 @@
 #ifndef NAV_DAT_H
 #define NAV_DAT_H
 
+#include "../config.h"
+
 #include <stddef.h>
 #include <stdint.h>
 
@@ -45,6 +47,11 @@
 #define COST_IMPASSABLE       0xff
 #define ISLAND_NONE           0xffff
 
+/* Travel costs are stored in units of 1/PTC_FIXED_SCALE. A 16-bit value is 
+ * enough to hold the cost of the longest possible path within a chunk. */
+#define PTC_FIXED_SCALE       8
+#define PTC_UNREACHABLE       0xffff
+
 struct coord{
     int r, c;
 };
@@ -84,9 +91,17 @@ struct nav_chunk{
     uint8_t         cost_base[FIELD_RES_R][FIELD_RES_C]; 
     /* Holds the cost to travel from every tile to every portal,
      * when the portal is reachable from the tile. This field is 
-     * synchronized with the 'cost_base' field.
+     * synchronized with the 'cost_base' field. It should only be 
+     * accessed via 'N_PortalTravelCost'.
      */
+#if CONFIG_LAZY_PORTAL_TRAVEL_COSTS
+    /* Fixed-point costs, with only the slices for the first 'num_portals' 
+     * portals being valid. A slice is allocated and filled in the first 
+     * time that it's queried. */
+    uint16_t       *portal_travel_costs[MAX_PORTALS_PER_CHUNK];
+#else
     float           portal_travel_costs[MAX_PORTALS_PER_CHUNK][FIELD_RES_R][FIELD_RES_C];
+#endif
     /* Every tile in the 'blockers' holds a reference count for
      * how many stationary entities are currently 'retaining' that 
      * tile by being positioned on it. 'Blocked' tiles are treated 
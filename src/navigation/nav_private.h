@@ -50,6 +50,15 @@ struct nav_private{
 bool N_PortalReachableFromTile(const struct portal *port, struct coord tile, 
                                const struct nav_chunk *chunk);
 
+/* Returns the cost to travel from the tile to the portal with the specified 
+ * index in the chunk, or FLT_MAX if the portal cannot be reached from the tile.
+ */
+float N_PortalTravelCost(const struct nav_chunk *chunk, int port_idx, struct coord tile);
+
+/* Returns the number of bytes currently used for holding all the 
+ * portal travel costs */
+size_t N_PortalTravelCostBytes(void);
+
 int  N_GridNeighbours(const uint8_t cost_field[FIELD_RES_R][FIELD_RES_C], struct coord coord, 
                       struct coord out_neighbours[static 8], float out_costs[static 8]);
 
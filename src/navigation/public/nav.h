@@ -46,6 +46,9 @@ struct obb;
 struct entity;
 
 typedef uint32_t dest_id_t;
+typedef uint32_t path_ticket_t;
+
+#define PATH_TICKET_INVALID (0)
 
 struct fc_stats{
     unsigned los_used;
@@ -56,12 +59,17 @@ struct fc_stats{
     unsigned flow_max;
     float    flow_hit_rate;
     unsigned flow_invalidated;
+    unsigned intf_used;
+    unsigned intf_max;
+    float    intf_hit_rate;
+    unsigned intf_invalidated;
     unsigned ffid_used;
     unsigned ffid_max;
     float    ffid_hit_rate;
     unsigned grid_path_used;
     unsigned grid_path_max;
     float    grid_path_hit_rate;
+    size_t   portal_travel_cost_bytes;
 };
 
 #define DEST_ID_INVALID (~((uint32_t)0))
@@ -197,6 +205,19 @@ dest_id_t N_DestIDForPos(void *nav_private, vec3_t map_pos, vec2_t xz_pos);
 bool      N_RequestPath(void *nav_private, vec2_t xz_src, vec2_t xz_dest, 
                         vec3_t map_pos, dest_id_t *out_dest_id);
 
+/* ------------------------------------------------------------------------
+ * Queue a path request and return a ticket for it right away. The queued
+ * requests are serviced in order during 'N_Update', within a fixed time 
+ * budget per frame. Once the fields for a request have been generated 
+ * (or it has been determined that no path exists), an EVENT_PATH_READY 
+ * event is posted with the ticket as its' argument. Since requests are 
+ * serviced in order, this implies that all previously issued tickets 
+ * are complete as well. Returns PATH_TICKET_INVALID on failure.
+ * ------------------------------------------------------------------------
+ */
+path_ticket_t N_RequestPathAsync(void *nav_private, vec2_t xz_src, vec2_t xz_dest, 
+                                 vec3_t map_pos);
+
 /* ------------------------------------------------------------------------
  * Returns the desired velocity for an entity at 'curr_pos' for it to flow
  * towards a particular destination.
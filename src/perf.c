@@ -43,12 +43,30 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+/* Profiling builds read the timestamp counter directly, as it is several 
+ * times cheaper than going through the OS */
+#if defined(PERF_SAMPLING) && (defined(__x86_64__) || defined(__i386__))
+    #define PERF_USE_TSC
+    #include <x86intrin.h>
+#endif
 
 
 #define PARENT_NONE     ~((uint32_t)0)
 #define GPU_STATE_NAME  "GPU"
 #define GPU_STATE_KEY   UINT64_MAX
 #define GPU_TIMER_HZ    (1 * 1000 * 1000 * 1000)
+#define TRACE_RING_SIZE (1 << 16)
+#define NAME_CACHE_SIZE (512)
+#define PERF_TREE_SIZE  (32768)
 
 struct perf_entry{
     union{
@@ -73,6 +91,34 @@ VEC_IMPL(static inline, perf, struct perf_entry)
 VEC_TYPE(idx, uint32_t)
 VEC_IMPL(static inline, idx, uint32_t)
 
+struct trace_event{
+    /* In performance counter units, except for the GPU timeline, where
+     * the raw GPU timestamps (in nanoseconds) are used */
+    uint64_t    begin_pc;
+    uint64_t    end_pc;
+    const char *name; /* borrowed from the name table of the owning thread */
+};
+
+/* Single-producer, single-consumer ring buffer of completed calls. The 
+ * producer is the profiled thread, which pushes a new event whenever an 
+ * entry is popped off its perf stack. The consumer is the main thread, 
+ * which drains the ring to the trace file at the end of every frame. 
+ * When the ring is full, the newest events are dropped.
+ */
+struct trace_ring{
+    SDL_atomic_t       head;
+    SDL_atomic_t       tail;
+    SDL_atomic_t       ndropped;
+    struct trace_event events[TRACE_RING_SIZE];
+};
+
+enum capture_state{
+    CAPTURE_OFF,
+    CAPTURE_PENDING,
+    CAPTURE_ACTIVE,
+    CAPTURE_ENDING,
+};
+
 struct perf_state{
     char              name[64];
     /* The next name ID to hand out 
@@ -83,6 +129,13 @@ struct perf_state{
      */
     khash_t(name_id) *name_id_table;
     khash_t(id_name) *id_name_table;
+    /* Direct-mapped cache of static name strings to their IDs, keyed 
+     * by the address of the string.
+     */
+    struct{
+        const char *name;
+        uint32_t    id;
+    }name_cache[NAME_CACHE_SIZE];
     /* The callstack of profiled functions. As enties are popped, the
      * entries for the corresponding index are updated in the perf tree. 
      */
@@ -92,10 +145,29 @@ struct perf_state{
      */
     int               perf_tree_idx;
     vec_perf_t        perf_trees[NFRAMES_LOGGED];
+    /* The thread ID used in trace captures 
+     */
+    int               trace_tid;
+    /* Only set while a trace capture is active. It is only ever (un)set 
+     * by the main thread at a frame boundary, after waiting for the render
+     * thread to go idle, when the other threads are not making any Perf_ 
+     * calls.
+     */
+    struct trace_ring *ring;
 };
 
 KHASH_MAP_INIT_INT64(pstate, struct perf_state)
 
+/*****************************************************************************/
+/* GLOBAL VARIABLES                                                          */
+/*****************************************************************************/
+
+#if defined(PERF_SAMPLING)
+bool g_perf_enabled = false;
+#else
+bool g_perf_enabled = true;
+#endif
+
 /*****************************************************************************/
 /* STATIC VARIABLES                                                          */
 /*****************************************************************************/
@@ -104,6 +176,30 @@ static khash_t(pstate) *s_thread_state_table;
 
 static int              s_last_idx = 0;
 static unsigned         s_last_frames_ms[NFRAMES_LOGGED];
+static uint64_t         s_frame_idx = 0;
+static int              s_next_trace_tid = 0;
+static uint64_t         s_counter_hz;
+#if defined(PERF_USE_TSC)
+static uint64_t         s_calib_tsc;
+static uint64_t         s_calib_pc;
+#endif
+static bool             s_enable_pending = false;
+
+static struct{
+    enum capture_state state;
+    FILE              *stream;
+    /* When non-zero, the capture is automatically ended after this many frames */
+    unsigned           nframes;
+    unsigned           nframes_done;
+    uint64_t           begin_frame;
+    uint64_t           start_pc;
+    size_t             nevents;
+    unsigned long      ndropped;
+    /* Written by the render thread: a GPU timestamp and the CPU 
+     * performance counter value sampled at the same time. */
+    uint64_t           gpu_ref_ns;
+    uint64_t           gpu_ref_pc;
+}s_capture;
 
 /*****************************************************************************/
 /* STATIC FUNCTIONS                                                          */
@@ -143,6 +239,18 @@ static uint32_t name_id_get(const char *name, struct perf_state *ps)
     return new_id;
 }
 
+static uint32_t name_id_get_static(const char *name, struct perf_state *ps)
+{
+    size_t slot = (((uintptr_t)name) >> 3) % NAME_CACHE_SIZE;
+    if(ps->name_cache[slot].name == name)
+        return ps->name_cache[slot].id;
+
+    uint32_t ret = name_id_get(name, ps);
+    ps->name_cache[slot].name = name;
+    ps->name_cache[slot].id = ret;
+    return ret;
+}
+
 const char *name_for_id(struct perf_state *ps, uint32_t id)
 {
     khiter_t k = kh_get(id_name, ps->id_name_table, id);
@@ -167,12 +275,15 @@ static bool pstate_init(struct perf_state *out, const char *name)
     for(int i = 0; i < NFRAMES_LOGGED; i++) {
     
         vec_perf_init(&out->perf_trees[i]);
-        if(!vec_perf_resize(&out->perf_trees[i], 32768))
+        if(!vec_perf_resize(&out->perf_trees[i], PERF_TREE_SIZE))
             goto fail_perf_trees;
     }
 
     pf_strlcpy(out->name, name, sizeof(out->name));
     out->perf_tree_idx = 0;
+    out->trace_tid = s_next_trace_tid++;
+    out->ring = NULL;
+    memset(out->name_cache, 0, sizeof(out->name_cache));
     return true;
 
 fail_perf_trees:
@@ -224,6 +335,310 @@ static bool register_gpu_state(void)
     return true;
 }
 
+static bool pstate_renderer_owned(uint64_t key)
+{
+    /* The states of the render thread and the GPU are advanced by the render
+     * thread itself at the end of every frame it processes, and these may lag
+     * behind the main thread by a number of frames. */
+    if(key == GPU_STATE_KEY)
+        return true;
+    return (!g_headless && key == tid_to_key(g_render_thread_id));
+}
+
+static struct perf_state *gpu_state(void)
+{
+    khiter_t k = kh_get(pstate, s_thread_state_table, GPU_STATE_KEY);
+    assert(k != kh_end(s_thread_state_table));
+    return &kh_val(s_thread_state_table, k);
+}
+
+static void pstate_advance(struct perf_state *ps)
+{
+    assert(vec_size(&ps->perf_stack) == 0);
+    ps->perf_tree_idx = (ps->perf_tree_idx + 1) % NFRAMES_LOGGED;
+    vec_perf_reset(&ps->perf_trees[ps->perf_tree_idx]);
+}
+
+static inline uint64_t perf_counter(void)
+{
+#if defined(PERF_USE_TSC)
+    return __rdtsc();
+#else
+    return SDL_GetPerformanceCounter();
+#endif
+}
+
+static void counter_calibrate(void)
+{
+#if defined(PERF_USE_TSC)
+    /* The TSC frequency is measured against the performance counter over 
+     * the entire lifetime of the process, becoming more accurate over time. */
+    uint64_t pc_hz = SDL_GetPerformanceFrequency();
+    uint64_t dpc = SDL_GetPerformanceCounter() - s_calib_pc;
+    uint64_t dtsc = __rdtsc() - s_calib_tsc;
+    if(dpc > 0)
+        s_counter_hz = (uint64_t)((double)dtsc * pc_hz / dpc);
+#else
+    s_counter_hz = SDL_GetPerformanceFrequency();
+#endif
+}
+
+static void counter_init(void)
+{
+#if defined(PERF_USE_TSC)
+    s_calib_pc = SDL_GetPerformanceCounter();
+    s_calib_tsc = __rdtsc();
+    /* Get an initial estimate over a short interval */
+    uint64_t pc_hz = SDL_GetPerformanceFrequency();
+    while(SDL_GetPerformanceCounter() - s_calib_pc < pc_hz / 100)
+        ;
+#endif
+    counter_calibrate();
+}
+
+static struct perf_state *curr_thread_state(void)
+{
+    SDL_threadID tid = SDL_ThreadID();
+    khiter_t k = kh_get(pstate, s_thread_state_table, tid_to_key(tid));
+    if(k == kh_end(s_thread_state_table))
+        return NULL;
+    return &kh_val(s_thread_state_table, k);
+}
+
+static void perf_push(struct perf_state *ps, uint32_t name_id)
+{
+    vec_perf_t *tree = &ps->perf_trees[ps->perf_tree_idx];
+    const size_t ssize = vec_size(&ps->perf_stack);
+    uint32_t parent_idx = ssize > 0 ? vec_AT(&ps->perf_stack, ssize-1) : PARENT_NONE;
+
+#if defined(PERF_SAMPLING)
+    /* Don't allocate in the instrumented path of profiling builds. Once the
+     * fixed-size buffer for the frame is full, the calls are dropped. */
+    if(vec_size(tree) == tree->capacity) {
+        vec_idx_push(&ps->perf_stack, PARENT_NONE);
+        return;
+    }
+#endif
+
+    vec_perf_push(tree, (struct perf_entry){
+        .pc_delta = perf_counter(),
+        .parent_idx = parent_idx,
+        .name_id = name_id
+    });
+
+    uint32_t new_idx = vec_size(tree)-1;
+    vec_idx_push(&ps->perf_stack, new_idx);
+}
+
+static void trace_ring_push(struct trace_ring *ring, struct trace_event event)
+{
+    unsigned head = SDL_AtomicGet(&ring->head);
+    unsigned tail = SDL_AtomicGet(&ring->tail);
+
+    if(head - tail == TRACE_RING_SIZE) {
+        SDL_AtomicIncRef(&ring->ndropped);
+        return;
+    }
+    ring->events[head % TRACE_RING_SIZE] = event;
+    SDL_AtomicSet(&ring->head, head + 1);
+}
+
+static bool trace_ring_pop(struct trace_ring *ring, struct trace_event *out)
+{
+    unsigned tail = SDL_AtomicGet(&ring->tail);
+    unsigned head = SDL_AtomicGet(&ring->head);
+
+    if(head == tail)
+        return false;
+    *out = ring->events[tail % TRACE_RING_SIZE];
+    SDL_AtomicSet(&ring->tail, tail + 1);
+    return true;
+}
+
+static double trace_ts_us(uint64_t pc)
+{
+    int64_t delta = pc - s_capture.start_pc;
+    return delta * 1000000.0 / s_counter_hz;
+}
+
+static void trace_write_begin(const char *name)
+{
+    FILE *stream = s_capture.stream;
+    if(s_capture.nevents++ > 0)
+        fputs(",\n", stream);
+
+    fputs("{\"name\":\"", stream);
+    for(const char *c = name; *c; c++) {
+        if(*c == '"' || *c == '\\')
+            fputc('\\', stream);
+        if((unsigned char)*c >= 0x20)
+            fputc(*c, stream);
+    }
+    fputs("\",\"pid\":1,", stream);
+}
+
+static void trace_write_thread_name(int tid, const char *name, int sort_index)
+{
+    trace_write_begin("thread_name");
+    fprintf(s_capture.stream, "\"tid\":%d,\"ph\":\"M\",\"args\":{\"name\":\"%s\"}}", tid, name);
+    trace_write_begin("thread_sort_index");
+    fprintf(s_capture.stream, "\"tid\":%d,\"ph\":\"M\",\"args\":{\"sort_index\":%d}}", tid, sort_index);
+}
+
+static void trace_write_complete(const char *name, int tid, double ts_us, double dur_us)
+{
+    trace_write_begin(name);
+    fprintf(s_capture.stream, "\"tid\":%d,\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f}", tid, ts_us, dur_us);
+}
+
+static void trace_write_frame_marker(int tid, uint64_t frame, double ts_us)
+{
+    char name[64];
+    pf_snprintf(name, sizeof(name), "Frame %lu", (unsigned long)frame);
+    trace_write_begin(name);
+    fprintf(s_capture.stream, "\"tid\":%d,\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f}", tid, ts_us);
+}
+
+static void capture_free_rings(void)
+{
+    for(khiter_t k = kh_begin(s_thread_state_table); k != kh_end(s_thread_state_table); k++) {
+
+        if(!kh_exist(s_thread_state_table, k))
+            continue;
+        struct perf_state *ps = &kh_val(s_thread_state_table, k);
+        free(ps->ring);
+        ps->ring = NULL;
+    }
+}
+
+static void capture_start(void)
+{
+    /* The rings of the render thread and the GPU timeline can only be 
+     * installed while the render thread is not running */
+    Engine_WaitRenderWorkDone();
+
+    for(khiter_t k = kh_begin(s_thread_state_table); k != kh_end(s_thread_state_table); k++) {
+
+        if(!kh_exist(s_thread_state_table, k))
+            continue;
+
+        struct perf_state *ps = &kh_val(s_thread_state_table, k);
+        ps->ring = malloc(sizeof(struct trace_ring));
+        if(!ps->ring)
+            goto fail;
+
+        SDL_AtomicSet(&ps->ring->head, 0);
+        SDL_AtomicSet(&ps->ring->tail, 0);
+        SDL_AtomicSet(&ps->ring->ndropped, 0);
+    }
+
+    s_capture.begin_frame = s_frame_idx;
+    s_capture.start_pc = perf_counter();
+    s_capture.nframes_done = 0;
+    s_capture.nevents = 0;
+    s_capture.ndropped = 0;
+    s_capture.gpu_ref_ns = 0;
+    s_capture.gpu_ref_pc = 0;
+
+    fputs("{\"traceEvents\":[\n", s_capture.stream);
+
+    trace_write_begin("process_name");
+    fputs("\"ph\":\"M\",\"args\":{\"name\":\"Permafrost Engine\"}}", s_capture.stream);
+
+    for(khiter_t k = kh_begin(s_thread_state_table); k != kh_end(s_thread_state_table); k++) {
+
+        if(!kh_exist(s_thread_state_table, k))
+            continue;
+        /* Show the GPU timeline below all the CPU threads */
+        struct perf_state *ps = &kh_val(s_thread_state_table, k);
+        bool gpu = (kh_key(s_thread_state_table, k) == GPU_STATE_KEY);
+        trace_write_thread_name(ps->trace_tid, ps->name, gpu ? s_next_trace_tid : ps->trace_tid);
+    }
+
+    /* Executed by the render thread during the next frame, before the 
+     * first GPU timestamps of the capture become available. */
+    R_PushCmd((struct rcmd){
+        .func = R_GL_TimestampCalibrate,
+        .nargs = 2,
+        .args = {
+            &s_capture.gpu_ref_ns,
+            &s_capture.gpu_ref_pc,
+        }
+    });
+
+    s_capture.state = CAPTURE_ACTIVE;
+    return;
+
+fail:
+    fprintf(stderr, "Failed to allocate the buffers for the trace capture.\n");
+    capture_free_rings();
+    fclose(s_capture.stream);
+    s_capture.stream = NULL;
+    s_capture.state = CAPTURE_OFF;
+}
+
+static void capture_drain(void)
+{
+    for(khiter_t k = kh_begin(s_thread_state_table); k != kh_end(s_thread_state_table); k++) {
+
+        if(!kh_exist(s_thread_state_table, k))
+            continue;
+        struct perf_state *ps = &kh_val(s_thread_state_table, k);
+        if(!ps->ring)
+            continue;
+
+        bool gpu = (kh_key(s_thread_state_table, k) == GPU_STATE_KEY);
+        struct trace_event event;
+
+        while(trace_ring_pop(ps->ring, &event)) {
+
+            double begin, end;
+            if(gpu) {
+                /* Map the GPU timestamps onto the CPU timeline using the 
+                 * reference pair sampled by the render thread */
+                double ref_us = trace_ts_us(s_capture.gpu_ref_pc);
+                begin = ref_us + ((int64_t)(event.begin_pc - s_capture.gpu_ref_ns)) / 1000.0;
+                end = ref_us + ((int64_t)(event.end_pc - s_capture.gpu_ref_ns)) / 1000.0;
+                /* Work submitted before the capture started */
+                if(begin < 0.0)
+                    continue;
+            }else{
+                begin = trace_ts_us(event.begin_pc);
+                end = trace_ts_us(event.end_pc);
+            }
+            trace_write_complete(event.name, ps->trace_tid, begin, end - begin);
+        }
+    }
+}
+
+static void capture_finish(void)
+{
+    /* Let the render thread push its' last events before freeing the rings */
+    Engine_WaitRenderWorkDone();
+    capture_drain();
+
+    for(khiter_t k = kh_begin(s_thread_state_table); k != kh_end(s_thread_state_table); k++) {
+
+        if(!kh_exist(s_thread_state_table, k))
+            continue;
+        struct perf_state *ps = &kh_val(s_thread_state_table, k);
+        if(!ps->ring)
+            continue;
+        s_capture.ndropped += SDL_AtomicGet(&ps->ring->ndropped);
+    }
+
+    fputs("\n],\"displayTimeUnit\":\"ms\"}\n", s_capture.stream);
+    fclose(s_capture.stream);
+    s_capture.stream = NULL;
+    capture_free_rings();
+
+    if(s_capture.ndropped > 0) {
+        fprintf(stderr, "WARNING: %lu events were dropped from the trace capture.\n", s_capture.ndropped);
+        fflush(stderr);
+    }
+    s_capture.state = CAPTURE_OFF;
+}
+
 /*****************************************************************************/
 /* EXTERN FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -237,12 +652,28 @@ bool Perf_Init(void)
         kh_destroy(pstate, s_thread_state_table);
         return false;
     }
-    assert(NFRAMES_LOGGED >= 3);
+    /* The GPU timestamps are resolved 2 frames after being issued and 
+     * reported from 3 frames ago */
+    assert(NFRAMES_LOGGED >= 5);
+    counter_init();
     return true;
 }
 
 void Perf_Shutdown(void)
 {
+    switch(s_capture.state) {
+    case CAPTURE_PENDING:
+        fclose(s_capture.stream);
+        s_capture.state = CAPTURE_OFF;
+        break;
+    case CAPTURE_ACTIVE:
+    case CAPTURE_ENDING:
+        capture_finish();
+        break;
+    default:
+        break;
+    }
+
     uint64_t key;
     struct perf_state curr;
     (void)key;
@@ -275,47 +706,48 @@ bool Perf_RegisterThread(SDL_threadID tid, const char *name)
 
 void Perf_Push(const char *name)
 {
-    SDL_threadID tid = SDL_ThreadID();
-    khiter_t k = kh_get(pstate, s_thread_state_table, tid_to_key(tid));
-    if(k == kh_end(s_thread_state_table))
+    struct perf_state *ps = curr_thread_state();
+    if(!ps)
         return;
+    perf_push(ps, name_id_get(name, ps));
+}
 
-    struct perf_state *ps = &kh_val(s_thread_state_table, k);
-    const size_t ssize = vec_size(&ps->perf_stack);
-    uint32_t parent_idx = ssize > 0 ? vec_AT(&ps->perf_stack, ssize-1) : PARENT_NONE;
-
-    vec_perf_push(&ps->perf_trees[ps->perf_tree_idx], (struct perf_entry){
-        .pc_delta = SDL_GetPerformanceCounter(),
-        .parent_idx = parent_idx,
-        .name_id = name_id_get(name, ps)
-    });
-
-    uint32_t new_idx = vec_size(&ps->perf_trees[ps->perf_tree_idx])-1;
-    vec_idx_push(&ps->perf_stack, new_idx);
+void Perf_PushStatic(const char *name)
+{
+    struct perf_state *ps = curr_thread_state();
+    if(!ps)
+        return;
+    perf_push(ps, name_id_get_static(name, ps));
 }
 
 void Perf_Pop(void)
 {
-    SDL_threadID tid = SDL_ThreadID();
-    khiter_t k = kh_get(pstate, s_thread_state_table, tid_to_key(tid));
-    if(k == kh_end(s_thread_state_table))
+    struct perf_state *ps = curr_thread_state();
+    if(!ps)
         return;
-
-    struct perf_state *ps = &kh_val(s_thread_state_table, k);
     assert(vec_size(&ps->perf_stack) > 0);
 
     uint32_t idx = vec_idx_pop(&ps->perf_stack);
+    if(idx == PARENT_NONE)
+        return;
+
     assert(idx < vec_size(&ps->perf_trees[ps->perf_tree_idx]));
     struct perf_entry *pe = &vec_AT(&ps->perf_trees[ps->perf_tree_idx], idx);
-    pe->pc_delta = abs(SDL_GetPerformanceCounter() - pe->pc_delta);
+    uint64_t now = perf_counter();
+
+    if(ps->ring) {
+        trace_ring_push(ps->ring, (struct trace_event){
+            .begin_pc = pe->pc_delta,
+            .end_pc = now,
+            .name = name_for_id(ps, pe->name_id)
+        });
+    }
+    pe->pc_delta = abs(now - pe->pc_delta);
 }
 
 void Perf_PushGPU(const char *name, uint32_t cookie)
 {
-    khiter_t k = kh_get(pstate, s_thread_state_table, GPU_STATE_KEY);
-    assert(k != kh_end(s_thread_state_table));
-
-    struct perf_state *ps = &kh_val(s_thread_state_table, k);
+    struct perf_state *ps = gpu_state();
     const size_t ssize = vec_size(&ps->perf_stack);
     uint32_t parent_idx = ssize > 0 ? vec_AT(&ps->perf_stack, ssize-1) : PARENT_NONE;
 
@@ -331,10 +763,7 @@ void Perf_PushGPU(const char *name, uint32_t cookie)
 
 void Perf_PopGPU(uint32_t cookie)
 {
-    khiter_t k = kh_get(pstate, s_thread_state_table, GPU_STATE_KEY);
-    if(k != kh_end(s_thread_state_table));
-
-    struct perf_state *ps = &kh_val(s_thread_state_table, k);
+    struct perf_state *ps = gpu_state();
     assert(vec_size(&ps->perf_stack) > 0);
 
     uint32_t idx = vec_idx_pop(&ps->perf_stack);
@@ -348,34 +777,11 @@ void Perf_BeginTick(void)
     ASSERT_IN_MAIN_THREAD();
     s_last_frames_ms[s_last_idx] = SDL_GetTicks();
 
-    khiter_t k = kh_get(pstate, s_thread_state_table, GPU_STATE_KEY);
-    if(k != kh_end(s_thread_state_table));
-
-    /* commands are just queued now, to be executed next tick when the 
-     * perf_tree_idx moves forward by 1 */
-    struct perf_state *gpu_ps = &kh_val(s_thread_state_table, k);
-    int write_idx = (gpu_ps->perf_tree_idx + 3) % NFRAMES_LOGGED;
+    if(s_capture.state == CAPTURE_ACTIVE) {
 
-    for(int i = 0; i < vec_size(&gpu_ps->perf_trees[write_idx]); i++) {
-    
-        struct perf_entry *pe = &vec_AT(&gpu_ps->perf_trees[write_idx], i);
-
-        R_PushCmd((struct rcmd){
-            .func = R_GL_TimestampForCookie,
-            .nargs = 2,
-            .args = {
-                &pe->begin.gpu_cookie,
-                &pe->begin.gpu_ts,
-            }
-        });
-        R_PushCmd((struct rcmd){
-            .func = R_GL_TimestampForCookie,
-            .nargs = 2,
-            .args = {
-                &pe->end.gpu_cookie,
-                &pe->end.gpu_ts,
-            }
-        });
+        khiter_t k = kh_get(pstate, s_thread_state_table, tid_to_key(g_main_thread_id));
+        int tid = (k != kh_end(s_thread_state_table)) ? kh_val(s_thread_state_table, k).trace_tid : 0;
+        trace_write_frame_marker(tid, s_frame_idx, trace_ts_us(perf_counter()));
     }
 }
 
@@ -383,22 +789,74 @@ void Perf_FinishTick(void)
 {
     ASSERT_IN_MAIN_THREAD();
 
+    if(s_capture.state == CAPTURE_ACTIVE || s_capture.state == CAPTURE_ENDING) {
+
+        capture_drain();
+
+        if(s_capture.nframes && ++s_capture.nframes_done == s_capture.nframes)
+            s_capture.state = CAPTURE_ENDING;
+        if(s_capture.state == CAPTURE_ENDING)
+            capture_finish();
+    }
+
     for(khiter_t k = kh_begin(s_thread_state_table); k != kh_end(s_thread_state_table); k++) {
 
         if(!kh_exist(s_thread_state_table, k))
             continue;
 
-        struct perf_state *curr = &kh_val(s_thread_state_table, k);
-        assert(vec_size(&curr->perf_stack) == 0);
-
-        curr->perf_tree_idx = (curr->perf_tree_idx + 1) % NFRAMES_LOGGED;
-        vec_perf_reset(&curr->perf_trees[curr->perf_tree_idx]);
+        if(pstate_renderer_owned(kh_key(s_thread_state_table, k)))
+            continue;
+        pstate_advance(&kh_val(s_thread_state_table, k));
     }
 
     uint32_t curr_time = SDL_GetTicks();
     uint32_t last_ts = s_last_frames_ms[s_last_idx];
     s_last_frames_ms[s_last_idx] = curr_time - last_ts;
     s_last_idx = (s_last_idx + 1) % NFRAMES_LOGGED;
+
+    counter_calibrate();
+#if defined(PERF_SAMPLING)
+    /* The render thread may still be inside an instrumented call */
+    if(g_perf_enabled != s_enable_pending) {
+        Engine_WaitRenderWorkDone();
+        g_perf_enabled = s_enable_pending;
+    }
+#endif
+
+    s_frame_idx++;
+    if(s_capture.state == CAPTURE_PENDING)
+        capture_start();
+}
+
+void Perf_FinishRenderTick(void)
+{
+    ASSERT_IN_RENDER_THREAD();
+
+    /* By now, the GPU is done with the calls issued 2 frames ago and their 
+     * timestamps can be read back without stalling */
+    struct perf_state *gpu_ps = gpu_state();
+    int resolve_idx = (gpu_ps->perf_tree_idx + NFRAMES_LOGGED - 2) % NFRAMES_LOGGED;
+    bool emit = (gpu_ps->ring && s_capture.gpu_ref_pc);
+
+    for(int i = 0; i < vec_size(&gpu_ps->perf_trees[resolve_idx]); i++) {
+
+        struct perf_entry *pe = &vec_AT(&gpu_ps->perf_trees[resolve_idx], i);
+        R_GL_TimestampForCookie(&pe->begin.gpu_cookie, &pe->begin.gpu_ts);
+        R_GL_TimestampForCookie(&pe->end.gpu_cookie, &pe->end.gpu_ts);
+
+        if(emit) {
+            trace_ring_push(gpu_ps->ring, (struct trace_event){
+                .begin_pc = pe->begin.gpu_ts,
+                .end_pc = pe->end.gpu_ts,
+                .name = name_for_id(gpu_ps, pe->name_id)
+            });
+        }
+    }
+
+    pstate_advance(gpu_ps);
+    struct perf_state *ps = curr_thread_state();
+    if(ps)
+        pstate_advance(ps);
 }
 
 size_t Perf_Report(size_t maxout, struct perf_info **out)
@@ -413,8 +871,11 @@ size_t Perf_Report(size_t maxout, struct perf_info **out)
         if(ret == maxout)
             break;
 
+        /* The render thread may be advancing its' own state concurrently, 
+         * so stay another frame clear of the slot that it resets next */
         struct perf_state *ps = &kh_val(s_thread_state_table, k);
-        int read_idx = (ps->perf_tree_idx + 1) % NFRAMES_LOGGED;
+        int lag = pstate_renderer_owned(kh_key(s_thread_state_table, k)) ? 2 : 1;
+        int read_idx = (ps->perf_tree_idx + lag) % NFRAMES_LOGGED;
         struct perf_info *info = malloc(sizeof(struct perf_info) + vec_size(&ps->perf_trees[read_idx]) * sizeof(info->entries[0]));
         if(!info)
             break;
@@ -432,7 +893,7 @@ size_t Perf_Report(size_t maxout, struct perf_info **out)
                 info->entries[i].pc_delta = delta;
                 info->entries[i].ms_delta = (delta * 1000.0 / hz);
             }else{
-                uint64_t hz = SDL_GetPerformanceFrequency();
+                uint64_t hz = s_counter_hz;
                 info->entries[i].pc_delta = entry->pc_delta;
                 info->entries[i].ms_delta = (entry->pc_delta * 1000.0 / hz);
             }
@@ -452,3 +913,71 @@ uint32_t Perf_LastFrameMS(void)
     return s_last_frames_ms[read_idx];
 }
 
+size_t Perf_PeakMemoryBytes(void)
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return 0;
+    return pmc.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if(0 != getrusage(RUSAGE_SELF, &usage))
+        return 0;
+    /* ru_maxrss is reported in kilobytes */
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+bool Perf_CaptureBegin(const char *path, unsigned nframes)
+{
+    ASSERT_IN_MAIN_THREAD();
+
+    if(s_capture.state != CAPTURE_OFF)
+        return false;
+
+    FILE *stream = fopen(path, "w");
+    if(!stream)
+        return false;
+
+    s_capture.stream = stream;
+    s_capture.nframes = nframes;
+    s_capture.state = CAPTURE_PENDING;
+    return true;
+}
+
+void Perf_CaptureEnd(void)
+{
+    ASSERT_IN_MAIN_THREAD();
+
+    switch(s_capture.state) {
+    case CAPTURE_PENDING:
+        fclose(s_capture.stream);
+        s_capture.stream = NULL;
+        s_capture.state = CAPTURE_OFF;
+        break;
+    case CAPTURE_ACTIVE:
+        s_capture.state = CAPTURE_ENDING;
+        break;
+    default:
+        break;
+    }
+}
+
+bool Perf_CaptureActive(void)
+{
+    return (s_capture.state != CAPTURE_OFF);
+}
+
+void Perf_SetSamplingEnabled(bool on)
+{
+#if defined(PERF_SAMPLING)
+    s_enable_pending = on;
+#endif
+}
+
+uint64_t Perf_Counter(void)
+{
+    return perf_counter();
+}
+
@@ -42,9 +42,9 @@
 
 #ifndef NDEBUG
 
-#define PERF_ENTER()            \
-    do{                         \
-        Perf_Push(__func__);    \
+#define PERF_ENTER()                \
+    do{                             \
+        Perf_PushStatic(__func__);  \
     }while(0)
 
 #define PERF_RETURN(...)        \
@@ -59,6 +59,37 @@
         return;                 \
     }while(0)
 
+#elif defined(PERF_SAMPLING)
+
+/* In profiling builds (release builds with PERF_SAMPLING defined) the 
+ * instrumentation is kept, but it only records anything while it is 
+ * turned on at runtime (via the 'pf.debug.perf_sampling' setting). The 
+ * flag is only ever flipped between frames, after the render thread has 
+ * caught up, when no thread is inside an instrumented function, so every 
+ * push is always matched by a pop.
+ */
+extern bool g_perf_enabled;
+
+#define PERF_ENTER()                    \
+    do{                                 \
+        if(g_perf_enabled)              \
+            Perf_PushStatic(__func__);  \
+    }while(0)
+
+#define PERF_RETURN(...)                \
+    do{                                 \
+        if(g_perf_enabled)              \
+            Perf_Pop();                 \
+        return (__VA_ARGS__);           \
+    }while(0)
+
+#define PERF_RETURN_VOID()              \
+    do{                                 \
+        if(g_perf_enabled)              \
+            Perf_Pop();                 \
+        return;                         \
+    }while(0)
+
 #else
 
 #define PERF_ENTER()
@@ -83,6 +114,9 @@ struct perf_info{
 };
 
 void     Perf_Push(const char *name);
+/* Same as Perf_Push, but the string must have static storage duration. 
+ * This allows skipping the string hashing. */
+void     Perf_PushStatic(const char *name);
 void     Perf_Pop(void);
 
 void     Perf_PushGPU(const char *name, uint32_t cookie);
@@ -100,6 +134,10 @@ void     Perf_PopGPU(uint32_t cookie);
  * must be 'free'd by the caller. */
 size_t   Perf_Report(size_t maxout, struct perf_info **out);
 uint32_t Perf_LastFrameMS(void);
+/* The peak resident set size of the process */
+size_t   Perf_PeakMemoryBytes(void);
+/* The timestamp source used for all the CPU timings */
+uint64_t Perf_Counter(void);
 
 /* The following can only be called from the main thread, making sure that 
  * none of the other threads are touching the Perf_ API concurrently */
@@ -108,6 +146,28 @@ void     Perf_Shutdown(void);
 bool     Perf_RegisterThread(SDL_threadID tid, const char *name);
 void     Perf_BeginTick(void);
 void     Perf_FinishTick(void);
+/* The render thread may run some frames behind the main thread. It marks 
+ * the end of its' own frames (for itself and the GPU timeline) with this. */
+void     Perf_FinishRenderTick(void);
+
+/* Begin streaming every Perf_ entry of all the registered threads (as well 
+ * as the GPU timestamps and frame markers) to the file at 'path', in the 
+ * Chrome trace event format. The resulting file can be opened in 
+ * chrome://tracing or in Perfetto. The capture starts at the next frame 
+ * boundary. If 'nframes' is non-zero, it is ended automatically after that 
+ * many frames. Otherwise it runs until Perf_CaptureEnd is called. Note that
+ * the GPU timings for the last couple of frames of a capture will not make
+ * it into the trace, as they are not yet available when it ends.
+ */
+bool     Perf_CaptureBegin(const char *path, unsigned nframes);
+/* The capture is ended and the file is closed at the end of the current frame */
+void     Perf_CaptureEnd(void);
+bool     Perf_CaptureActive(void);
+
+/* Turn the recording of the PERF_ENTER scopes on or off in profiling builds.
+ * The change takes effect at the start of the next frame. This is a no-op 
+ * in other builds. */
+void     Perf_SetSamplingEnabled(bool on);
 
 #endif
 
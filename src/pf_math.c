@@ -34,6 +34,7 @@
  */
 
 #include "pf_math.h"
+#include "pf_math_simd.h"
 #include <string.h>
 #include <assert.h>
 
@@ -223,22 +224,12 @@ void PFM_Mat4x4_Scale(mat4x4_t *op1, GLfloat scale, mat4x4_t *out)
 
 void PFM_Mat4x4_Mult4x4 (mat4x4_t *op1, mat4x4_t *op2, mat4x4_t *out)
 {
-    for(int r = 0; r < 4; r++) {
-        for(int c = 0; c < 4; c++) {
-            out->cols[c][r] = 0.0f;
-            for(int k = 0; k < 4; k++)
-                out->cols[c][r] += op1->cols[k][r] * op2->cols[c][k]; 
-        }
-    }
+    PFM_SIMD_Mat4x4_Mult4x4(op1, op2, out);
 }
 
 void PFM_Mat4x4_Mult4x1(mat4x4_t *op1, vec4_t *op2, vec4_t *out)
 {
-    for(int r = 0; r < 4; r++) {
-        out->raw[r] = 0.0f;
-        for(int c = 0; c < 4; c++)
-            out->raw[r] += op1->cols[c][r] * op2->raw[c];
-    }
+    PFM_SIMD_Mat4x4_Mult4x1(op1, op2, out);
 }
 
 void PFM_Mat4x4_Identity(mat4x4_t *out)
@@ -305,19 +296,7 @@ void PFM_Mat4x4_MakeRotZ(GLfloat radians, mat4x4_t *out)
  */
 void PFM_Mat4x4_RotFromQuat(const quat_t *quat, mat4x4_t *out)
 {
-    PFM_Mat4x4_Identity(out);
-
-    out->cols[0][0]  = 1 - 2*pow(quat->y, 2) - 2*pow(quat->z, 2);
-    out->cols[1][0] = 2*quat->x*quat->y + 2*quat->w*quat->z;
-    out->cols[2][0] = 2*quat->x*quat->z - 2*quat->w*quat->y;
-
-    out->cols[0][1] = 2*quat->x*quat->y - 2*quat->w*quat->z;
-    out->cols[1][1] = 1 - 2*pow(quat->x, 2) - 2*pow(quat->z, 2);
-    out->cols[2][1] = 2*quat->y*quat->z + 2*quat->w*quat->x;
-
-    out->cols[0][2] = 2*quat->x*quat->z + 2*quat->w*quat->y;
-    out->cols[1][2] = 2*quat->y*quat->z - 2*quat->w*quat->x;
-    out->cols[2][2] = 1 - 2*pow(quat->x, 2) - 2*pow(quat->y, 2);
+    PFM_SIMD_Mat4x4_RotFromQuat(quat, out);
 }
 
 void PFM_Mat4x4_RotFromEuler(GLfloat deg_x, GLfloat deg_y, GLfloat deg_z, mat4x4_t *out)
@@ -619,6 +598,43 @@ void PFM_Quat_Normal(quat_t *op1, quat_t *out)
     out->w = op1->w / len;
 }
 
+void PFM_Mat4x4_MakeSQTBatch(size_t n, const struct SQT *sqts, mat4x4_t *out)
+{
+    for(size_t i = 0; i < n; i++) {
+        PFM_SIMD_Mat4x4_MakeTRS(&sqts[i].trans, &sqts[i].quat_rotation, &sqts[i].scale, &out[i]);
+    }
+}
+
+void PFM_Mat4x4_Mult4x4Batch(const mat4x4_t *lhs, size_t n, const mat4x4_t *rhs, mat4x4_t *out)
+{
+#if defined(__SSE__)
+    __m128 a[4];
+    pfm_simd_load_cols(lhs, a);
+    for(size_t i = 0; i < n; i++) {
+        pfm_simd_mult4x4(a, &rhs[i], &out[i]);
+    }
+#else
+    for(size_t i = 0; i < n; i++) {
+        PFM_SIMD_Mat4x4_Mult4x4(lhs, &rhs[i], &out[i]);
+    }
+#endif
+}
+
+void PFM_Mat4x4_Mult4x1Batch(const mat4x4_t *lhs, size_t n, const vec4_t *rhs, vec4_t *out)
+{
+#if defined(__SSE__)
+    __m128 a[4];
+    pfm_simd_load_cols(lhs, a);
+    for(size_t i = 0; i < n; i++) {
+        pfm_simd_mult4x1(a, &rhs[i], &out[i]);
+    }
+#else
+    for(size_t i = 0; i < n; i++) {
+        PFM_SIMD_Mat4x4_Mult4x1(lhs, &rhs[i], &out[i]);
+    }
+#endif
+}
+
 GLfloat PFM_BilinearInterp(GLfloat q11, GLfloat q12, GLfloat q21, GLfloat q22,
                            GLfloat x1,  GLfloat x2,  GLfloat y1,  GLfloat y2,
                            GLfloat x,   GLfloat y)
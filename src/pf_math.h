@@ -38,6 +38,7 @@
 
 #include <GL/glew.h> /* GLfloat definition */
 #include <stdio.h>   /* FILE definition    */
+#include <stddef.h>  /* size_t definition  */
 #ifndef _USE_MATH_DEFINES
     #define _USE_MATH_DEFINES
 #endif
@@ -96,6 +97,13 @@ typedef union mat4x4{
     };
 }mat4x4_t;
 
+/* Scale, rotation and translation */
+struct SQT{
+    vec3_t scale;
+    quat_t quat_rotation;
+    vec3_t trans;
+};
+
 
 /*****************************************************************************/
 /* vec2                                                                      */
@@ -170,6 +178,17 @@ void    PFM_Mat4x4_MakeOrthographic(GLfloat left, GLfloat right,
 void    PFM_Mat4x4_MakeLookAt     (vec3_t *camera_pos, vec3_t *target_pos, 
                                    vec3_t *up_dir, mat4x4_t *out);
 
+/*****************************************************************************/
+/* mat4x4 batch                                                              */
+/*****************************************************************************/
+
+/* out[i] = T * R * S for every sqts[i] */
+void    PFM_Mat4x4_MakeSQTBatch (size_t n, const struct SQT *sqts, mat4x4_t *out);
+/* out[i] = lhs * rhs[i], i.e. a view-projection matrix applied to N model matrices */
+void    PFM_Mat4x4_Mult4x4Batch (const mat4x4_t *lhs, size_t n, const mat4x4_t *rhs, mat4x4_t *out);
+/* out[i] = lhs * rhs[i] */
+void    PFM_Mat4x4_Mult4x1Batch (const mat4x4_t *lhs, size_t n, const vec4_t *rhs, vec4_t *out);
+
 /*****************************************************************************/
 /* quat                                                                      */
 /*****************************************************************************/
@@ -0,0 +1,288 @@
+/*
+ *  This file is part of Permafrost Engine. 
+ *  Copyright (C) 2020 Eduard Permyakov 
+ *
+ *  Permafrost Engine is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Permafrost Engine is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ *  Linking this software statically or dynamically with other modules is making 
+ *  a combined work based on this software. Thus, the terms and conditions of 
+ *  the GNU General Public License cover the whole combination. 
+ *  
+ *  As a special exception, the copyright holders of Permafrost Engine give 
+ *  you permission to link Permafrost Engine with independent modules to produce 
+ *  an executable, regardless of the license terms of these independent 
+ *  modules, and to copy and distribute the resulting executable under 
+ *  terms of your choice, provided that you also meet, for each linked 
+ *  independent module, the terms and conditions of the license of that 
+ *  module. An independent module is a module which is not derived from 
+ *  or based on Permafrost Engine. If you modify Permafrost Engine, you may 
+ *  extend this exception to your version of Permafrost Engine, but you are not 
+ *  obliged to do so. If you do not wish to do so, delete this exception 
+ *  statement from your version.
+ *
+ */
+
+#ifndef PF_MATH_SIMD_H
+#define PF_MATH_SIMD_H
+
+/* Inlineable fast paths for the hottest of the 'pf_math' matrix routines. 
+ * The 'PFM_' functions of the same name and the batch routines are 
+ * out-of-line wrappers around these. Unless noted otherwise, the results 
+ * are bit-identical to the original scalar routines for finite inputs (up 
+ * to the sign of zero elements), so they are safe to use in the simulation.
+ *
+ * The SSE paths are selected at compile-time; targets without SSE fall 
+ * back to the plain scalar loops.
+ */
+
+#include "pf_math.h"
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+/*****************************************************************************/
+/* mat4x4                                                                    */
+/*****************************************************************************/
+
+#if defined(__SSE__)
+
+/* Multiplies the matrix with columns 'a' by 'op2', accumulating from zero 
+ * in the same order as the scalar loop. 
+ */
+static inline void pfm_simd_mult4x4(const __m128 a[4], const mat4x4_t *op2, mat4x4_t *out)
+{
+    __m128 res[4];
+    for(int c = 0; c < 4; c++) {
+        __m128 acc = _mm_setzero_ps();
+        acc = _mm_add_ps(acc, _mm_mul_ps(a[0], _mm_set1_ps(op2->cols[c][0])));
+        acc = _mm_add_ps(acc, _mm_mul_ps(a[1], _mm_set1_ps(op2->cols[c][1])));
+        acc = _mm_add_ps(acc, _mm_mul_ps(a[2], _mm_set1_ps(op2->cols[c][2])));
+        acc = _mm_add_ps(acc, _mm_mul_ps(a[3], _mm_set1_ps(op2->cols[c][3])));
+        res[c] = acc;
+    }
+    for(int c = 0; c < 4; c++)
+        _mm_storeu_ps(out->cols[c], res[c]);
+}
+
+static inline void pfm_simd_mult4x1(const __m128 a[4], const vec4_t *op2, vec4_t *out)
+{
+    __m128 acc = _mm_setzero_ps();
+    acc = _mm_add_ps(acc, _mm_mul_ps(a[0], _mm_set1_ps(op2->x)));
+    acc = _mm_add_ps(acc, _mm_mul_ps(a[1], _mm_set1_ps(op2->y)));
+    acc = _mm_add_ps(acc, _mm_mul_ps(a[2], _mm_set1_ps(op2->z)));
+    acc = _mm_add_ps(acc, _mm_mul_ps(a[3], _mm_set1_ps(op2->w)));
+    _mm_storeu_ps(out->raw, acc);
+}
+
+static inline void pfm_simd_load_cols(const mat4x4_t *in, __m128 out[4])
+{
+    for(int c = 0; c < 4; c++)
+        out[c] = _mm_loadu_ps(in->cols[c]);
+}
+
+#endif
+
+static inline void PFM_SIMD_Mat4x4_Mult4x4(const mat4x4_t *op1, const mat4x4_t *op2, mat4x4_t *out)
+{
+#if defined(__SSE__)
+    __m128 a[4];
+    pfm_simd_load_cols(op1, a);
+    pfm_simd_mult4x4(a, op2, out);
+#else
+    mat4x4_t res;
+    for(int r = 0; r < 4; r++) {
+        for(int c = 0; c < 4; c++) {
+            res.cols[c][r] = 0.0f;
+            for(int k = 0; k < 4; k++)
+                res.cols[c][r] += op1->cols[k][r] * op2->cols[c][k]; 
+        }
+    }
+    *out = res;
+#endif
+}
+
+static inline void PFM_SIMD_Mat4x4_Mult4x1(const mat4x4_t *op1, const vec4_t *op2, vec4_t *out)
+{
+#if defined(__SSE__)
+    __m128 a[4];
+    pfm_simd_load_cols(op1, a);
+    pfm_simd_mult4x1(a, op2, out);
+#else
+    vec4_t res;
+    for(int r = 0; r < 4; r++) {
+        res.raw[r] = 0.0f;
+        for(int c = 0; c < 4; c++)
+            res.raw[r] += op1->cols[c][r] * op2->raw[c];
+    }
+    *out = res;
+#endif
+}
+
+/* The upper-left 3x3 block is the rotation. The diagonal is evaluated in 
+ * double precision, exactly like the original 'pow'-based expressions. 
+ */
+static inline void PFM_SIMD_Mat4x4_RotFromQuat(const quat_t *quat, mat4x4_t *out)
+{
+    const double xx = (double)quat->x * quat->x;
+    const double yy = (double)quat->y * quat->y;
+    const double zz = (double)quat->z * quat->z;
+
+    const GLfloat xy = 2*quat->x*quat->y, wz = 2*quat->w*quat->z;
+    const GLfloat xz = 2*quat->x*quat->z, wy = 2*quat->w*quat->y;
+    const GLfloat yz = 2*quat->y*quat->z, wx = 2*quat->w*quat->x;
+
+    *out = (mat4x4_t){ .cols = {
+        {1 - 2*yy - 2*zz, xy - wz,         xz + wy,         0.0f},
+        {xy + wz,         1 - 2*xx - 2*zz, yz - wx,         0.0f},
+        {xz - wy,         yz + wx,         1 - 2*xx - 2*yy, 0.0f},
+        {0.0f,            0.0f,            0.0f,            1.0f},
+    }};
+}
+
+/* Equivalent to (T * R * S), as used for the joint transforms. 
+ */
+static inline void PFM_SIMD_Mat4x4_MakeTRS(const vec3_t *trans, const quat_t *rot, 
+                                           const vec3_t *scale, mat4x4_t *out)
+{
+    mat4x4_t r;
+    PFM_SIMD_Mat4x4_RotFromQuat(rot, &r);
+
+    for(int c = 0; c < 3; c++) {
+        for(int k = 0; k < 4; k++)
+            out->cols[c][k] = 0.0f + r.cols[c][k] * scale->raw[c];
+    }
+    out->cols[3][0] = trans->x;
+    out->cols[3][1] = trans->y;
+    out->cols[3][2] = trans->z;
+    out->cols[3][3] = 1.0f;
+}
+
+/* Equivalent to (T * S * R), as used for the entity model matrices. 
+ */
+static inline void PFM_SIMD_Mat4x4_MakeTSR(const vec3_t *trans, const quat_t *rot, 
+                                           const vec3_t *scale, mat4x4_t *out)
+{
+    mat4x4_t r;
+    PFM_SIMD_Mat4x4_RotFromQuat(rot, &r);
+
+    const GLfloat s[4] = {scale->x, scale->y, scale->z, 1.0f};
+    for(int c = 0; c < 3; c++) {
+        for(int k = 0; k < 4; k++)
+            out->cols[c][k] = 0.0f + r.cols[c][k] * s[k];
+    }
+    out->cols[3][0] = trans->x;
+    out->cols[3][1] = trans->y;
+    out->cols[3][2] = trans->z;
+    out->cols[3][3] = 1.0f;
+}
+
+#if defined(__SSE__)
+
+/* Computes the rows of the adjugate of 'in' (read as row-major, which 
+ * yields the adjugate of the transpose) by Laplace expansion over the 
+ * 2x2 minors of its' first and last two columns. Returns the determinant.
+ */
+static inline float pfm_simd_adjugate(const mat4x4_t *in, __m128 out[4])
+{
+    const __m128 l0 = _mm_loadu_ps(in->cols[0]);
+    const __m128 l1 = _mm_loadu_ps(in->cols[1]);
+    const __m128 l2 = _mm_loadu_ps(in->cols[2]);
+    const __m128 l3 = _mm_loadu_ps(in->cols[3]);
+
+    /* (s0, s1, s2, s3) and (c0, c1, c2, c3) */
+    const __m128 s03 = _mm_sub_ps(
+        _mm_mul_ps(_mm_shuffle_ps(l0, l0, _MM_SHUFFLE(1,0,0,0)), _mm_shuffle_ps(l1, l1, _MM_SHUFFLE(2,3,2,1))),
+        _mm_mul_ps(_mm_shuffle_ps(l1, l1, _MM_SHUFFLE(1,0,0,0)), _mm_shuffle_ps(l0, l0, _MM_SHUFFLE(2,3,2,1))));
+    const __m128 c03 = _mm_sub_ps(
+        _mm_mul_ps(_mm_shuffle_ps(l2, l2, _MM_SHUFFLE(1,0,0,0)), _mm_shuffle_ps(l3, l3, _MM_SHUFFLE(2,3,2,1))),
+        _mm_mul_ps(_mm_shuffle_ps(l3, l3, _MM_SHUFFLE(1,0,0,0)), _mm_shuffle_ps(l2, l2, _MM_SHUFFLE(2,3,2,1))));
+    /* (s4, s5, c4, c5) */
+    const __m128 s45c45 = _mm_sub_ps(
+        _mm_mul_ps(_mm_shuffle_ps(l0, l2, _MM_SHUFFLE(2,1,2,1)), _mm_shuffle_ps(l1, l3, _MM_SHUFFLE(3,3,3,3))),
+        _mm_mul_ps(_mm_shuffle_ps(l1, l3, _MM_SHUFFLE(2,1,2,1)), _mm_shuffle_ps(l0, l2, _MM_SHUFFLE(3,3,3,3))));
+
+    /* Pairs of the same minor of the last and first two columns */
+    const __m128 m5 = _mm_shuffle_ps(s45c45, s45c45, _MM_SHUFFLE(1,1,3,3));
+    const __m128 m4 = _mm_shuffle_ps(s45c45, s45c45, _MM_SHUFFLE(0,0,2,2));
+    const __m128 m3 = _mm_shuffle_ps(c03, s03, _MM_SHUFFLE(3,3,3,3));
+    const __m128 m2 = _mm_shuffle_ps(c03, s03, _MM_SHUFFLE(2,2,2,2));
+    const __m128 m1 = _mm_shuffle_ps(c03, s03, _MM_SHUFFLE(1,1,1,1));
+    const __m128 m0 = _mm_shuffle_ps(c03, s03, _MM_SHUFFLE(0,0,0,0));
+
+    /* The columns of the input with the rows in (1, 0, 3, 2) order */
+    __m128 t0 = l0, t1 = l1, t2 = l2, t3 = l3;
+    _MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+    const __m128 v0 = _mm_shuffle_ps(t0, t0, _MM_SHUFFLE(2,3,0,1));
+    const __m128 v1 = _mm_shuffle_ps(t1, t1, _MM_SHUFFLE(2,3,0,1));
+    const __m128 v2 = _mm_shuffle_ps(t2, t2, _MM_SHUFFLE(2,3,0,1));
+    const __m128 v3 = _mm_shuffle_ps(t3, t3, _MM_SHUFFLE(2,3,0,1));
+
+    const __m128 pos = _mm_setr_ps( 1.0f, -1.0f,  1.0f, -1.0f);
+    const __m128 neg = _mm_setr_ps(-1.0f,  1.0f, -1.0f,  1.0f);
+
+    out[0] = _mm_mul_ps(pos, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v1, m5), _mm_mul_ps(v2, m4)), _mm_mul_ps(v3, m3)));
+    out[1] = _mm_mul_ps(neg, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v0, m5), _mm_mul_ps(v2, m2)), _mm_mul_ps(v3, m1)));
+    out[2] = _mm_mul_ps(pos, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v0, m4), _mm_mul_ps(v1, m2)), _mm_mul_ps(v3, m0)));
+    out[3] = _mm_mul_ps(neg, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v0, m3), _mm_mul_ps(v1, m1)), _mm_mul_ps(v2, m0)));
+
+    float s[4], c[4], sc[4];
+    _mm_storeu_ps(s, s03);
+    _mm_storeu_ps(c, c03);
+    _mm_storeu_ps(sc, s45c45);
+    return s[0] * sc[3] - s[1] * sc[2] + s[2] * c[3] + s[3] * c[2] - sc[0] * c[1] + sc[1] * c[0];
+}
+
+#endif
+
+/* Single-precision inverse. Unlike 'PFM_Mat4x4_Inverse', which accumulates 
+ * the determinant in double precision, the result may differ from the exact 
+ * inverse in the last few bits. Intended for rendering.
+ */
+static inline void PFM_SIMD_Mat4x4_Inverse(const mat4x4_t *in, mat4x4_t *out)
+{
+#if defined(__SSE__)
+    __m128 adj[4];
+    const __m128 inv_det = _mm_set1_ps(1.0f / pfm_simd_adjugate(in, adj));
+    for(int i = 0; i < 4; i++)
+        _mm_storeu_ps(out->cols[i], _mm_mul_ps(adj[i], inv_det));
+#else
+    mat4x4_t tmp = *in;
+    PFM_Mat4x4_Inverse(&tmp, out);
+#endif
+}
+
+/* The transpose of the inverse of 'in', for transforming normals. 
+ * Same precision as 'PFM_SIMD_Mat4x4_Inverse'.
+ */
+static inline void PFM_SIMD_Mat4x4_Normal(const mat4x4_t *in, mat4x4_t *out)
+{
+#if defined(__SSE__)
+    __m128 adj[4];
+    const __m128 inv_det = _mm_set1_ps(1.0f / pfm_simd_adjugate(in, adj));
+    _MM_TRANSPOSE4_PS(adj[0], adj[1], adj[2], adj[3]);
+    for(int i = 0; i < 4; i++)
+        _mm_storeu_ps(out->cols[i], _mm_mul_ps(adj[i], inv_det));
+#else
+    mat4x4_t tmp = *in, inv;
+    PFM_Mat4x4_Inverse(&tmp, &inv);
+    for(int r = 0; r < 4; r++) {
+        for(int c = 0; c < 4; c++)
+            out->cols[c][r] = inv.cols[r][c];
+    }
+#endif
+}
+
+#endif
+
@@ -43,6 +43,7 @@
 #include "gl_perf.h"
 #include "gl_vertex.h"
 #include "gl_state.h"
+#include "gl_render.h"
 #include "render_private.h"
 #include "public/render.h"
 #include "../entity.h"
@@ -50,6 +51,9 @@
 #include "../lib/public/khash.h"
 #include "../map/public/tile.h"
 #include "../game/public/game.h"
+#include "../config.h"
+#include "../main.h"
+#include "../pf_math_simd.h"
 
 #include <inttypes.h>
 #include <assert.h>
@@ -68,9 +72,21 @@
 #define MAX_BATCHES         (256)
 #define MAX_INSTS           (16384)
 #define ARR_SIZE(a)         (sizeof(a)/sizeof(a[0]))
+#define MAX(a, b)           ((a) > (b) ? (a) : (b))
+#define MIN(a, b)           ((a) < (b) ? (a) : (b))
 
 #define CMD_RING_TUNIT      (GL_TEXTURE5)
 #define ATTR_RING_TUNIT     (GL_TEXTURE6)
+#define BAKED_ANIM_TUNIT    (GL_TEXTURE7)
+
+#define BAKED_ANIM_MIN_MATS (4096)
+
+#define TERRAIN_CMD_RING_SZ  (4 * 1024 * sizeof(struct GL_DEI_Cmd))
+#define TERRAIN_ATTR_RING_SZ (1024*1024)
+#define TERRAIN_DRAW_ID_LOC  (10)
+#define TERRAIN_SLOT_TILES   (TILES_PER_CHUNK_WIDTH * TILES_PER_CHUNK_HEIGHT)
+#define TERRAIN_SLOT_VERTS   (TERRAIN_SLOT_TILES * VERTS_PER_TILE + TERRAIN_LOD_MAX_MERGED_VERTS)
+#define TERRAIN_SLOT_INDICES (TERRAIN_NUM_LODS * TERRAIN_SLOT_TILES * INDICES_PER_TILE)
 
 #define GL_PERF_CALL(name, ...)     \
     do{                             \
@@ -130,6 +146,14 @@ struct GL_DAI_Cmd{
 	GLuint base_instance;
 };
 
+struct GL_DEI_Cmd{
+	GLuint count;
+	GLuint instance_count;
+	GLuint first_index;
+	GLint  base_vertex;
+	GLuint base_instance;
+};
+
 enum batch_type{
     BATCH_TYPE_ANIM,
     BATCH_TYPE_STAT,
@@ -166,13 +190,52 @@ struct gl_batch{
 
 KHASH_MAP_INIT_INT(batch, struct gl_batch*)
 
+/* The skinning matrices for every frame of every clip of all the loaded 
+ * animated models, exposed to the shaders as an RGBA32F buffer texture.
+ * Models are only ever appended. */
+struct baked_anim_buff{
+    GLuint VBO;
+    GLuint tex_buff;
+    size_t capacity; /* in matrices */
+    size_t used;     /* in matrices */
+};
+
+struct terrain_slot{
+    int  idx;
+    bool dirty; /* The chunk has been modified since it was last copied */
+};
+
+KHASH_MAP_INIT_INT(tslot, struct terrain_slot)
+
+/* The vertices and indices of all the terrain chunks of the map, copied
+ * into a single pair of buffers so that all the visible chunks can be 
+ * drawn with a single multi-draw call. Every chunk gets a fixed-size slot 
+ * in the buffers the first time that it is drawn. */
+struct terrain_batch{
+    GLuint           VBO;
+    GLuint           EBO;
+    /* For the terrain shaders */
+    GLuint           VAO;
+    /* For the depth pass - the draw ID is at the location expected by 
+     * the batched static mesh depth shader */
+    GLuint           VAO_depth;
+    size_t           nslots;
+    size_t           nused;
+    /* Maps the chunk's own VBO to its' slot */
+    khash_t(tslot)  *slot_map;
+    struct gl_ring  *cmd_ring;
+    struct gl_ring  *attr_ring;
+};
+
 /*****************************************************************************/
-/* STATIC FUNCTIONS                                                          */
+/* STATIC VARIABLES                                                          */
 /*****************************************************************************/
 
-static struct gl_batch *s_anim_batch;
-static khash_t(batch)  *s_chunk_batches;
-static GLuint           s_draw_id_vbo;
+static struct gl_batch       *s_anim_batch;
+static khash_t(batch)        *s_chunk_batches;
+static GLuint                 s_draw_id_vbo;
+static struct baked_anim_buff s_baked_anim;
+static struct terrain_batch  *s_terrain_batch;
 
 /*****************************************************************************/
 /* STATIC FUNCTIONS                                                          */
@@ -849,8 +912,24 @@ static void batch_push_stat_attrs_depth(struct gl_batch *batch, const struct ent
     R_GL_StateInstall(GL_U_ATTR_STRIDE, R_GL_Shader_GetCurrActive());
 }
 
+static bool batch_dcall_baked(struct draw_call_desc dcall, struct inst_group_desc *descs)
+{
+#if CONFIG_USE_BAKED_ANIM
+    for(int i = dcall.start_idx; i <= dcall.end_idx; i++) {
+
+        const struct render_private *priv = descs[i].render_private;
+        if(priv->anim_baked_base < 0)
+            return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
 static void batch_push_anim_attrs(struct gl_batch *batch, const struct ent_anim_rstate *ents,
-                                  struct draw_call_desc dcall, struct inst_group_desc *descs)
+                                  struct draw_call_desc dcall, struct inst_group_desc *descs, 
+                                  bool baked)
 {
     /* The per-instance static attributes have the follwing layout in the buffer:
      *
@@ -869,7 +948,18 @@ static void batch_push_anim_attrs(struct gl_batch *batch, const struct ent_anim_
      *  +--------------------------------------------------+
      *
      * In total, 3264 floats (13056 bytes) are pushed per instance.
+     *
+     * When the skinning matrices have been baked, the joint matrices are 
+     * replaced by a reference into the baked animation buffer:
+     *
+     *  +--------------------------------------------------+
+     *  | {float, float, float, float} (4 floats)          | (clip base, frame, 
+     *  +--------------------------------------------------+  num joints, unused)
+     *
+     * In total, 196 floats (784 bytes) are pushed per instance.
      */
+    const size_t inst_floats = baked ? 196 : 3264;
+
     size_t ninsts = 0;
     for(int i = dcall.start_idx; i <= dcall.end_idx; i++) {
 
@@ -885,11 +975,22 @@ static void batch_push_anim_attrs(struct gl_batch *batch, const struct ent_anim_
             }
             batch_ring_append_mats(batch, priv);
 
-            mat4x4_t model, normal;
-            PFM_Mat4x4_Inverse((mat4x4_t*)&ents[j].model, &model);
-            PFM_Mat4x4_Transpose(&model, &normal);
+            mat4x4_t normal;
+            PFM_SIMD_Mat4x4_Normal(&ents[j].model, &normal);
+
+            R_GL_RingbufferAppendLast(batch->attr_ring, &normal, sizeof(mat4x4_t));
 
-            R_GL_RingbufferAppendLast(batch->attr_ring, &ents[j].model, sizeof(mat4x4_t));
+            if(baked) {
+
+                GLfloat ref[4] = {
+                    priv->anim_baked_base + ents[j].baked_clip_base,
+                    ents[j].baked_frame,
+                    ents[j].njoints,
+                    0.0f
+                };
+                R_GL_RingbufferAppendLast(batch->attr_ring, ref, sizeof(ref));
+                continue;
+            }
 
             const size_t njoints = ents[j].njoints;
             const size_t matsize = njoints * sizeof(mat4x4_t);
@@ -905,14 +1006,71 @@ static void batch_push_anim_attrs(struct gl_batch *batch, const struct ent_anim_
     }
     size_t begin, end;
     R_GL_RingbufferGetLastRange(batch->attr_ring, &begin, &end);
-    assert(end > begin ? (end - begin == 13056 * ninsts)
-                       : ((ANIM_ATTR_RING_SZ - begin) + end == 13056 * ninsts));
+    assert(end > begin ? (end - begin == inst_floats * sizeof(GLfloat) * ninsts)
+                       : ((ANIM_ATTR_RING_SZ - begin) + end == inst_floats * sizeof(GLfloat) * ninsts));
 
     R_GL_StateSet(GL_U_ATTR_STRIDE, (struct uval){ 
         .type = UTYPE_INT, 
-        .val.as_int = 3264
+        .val.as_int = inst_floats
     });
     R_GL_StateInstall(GL_U_ATTR_STRIDE, R_GL_Shader_GetCurrActive());
+
+    R_GL_StateSet(GL_U_ANIM_BAKED, (struct uval){ 
+        .type = UTYPE_INT, 
+        .val.as_int = baked
+    });
+    R_GL_StateInstall(GL_U_ANIM_BAKED, R_GL_Shader_GetCurrActive());
+}
+
+static void batch_bind_baked_anim(GLuint shader_prog)
+{
+    glActiveTexture(BAKED_ANIM_TUNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, s_baked_anim.tex_buff);
+
+    R_GL_StateSet(GL_U_ANIM_BAKED_BUFF, (struct uval){
+        .type = UTYPE_INT,
+        .val.as_int = BAKED_ANIM_TUNIT - GL_TEXTURE0
+    });
+    R_GL_StateInstall(GL_U_ANIM_BAKED_BUFF, shader_prog);
+}
+
+static bool baked_anim_reserve(size_t nmats)
+{
+    if(s_baked_anim.used + nmats <= s_baked_anim.capacity)
+        return true;
+
+    size_t new_cap = MAX(s_baked_anim.capacity * 2, BAKED_ANIM_MIN_MATS);
+    while(new_cap < s_baked_anim.used + nmats)
+        new_cap *= 2;
+
+    GLint max_texels;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+    if(new_cap * 4 > max_texels) {
+        new_cap = max_texels / 4;
+        if(new_cap < s_baked_anim.used + nmats)
+            return false;
+    }
+
+    GLuint new_vbo;
+    glGenBuffers(1, &new_vbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_vbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_cap * sizeof(mat4x4_t), NULL, GL_STATIC_DRAW);
+
+    if(s_baked_anim.used) {
+        glBindBuffer(GL_COPY_READ_BUFFER, s_baked_anim.VBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, 
+            s_baked_anim.used * sizeof(mat4x4_t));
+    }
+    glDeleteBuffers(1, &s_baked_anim.VBO);
+
+    glBindTexture(GL_TEXTURE_BUFFER, s_baked_anim.tex_buff);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, new_vbo);
+
+    s_baked_anim.VBO = new_vbo;
+    s_baked_anim.capacity = new_cap;
+
+    GL_ASSERT_OK();
+    return true;
 }
 
 static void batch_push_cmds(struct gl_batch *batch, struct draw_call_desc dcall,
@@ -1036,9 +1194,14 @@ static void batch_do_drawcall_stat(struct gl_batch *batch, const struct ent_stat
 static void batch_do_drawcall_anim(struct gl_batch *batch, const struct ent_anim_rstate *ents,
                                    struct draw_call_desc dcall, struct inst_group_desc *descs)
 {
-    batch_push_anim_attrs(batch, ents, dcall, descs);
+    bool baked = batch_dcall_baked(dcall, descs);
+    batch_push_anim_attrs(batch, ents, dcall, descs, baked);
     R_GL_RingbufferBindLast(batch->attr_ring, ATTR_RING_TUNIT, R_GL_Shader_GetCurrActive(), "attrbuff");
 
+    if(baked) {
+        batch_bind_baked_anim(R_GL_Shader_GetCurrActive());
+    }
+
     GLuint VAO = batch->vbos[dcall.vbo_idx].VAO;
     glBindVertexArray(VAO);
 
@@ -1157,6 +1320,399 @@ static void batch_render_stat_all(vec_rstat_t *ents, bool shadows, enum render_p
     }
 }
 
+static void terrain_batch_init_vaos(struct terrain_batch *batch)
+{
+    size_t stride = sizeof(struct terrain_vert);
+
+    glGenVertexArrays(1, &batch->VAO);
+    glBindVertexArray(batch->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, batch->VBO);
+
+    /* Attribute 0 - position */
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    /* Attribute 1 - texture coordinates */
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, 
+        (void*)offsetof(struct terrain_vert, uv));
+    glEnableVertexAttribArray(1);
+
+    /* Attribute 2 - normal */
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, 
+        (void*)offsetof(struct terrain_vert, normal));
+    glEnableVertexAttribArray(2);
+
+    /* Attribute 3 - material index */
+    glVertexAttribIPointer(3, 1, GL_INT, stride, 
+        (void*)offsetof(struct terrain_vert, material_idx));
+    glEnableVertexAttribArray(3);
+
+    /* Attribute 4 - blend mode */
+    glVertexAttribIPointer(4, 1, GL_SHORT, stride, 
+        (void*)offsetof(struct terrain_vert, blend_mode));
+    glEnableVertexAttribArray(4);
+
+    /* Attribute 5 - middle indices */
+    glVertexAttribIPointer(5, 1, GL_SHORT, stride, 
+        (void*)offsetof(struct terrain_vert, middle_indices));
+    glEnableVertexAttribArray(5);
+
+    /* Attribute 6/7 - corner indices */
+    glVertexAttribIPointer(6, 2, GL_INT, stride, 
+        (void*)offsetof(struct terrain_vert, c1_indices));
+    glEnableVertexAttribArray(6);
+    glVertexAttribIPointer(7, 2, GL_INT, stride, 
+        (void*)offsetof(struct terrain_vert, c2_indices));
+    glEnableVertexAttribArray(7);
+
+    /* Attribute 8 - top and bottom edge indices */
+    glVertexAttribIPointer(8, 1, GL_INT, stride, 
+        (void*)offsetof(struct terrain_vert, tb_indices));
+    glEnableVertexAttribArray(8);
+
+    /* Attribute 9 - left and right edge indices */
+    glVertexAttribIPointer(9, 1, GL_INT, stride, 
+        (void*)offsetof(struct terrain_vert, lr_indices));
+    glEnableVertexAttribArray(9);
+
+    /* Attribute 10 - draw ID 
+     * This is a per-instance attribute that is sourced from the draw ID buffer */
+    glBindBuffer(GL_ARRAY_BUFFER, s_draw_id_vbo);
+    glVertexAttribIPointer(TERRAIN_DRAW_ID_LOC, 1, GL_INT, sizeof(GLint), 0);
+    glEnableVertexAttribArray(TERRAIN_DRAW_ID_LOC);
+    glVertexAttribDivisor(TERRAIN_DRAW_ID_LOC, 1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->EBO);
+
+    glGenVertexArrays(1, &batch->VAO_depth);
+    glBindVertexArray(batch->VAO_depth);
+    glBindBuffer(GL_ARRAY_BUFFER, batch->VBO);
+
+    /* Attribute 0 - position */
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    /* Attribute 4 - draw ID */
+    glBindBuffer(GL_ARRAY_BUFFER, s_draw_id_vbo);
+    glVertexAttribIPointer(4, 1, GL_INT, sizeof(GLint), 0);
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->EBO);
+    glBindVertexArray(0);
+}
+
+static struct terrain_batch *terrain_batch_init(size_t nslots)
+{
+    struct terrain_batch *batch = malloc(sizeof(struct terrain_batch));
+    if(!batch)
+        goto fail_alloc;
+
+    batch->cmd_ring = R_GL_RingbufferInit(TERRAIN_CMD_RING_SZ, RING_UBYTE);
+    if(!batch->cmd_ring)
+        goto fail_cmd_ring;
+
+    batch->attr_ring = R_GL_RingbufferInit(TERRAIN_ATTR_RING_SZ, RING_FLOAT);
+    if(!batch->attr_ring)
+        goto fail_attr_ring;
+
+    batch->slot_map = kh_init(tslot);
+    if(!batch->slot_map)
+        goto fail_slot_map;
+
+    GL_ASSERT_OK();
+
+    glGenBuffers(1, &batch->VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, batch->VBO);
+    glBufferData(GL_ARRAY_BUFFER, nslots * TERRAIN_SLOT_VERTS * sizeof(struct terrain_vert), 
+        NULL, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &batch->EBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, batch->EBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, nslots * TERRAIN_SLOT_INDICES * sizeof(GLushort), 
+        NULL, GL_DYNAMIC_DRAW);
+
+    if(glGetError() == GL_OUT_OF_MEMORY)
+        goto fail_buffs;
+
+    terrain_batch_init_vaos(batch);
+    batch->nslots = nslots;
+    batch->nused = 0;
+
+    GL_ASSERT_OK();
+    return batch;
+
+fail_buffs:
+    glDeleteBuffers(1, &batch->VBO);
+    glDeleteBuffers(1, &batch->EBO);
+    kh_destroy(tslot, batch->slot_map);
+fail_slot_map:
+    R_GL_RingbufferDestroy(batch->attr_ring);
+fail_attr_ring:
+    R_GL_RingbufferDestroy(batch->cmd_ring);
+fail_cmd_ring:
+    free(batch);
+fail_alloc:
+    return NULL;
+}
+
+static void terrain_batch_destroy(struct terrain_batch *batch)
+{
+    if(!batch)
+        return;
+
+    glDeleteVertexArrays(1, &batch->VAO);
+    glDeleteVertexArrays(1, &batch->VAO_depth);
+    glDeleteBuffers(1, &batch->VBO);
+    glDeleteBuffers(1, &batch->EBO);
+
+    kh_destroy(tslot, batch->slot_map);
+    R_GL_RingbufferDestroy(batch->attr_ring);
+    R_GL_RingbufferDestroy(batch->cmd_ring);
+    free(batch);
+}
+
+static size_t terrain_num_indices(const struct mesh *mesh)
+{
+    assert(mesh->num_lods > 0);
+    const int last = mesh->num_lods - 1;
+    return mesh->lods[last].offset + mesh->lods[last].count;
+}
+
+static void terrain_batch_copy(struct terrain_batch *batch, const struct mesh *mesh, int idx)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, mesh->VBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, batch->VBO);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 
+        idx * TERRAIN_SLOT_VERTS * sizeof(struct terrain_vert), 
+        mesh->num_verts * sizeof(struct terrain_vert));
+
+    glBindBuffer(GL_COPY_READ_BUFFER, mesh->EBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, batch->EBO);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 
+        idx * TERRAIN_SLOT_INDICES * sizeof(GLushort), 
+        terrain_num_indices(mesh) * sizeof(GLushort));
+
+    GL_ASSERT_OK();
+}
+
+/* Returns the index of the chunk's slot in the batch buffers, copying the 
+ * chunk's vertices and indices into the slot if they are not up-to-date. 
+ * Returns -1 if the chunk cannot be part of the batch. */
+static int terrain_batch_slot(struct terrain_batch *batch, const struct render_private *priv)
+{
+    const struct mesh *mesh = &priv->mesh;
+
+    khiter_t k = kh_get(tslot, batch->slot_map, mesh->VBO);
+    if(k != kh_end(batch->slot_map)) {
+
+        struct terrain_slot *slot = &kh_value(batch->slot_map, k);
+        if(slot->dirty) {
+            terrain_batch_copy(batch, mesh, slot->idx);
+            slot->dirty = false;
+        }
+        return slot->idx;
+    }
+
+    if(batch->nused == batch->nslots)
+        return -1;
+    if(!mesh->EBO || mesh->num_verts > TERRAIN_SLOT_VERTS)
+        return -1;
+    if(terrain_num_indices(mesh) > TERRAIN_SLOT_INDICES)
+        return -1;
+
+    int status;
+    k = kh_put(tslot, batch->slot_map, mesh->VBO, &status);
+    if(status == -1)
+        return -1;
+
+    int idx = batch->nused++;
+    kh_value(batch->slot_map, k) = (struct terrain_slot){idx, false};
+    terrain_batch_copy(batch, mesh, idx);
+    return idx;
+}
+
+static void terrain_batch_push_attrs(struct terrain_batch *batch, const mat4x4_t *models, size_t nchunks)
+{
+    /* The per-chunk attributes have the following layout in the buffer:
+     *
+     *  +--------------------------------------------------+ <-- base
+     *  | mat4x4_t (16 floats)                             | (model matrix)
+     *  +--------------------------------------------------+
+     *
+     * In total, 16 floats (64 bytes) are pushed per chunk.
+     */
+    R_GL_RingbufferPush(batch->attr_ring, models, nchunks * sizeof(mat4x4_t));
+
+    R_GL_StateSet(GL_U_ATTR_STRIDE, (struct uval){ 
+        .type = UTYPE_INT, 
+        .val.as_int = 16
+    });
+    R_GL_StateInstall(GL_U_ATTR_STRIDE, R_GL_Shader_GetCurrActive());
+}
+
+static GLuint terrain_first_index(const struct mesh *mesh, int slot, int lod)
+{
+    return slot * TERRAIN_SLOT_INDICES + mesh->lods[lod].offset;
+}
+
+static void terrain_batch_multidraw_legacy(struct terrain_batch *batch, void **chunk_rprivates, 
+                                           const int *slots, const int *lods, size_t nchunks)
+{
+    for(int i = 0; i < nchunks; i++) {
+
+        const struct render_private *priv = chunk_rprivates[i];
+
+        R_GL_StateSet(GL_U_ATTR_OFFSET, (struct uval){ 
+            .type = UTYPE_INT, 
+            .val.as_int = i
+        });
+        R_GL_StateInstall(GL_U_ATTR_OFFSET, R_GL_Shader_GetCurrActive());
+
+        GLuint first = terrain_first_index(&priv->mesh, slots[i], lods[i]);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, priv->mesh.lods[lods[i]].count, 
+            GL_UNSIGNED_SHORT, (void*)(first * sizeof(GLushort)), 1, slots[i] * TERRAIN_SLOT_VERTS);
+    }
+}
+
+static void terrain_batch_multidraw(struct terrain_batch *batch, void **chunk_rprivates, 
+                                    const int *slots, const int *lods, size_t nchunks)
+{
+    R_GL_StateSet(GL_U_ATTR_OFFSET, (struct uval){ 
+        .type = UTYPE_INT, 
+        .val.as_int = 0
+    });
+    R_GL_StateInstall(GL_U_ATTR_OFFSET, R_GL_Shader_GetCurrActive());
+
+    for(int i = 0; i < nchunks; i++) {
+
+        const struct render_private *priv = chunk_rprivates[i];
+        struct GL_DEI_Cmd cmd = (struct GL_DEI_Cmd){
+            .count = priv->mesh.lods[lods[i]].count,
+            .instance_count = 1,
+            .first_index = terrain_first_index(&priv->mesh, slots[i], lods[i]),
+            .base_vertex = slots[i] * TERRAIN_SLOT_VERTS,
+            .base_instance = i,
+        };
+
+        if(i == 0) {
+            R_GL_RingbufferPush(batch->cmd_ring, &cmd, sizeof(struct GL_DEI_Cmd));
+        }else{
+            R_GL_RingbufferAppendLast(batch->cmd_ring, &cmd, sizeof(struct GL_DEI_Cmd));
+        }
+    }
+
+    GLuint cmd_vbo = R_GL_RingbufferGetVBO(batch->cmd_ring);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, cmd_vbo);
+
+    size_t cmd_begin, cmd_end;
+    R_GL_RingbufferGetLastRange(batch->cmd_ring, &cmd_begin, &cmd_end);
+
+    if(cmd_end < cmd_begin) {
+
+        assert((TERRAIN_CMD_RING_SZ - cmd_begin) % sizeof(struct GL_DEI_Cmd) == 0);
+        size_t ncmds_end = (TERRAIN_CMD_RING_SZ - cmd_begin) / sizeof(struct GL_DEI_Cmd);
+        GL_PERF_CALL("multidraw", glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, 
+            (void*)cmd_begin, ncmds_end, 0));
+
+        assert(cmd_end % sizeof(struct GL_DEI_Cmd) == 0);
+        size_t ncmds_begin = cmd_end / sizeof(struct GL_DEI_Cmd);
+        GL_PERF_CALL("multidraw", glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, 
+            (void*)0, ncmds_begin, 0));
+    }else{
+        GL_PERF_CALL("multidraw", glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, 
+            (void*)cmd_begin, nchunks, 0));
+    }
+
+    R_GL_RingbufferSyncLast(batch->cmd_ring);
+}
+
+static void terrain_draw_unbatched(void *chunk_rprivate, mat4x4_t *model, int *lod, 
+                                   enum render_pass pass)
+{
+    switch(pass) {
+    case RENDER_PASS_DEPTH:
+        R_GL_RenderDepthMapLOD(chunk_rprivate, model, lod);
+        break;
+    case RENDER_PASS_REGULAR:
+        R_GL_DrawLOD(chunk_rprivate, model, lod);
+        break;
+    default: assert(0);
+    }
+}
+
+static void terrain_batch_render(struct terrain_batch *batch, void **chunk_rprivates, 
+                                 mat4x4_t *models, int *lods, size_t nchunks, 
+                                 bool shadows, enum render_pass pass)
+{
+    /* Chunks that don't fit in the batch are drawn one by one after the rest */
+    void    *batched[nchunks];
+    mat4x4_t batched_models[nchunks];
+    int      batched_lods[nchunks];
+    int      slots[nchunks];
+    size_t   nbatched = 0;
+
+    void    *unbatched[nchunks];
+    size_t   unbatched_idx[nchunks];
+    size_t   nunbatched = 0;
+
+    for(int i = 0; i < nchunks; i++) {
+
+        struct render_private *priv = chunk_rprivates[i];
+        int slot = batch ? terrain_batch_slot(batch, priv) : -1;
+
+        if(slot < 0) {
+            unbatched[nunbatched] = priv;
+            unbatched_idx[nunbatched++] = i;
+            continue;
+        }
+
+        batched[nbatched] = priv;
+        batched_models[nbatched] = models[i];
+        batched_lods[nbatched] = MIN(MAX(lods[i], 0), (int)priv->mesh.num_lods - 1);
+        slots[nbatched] = slot;
+        nbatched++;
+    }
+
+    if(nbatched > 0) {
+
+        GLuint shader_prog = 0;
+        switch(pass) {
+        case RENDER_PASS_DEPTH:
+            shader_prog = R_GL_Shader_GetProgForName("batched.mesh.static.depth");
+            R_GL_Shader_InstallProg(shader_prog);
+            glBindVertexArray(batch->VAO_depth);
+            break;
+        case RENDER_PASS_REGULAR:
+            shader_prog = R_GL_Shader_GetProgForName(shadows ? "batched.terrain-shadowed" 
+                                                             : "batched.terrain");
+            R_GL_Shader_InstallProg(shader_prog);
+            R_GL_MapBind(shader_prog);
+            R_GL_ShadowMapBind();
+            glBindVertexArray(batch->VAO);
+            break;
+        default: assert(0);
+        }
+
+        terrain_batch_push_attrs(batch, batched_models, nbatched);
+        R_GL_RingbufferBindLast(batch->attr_ring, ATTR_RING_TUNIT, shader_prog, "attrbuff");
+
+        if(!GLEW_ARB_multi_draw_indirect) {
+            terrain_batch_multidraw_legacy(batch, batched, slots, batched_lods, nbatched);
+        }else{
+            terrain_batch_multidraw(batch, batched, slots, batched_lods, nbatched);
+        }
+
+        R_GL_RingbufferSyncLast(batch->attr_ring);
+        glBindVertexArray(0);
+    }
+
+    for(int i = 0; i < nunbatched; i++) {
+        size_t idx = unbatched_idx[i];
+        terrain_draw_unbatched(unbatched[i], &models[idx], &lods[idx], pass);
+    }
+}
+
 /*****************************************************************************/
 /* EXTERN FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -1178,6 +1734,9 @@ bool R_GL_Batch_Init(void)
     glBindBuffer(GL_ARRAY_BUFFER, s_draw_id_vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(draw_id_buff), draw_id_buff, GL_STATIC_DRAW);
 
+    memset(&s_baked_anim, 0, sizeof(s_baked_anim));
+    glGenTextures(1, &s_baked_anim.tex_buff);
+
     return true;
 
 fail_chunk_batches:
@@ -1198,7 +1757,35 @@ void R_GL_Batch_Shutdown(void)
         batch_destroy(curr);
     });
     kh_destroy(batch, s_chunk_batches);
+    terrain_batch_destroy(s_terrain_batch);
+    s_terrain_batch = NULL;
     glDeleteBuffers(1, &s_draw_id_vbo);
+
+    glDeleteBuffers(1, &s_baked_anim.VBO);
+    glDeleteTextures(1, &s_baked_anim.tex_buff);
+    memset(&s_baked_anim, 0, sizeof(s_baked_anim));
+}
+
+void R_GL_Batch_BakeSkinMats(void *render_private, const mat4x4_t *mats, const size_t *nmats)
+{
+    GL_PERF_ENTER();
+    ASSERT_IN_RENDER_THREAD();
+
+    struct render_private *priv = render_private;
+    priv->anim_baked_base = -1;
+
+    if(!baked_anim_reserve(*nmats))
+        GL_PERF_RETURN_VOID();
+
+    glBindBuffer(GL_TEXTURE_BUFFER, s_baked_anim.VBO);
+    glBufferSubData(GL_TEXTURE_BUFFER, s_baked_anim.used * sizeof(mat4x4_t), 
+        *nmats * sizeof(mat4x4_t), mats);
+
+    priv->anim_baked_base = s_baked_anim.used;
+    s_baked_anim.used += *nmats;
+
+    GL_ASSERT_OK();
+    GL_PERF_RETURN_VOID();
 }
 
 void R_GL_Batch_Draw(struct render_input *in)
@@ -1234,6 +1821,9 @@ void R_GL_Batch_Reset(void)
 
     batch_destroy(s_anim_batch);
     s_anim_batch = batch_init(BATCH_TYPE_ANIM);
+
+    terrain_batch_destroy(s_terrain_batch);
+    s_terrain_batch = NULL;
 }
 
 void R_GL_Batch_AllocChunks(struct map_resolution *res)
@@ -1254,6 +1844,38 @@ void R_GL_Batch_AllocChunks(struct map_resolution *res)
         }
     }}
 
+    if(CONFIG_USE_BATCH_RENDERING && CONFIG_USE_BATCH_TERRAIN) {
+        terrain_batch_destroy(s_terrain_batch);
+        s_terrain_batch = terrain_batch_init(res->chunk_w * res->chunk_h);
+    }
+
     GL_PERF_RETURN_VOID();
 }
 
+void R_GL_Batch_DrawMap(void **chunk_rprivates, mat4x4_t *models, int *lods, 
+                        const size_t *nchunks, const bool *shadows, const enum render_pass *pass)
+{
+    GL_PERF_ENTER();
+    ASSERT_IN_RENDER_THREAD();
+
+    if(*nchunks > 0) {
+        terrain_batch_render(s_terrain_batch, chunk_rprivates, models, lods, *nchunks, *shadows, *pass);
+    }
+
+    GL_ASSERT_OK();
+    GL_PERF_RETURN_VOID();
+}
+
+void R_GL_Batch_InvalidateChunk(const void *chunk_rprivate)
+{
+    if(!s_terrain_batch)
+        return;
+
+    const struct render_private *priv = chunk_rprivate;
+    khiter_t k = kh_get(tslot, s_terrain_batch->slot_map, priv->mesh.VBO);
+    if(k == kh_end(s_terrain_batch->slot_map))
+        return;
+
+    kh_value(s_terrain_batch->slot_map, k).dirty = true;
+}
+
@@ -42,6 +42,9 @@ struct render_input;
 
 bool R_GL_Batch_Init(void);
 void R_GL_Batch_Shutdown(void);
+/* Must be called whenever the vertices or indices of a terrain chunk are 
+ * modified, so that its' copy in the terrain batch is refreshed. */
+void R_GL_Batch_InvalidateChunk(const void *chunk_rprivate);
 
 #endif
 
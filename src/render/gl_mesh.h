@@ -40,10 +40,22 @@
 
 struct vertex;
 
+#define MESH_MAX_LODS (3)
+
 struct mesh{
     unsigned num_verts;
     GLuint   VBO;
     GLuint   VAO;
+    /* Optional index buffer (of GLushort indices). When present, the 
+     * mesh is drawn from the index range of the requested level of 
+     * detail instead of from 'num_verts' consecutive vertices. The 
+     * ranges for all the levels are kept back-to-back in the buffer. */
+    GLuint   EBO;
+    unsigned num_lods;
+    struct{
+        unsigned offset;
+        unsigned count;
+    }lods[MESH_MAX_LODS];
 };
 
 #endif
@@ -69,7 +69,7 @@ extern bool g_trace_gpu;
 
 #define GL_PERF_ENTER()                         \
     do{                                         \
-        Perf_Push(__func__);                    \
+        Perf_PushStatic(__func__);              \
         GL_GPU_PERF_PUSH(__func__);             \
     }while(0)
 
@@ -87,6 +87,15 @@ extern bool g_trace_gpu;
         return;                                 \
     }while(0)
 
+#elif defined(PERF_SAMPLING)
+
+#define GL_GPU_PERF_PUSH(name)
+#define GL_GPU_PERF_POP()
+
+#define GL_PERF_ENTER()             PERF_ENTER()
+#define GL_PERF_RETURN(...)         PERF_RETURN(__VA_ARGS__)
+#define GL_PERF_RETURN_VOID(...)    PERF_RETURN_VOID()
+
 #else
 
 #define GL_GPU_PERF_PUSH(name)
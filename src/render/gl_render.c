@@ -63,6 +63,7 @@
 #define EPSILON                     (1.0f/1024)
 #define ARR_SIZE(a)                 (sizeof(a)/sizeof(a[0]))
 #define MAX(a, b)                   ((a) > (b) ? (a) : (b))
+#define MIN(a, b)                   ((a) < (b) ? (a) : (b))
 
 /*****************************************************************************/
 /* EXTERN FUNCTIONS                                                          */
@@ -74,6 +75,9 @@ void R_GL_Init(struct render_private *priv, const char *shader, const struct ver
     ASSERT_IN_RENDER_THREAD();
     struct mesh *mesh = &priv->mesh;
 
+    mesh->num_lods = 0;
+    mesh->EBO = 0;
+
     glGenVertexArrays(1, &mesh->VAO);
     glBindVertexArray(mesh->VAO);
 
@@ -171,7 +175,28 @@ void R_GL_Init(struct render_private *priv, const char *shader, const struct ver
     GL_PERF_RETURN_VOID();
 }
 
+void R_GL_MeshDraw(const struct mesh *mesh, int lod)
+{
+    ASSERT_IN_RENDER_THREAD();
+
+    glBindVertexArray(mesh->VAO);
+    if(mesh->EBO) {
+        assert(mesh->num_lods > 0);
+        lod = MIN(MAX(lod, 0), (int)mesh->num_lods - 1);
+        glDrawElements(GL_TRIANGLES, mesh->lods[lod].count, GL_UNSIGNED_SHORT, 
+            (void*)(mesh->lods[lod].offset * sizeof(GLushort)));
+    }else{
+        glDrawArrays(GL_TRIANGLES, 0, mesh->num_verts);
+    }
+}
+
 void R_GL_Draw(const void *render_private, mat4x4_t *model)
+{
+    const int lod = 0;
+    R_GL_DrawLOD(render_private, model, &lod);
+}
+
+void R_GL_DrawLOD(const void *render_private, mat4x4_t *model, const int *lod)
 {
     GL_PERF_ENTER();
     ASSERT_IN_RENDER_THREAD();
@@ -196,8 +221,7 @@ void R_GL_Draw(const void *render_private, mat4x4_t *model)
     }
     R_GL_ShadowMapBind();
     
-    glBindVertexArray(priv->mesh.VAO);
-    glDrawArrays(GL_TRIANGLES, 0, priv->mesh.num_verts);
+    R_GL_MeshDraw(&priv->mesh, *lod);
 
     GL_ASSERT_OK();
     GL_PERF_RETURN_VOID();
@@ -733,8 +757,7 @@ void R_GL_DrawNormals(const void *render_private, mat4x4_t *model, const bool *a
                                        : "mesh.static.normals.colored";
     R_GL_Shader_Install(normals_shader);
 
-    glBindVertexArray(priv->mesh.VAO);
-    glDrawArrays(GL_TRIANGLES, 0, priv->mesh.num_verts);
+    R_GL_MeshDraw(&priv->mesh, 0);
 
     GL_ASSERT_OK();
     GL_PERF_RETURN_VOID();
@@ -1356,3 +1379,11 @@ void R_GL_TimestampForCookie(uint32_t *cookie, uint64_t *out)
     glDeleteQueries(1, &timer_query);
 }
 
+void R_GL_TimestampCalibrate(uint64_t *out_gpu_ns, uint64_t *out_cpu_pc)
+{
+    GLint64 gpu_ts;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_ts);
+    *out_cpu_pc = Perf_Counter();
+    *out_gpu_ns = gpu_ts;
+}
+
@@ -52,11 +52,14 @@ struct render_private;
 struct vertex;
 struct tile;
 struct tile_desc;
+struct tile_chunk_lods;
 struct map;
+struct mesh;
 
 /* General */
 
 void   R_GL_Init(struct render_private *priv, const char *shader, const struct vertex *vbuff);
+void   R_GL_MeshDraw(const struct mesh *mesh, int lod);
 void   R_GL_GlobalConfig(void);
 void   R_GL_SetViewport(int *x, int *y, int *w, int *h);
 
@@ -72,8 +75,10 @@ void   R_GL_ShadowMapBind(void);
 void   R_GL_SetClipPlane(vec4_t plane_eq);
 
 /* Terrain */
+void   R_GL_MapBind(GLuint shader_prog);
 void   R_GL_MapFogBindLast(GLuint tunit, GLuint shader_prog, const char *uname);
 void   R_GL_MapUpdateFogClear(void);
+void   R_GL_TileChunkInitLODs(void *chunk_rprivate, const struct tile_chunk_lods *lods, const GLushort *ibuff);
 
 
 #endif
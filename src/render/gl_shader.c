@@ -253,6 +253,60 @@ static struct shader s_shaders[] = {
             {0}
         },
     },
+    {
+        .prog_id     = (intptr_t)NULL,
+        .name        = "batched.terrain",
+        .vertex_path = "shaders/vertex/terrain-batched.glsl",
+        .geo_path    = NULL,
+        .frag_path   = "shaders/fragment/terrain.glsl",
+        .uniforms    = (struct uniform[]){
+            { UTYPE_MAT4,      GL_U_VIEW              },
+            { UTYPE_MAT4,      GL_U_PROJECTION        },
+            { UTYPE_VEC4,      GL_U_CLIP_PLANE0       },
+            { UTYPE_VEC3,      GL_U_AMBIENT_COLOR     },
+            { UTYPE_VEC3,      GL_U_LIGHT_COLOR       },
+            { UTYPE_VEC3,      GL_U_LIGHT_POS         },
+            { UTYPE_VEC3,      GL_U_VIEW_POS          },
+            { UTYPE_INT,       GL_U_TEX_ARRAY0        },
+            { UTYPE_INT,       "visbuff",             },
+            { UTYPE_INT,       "visbuff_offset",      },
+            { UTYPE_IVEC4,     GL_U_MAP_RES,          },
+            { UTYPE_VEC2,      GL_U_MAP_POS,          },
+            { UTYPE_INT,       "attrbuff"             },
+            { UTYPE_INT,       "attrbuff_offset"      },
+            { UTYPE_INT,       GL_U_ATTR_STRIDE       },
+            { UTYPE_INT,       GL_U_ATTR_OFFSET       },
+            {0}
+        },
+    },
+    {
+        .prog_id     = (intptr_t)NULL,
+        .name        = "batched.terrain-shadowed",
+        .vertex_path = "shaders/vertex/terrain-shadowed-batched.glsl",
+        .geo_path    = NULL,
+        .frag_path   = "shaders/fragment/terrain-shadowed.glsl",
+        .uniforms    = (struct uniform[]){
+            { UTYPE_MAT4,      GL_U_VIEW              },
+            { UTYPE_MAT4,      GL_U_PROJECTION        },
+            { UTYPE_VEC4,      GL_U_CLIP_PLANE0       },
+            { UTYPE_MAT4,      GL_U_LS_TRANS          },
+            { UTYPE_VEC3,      GL_U_AMBIENT_COLOR     },
+            { UTYPE_VEC3,      GL_U_LIGHT_COLOR       },
+            { UTYPE_VEC3,      GL_U_LIGHT_POS         },
+            { UTYPE_VEC3,      GL_U_VIEW_POS          },
+            { UTYPE_INT,       GL_U_TEX_ARRAY0        },
+            { UTYPE_INT,       "visbuff",             },
+            { UTYPE_INT,       "visbuff_offset",      },
+            { UTYPE_IVEC4,     GL_U_MAP_RES,          },
+            { UTYPE_VEC2,      GL_U_MAP_POS,          },
+            { UTYPE_INT,       GL_U_SHADOW_MAP        },
+            { UTYPE_INT,       "attrbuff"             },
+            { UTYPE_INT,       "attrbuff_offset"      },
+            { UTYPE_INT,       GL_U_ATTR_STRIDE       },
+            { UTYPE_INT,       GL_U_ATTR_OFFSET       },
+            {0}
+        },
+    },
     {
         .prog_id     = (intptr_t)NULL,
         .name        = "mesh.static.depth",
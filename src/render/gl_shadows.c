@@ -195,6 +195,12 @@ void R_GL_DepthPassEnd(void)
 }
 
 void R_GL_RenderDepthMap(const void *render_private, mat4x4_t *model)
+{
+    const int lod = 0;
+    R_GL_RenderDepthMapLOD(render_private, model, &lod);
+}
+
+void R_GL_RenderDepthMapLOD(const void *render_private, mat4x4_t *model, const int *lod)
 {
     GL_PERF_ENTER();
     ASSERT_IN_RENDER_THREAD();
@@ -208,8 +214,7 @@ void R_GL_RenderDepthMap(const void *render_private, mat4x4_t *model)
     const struct render_private *priv = render_private;
     R_GL_Shader_InstallProg(priv->shader_prog_dp);
 
-    glBindVertexArray(priv->mesh.VAO);
-    glDrawArrays(GL_TRIANGLES, 0, priv->mesh.num_verts);
+    R_GL_MeshDraw(&priv->mesh, *lod);
 
     GL_ASSERT_OK();
     GL_PERF_RETURN_VOID();
@@ -90,6 +90,8 @@
 #define GL_U_MAP_POS            "map_pos"
 #define GL_U_ATTR_STRIDE        "attr_stride"
 #define GL_U_ATTR_OFFSET        "attr_offset"
+#define GL_U_ANIM_BAKED         "anim_baked"
+#define GL_U_ANIM_BAKED_BUFF    "anim_baked_buff"
 
 enum utype{
     UTYPE_FLOAT,
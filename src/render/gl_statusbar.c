@@ -68,18 +68,20 @@ void R_GL_DrawHealthbars(const size_t *num_ents, GLfloat *ent_health_pc,
     /* Convert the worldspace positions to SDL screenspace positions */
     vec2_t ent_top_pos_ss[*num_ents]; /* Screen-space XY positions of the entity tops. */
 
-    mat4x4_t view, proj;
+    mat4x4_t view, proj, view_proj;
     Camera_MakeViewMat(cam, &view); 
     Camera_MakeProjMat(cam, &proj);
+    PFM_Mat4x4_Mult4x4(&proj, &view, &view_proj);
 
+    vec4_t ent_top_homo[*num_ents], clip[*num_ents];
     for(int i = 0; i < *num_ents; i++) {
-    
-        vec4_t ent_top_homo = (vec4_t){ent_top_pos_ws[i].x, ent_top_pos_ws[i].y, ent_top_pos_ws[i].z, 1.0f};
+        ent_top_homo[i] = (vec4_t){ent_top_pos_ws[i].x, ent_top_pos_ws[i].y, ent_top_pos_ws[i].z, 1.0f};
+    }
+    PFM_Mat4x4_Mult4x1Batch(&view_proj, *num_ents, ent_top_homo, clip);
 
-        vec4_t clip, tmp;
-        PFM_Mat4x4_Mult4x1(&view, &ent_top_homo, &tmp);
-        PFM_Mat4x4_Mult4x1(&proj, &tmp, &clip);
-        vec3_t ndc = (vec3_t){clip.x / clip.w, clip.y / clip.w, clip.z / clip.w};
+    for(int i = 0; i < *num_ents; i++) {
+    
+        vec3_t ndc = (vec3_t){clip[i].x / clip[i].w, clip[i].y / clip[i].w, clip[i].z / clip[i].w};
 
         float screen_x = (ndc.x + 1.0f) * width/2.0f;
         float screen_y = height - ((ndc.y + 1.0f) * height/2.0f);
@@ -127,9 +127,7 @@ void R_GL_MapBegin(const bool *shadows, const vec2_t *pos)
     }
     assert(shader_prog != -1);
     R_GL_Shader_InstallProg(shader_prog);
-
-    R_GL_Texture_BindArray(&s_map_textures, shader_prog);
-    R_GL_RingbufferBindLast(s_fog_ring, GL_TEXTURE1, shader_prog, "visbuff");
+    R_GL_MapBind(shader_prog);
 
 	R_GL_StateSet(GL_U_MAP_POS, (struct uval){
         .type = UTYPE_VEC2,
@@ -158,6 +156,12 @@ void R_GL_MapInvalidate(void)
     GL_PERF_RETURN_VOID();
 }
 
+void R_GL_MapBind(GLuint shader_prog)
+{
+    R_GL_Texture_BindArray(&s_map_textures, shader_prog);
+    R_GL_RingbufferBindLast(s_fog_ring, GL_TEXTURE1, shader_prog, "visbuff");
+}
+
 void R_GL_MapFogBindLast(GLuint tunit, GLuint shader_prog, const char *uname)
 {
     R_GL_RingbufferBindLast(s_fog_ring, tunit, shader_prog, uname);
@@ -42,6 +42,7 @@
 #include "gl_assert.h"
 #include "gl_state.h"
 #include "gl_perf.h"
+#include "gl_batch.h"
 #include "public/render.h"
 #include "../map/public/tile.h"
 #include "../map/public/map.h"
@@ -55,13 +56,23 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
   
 
 #define ARR_SIZE(a)                 (sizeof(a)/sizeof(a[0]))
 #define MAG(x, y)                   sqrt(pow(x,2) + pow(y,2))
 #define VEC3_EQUAL(a, b)            (0 == memcmp((a).raw, (b).raw, sizeof((a).raw)))
+#define VERTS_PER_MAJOR_TRI         (VERTS_PER_TOP_FACE / 4)
+#define MAX(a, b)                   ((a) > (b) ? (a) : (b))
+
+/* Used for the merged geometry of the coarse levels of detail - must match the shaders */
+#define BLEND_MODE_MERGED           (BLEND_MODE_BLUR + 1)
+/* The upper bound of indices for merged geometry: each merged region or cliff 
+ * run has at least as many vertices as it has triangles. */
+#define MAX_MERGED_INDICES          (3 * TERRAIN_LOD_MAX_MERGED_VERTS)
 
 #define CPY2(dst, src)      \
     do{                     \
@@ -98,10 +109,6 @@ struct tile_adj_info{
     int right_center_idx;
 };
 
-struct tri{
-    struct terrain_vert verts[3];
-};
-
 /* Each top face is made up of 8 triangles, in the following configuration:
  *   +------+------+
  *   |\     |     /|
@@ -132,46 +139,88 @@ struct tri{
  * of each edge. When smoothing the normals, this extra point having its' own 
  * normal is essential. Care must be taken to ensure the appropriate winding order
  * for each triangle for backface culling!
+ *
+ * The two halves of a major triangle share its' edge midpoint, center and corner 
+ * vertices via the index buffer, so each major triangle only needs 4 vertices. The 
+ * midpoint vertex comes first in both halves, making it the provoking vertex that 
+ * holds the flat attributes of the whole major triangle. The corners are not shared 
+ * between major triangles since they can have different normals and materials.
  */
 union top_face_vbuff{
     struct terrain_vert verts[VERTS_PER_TOP_FACE];
-    struct tri tris[VERTS_PER_TOP_FACE/3];
     struct{
         /* Tri 0 */
-        struct terrain_vert se0; 
-        struct terrain_vert s0;
+        struct terrain_vert s;
         struct terrain_vert center0;
+        struct terrain_vert se0; 
+        struct terrain_vert sw0;
         /* Tri 1 */
+        struct terrain_vert w;
         struct terrain_vert center1;
-        struct terrain_vert s1;
-        struct terrain_vert sw0;
-        /* Tri 2 */
         struct terrain_vert sw1;
-        struct terrain_vert w0;
-        struct terrain_vert center2;
-        /* Tri 3 */
-        struct terrain_vert center3;
-        struct terrain_vert w1;
         struct terrain_vert nw0;
-        /* Tri 4 */
+        /* Tri 2 */
+        struct terrain_vert n;
+        struct terrain_vert center2;
         struct terrain_vert nw1;
-        struct terrain_vert n0;
-        struct terrain_vert center4;
-        /* Tri 5 */
-        struct terrain_vert center5;
-        struct terrain_vert n1;
         struct terrain_vert ne0;
-        /* Tri 6 */
+        /* Tri 3 */
+        struct terrain_vert e;
+        struct terrain_vert center3;
         struct terrain_vert ne1;
-        struct terrain_vert e0;
-        struct terrain_vert center6;
-        /* Tri 7 */
-        struct terrain_vert center7;
-        struct terrain_vert e1;
         struct terrain_vert se1;
     };
 };
 
+enum side_face{
+    SIDE_FACE_FRONT,
+    SIDE_FACE_BACK,
+    SIDE_FACE_LEFT,
+    SIDE_FACE_RIGHT,
+};
+
+/* Scratch state for building the levels of detail of a single chunk. It is 
+ * allocated per build, as chunks are built on both the main and render threads. */
+struct lod_ctx{
+    const struct map    *map;
+    int                  chunk_r, chunk_c;
+    int                  width, height;
+    /* Bitmask of side faces that are hidden by the adjacent tile */
+    uint8_t              hidden[TILES_PER_CHUNK_HEIGHT][TILES_PER_CHUNK_WIDTH];
+    /* Bitmask of side faces that are part of a merged cliff run */
+    uint8_t              merged_faces[TILES_PER_CHUNK_HEIGHT][TILES_PER_CHUNK_WIDTH];
+    /* Set for tiles whose' top face is part of a merged region */
+    bool                 merged_top[TILES_PER_CHUNK_HEIGHT][TILES_PER_CHUNK_WIDTH];
+    struct terrain_vert *merged_verts;
+    size_t               num_merged_verts;
+    GLushort             merged_indices[MAX_MERGED_INDICES];
+    size_t               num_merged_indices;
+};
+
+/*****************************************************************************/
+/* STATIC VARIABLES                                                          */
+/*****************************************************************************/
+
+/* Side face vertices are laid out as (nw, ne, se, sw) */
+static const GLushort s_side_face_indices[INDICES_PER_SIDE_FACE] = {
+    0, 1, 3, 
+    2, 3, 1
+};
+
+/* Each major triangle is laid out as (mid, center, cornerA, cornerB) */
+static const GLushort s_top_face_indices[INDICES_PER_TOP_FACE] = {
+     0,  1,  2,    0,  3,  1, 
+     4,  5,  6,    4,  7,  5, 
+     8,  9, 10,    8, 11,  9, 
+    12, 13, 14,   12, 15, 13
+};
+
+/* Scratch buffers for rebuilding the levels of detail of a chunk. Only 
+ * touched by the render thread. */
+static GLushort            s_lod_indices[TERRAIN_NUM_LODS * INDICES_PER_TILE 
+                                         * TILES_PER_CHUNK_WIDTH * TILES_PER_CHUNK_HEIGHT];
+static struct terrain_vert s_lod_merged[TERRAIN_LOD_MAX_MERGED_VERTS];
+
 /*****************************************************************************/
 /* STATIC FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -540,6 +589,442 @@ static float tile_min_visible_height(const struct map *map, struct tile_desc til
     return arr_min(heights, ARR_SIZE(heights)) * Y_COORDS_PER_TILE;
 }
 
+/* A side face is completely hidden when the adjacent tile sharing its' edge 
+ * is at least as high at both of the edge's endpoints. Faces at the edge of 
+ * the map are always kept. */
+static bool tile_side_face_hidden(const struct map *map, struct tile_desc tile, 
+                                  const struct tile *curr_tile, enum side_face face)
+{
+    struct map_resolution res;
+    M_GetResolution(map, &res);
+
+    struct tile *adj_tile = NULL;
+    struct tile_desc ref = tile;
+    int ret;
+
+    switch(face) {
+    case SIDE_FACE_FRONT:   ret = M_Tile_RelativeDesc(res, &ref,  0,  1); break;
+    case SIDE_FACE_BACK:    ret = M_Tile_RelativeDesc(res, &ref,  0, -1); break;
+    case SIDE_FACE_LEFT:    ret = M_Tile_RelativeDesc(res, &ref, -1,  0); break;
+    case SIDE_FACE_RIGHT:   ret = M_Tile_RelativeDesc(res, &ref,  1,  0); break;
+    default: assert(0); return false;
+    }
+
+    if(!ret)
+        return false;
+
+    ret = M_TileForDesc(map, ref, &adj_tile);
+    assert(ret);
+
+    switch(face) {
+    case SIDE_FACE_FRONT:
+        return M_Tile_NWHeight(adj_tile) >= M_Tile_SWHeight(curr_tile)
+            && M_Tile_NEHeight(adj_tile) >= M_Tile_SEHeight(curr_tile);
+    case SIDE_FACE_BACK:
+        return M_Tile_SWHeight(adj_tile) >= M_Tile_NWHeight(curr_tile)
+            && M_Tile_SEHeight(adj_tile) >= M_Tile_NEHeight(curr_tile);
+    case SIDE_FACE_LEFT:
+        return M_Tile_NEHeight(adj_tile) >= M_Tile_NWHeight(curr_tile)
+            && M_Tile_SEHeight(adj_tile) >= M_Tile_SWHeight(curr_tile);
+    case SIDE_FACE_RIGHT:
+        return M_Tile_NWHeight(adj_tile) >= M_Tile_NEHeight(curr_tile)
+            && M_Tile_SWHeight(adj_tile) >= M_Tile_SEHeight(curr_tile);
+    default: 
+        assert(0); 
+        return false;
+    }
+}
+
+/* Get the index of the vertex (relative to the start of the tile's vertices) 
+ * for the i-th element of the tile's full, unculled, triangle list. */
+static GLushort tile_vert_index(int i)
+{
+    assert(i >= 0 && i < INDICES_PER_TILE);
+
+    if(i < 4 * INDICES_PER_SIDE_FACE) {
+        return (i / INDICES_PER_SIDE_FACE) * VERTS_PER_SIDE_FACE 
+             + s_side_face_indices[i % INDICES_PER_SIDE_FACE];
+    }
+    return 4 * VERTS_PER_SIDE_FACE + s_top_face_indices[i - 4 * INDICES_PER_SIDE_FACE];
+}
+
+/* The coarse levels of detail collapse every major triangle of the top face
+ * into a single triangle, dropping the edge midpoint. This is exact for all 
+ * tile types, as the midpoints of the edges are never raised. The majors 
+ * along the chunk border are kept whole, so that the edges of adjacent chunks 
+ * still line up when they are drawn with different levels of detail. */
+static size_t tile_lod_top_indices(const struct lod_ctx *ctx, int r, int c, 
+                                   GLushort base, GLushort *out)
+{
+    /* Majors are ordered south, west, north, east */
+    const bool on_border[4] = {
+        r == ctx->height - 1,
+        c == 0,
+        r == 0,
+        c == ctx->width - 1,
+    };
+
+    size_t ret = 0;
+    for(int i = 0; i < 4; i++) {
+
+        GLushort major = base + 4 * VERTS_PER_SIDE_FACE + i * VERTS_PER_MAJOR_TRI;
+        if(on_border[i]) {
+            for(int j = 0; j < INDICES_PER_TOP_FACE / 4; j++) {
+                out[ret++] = base + 4 * VERTS_PER_SIDE_FACE + s_top_face_indices[i * INDICES_PER_TOP_FACE / 4 + j];
+            }
+        }else{
+            /* (cornerA, cornerB, center) */
+            out[ret++] = major + 2;
+            out[ret++] = major + 3;
+            out[ret++] = major + 1;
+        }
+    }
+    return ret;
+}
+
+static size_t tile_lod_indices(const struct lod_ctx *ctx, int lod, int r, int c, GLushort *out)
+{
+    GLushort base = (r * ctx->width + c) * VERTS_PER_TILE;
+    size_t ret = 0;
+
+    for(int i = 0; i < 4; i++) {
+
+        if(ctx->hidden[r][c] & (1 << i))
+            continue;
+        if(lod >= 2 && (ctx->merged_faces[r][c] & (1 << i)))
+            continue;
+
+        for(int j = 0; j < INDICES_PER_SIDE_FACE; j++) {
+            out[ret++] = base + i * VERTS_PER_SIDE_FACE + s_side_face_indices[j];
+        }
+    }
+
+    if(lod == 0) {
+        for(int j = 0; j < INDICES_PER_TOP_FACE; j++) {
+            out[ret++] = base + 4 * VERTS_PER_SIDE_FACE + s_top_face_indices[j];
+        }
+    }else if(lod == 1 || !ctx->merged_top[r][c]) {
+        ret += tile_lod_top_indices(ctx, r, c, base, out + ret);
+    }
+    return ret;
+}
+
+static GLushort lod_push_merged_vert(struct lod_ctx *ctx, struct terrain_vert vert)
+{
+    assert(ctx->num_merged_verts < TERRAIN_LOD_MAX_MERGED_VERTS);
+
+    vert.blend_mode = BLEND_MODE_MERGED;
+    ctx->merged_verts[ctx->num_merged_verts] = vert;
+    return (ctx->width * ctx->height * VERTS_PER_TILE) + ctx->num_merged_verts++;
+}
+
+static void lod_push_merged_tri(struct lod_ctx *ctx, GLushort a, GLushort b, GLushort c)
+{
+    assert(ctx->num_merged_indices + 3 <= MAX_MERGED_INDICES);
+
+    ctx->merged_indices[ctx->num_merged_indices++] = a;
+    ctx->merged_indices[ctx->num_merged_indices++] = b;
+    ctx->merged_indices[ctx->num_merged_indices++] = c;
+}
+
+/* A tile's top face can be merged with its' neighbours when it is flat and 
+ * fully surrounded by flat tiles of the same material, as its' blended 
+ * texture is then just the material's own texture. Tiles along the chunk 
+ * border are never merged. */
+static bool tile_top_mergeable(const struct lod_ctx *ctx, int r, int c)
+{
+    if(r == 0 || r == ctx->height - 1 || c == 0 || c == ctx->width - 1)
+        return false;
+
+    struct tile *tile;
+    int status = M_TileForDesc(ctx->map, (struct tile_desc){ctx->chunk_r, ctx->chunk_c, r, c}, &tile);
+    assert(status);
+
+    if(tile->type != TILETYPE_FLAT)
+        return false;
+
+    for(int dr = -1; dr <= 1; dr++) {
+    for(int dc = -1; dc <= 1; dc++) {
+
+        struct tile *adj;
+        status = M_TileForDesc(ctx->map, (struct tile_desc){ctx->chunk_r, ctx->chunk_c, r + dr, c + dc}, &adj);
+        assert(status);
+
+        if(adj->type != TILETYPE_FLAT || adj->top_mat_idx != tile->top_mat_idx)
+            return false;
+    }}
+
+    (void)status;
+    return true;
+}
+
+static struct terrain_vert lod_region_vert(const struct tile *tile, float r, float c, int uv_r, int uv_c)
+{
+    return (struct terrain_vert) {
+        .pos    = (vec3_t) { 0.0f - (c * X_COORDS_PER_TILE),
+                             tile->base_height * Y_COORDS_PER_TILE,
+                             0.0f + (r * Z_COORDS_PER_TILE) },
+        .uv     = (vec2_t) { c - uv_c, uv_r - r },
+        .normal = (vec3_t) { 0.0f, 1.0f, 0.0f },
+        .material_idx  = tile->top_mat_idx,
+    };
+}
+
+/* Replace the top faces of the rectangle of tiles [r0, r1] x [c0, c1] with a 
+ * single polygon. The polygon has a vertex at every tile corner along its' 
+ * perimeter so that it doesn't introduce T-junctions with the surrounding 
+ * tiles. It is triangulated as a fan around its' center. */
+static bool lod_merge_region(struct lod_ctx *ctx, int r0, int c0, int r1, int c1)
+{
+    int w = c1 - c0 + 1;
+    int h = r1 - r0 + 1;
+    if(ctx->num_merged_verts + 2 * (w + h) + 1 > TERRAIN_LOD_MAX_MERGED_VERTS)
+        return false;
+
+    struct tile *tile;
+    int status = M_TileForDesc(ctx->map, (struct tile_desc){ctx->chunk_r, ctx->chunk_c, r0, c0}, &tile);
+    assert(status);
+
+    GLushort center = lod_push_merged_vert(ctx, 
+        lod_region_vert(tile, r0 + h / 2.0f, c0 + w / 2.0f, r1 + 1, c0));
+
+    /* Walk the perimeter from the south-east corner, along the south edge, 
+     * then up the west edge, along the north edge and down the east edge. */
+    GLushort first = center + 1;
+    for(int c = c1 + 1; c > c0; c--)
+        lod_push_merged_vert(ctx, lod_region_vert(tile, r1 + 1, c, r1 + 1, c0));
+    for(int r = r1 + 1; r > r0; r--)
+        lod_push_merged_vert(ctx, lod_region_vert(tile, r, c0, r1 + 1, c0));
+    for(int c = c0; c < c1 + 1; c++)
+        lod_push_merged_vert(ctx, lod_region_vert(tile, r0, c, r1 + 1, c0));
+    for(int r = r0; r < r1 + 1; r++)
+        lod_push_merged_vert(ctx, lod_region_vert(tile, r, c1 + 1, r1 + 1, c0));
+
+    int nperim = 2 * (w + h);
+    for(int i = 0; i < nperim; i++) {
+        lod_push_merged_tri(ctx, center, first + i, first + (i + 1) % nperim);
+    }
+
+    for(int r = r0; r <= r1; r++) {
+    for(int c = c0; c <= c1; c++) {
+        ctx->merged_top[r][c] = true;
+    }}
+    return true;
+}
+
+/* Greedily grow rectangles of mergeable tiles at the same height, first
+ * along the row and then downwards. */
+static void lod_merge_regions(struct lod_ctx *ctx)
+{
+    bool mergeable[TILES_PER_CHUNK_HEIGHT][TILES_PER_CHUNK_WIDTH];
+    int heights[TILES_PER_CHUNK_HEIGHT][TILES_PER_CHUNK_WIDTH];
+    int mats[TILES_PER_CHUNK_HEIGHT][TILES_PER_CHUNK_WIDTH];
+
+    for(int r = 0; r < ctx->height; r++) {
+    for(int c = 0; c < ctx->width;  c++) {
+
+        struct tile *tile;
+        int status = M_TileForDesc(ctx->map, (struct tile_desc){ctx->chunk_r, ctx->chunk_c, r, c}, &tile);
+        assert(status);
+
+        mergeable[r][c] = tile_top_mergeable(ctx, r, c);
+        heights[r][c] = tile->base_height;
+        mats[r][c] = tile->top_mat_idx;
+    }}
+
+#define SAME_REGION(r, c, r0, c0) \
+    (mergeable[r][c] && !ctx->merged_top[r][c] \
+     && heights[r][c] == heights[r0][c0] && mats[r][c] == mats[r0][c0])
+
+    for(int r0 = 0; r0 < ctx->height; r0++) {
+    for(int c0 = 0; c0 < ctx->width;  c0++) {
+
+        if(!mergeable[r0][c0] || ctx->merged_top[r0][c0])
+            continue;
+
+        int c1 = c0;
+        while(c1 + 1 < ctx->width && SAME_REGION(r0, c1 + 1, r0, c0))
+            c1++;
+
+        int r1 = r0;
+        while(r1 + 1 < ctx->height) {
+            bool row_ok = true;
+            for(int c = c0; c <= c1; c++) {
+                if(!SAME_REGION(r1 + 1, c, r0, c0)) {
+                    row_ok = false;
+                    break;
+                }
+            }
+            if(!row_ok)
+                break;
+            r1++;
+        }
+
+        if((r1 - r0 + 1) * (c1 - c0 + 1) < 2)
+            continue;
+        lod_merge_region(ctx, r0, c0, r1, c1);
+    }}
+
+#undef SAME_REGION
+}
+
+/* Replace the side faces of the tiles in a run with a single strip. The 
+ * faces are ordered such that each face's north-east vertex coincides with 
+ * the next face's north-west vertex. Both the top and the bottom edge keep 
+ * a vertex at every tile corner, as they border the top faces of the tiles 
+ * and the side faces of the tiles below, and dropping any of them would
+ * introduce T-junctions. The strip only saves on the per-face vertices. */
+static bool lod_merge_run(struct lod_ctx *ctx, enum side_face face, 
+                          const struct tile_desc *tiles, size_t ntiles)
+{
+    if(ctx->num_merged_verts + 2 * (ntiles + 1) > TERRAIN_LOD_MAX_MERGED_VERTS)
+        return false;
+
+    struct terrain_vert verts[VERTS_PER_TILE];
+    const struct face *tf = (const struct face*)(verts + face * VERTS_PER_SIDE_FACE);
+    struct terrain_vert vert;
+
+    R_TileGetVertices(ctx->map, tiles[0], verts);
+
+    vert = tf->nw;
+    vert.uv = (vec2_t){0.0f, tf->nw.uv.y};
+    GLushort prev_top = lod_push_merged_vert(ctx, vert);
+
+    vert = tf->sw;
+    vert.uv = (vec2_t){0.0f, 0.0f};
+    GLushort prev_bot = lod_push_merged_vert(ctx, vert);
+
+    for(int i = 0; i < ntiles; i++) {
+
+        if(i > 0) {
+            R_TileGetVertices(ctx->map, tiles[i], verts);
+        }
+
+        vert = tf->ne;
+        vert.uv = (vec2_t){i + 1, tf->ne.uv.y};
+        GLushort top = lod_push_merged_vert(ctx, vert);
+
+        vert = tf->se;
+        vert.uv = (vec2_t){i + 1, 0.0f};
+        GLushort bot = lod_push_merged_vert(ctx, vert);
+
+        /* Same winding as s_side_face_indices */
+        lod_push_merged_tri(ctx, prev_top, top, prev_bot);
+        lod_push_merged_tri(ctx, bot, prev_bot, top);
+
+        prev_top = top;
+        prev_bot = bot;
+
+        ctx->merged_faces[tiles[i].tile_r][tiles[i].tile_c] |= (1 << face);
+    }
+    return true;
+}
+
+/* Side faces along an edge of the same cliff are merged into runs. Faces
+ * along the chunk border are never merged. */
+static void lod_merge_runs(struct lod_ctx *ctx)
+{
+    for(int face = 0; face < 4; face++) {
+
+        bool along_row = (face == SIDE_FACE_FRONT || face == SIDE_FACE_BACK);
+        bool reverse = (face == SIDE_FACE_BACK || face == SIDE_FACE_RIGHT);
+        int nlines = along_row ? ctx->height : ctx->width;
+        int len = along_row ? ctx->width : ctx->height;
+
+        for(int line = 0; line < nlines; line++) {
+
+            if(face == SIDE_FACE_FRONT && line == ctx->height - 1)
+                continue;
+            if(face == SIDE_FACE_BACK && line == 0)
+                continue;
+            if(face == SIDE_FACE_LEFT && line == 0)
+                continue;
+            if(face == SIDE_FACE_RIGHT && line == ctx->width - 1)
+                continue;
+
+            struct tile_desc run[MAX(TILES_PER_CHUNK_WIDTH, TILES_PER_CHUNK_HEIGHT)];
+            size_t nrun = 0;
+            int run_top = 0, run_mat = 0;
+            float run_bot = 0.0f;
+
+            for(int i = 0; i <= len; i++) {
+
+                bool eligible = false;
+                int top = 0, mat = 0;
+                float bot = 0.0f;
+                struct tile_desc td;
+
+                if(i < len) {
+                    int k = reverse ? (len - 1 - i) : i;
+                    int r = along_row ? line : k;
+                    int c = along_row ? k : line;
+                    td = (struct tile_desc){ctx->chunk_r, ctx->chunk_c, r, c};
+
+                    struct tile *tile;
+                    int status = M_TileForDesc(ctx->map, td, &tile);
+                    assert(status);
+
+                    int ha, hb;
+                    switch(face) {
+                    case SIDE_FACE_FRONT: ha = M_Tile_SWHeight(tile); hb = M_Tile_SEHeight(tile); break;
+                    case SIDE_FACE_BACK:  ha = M_Tile_NWHeight(tile); hb = M_Tile_NEHeight(tile); break;
+                    case SIDE_FACE_LEFT:  ha = M_Tile_NWHeight(tile); hb = M_Tile_SWHeight(tile); break;
+                    case SIDE_FACE_RIGHT: ha = M_Tile_NEHeight(tile); hb = M_Tile_SEHeight(tile); break;
+                    default: assert(0); ha = hb = 0;
+                    }
+
+                    eligible = !(ctx->hidden[r][c] & (1 << face)) && (ha == hb);
+                    top = ha;
+                    mat = tile->sides_mat_idx;
+                    bot = eligible ? tile_min_visible_height(ctx->map, td) : 0.0f;
+                }
+
+                bool extends = eligible && nrun > 0 
+                    && top == run_top && mat == run_mat && bot == run_bot;
+
+                if(!extends) {
+                    if(nrun >= 2) {
+                        lod_merge_run(ctx, face, run, nrun);
+                    }
+                    nrun = 0;
+                }
+                if(!eligible)
+                    continue;
+
+                if(nrun == 0) {
+                    run_top = top;
+                    run_mat = mat;
+                    run_bot = bot;
+                }
+                run[nrun++] = td;
+            }
+        }
+    }
+}
+
+static void tile_chunk_upload_lods(struct render_private *priv, const struct tile_chunk_lods *lods, 
+                                   const GLushort *ibuff)
+{
+    struct mesh *mesh = &priv->mesh;
+    assert(TERRAIN_NUM_LODS <= MESH_MAX_LODS);
+
+    size_t total = 0;
+    for(int i = 0; i < TERRAIN_NUM_LODS; i++) {
+        mesh->lods[i].offset = total;
+        mesh->lods[i].count = lods->num_indices[i];
+        total += lods->num_indices[i];
+    }
+    mesh->num_lods = TERRAIN_NUM_LODS;
+
+    /* The element buffer binding is part of the VAO's state */
+    glBindVertexArray(mesh->VAO);
+    if(!mesh->EBO) {
+        glGenBuffers(1, &mesh->EBO);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, total * sizeof(GLushort), ibuff, GL_STATIC_DRAW);
+}
+
 /*****************************************************************************/
 /* EXTERN FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -550,7 +1035,8 @@ void R_GL_TileDrawSelected(const struct tile_desc *in, const void *chunk_rprivat
     GL_PERF_ENTER();
     ASSERT_IN_RENDER_THREAD();
 
-    struct terrain_vert vbuff[VERTS_PER_TILE];
+    struct terrain_vert tile_verts[VERTS_PER_TILE];
+    struct terrain_vert vbuff[INDICES_PER_TILE];
     vec4_t red = (vec4_t){1.0f, 0.0f, 0.0f, 1.0};
     GLuint VAO, VBO;
 
@@ -561,9 +1047,14 @@ void R_GL_TileDrawSelected(const struct tile_desc *in, const void *chunk_rprivat
     glBindBuffer(GL_ARRAY_BUFFER, priv->mesh.VBO);
     const struct terrain_vert *vert_base = glMapBufferRange(GL_ARRAY_BUFFER, offset, length, GL_MAP_READ_BIT);
     assert(vert_base);
-    memcpy(vbuff, vert_base, sizeof(vbuff));
+    memcpy(tile_verts, vert_base, sizeof(tile_verts));
     glUnmapBuffer(GL_ARRAY_BUFFER);
 
+    /* Draw all the faces of the tile, including the ones culled from the chunk mesh */
+    for(int i = 0; i < INDICES_PER_TILE; i++) {
+        vbuff[i] = tile_verts[tile_vert_index(i)];
+    }
+
     /* Additionally, scale the tile selection mesh slightly around its' center. This is so that 
      * it is slightly larger than the actual tile underneath and can be rendered on top of it. */
     const float SCALE_FACTOR = 1.025f;
@@ -621,7 +1112,7 @@ void R_GL_TileDrawSelected(const struct tile_desc *in, const void *chunk_rprivat
     glBufferData(GL_ARRAY_BUFFER, sizeof(vbuff), vbuff, GL_STATIC_DRAW);
 
     glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, VERTS_PER_TILE);
+    glDrawArrays(GL_TRIANGLES, 0, ARR_SIZE(vbuff));
 
     /* cleanup */
     glDeleteVertexArrays(1, &VAO);
@@ -779,7 +1270,8 @@ void R_GL_TilePatchVertsBlend(void *chunk_rprivate, const struct map *map, const
     /* Now, update all triangles of the top face 
      *
      * Since all the material index attributes are flat attribute, we only need to set 
-     * them for the provoking vertex of each triangle.
+     * them for the provoking vertex of each triangle. Both halves of a major triangle 
+     * share the same provoking vertex.
      *
      * 'c1_indices' and 'c2_indices' hold the 8 surrounding materials for the triangle's 
      * two non-central vertices. If the vertex is surrounded by only 2 different materials, 
@@ -798,35 +1290,29 @@ void R_GL_TilePatchVertsBlend(void *chunk_rprivate, const struct map *map, const
     GL_ASSERT_OK();
     assert(tile_verts_base);
 
-    struct terrain_vert *south_provoking[2] = {tile_verts_base + (4 * VERTS_PER_SIDE_FACE) + 0*3,
-                                               tile_verts_base + (4 * VERTS_PER_SIDE_FACE) + 1*3};
-    struct terrain_vert *west_provoking[2]  = {tile_verts_base + (4 * VERTS_PER_SIDE_FACE) + 2*3,
-                                               tile_verts_base + (4 * VERTS_PER_SIDE_FACE) + 3*3};
-    struct terrain_vert *north_provoking[2] = {tile_verts_base + (4 * VERTS_PER_SIDE_FACE) + 4*3,
-                                               tile_verts_base + (4 * VERTS_PER_SIDE_FACE) + 5*3};
-    struct terrain_vert *east_provoking[2]  = {tile_verts_base + (4 * VERTS_PER_SIDE_FACE) + 6*3,
-                                               tile_verts_base + (4 * VERTS_PER_SIDE_FACE) + 7*3};
-
-    for(int i = 0; i < 2; i++) {
+    union top_face_vbuff *tfvb = (union top_face_vbuff*)(tile_verts_base + (4 * VERTS_PER_SIDE_FACE));
+    struct terrain_vert *south_provoking = &tfvb->s;
+    struct terrain_vert *west_provoking  = &tfvb->w;
+    struct terrain_vert *north_provoking = &tfvb->n;
+    struct terrain_vert *east_provoking  = &tfvb->e;
 
-        south_provoking[i]->c1_indices[0] = INDICES_MASK_32(bot.top_left_mask, bot_left.top_right_mask);
-        south_provoking[i]->c1_indices[1] = INDICES_MASK_32(left.bot_right_mask, curr.bot_left_mask);
+    south_provoking->c1_indices[0] = INDICES_MASK_32(bot.top_left_mask, bot_left.top_right_mask);
+    south_provoking->c1_indices[1] = INDICES_MASK_32(left.bot_right_mask, curr.bot_left_mask);
 
-        south_provoking[i]->c2_indices[0] = INDICES_MASK_32(bot_right.top_left_mask, bot.top_right_mask);
-        south_provoking[i]->c2_indices[1] = INDICES_MASK_32(curr.bot_right_mask, right.bot_left_mask);
+    south_provoking->c2_indices[0] = INDICES_MASK_32(bot_right.top_left_mask, bot.top_right_mask);
+    south_provoking->c2_indices[1] = INDICES_MASK_32(curr.bot_right_mask, right.bot_left_mask);
 
-        north_provoking[i]->c1_indices[0] = INDICES_MASK_32(curr.top_left_mask, left.top_right_mask);
-        north_provoking[i]->c1_indices[1] = INDICES_MASK_32(top_left.bot_right_mask, top.bot_left_mask);
+    north_provoking->c1_indices[0] = INDICES_MASK_32(curr.top_left_mask, left.top_right_mask);
+    north_provoking->c1_indices[1] = INDICES_MASK_32(top_left.bot_right_mask, top.bot_left_mask);
 
-        north_provoking[i]->c2_indices[0] = INDICES_MASK_32(right.top_left_mask, curr.top_right_mask);
-        north_provoking[i]->c2_indices[1] = INDICES_MASK_32(top.bot_right_mask, top_right.bot_left_mask);
+    north_provoking->c2_indices[0] = INDICES_MASK_32(right.top_left_mask, curr.top_right_mask);
+    north_provoking->c2_indices[1] = INDICES_MASK_32(top.bot_right_mask, top_right.bot_left_mask);
 
-        CPY2(west_provoking[i]->c1_indices, south_provoking[0]->c1_indices);
-        CPY2(west_provoking[i]->c2_indices, north_provoking[0]->c1_indices);
+    CPY2(west_provoking->c1_indices, south_provoking->c1_indices);
+    CPY2(west_provoking->c2_indices, north_provoking->c1_indices);
 
-        CPY2(east_provoking[i]->c1_indices, south_provoking[0]->c2_indices);
-        CPY2(east_provoking[i]->c2_indices, north_provoking[0]->c2_indices);
-    }
+    CPY2(east_provoking->c1_indices, south_provoking->c2_indices);
+    CPY2(east_provoking->c2_indices, north_provoking->c2_indices);
 
     GLuint tb_mask = INDICES_MASK_32(
         INDICES_MASK_16(curr.top_center_idx, top.bot_center_idx),
@@ -838,10 +1324,10 @@ void R_GL_TilePatchVertsBlend(void *chunk_rprivate, const struct map *map, const
     );
 
     struct terrain_vert *provoking[] = {
-        south_provoking[0], south_provoking[1], 
-        north_provoking[0], north_provoking[1], 
-        west_provoking[0],  west_provoking[1], 
-        east_provoking[0],  east_provoking[1]
+        south_provoking, 
+        north_provoking, 
+        west_provoking,
+        east_provoking
     };
 
     for(int i = 0; i < ARR_SIZE(provoking); i++) {
@@ -850,9 +1336,24 @@ void R_GL_TilePatchVertsBlend(void *chunk_rprivate, const struct map *map, const
         provoking[i]->lr_indices = lr_mask;
         provoking[i]->middle_indices = curr.middle_mask;
         provoking[i]->blend_mode = optimal_blendmode(provoking[i]);
+
+        /* The coarser levels of detail draw each major triangle with one of 
+         * its' corners as the provoking vertex, so all the vertices of the 
+         * major triangle must hold the same flat attributes. */
+        for(int j = 1; j < VERTS_PER_MAJOR_TRI; j++) {
+
+            struct terrain_vert *vert = provoking[i] + j;
+            CPY2(vert->c1_indices, provoking[i]->c1_indices);
+            CPY2(vert->c2_indices, provoking[i]->c2_indices);
+            vert->tb_indices = provoking[i]->tb_indices;
+            vert->lr_indices = provoking[i]->lr_indices;
+            vert->middle_indices = provoking[i]->middle_indices;
+            vert->blend_mode = provoking[i]->blend_mode;
+        }
     }
 
     glUnmapBuffer(GL_ARRAY_BUFFER);
+    R_GL_Batch_InvalidateChunk(chunk_rprivate);
     GL_ASSERT_OK();
 }
 
@@ -926,29 +1427,25 @@ void R_GL_TilePatchVertsSmooth(void *chunk_rprivate, const struct map *map, cons
     memset(tiles, 0, sizeof(tiles));
     td = *tile; if(M_Tile_RelativeDesc(res, &td,  0, -1)) M_TileForDesc(map, td, &tiles[2]);
     td = *tile; if(M_Tile_RelativeDesc(res, &td,  0,  0)) M_TileForDesc(map, td, &tiles[3]);
-    tile_smooth_normals_edge(tiles, &tfvb->n0);
-    tile_smooth_normals_edge(tiles, &tfvb->n1);
+    tile_smooth_normals_edge(tiles, &tfvb->n);
 
     /* Bot edge */
     memset(tiles, 0, sizeof(tiles));
     td = *tile; if(M_Tile_RelativeDesc(res, &td,  0,  0)) M_TileForDesc(map, td, &tiles[2]);
     td = *tile; if(M_Tile_RelativeDesc(res, &td,  0,  1)) M_TileForDesc(map, td, &tiles[3]);
-    tile_smooth_normals_edge(tiles, &tfvb->s0);
-    tile_smooth_normals_edge(tiles, &tfvb->s1);
+    tile_smooth_normals_edge(tiles, &tfvb->s);
 
     /* Left edge */
     memset(tiles, 0, sizeof(tiles));
     td = *tile; if(M_Tile_RelativeDesc(res, &td, -1,  0)) M_TileForDesc(map, td, &tiles[0]);
     td = *tile; if(M_Tile_RelativeDesc(res, &td,  0,  0)) M_TileForDesc(map, td, &tiles[1]);
-    tile_smooth_normals_edge(tiles, &tfvb->w0);
-    tile_smooth_normals_edge(tiles, &tfvb->w1);
+    tile_smooth_normals_edge(tiles, &tfvb->w);
 
     /* Right edge */
     memset(tiles, 0, sizeof(tiles));
     td = *tile; if(M_Tile_RelativeDesc(res, &td,  0,  0)) M_TileForDesc(map, td, &tiles[0]);
     td = *tile; if(M_Tile_RelativeDesc(res, &td,  1,  0)) M_TileForDesc(map, td, &tiles[1]);
-    tile_smooth_normals_edge(tiles, &tfvb->e0);
-    tile_smooth_normals_edge(tiles, &tfvb->e1);
+    tile_smooth_normals_edge(tiles, &tfvb->e);
 
     /* Center */
     vec3_t center_norm = {0};
@@ -960,12 +1457,9 @@ void R_GL_TilePatchVertsSmooth(void *chunk_rprivate, const struct map *map, cons
     tfvb->center1.normal = center_norm;
     tfvb->center2.normal = center_norm;
     tfvb->center3.normal = center_norm;
-    tfvb->center4.normal = center_norm;
-    tfvb->center5.normal = center_norm;
-    tfvb->center6.normal = center_norm;
-    tfvb->center7.normal = center_norm;
 
     glUnmapBuffer(GL_ARRAY_BUFFER);
+    R_GL_Batch_InvalidateChunk(chunk_rprivate);
     GL_ASSERT_OK();
 }
 
@@ -994,10 +1488,131 @@ void R_GL_TileUpdate(void *chunk_rprivate, const struct map *map, const struct t
         R_GL_TilePatchVertsSmooth(chunk_rprivate, map, desc);
     }
 
+    /* The change in height may have hidden or exposed some side faces in 
+     * the chunk, and changed which tiles can be merged at the coarser levels 
+     * of detail. An update touches the adjacent tiles too, so the levels of 
+     * detail are only rebuilt once all of them are done. */
+    if(priv->mesh.EBO) {
+        priv->lods_dirty = true;
+    }
+
+    R_GL_Batch_InvalidateChunk(chunk_rprivate);
+
+    GL_ASSERT_OK();
+    GL_PERF_RETURN_VOID();
+}
+
+void R_GL_TileChunkInitLODs(void *chunk_rprivate, const struct tile_chunk_lods *lods, const GLushort *ibuff)
+{
+    GL_PERF_ENTER();
+    ASSERT_IN_RENDER_THREAD();
+
+    struct render_private *priv = chunk_rprivate;
+    assert(!priv->mesh.EBO);
+    tile_chunk_upload_lods(priv, lods, ibuff);
+
+    GL_ASSERT_OK();
+    GL_PERF_RETURN_VOID();
+}
+
+void R_GL_TileChunkUpdateLODs(void *chunk_rprivate, const struct map *map, 
+                              const int *chunk_r, const int *chunk_c)
+{
+    GL_PERF_ENTER();
+    ASSERT_IN_RENDER_THREAD();
+
+    struct render_private *priv = chunk_rprivate;
+    if(!priv->lods_dirty)
+        GL_PERF_RETURN_VOID();
+
+    struct tile_chunk_lods lods;
+    if(!R_TileChunkGetLODs(map, *chunk_r, *chunk_c, TILES_PER_CHUNK_WIDTH, TILES_PER_CHUNK_HEIGHT, 
+        s_lod_indices, s_lod_merged, &lods)) {
+
+        /* The chunk stays dirty, so the next update of any of its' tiles 
+         * will retry. Until then, the previous levels of detail are drawn. */
+        fprintf(stderr, "Failed to rebuild the levels of detail of chunk (%d, %d).\n", 
+            *chunk_r, *chunk_c);
+        GL_PERF_RETURN_VOID();
+    }
+
+    size_t merged_offset = TILES_PER_CHUNK_WIDTH * TILES_PER_CHUNK_HEIGHT * VERTS_PER_TILE;
+    assert(merged_offset + TERRAIN_LOD_MAX_MERGED_VERTS <= priv->mesh.num_verts);
+
+    glBindBuffer(GL_ARRAY_BUFFER, priv->mesh.VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, merged_offset * sizeof(struct terrain_vert), 
+        lods.num_merged_verts * sizeof(struct terrain_vert), s_lod_merged);
+    tile_chunk_upload_lods(priv, &lods, s_lod_indices);
+
+    priv->lods_dirty = false;
+    R_GL_Batch_InvalidateChunk(chunk_rprivate);
+
     GL_ASSERT_OK();
     GL_PERF_RETURN_VOID();
 }
 
+bool R_TileChunkGetLODs(const struct map *map, int chunk_r, int chunk_c, size_t width, size_t height, 
+                        GLushort *out_indices, struct terrain_vert *out_merged, struct tile_chunk_lods *out)
+{
+    PERF_ENTER();
+    assert(width <= TILES_PER_CHUNK_WIDTH && height <= TILES_PER_CHUNK_HEIGHT);
+    assert(VERTS_PER_TILE * width * height + TERRAIN_LOD_MAX_MERGED_VERTS - 1 <= USHRT_MAX);
+
+    struct lod_ctx *ctx = malloc(sizeof(struct lod_ctx));
+    if(!ctx)
+        PERF_RETURN(false);
+
+    ctx->map = map;
+    ctx->chunk_r = chunk_r;
+    ctx->chunk_c = chunk_c;
+    ctx->width = width;
+    ctx->height = height;
+    ctx->merged_verts = out_merged;
+    ctx->num_merged_verts = 0;
+    ctx->num_merged_indices = 0;
+    memset(ctx->hidden, 0, sizeof(ctx->hidden));
+    memset(ctx->merged_faces, 0, sizeof(ctx->merged_faces));
+    memset(ctx->merged_top, 0, sizeof(ctx->merged_top));
+
+    for(int r = 0; r < height; r++) {
+    for(int c = 0; c < width;  c++) {
+
+        struct tile_desc td = (struct tile_desc){chunk_r, chunk_c, r, c};
+        struct tile *tile;
+        int status = M_TileForDesc(map, td, &tile);
+        assert(status);
+
+        for(int i = 0; i < 4; i++) {
+            if(tile_side_face_hidden(map, td, tile, i))
+                ctx->hidden[r][c] |= (1 << i);
+        }
+    }}
+
+    lod_merge_regions(ctx);
+    lod_merge_runs(ctx);
+
+    /* The index ranges of all the levels of detail are laid out back-to-back */
+    GLushort *curr = out_indices;
+    for(int lod = 0; lod < TERRAIN_NUM_LODS; lod++) {
+
+        GLushort *begin = curr;
+        if(lod >= 2) {
+            memcpy(curr, ctx->merged_indices, ctx->num_merged_indices * sizeof(GLushort));
+            curr += ctx->num_merged_indices;
+        }
+
+        for(int r = 0; r < height; r++) {
+        for(int c = 0; c < width;  c++) {
+            curr += tile_lod_indices(ctx, lod, r, c, curr);
+        }}
+        out->num_indices[lod] = curr - begin;
+    }
+    out->num_merged_verts = ctx->num_merged_verts;
+
+    free(ctx);
+    PERF_RETURN(true);
+}
+
 void R_TileGetVertices(const struct map *map, struct tile_desc td, struct terrain_vert *out)
 {
     PERF_ENTER();
@@ -1195,22 +1810,19 @@ void R_TileGetVertices(const struct map *map, struct tile_desc td, struct terrai
 #undef V_COORD
 
     struct face *faces[] = {
-        &front, &back, &left, &right 
+        [SIDE_FACE_FRONT] = &front, 
+        [SIDE_FACE_BACK]  = &back, 
+        [SIDE_FACE_LEFT]  = &left, 
+        [SIDE_FACE_RIGHT] = &right 
     };
 
     for(int i = 0; i < ARR_SIZE(faces); i++) {
 
         struct face *curr = faces[i];
-
-        /* First triangle */
-        memcpy(out + (i * VERTS_PER_SIDE_FACE) + 0, &curr->nw, sizeof(struct terrain_vert));
-        memcpy(out + (i * VERTS_PER_SIDE_FACE) + 1, &curr->ne, sizeof(struct terrain_vert));
-        memcpy(out + (i * VERTS_PER_SIDE_FACE) + 2, &curr->sw, sizeof(struct terrain_vert));
-
-        /* Second triangle */
-        memcpy(out + (i * VERTS_PER_SIDE_FACE) + 3, &curr->se, sizeof(struct terrain_vert));
-        memcpy(out + (i * VERTS_PER_SIDE_FACE) + 4, &curr->sw, sizeof(struct terrain_vert));
-        memcpy(out + (i * VERTS_PER_SIDE_FACE) + 5, &curr->ne, sizeof(struct terrain_vert));
+        out[(i * VERTS_PER_SIDE_FACE) + 0] = curr->nw;
+        out[(i * VERTS_PER_SIDE_FACE) + 1] = curr->ne;
+        out[(i * VERTS_PER_SIDE_FACE) + 2] = curr->se;
+        out[(i * VERTS_PER_SIDE_FACE) + 3] = curr->sw;
     }
 
     /* Lastly, the top face. Unlike the other five faces, it can have different 
@@ -1302,41 +1914,29 @@ void R_TileGetVertices(const struct map *map, struct tile_desc td, struct terrai
 
     assert(sizeof(union top_face_vbuff) == VERTS_PER_TOP_FACE * sizeof(struct terrain_vert));
     union top_face_vbuff *tfvb = (union top_face_vbuff*)(out + 4 * VERTS_PER_SIDE_FACE);
-    tfvb->se0 = top.se;
-    tfvb->s0 = south_vert;
+    tfvb->s = south_vert;
     tfvb->center0 = center_vert_tri0;
-    tfvb->center1 = center_vert_tri0;
-    tfvb->s1 = south_vert;
+    tfvb->se0 = top.se;
     tfvb->sw0 = top.sw;
+    tfvb->w = west_vert;
+    tfvb->center1 = top_tri_left_aligned ? center_vert_tri1 : center_vert_tri0;
     tfvb->sw1 = top.sw;
-    tfvb->w0 = west_vert;
-    tfvb->center2 = top_tri_left_aligned ? center_vert_tri1 : center_vert_tri0;
-    tfvb->center3 = top_tri_left_aligned ? center_vert_tri1 : center_vert_tri0;
-    tfvb->w1 = west_vert;
     tfvb->nw0 = top.nw;
+    tfvb->n = north_vert;
+    tfvb->center2 = center_vert_tri1;
     tfvb->nw1 = top.nw;
-    tfvb->n0 = north_vert;
-    tfvb->center4 = center_vert_tri1;
-    tfvb->center5 = center_vert_tri1;
-    tfvb->n1 = north_vert;
     tfvb->ne0 = top.ne;
+    tfvb->e = east_vert;
+    tfvb->center3 = top_tri_left_aligned ? center_vert_tri0 : center_vert_tri1;
     tfvb->ne1 = top.ne;
-    tfvb->e0 = east_vert;
-    tfvb->center6 = top_tri_left_aligned ? center_vert_tri0 : center_vert_tri1;
-    tfvb->center7 = top_tri_left_aligned ? center_vert_tri0 : center_vert_tri1;
-    tfvb->e1 = east_vert;
     tfvb->se1 = top.se;
 
     /* Give a slight overlap to the triangles of the top face to make sure there 
      * no gap can appear between adjacent triangles due to interpolation errors */
     tfvb->center0.pos.z -= 0.005;
-    tfvb->center1.pos.z -= 0.005;
-    tfvb->center2.pos.x -= 0.005;
-    tfvb->center3.pos.x -= 0.005;
-    tfvb->center4.pos.z += 0.005;
-    tfvb->center5.pos.z += 0.005;
-    tfvb->center6.pos.x += 0.005;
-    tfvb->center7.pos.x += 0.005;
+    tfvb->center1.pos.x -= 0.005;
+    tfvb->center2.pos.z += 0.005;
+    tfvb->center3.pos.x += 0.005;
 
     if(top_tri_left_aligned) {
         tfvb->se0.material_idx = tri0_idx;
@@ -1376,17 +1976,11 @@ void R_TileGetVertices(const struct map *map, struct tile_desc td, struct terrai
         tfvb->se1.normal = top_tri_normals[1];
     }
 
-    for(struct terrain_vert *curr_provoking = out; 
-        curr_provoking < out + (4 * VERTS_PER_SIDE_FACE); 
-        curr_provoking += 3) {
-
-        curr_provoking->blend_mode = BLEND_MODE_NOBLEND;
+    for(struct terrain_vert *curr = out; curr < out + (4 * VERTS_PER_SIDE_FACE); curr++) {
+        curr->blend_mode = BLEND_MODE_NOBLEND;
     }
-    for(struct terrain_vert *curr_provoking = out + (4 * VERTS_PER_SIDE_FACE); 
-        curr_provoking < out + VERTS_PER_TILE; 
-        curr_provoking += 3) {
-
-        curr_provoking->blend_mode = tile->blend_mode;
+    for(struct terrain_vert *curr = out + (4 * VERTS_PER_SIDE_FACE); curr < out + VERTS_PER_TILE; curr++) {
+        curr->blend_mode = tile->blend_mode;
     }
 
     PERF_RETURN_VOID();
@@ -1400,9 +1994,10 @@ int R_TileGetTriMesh(const struct map *map, struct tile_desc *td, mat4x4_t *mode
     R_TileGetVertices(map, *td, verts);
     int i = 0;
 
-    for(; i < ARR_SIZE(verts); i++) {
+    for(; i < INDICES_PER_TILE; i++) {
 
-        vec4_t pos_homo = (vec4_t){verts[i].pos.x, verts[i].pos.y, verts[i].pos.z, 1.0f};
+        const struct terrain_vert *vert = &verts[tile_vert_index(i)];
+        vec4_t pos_homo = (vec4_t){vert->pos.x, vert->pos.y, vert->pos.z, 1.0f};
         vec4_t ws_pos_homo;
         PFM_Mat4x4_Mult4x1(model, &pos_homo, &ws_pos_homo);
 
@@ -67,9 +67,19 @@ struct ui_vert{
     uint8_t color[4];
 };
 
-#define VERTS_PER_SIDE_FACE (6)
-#define VERTS_PER_TOP_FACE  (24)
-#define VERTS_PER_TILE      (4 * VERTS_PER_SIDE_FACE + VERTS_PER_TOP_FACE)
+#define VERTS_PER_SIDE_FACE   (4)
+#define VERTS_PER_TOP_FACE    (16)
+#define VERTS_PER_TILE        (4 * VERTS_PER_SIDE_FACE + VERTS_PER_TOP_FACE)
+#define INDICES_PER_SIDE_FACE (6)
+#define INDICES_PER_TOP_FACE  (24)
+#define INDICES_PER_TILE      (4 * INDICES_PER_SIDE_FACE + INDICES_PER_TOP_FACE)
+/* Level 0 is the full-detail terrain mesh. Level 1 draws each of the 4 major 
+ * triangles of a top face as a single triangle. Level 2 additionally merges 
+ * flat regions and straight runs of cliff faces into larger polygons. */
+#define TERRAIN_NUM_LODS      (3)
+/* The number of vertices reserved at the end of each chunk's vertex buffer for 
+ * the merged geometry of the coarsest level of detail */
+#define TERRAIN_LOD_MAX_MERGED_VERTS (2048)
 #define TILE_DEPTH          (3)
 #define MAX_MATERIALS       (16)
 
@@ -85,6 +95,13 @@ struct ui_vert{
  */
 void   R_GL_Draw(const void *render_private, mat4x4_t *model);
 
+/* ---------------------------------------------------------------------------
+ * Like 'R_GL_Draw', but uses the specified level of detail of the mesh. The 
+ * level is clamped to the coarsest one the mesh has.
+ * ---------------------------------------------------------------------------
+ */
+void   R_GL_DrawLOD(const void *render_private, mat4x4_t *model, const int *lod);
+
 /* ---------------------------------------------------------------------------
  * Clear the draw buffer and set up the global OpenGL state at the beginning 
  * of the frame.
@@ -267,6 +284,14 @@ void   R_GL_DrawCombinedHRVO(vec2_t *apexes, vec2_t *left_rays, vec2_t *right_ra
  */
 void   R_GL_TimestampForCookie(uint32_t *cookie, uint64_t *out);
 
+/* ---------------------------------------------------------------------------
+ * Sample the current GPU timestamp (in nanoseconds) together with the CPU
+ * performance counter, allowing GPU timestamps to be mapped onto the CPU 
+ * timeline.
+ * ---------------------------------------------------------------------------
+ */
+void   R_GL_TimestampCalibrate(uint64_t *out_gpu_ns, uint64_t *out_cpu_pc);
+
 /*###########################################################################*/
 /* RENDER TILES                                                              */
 /*###########################################################################*/
@@ -286,6 +311,15 @@ void   R_GL_TileDrawSelected(const struct tile_desc *in, const void *chunk_rpriv
  */
 void   R_GL_TileUpdate(void *chunk_rprivate, const struct map *map, const struct tile_desc *desc);
 
+/* ---------------------------------------------------------------------------
+ * Rebuild the levels of detail of the chunk if any of its' tiles have been
+ * updated since they were last built. Should be called once all the tile 
+ * updates for the chunk have been made.
+ * ---------------------------------------------------------------------------
+ */
+void   R_GL_TileChunkUpdateLODs(void *chunk_rprivate, const struct map *map, 
+                                const int *chunk_r, const int *chunk_c);
+
 /*###########################################################################*/
 /* RENDER MINIMAP                                                            */
 /*###########################################################################*/
@@ -407,6 +441,13 @@ void R_GL_DepthPassEnd(void);
  */
 void R_GL_RenderDepthMap(const void *render_private, mat4x4_t *model);
 
+/* ---------------------------------------------------------------------------
+ * Like 'R_GL_RenderDepthMap', but uses the specified level of detail of the 
+ * mesh.
+ * ---------------------------------------------------------------------------
+ */
+void R_GL_RenderDepthMapLOD(const void *render_private, mat4x4_t *model, const int *lod);
+
 /* ---------------------------------------------------------------------------
  * Return the frustum of the light source used for rendering the shadow map.
  * An up-to-date frustum is generated during 'R_GL_DepthPassBegin'
@@ -508,6 +549,23 @@ void R_GL_Batch_Reset(void);
  */
 void R_GL_Batch_AllocChunks(struct map_resolution *res);
 
+/* ---------------------------------------------------------------------------
+ * Append the model's skinning matrices for every frame of every clip to the 
+ * baked animation buffer.
+ * ---------------------------------------------------------------------------
+ */
+void R_GL_Batch_BakeSkinMats(void *render_private, const mat4x4_t *mats, const size_t *nmats);
+
+/* ---------------------------------------------------------------------------
+ * Draw the specified terrain chunks, each with its' model matrix and level of 
+ * detail, with a single multi-draw call. This is equivalent to calling 
+ * R_GL_DrawLOD(...) or R_GL_RenderDepthMapLOD(...) for every chunk, depending
+ * on the pass. Must be called between 'R_GL_MapBegin' and 'R_GL_MapEnd'.
+ * ---------------------------------------------------------------------------
+ */
+void R_GL_Batch_DrawMap(void **chunk_rprivates, mat4x4_t *models, int *lods, 
+                        const size_t *nchunks, const bool *shadows, const enum render_pass *pass);
+
 
 #endif
 
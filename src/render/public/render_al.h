@@ -36,6 +36,8 @@
 #ifndef RENDER_AL_H
 #define RENDER_AL_H
 
+#include "../../pf_math.h"
+
 #include <stdio.h>
 #include <SDL_rwops.h>
 
@@ -50,6 +52,15 @@ struct tile;
  */
 void  *R_AL_PrivFromStream(const char *base_path, const struct pfobj_hdr *header, SDL_RWops *stream);
 
+/* ---------------------------------------------------------------------------
+ * Upload the model's baked skinning matrices (as produced by A_AL_BakeSkinMats) 
+ * so that batched rendering can index them on the GPU, instead of streaming 
+ * the joint matrices for every instance every frame. If the upload fails, 
+ * rendering falls back to streaming the joint matrices.
+ * ---------------------------------------------------------------------------
+ */
+void   R_AL_BakeSkinMats(void *render_private, const mat4x4_t *mats, size_t nmats);
+
 /* ---------------------------------------------------------------------------
  * Dumps private render data in PF Object format.
  * ---------------------------------------------------------------------------
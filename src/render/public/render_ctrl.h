@@ -38,8 +38,10 @@
 
 #include "../../lib/public/queue.h"
 #include "../../lib/public/stalloc.h"
+#include "../../config.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <SDL_mutex.h>
 #include <SDL_thread.h>
@@ -63,21 +65,32 @@ struct render_init_arg{
     bool        out_success;
 };
 
+/* The maximum number of workspaces that can be submitted to the render 
+ * thread without it having completed them. */
+#define MAX_QUEUED_WS (CONFIG_MAX_FRAMES_AHEAD + 1)
+
+struct render_workspace;
+
 struct render_sync_state{
     /* The render thread owns the data pointed to by 'arg' until
-     * signalling the first 'done'. */
+     * completing the first submission. */
     struct render_init_arg *arg;
-    /* The start flag is set by the main thread when the render
-     * thread is allowed to start processing commands.
+    /* FIFO of the workspaces submitted by the main thread, which the 
+     * render thread processes in order. The render thread owns every 
+     * submitted workspace until it is completed. The very first 
+     * submission is a NULL workspace, which signals the render thread 
+     * to initialize the context.
      * The quit flag is set by the main thread when the render 
      * thread should exit. */
-    bool       start;
+    struct render_workspace *queued[MAX_QUEUED_WS];
+    int        qhead;
+    int        nqueued;
     bool       quit;
     SDL_mutex *sq_lock;
     SDL_cond  *sq_cond;
-    /* The done flag is set by the render thread when it is done 
-     * procesing commands for the current frame. */
-    bool       done;
+    /* The number of submissions that the render thread is done 
+     * processing. */
+    uint64_t   ncompleted;
     SDL_mutex *done_lock;
     SDL_cond  *done_cond;
     /* Flag to specify if the framebuffer should be presented on
@@ -85,7 +98,8 @@ struct render_sync_state{
     bool       swap_buffers;
 };
 
-#define MAX_ARGS 8
+#define MAX_ARGS    8
+#define MAX_SUBBUFS 8
 
 struct rcmd{
     void (*func)();
@@ -96,11 +110,24 @@ struct rcmd{
 QUEUE_TYPE(rcmd, struct rcmd)
 QUEUE_IMPL(static inline, rcmd, struct rcmd)
 
+struct rcmd_buff{
+    /* Stack allocator for storing all the data/arguments associated
+     * with the commands */
+    struct memstack   args;
+    queue_rcmd_t      commands;
+};
+
 struct render_workspace{
     /* Stack allocator for storing all the data/arguments associated
      * with the commands */
     struct memstack   args;
     queue_rcmd_t      commands;
+    /* Sub-buffers that can be recorded concurrently by different threads. 
+     * Each one is executed at the position in 'commands' where it was 
+     * reserved, so the order of execution does not depend on the order 
+     * in which the sub-buffers get recorded. */
+    size_t            nsubbufs;
+    struct rcmd_buff  subbufs[MAX_SUBBUFS];
 };
 
 
@@ -110,6 +137,20 @@ SDL_Thread *R_Run(struct render_sync_state *rstate);
 void       *R_PushArg(const void *src, size_t size);
 void        R_PushCmd(struct rcmd cmd);
 
+/* Reserve a command sub-buffer in the workspace that is being recorded and 
+ * splice it into the main command stream at the current position. Returns
+ * the index of the sub-buffer, or -1 if none are left, in which case the
+ * commands should be pushed directly. Must be called from the main thread. 
+ */
+int         R_SubBufReserve(void);
+/* Redirect all the R_PushCmd and R_PushArg calls made by the calling thread 
+ * (main or worker) into a reserved sub-buffer. A sub-buffer must only be 
+ * recorded by a single thread and all the recording must be finished before 
+ * the workspaces are swapped. 
+ */
+void        R_SubBufBegin(int idx);
+void        R_SubBufEnd(void);
+
 bool        R_InitWS(struct render_workspace *ws);
 void        R_DestroyWS(struct render_workspace *ws);
 void        R_ClearWS(struct render_workspace *ws);
@@ -45,6 +45,8 @@
 #include "../main.h"
 #include "../ui.h"
 #include "../game/public/game.h"
+#include "../sched.h"
+#include "../perf.h"
 
 #include <assert.h>
 #include <math.h>
@@ -69,6 +71,17 @@ bool g_trace_gpu;
 
 static SDL_GLContext s_context;
 
+/* The sub-buffer that each thread (indexed by its' scheduler thread index) 
+ * is currently recording into, if any. Each slot is only accessed by the 
+ * thread that owns it. */
+static struct rcmd_buff *s_bound_subbuf[MAX_WORKER_THREADS + 1];
+/* The workspace that the sub-buffers were last reserved in. The workspaces 
+ * are only swapped by the main thread, so this is stable for as long as 
+ * any worker may be recording. */
+static struct render_workspace *s_subbuf_ws;
+/* The workspace currently being processed. Only accessed by the render thread */
+static struct render_workspace *s_render_ws;
+
 /* write-once strings. Set by render thread at initialization */
 char                 s_info_vendor[128];
 char                 s_info_renderer[128];
@@ -243,21 +256,24 @@ static void trace_gpu_commit(const struct sval *new_val)
     });
 }
 
-static bool render_wait_cmd(struct render_sync_state *rstate)
+static bool render_wait_cmd(struct render_sync_state *rstate, struct render_workspace **out)
 {
     SDL_LockMutex(rstate->sq_lock);
-    while(!rstate->start && !rstate->quit)
+    while(rstate->nqueued == 0 && !rstate->quit)
         SDL_CondWait(rstate->sq_cond, rstate->sq_lock);
 
-    if(rstate->quit) {
+    /* Finish all the submitted work before quitting */
+    if(rstate->nqueued == 0) {
 
+        assert(rstate->quit);
         rstate->quit = false;
         SDL_UnlockMutex(rstate->sq_lock);
         return true;
     }
-    
-    assert(rstate->start == true);
-    rstate->start = false;
+
+    *out = rstate->queued[rstate->qhead];
+    rstate->qhead = (rstate->qhead + 1) % MAX_QUEUED_WS;
+    rstate->nqueued--;
     SDL_UnlockMutex(rstate->sq_lock);
     return false;
 }
@@ -265,7 +281,7 @@ static bool render_wait_cmd(struct render_sync_state *rstate)
 static void render_signal_done(struct render_sync_state *rstate)
 {
     SDL_LockMutex(rstate->done_lock);
-    rstate->done = true;
+    rstate->ncompleted++;
     SDL_CondSignal(rstate->done_cond);
     SDL_UnlockMutex(rstate->done_lock);
 }
@@ -491,27 +507,72 @@ static void render_process_cmds(queue_rcmd_t *cmds)
     }
 }
 
+static void render_process_subbuf(queue_rcmd_t *cmds)
+{
+    render_process_cmds(cmds);
+}
+
+static struct rcmd_buff *render_bound_subbuf(void)
+{
+    if(SDL_ThreadID() == g_main_thread_id)
+        return s_bound_subbuf[0];
+    return s_bound_subbuf[Sched_CurrentThreadIdx()];
+}
+
+static bool rcmd_buff_init(struct rcmd_buff *buff, size_t ncmds)
+{
+    if(!stalloc_init(&buff->args)) 
+        goto fail_args;
+
+    if(!queue_rcmd_init(&buff->commands, ncmds))
+        goto fail_queue;
+
+    return true;
+
+fail_queue:
+    stalloc_destroy(&buff->args);
+fail_args:
+    return false;
+}
+
+static void rcmd_buff_destroy(struct rcmd_buff *buff)
+{
+    queue_rcmd_destroy(&buff->commands);
+    stalloc_destroy(&buff->args);
+}
+
+static void rcmd_buff_clear(struct rcmd_buff *buff)
+{
+    queue_rcmd_clear(&buff->commands);
+    stalloc_clear(&buff->args);
+}
+
 static int render(void *data)
 {
     struct render_sync_state *rstate = data; 
     SDL_Window *window = rstate->arg->in_window; /* cache window ptr */
+    struct render_workspace *ws = NULL;
 
-    bool quit = render_wait_cmd(rstate);
-    assert(!quit);
+    bool quit = render_wait_cmd(rstate, &ws);
+    assert(!quit && !ws);
     render_init_ctx(rstate->arg);
     rstate->arg = NULL; /* arg is stale after signalling main thread */
     render_signal_done(rstate);
 
     while(true) {
     
-        quit = render_wait_cmd(rstate);
+        quit = render_wait_cmd(rstate, &ws);
         if(quit)
             break;
 
-        render_process_cmds(&G_GetRenderWS()->commands);
+        assert(ws);
+        s_render_ws = ws;
+        render_process_cmds(&ws->commands);
         if(rstate->swap_buffers)
             SDL_GL_SwapWindow(window);
 
+        Perf_FinishRenderTick();
+        s_render_ws = NULL;
         render_signal_done(rstate);
     }
 
@@ -661,9 +722,17 @@ SDL_Thread *R_Run(struct render_sync_state *rstate)
 
 void *R_PushArg(const void *src, size_t size)
 {
-    struct render_workspace *ws = (SDL_ThreadID() == g_render_thread_id) ? G_GetRenderWS() 
-                                                                         : G_GetSimWS();
-    void *ret = stalloc(&ws->args, size);
+    struct memstack *args;
+
+    if(SDL_ThreadID() == g_render_thread_id) {
+        assert(s_render_ws);
+        args = &s_render_ws->args;
+    }else{
+        struct rcmd_buff *sub = render_bound_subbuf();
+        args = sub ? &sub->args : &G_GetSimWS()->args;
+    }
+
+    void *ret = stalloc(args, size);
     if(!ret)
         return ret;
 
@@ -673,6 +742,10 @@ void *R_PushArg(const void *src, size_t size)
 
 void R_PushCmd(struct rcmd cmd)
 {
+    /* There is no render thread to consume the commands */
+    if(g_headless)
+        return;
+
     /* If invoking from the render thread, execute immediately
      * as if it were a function call */
     if(SDL_ThreadID() == g_render_thread_id) {
@@ -681,10 +754,56 @@ void R_PushCmd(struct rcmd cmd)
         return;
     }
 
+    struct rcmd_buff *sub = render_bound_subbuf();
+    if(sub) {
+        queue_rcmd_push(&sub->commands, &cmd);
+        return;
+    }
+
     struct render_workspace *ws = G_GetSimWS();
     queue_rcmd_push(&ws->commands, &cmd);
 }
 
+int R_SubBufReserve(void)
+{
+    ASSERT_IN_MAIN_THREAD();
+    assert(!s_bound_subbuf[0]);
+
+    struct render_workspace *ws = G_GetSimWS();
+    if(ws->nsubbufs == MAX_SUBBUFS)
+        return -1;
+
+    int ret = ws->nsubbufs++;
+    s_subbuf_ws = ws;
+    R_PushCmd((struct rcmd){
+        .func = render_process_subbuf,
+        .nargs = 1,
+        .args = { &ws->subbufs[ret].commands },
+    });
+    return ret;
+}
+
+void R_SubBufBegin(int idx)
+{
+    ASSERT_IN_MAIN_OR_WORKER_THREAD();
+
+    struct render_workspace *ws = s_subbuf_ws;
+    assert(ws && idx >= 0 && idx < ws->nsubbufs);
+
+    int tidx = Sched_CurrentThreadIdx();
+    assert(!s_bound_subbuf[tidx]);
+    s_bound_subbuf[tidx] = &ws->subbufs[idx];
+}
+
+void R_SubBufEnd(void)
+{
+    ASSERT_IN_MAIN_OR_WORKER_THREAD();
+
+    int tidx = Sched_CurrentThreadIdx();
+    assert(s_bound_subbuf[tidx]);
+    s_bound_subbuf[tidx] = NULL;
+}
+
 bool R_InitWS(struct render_workspace *ws)
 {
     if(!stalloc_init(&ws->args)) 
@@ -693,8 +812,20 @@ bool R_InitWS(struct render_workspace *ws)
     if(!queue_rcmd_init(&ws->commands, 2048))
         goto fail_queue;
 
+    int nsub = 0;
+    for(; nsub < MAX_SUBBUFS; nsub++) {
+        if(!rcmd_buff_init(&ws->subbufs[nsub], 512))
+            goto fail_subbufs;
+    }
+
+    ws->nsubbufs = 0;
     return true;
 
+fail_subbufs:
+    for(int i = 0; i < nsub; i++) {
+        rcmd_buff_destroy(&ws->subbufs[i]);
+    }
+    queue_rcmd_destroy(&ws->commands);
 fail_queue:
     stalloc_destroy(&ws->args);
 fail_args:
@@ -703,12 +834,20 @@ fail_args:
 
 void R_DestroyWS(struct render_workspace *ws)
 {
+    for(int i = 0; i < MAX_SUBBUFS; i++) {
+        rcmd_buff_destroy(&ws->subbufs[i]);
+    }
     queue_rcmd_destroy(&ws->commands);
     stalloc_destroy(&ws->args);
 }
 
 void R_ClearWS(struct render_workspace *ws)
 {
+    for(int i = 0; i < ws->nsubbufs; i++) {
+        rcmd_buff_clear(&ws->subbufs[i]);
+    }
+    ws->nsubbufs = 0;
+
     queue_rcmd_clear(&ws->commands);
     stalloc_clear(&ws->args);
 }
@@ -35,6 +35,7 @@
 
 #include "public/render.h"
 #include "public/render_ctrl.h"
+#include "public/render_al.h"
 #include "render_private.h"
 #include "gl_vertex.h"
 #include "gl_material.h"
@@ -216,24 +217,29 @@ void *R_AL_PrivFromStream(const char *base_path, const struct pfobj_hdr *header,
     bool anim = (header->num_as > 0);
     priv->vertex_stride = anim ? sizeof(struct anim_vert) : sizeof(struct vertex);
 
+    /* When running headless, the vertices are never uploaded. They are 
+     * only parsed to advance the stream, so a single scratch vertex is 
+     * enough. */
     size_t vbuff_sz = header->num_verts * priv->vertex_stride;
-    void *vbuff = malloc(vbuff_sz);
+    void *vbuff = malloc(g_headless ? priv->vertex_stride : vbuff_sz);
     if(!vbuff)
         goto fail_alloc_vbuff;
 
     priv->mesh.num_verts = header->num_verts;
     priv->num_materials = header->num_materials;
+    priv->anim_baked_base = -1;
     priv->materials = (void*)(priv + 1);
 
     for(int i = 0; i < header->num_verts; i++) {
 
         bool status;
         char ignoreline[MAX_LINE_LEN];
+        int vidx = g_headless ? 0 : i;
 
         if(anim) {
-            status = al_read_anim_vertex(stream, ((struct anim_vert*)vbuff) + i);
+            status = al_read_anim_vertex(stream, ((struct anim_vert*)vbuff) + vidx);
         }else{
-            status = al_read_vertex(stream, ((struct vertex*)vbuff) + i, ignoreline);
+            status = al_read_vertex(stream, ((struct vertex*)vbuff) + vidx, ignoreline);
         }
         if(!status)
             goto fail_parse;
@@ -249,6 +255,11 @@ void *R_AL_PrivFromStream(const char *base_path, const struct pfobj_hdr *header,
         assert(!null);
     }
 
+    if(g_headless) {
+        free(vbuff);
+        PERF_RETURN(priv);
+    }
+
     struct sval sh_setting;
     ss_e status = Settings_Get("pf.video.shadows_enabled", &sh_setting);
     assert(status == SS_OKAY);
@@ -283,6 +294,23 @@ fail_alloc_priv:
     PERF_RETURN(NULL);
 }
 
+void R_AL_BakeSkinMats(void *render_private, const mat4x4_t *mats, size_t nmats)
+{
+    void *arg = R_PushArg(mats, nmats * sizeof(mat4x4_t));
+    if(!arg)
+        return;
+
+    R_PushCmd((struct rcmd){
+        .func = R_GL_Batch_BakeSkinMats,
+        .nargs = 3,
+        .args = {
+            render_private,
+            arg,
+            R_PushArg(&nmats, sizeof(nmats)),
+        },
+    });
+}
+
 void R_AL_DumpPrivate(FILE *stream, void *priv_data)
 {
     struct render_private *priv = priv_data;
@@ -352,21 +380,33 @@ bool R_AL_InitPrivFromTiles(const struct map *map, int chunk_r, int chunk_c,
     PERF_ENTER();
     ASSERT_IN_MAIN_THREAD();
 
-    size_t num_verts = VERTS_PER_TILE * (width * height);
+    /* Reserve space for the merged geometry of the chunk's coarser levels of detail */
+    size_t num_tile_verts = VERTS_PER_TILE * (width * height);
+    size_t num_verts = num_tile_verts + TERRAIN_LOD_MAX_MERGED_VERTS;
 
     struct render_private *priv = priv_buff;
     char *unused_base = (char*)priv_buff + sizeof(struct render_private);
     size_t vbuff_sz = num_verts * sizeof(struct terrain_vert);
 
-    struct terrain_vert *vbuff = malloc(vbuff_sz);
-    if(!vbuff)
-        goto fail_alloc;
-
     priv->vertex_stride = sizeof(struct terrain_vert);
     priv->mesh.num_verts = num_verts;
+    priv->lods_dirty = false;
     priv->materials = (void*)unused_base;
     priv->num_materials = 0;
 
+    /* There is no GL context to upload the mesh to */
+    if(g_headless)
+        PERF_RETURN(true);
+
+    struct terrain_vert *vbuff = calloc(num_verts, sizeof(struct terrain_vert));
+    if(!vbuff)
+        goto fail_alloc;
+
+    size_t ibuff_sz = TERRAIN_NUM_LODS * INDICES_PER_TILE * (width * height) * sizeof(GLushort);
+    GLushort *ibuff = malloc(ibuff_sz);
+    if(!ibuff)
+        goto fail_alloc_ibuff;
+
     for(int r = 0; r < height; r++) {
     for(int c = 0; c < width;  c++) {
 
@@ -375,6 +415,16 @@ bool R_AL_InitPrivFromTiles(const struct map *map, int chunk_r, int chunk_c,
         R_TileGetVertices(map, td, vert_base);
     }}
 
+    /* Side faces fully covered by a neighbouring tile never get drawn */
+    struct tile_chunk_lods lods;
+    if(!R_TileChunkGetLODs(map, chunk_r, chunk_c, width, height, ibuff, vbuff + num_tile_verts, &lods))
+        goto fail_lods;
+
+    size_t num_indices = 0;
+    for(int i = 0; i < TERRAIN_NUM_LODS; i++) {
+        num_indices += lods.num_indices[i];
+    }
+
     struct sval sh_setting;
     ss_e status = Settings_Get("pf.video.shadows_enabled", &sh_setting);
     assert(status == SS_OKAY);
@@ -390,9 +440,24 @@ bool R_AL_InitPrivFromTiles(const struct map *map, int chunk_r, int chunk_c,
         },
     });
 
+    R_PushCmd((struct rcmd){
+        .func = R_GL_TileChunkInitLODs,
+        .nargs = 3,
+        .args = {
+            priv,
+            R_PushArg(&lods, sizeof(lods)),
+            R_PushArg(ibuff, num_indices * sizeof(GLushort)),
+        },
+    });
+
+    free(ibuff);
     free(vbuff);
     PERF_RETURN(true);
 
+fail_lods:
+    free(ibuff);
+fail_alloc_ibuff:
+    free(vbuff);
 fail_alloc:
     PERF_RETURN(false);
 }
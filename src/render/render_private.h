@@ -38,8 +38,11 @@
 
 #include "gl_mesh.h"
 #include "gl_texture.h"
+#include "public/render.h"
 #include "../map/public/tile.h"
 
+#include <stdbool.h>
+
 struct terrain_vert;
 struct map;
 
@@ -51,9 +54,27 @@ struct render_private{
     GLuint              shader_prog;
     GLuint              shader_prog_dp; /* for the depth pass */
     GLuint              vertex_stride;
+    /* Index of the model's first matrix in the baked animation buffer, 
+     * or -1 if the model's skinning matrices have not been baked */
+    GLint               anim_baked_base;
+    /* Set for terrain chunks whose' tiles have been updated since their 
+     * levels of detail were last built */
+    bool                lods_dirty;
+};
+
+/* The index counts for each level of detail of a terrain chunk. The coarsest 
+ * levels draw some merged geometry, the vertices of which are stored after 
+ * the vertices of the chunk's tiles. */
+struct tile_chunk_lods{
+    size_t num_indices[TERRAIN_NUM_LODS];
+    size_t num_merged_verts;
 };
 
 /* Tile */
 void R_TileGetVertices(const struct map *map, struct tile_desc td, struct terrain_vert *out);
+/* 'out_indices' must have space for (TERRAIN_NUM_LODS * INDICES_PER_TILE * width * height) 
+ * indices and 'out_merged' for TERRAIN_LOD_MAX_MERGED_VERTS vertices. */
+bool R_TileChunkGetLODs(const struct map *map, int chunk_r, int chunk_c, size_t width, size_t height, 
+                        GLushort *out_indices, struct terrain_vert *out_merged, struct tile_chunk_lods *out);
 
 #endif
@@ -0,0 +1,270 @@
+/*
+ *  This file is part of Permafrost Engine. 
+ *  Copyright (C) 2020 Eduard Permyakov 
+ *
+ *  Permafrost Engine is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Permafrost Engine is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ *  Linking this software statically or dynamically with other modules is making 
+ *  a combined work based on this software. Thus, the terms and conditions of 
+ *  the GNU General Public License cover the whole combination. 
+ *  
+ *  As a special exception, the copyright holders of Permafrost Engine give 
+ *  you permission to link Permafrost Engine with independent modules to produce 
+ *  an executable, regardless of the license terms of these independent 
+ *  modules, and to copy and distribute the resulting executable under 
+ *  terms of your choice, provided that you also meet, for each linked 
+ *  independent module, the terms and conditions of the license of that 
+ *  module. An independent module is a module which is not derived from 
+ *  or based on Permafrost Engine. If you modify Permafrost Engine, you may 
+ *  extend this exception to your version of Permafrost Engine, but you are not 
+ *  obliged to do so. If you do not wish to do so, delete this exception 
+ *  statement from your version.
+ *
+ */
+
+#include "sched.h"
+#include "perf.h"
+#include "lib/public/pf_string.h"
+
+#include <SDL.h>
+#include <assert.h>
+#include <stdint.h>
+#include <limits.h>
+
+
+#define MIN(a, b)       ((a) < (b) ? (a) : (b))
+#define MAX(a, b)       ((a) > (b) ? (a) : (b))
+#define CACHELINE_SZ    (64)
+
+/* A contiguous sub-range of items that is initially 'owned' by a single thread. 
+ * Items are claimed from the front of the range by atomically bumping the 'next' 
+ * index, so the owner and any stealing threads never hand out the same batch twice. 
+ * Padded to avoid false sharing between the threads hammering adjacent ranges. 
+ */
+struct range{
+    SDL_atomic_t next;
+    int          end;
+    char         pad[CACHELINE_SZ - sizeof(SDL_atomic_t) - sizeof(int)];
+};
+
+struct parallel_work{
+    sched_range_func_t func;
+    void              *arg;
+    int                grain;
+    struct range       ranges[MAX_WORKER_THREADS + 1];
+};
+
+/*****************************************************************************/
+/* STATIC VARIABLES                                                          */
+/*****************************************************************************/
+
+static SDL_Thread          *s_workers[MAX_WORKER_THREADS];
+static int                  s_nworkers = 0;
+/* Holds the (1-based) thread index for the worker threads, NULL otherwise */
+static SDL_TLSID            s_thread_idx_tls;
+
+/* Protects all the fields below */
+static SDL_mutex           *s_lock;
+static SDL_cond            *s_start_cond;
+static SDL_cond            *s_done_cond;
+/* Bumped each time new work is published to the workers */
+static uint64_t             s_generation = 0;
+/* The number of workers that have not yet finished the current work */
+static int                  s_nbusy = 0;
+static bool                 s_quit = false;
+
+static struct parallel_work s_work;
+
+/*****************************************************************************/
+/* STATIC FUNCTIONS                                                          */
+/*****************************************************************************/
+
+static void run_ranges(struct parallel_work *work, int thread_idx)
+{
+    const int nthreads = s_nworkers + 1;
+
+    /* First drain our own sub-range and then start stealing batches 
+     * from the other threads' sub-ranges. */
+    for(int i = 0; i < nthreads; i++) {
+
+        struct range *curr = &work->ranges[(thread_idx + i) % nthreads];
+        int begin;
+
+        while((begin = SDL_AtomicAdd(&curr->next, work->grain)) < curr->end) {
+
+            int end = MIN(begin + work->grain, curr->end);
+            work->func(work->arg, thread_idx, begin, end);
+        }
+    }
+}
+
+static int worker_main(void *arg)
+{
+    int thread_idx = (intptr_t)arg;
+    SDL_TLSSet(s_thread_idx_tls, (void*)(intptr_t)thread_idx, NULL);
+
+    uint64_t seen_generation = 0;
+    while(true) {
+
+        SDL_LockMutex(s_lock);
+        while(!s_quit && s_generation == seen_generation)
+            SDL_CondWait(s_start_cond, s_lock);
+
+        if(s_quit) {
+            SDL_UnlockMutex(s_lock);
+            break;
+        }
+        seen_generation = s_generation;
+        SDL_UnlockMutex(s_lock);
+
+        run_ranges(&s_work, thread_idx);
+
+        SDL_LockMutex(s_lock);
+        if(--s_nbusy == 0)
+            SDL_CondSignal(s_done_cond);
+        SDL_UnlockMutex(s_lock);
+    }
+    return 0;
+}
+
+/*****************************************************************************/
+/* EXTERN FUNCTIONS                                                          */
+/*****************************************************************************/
+
+bool Sched_Init(void)
+{
+    ASSERT_IN_MAIN_THREAD();
+
+    s_thread_idx_tls = SDL_TLSCreate();
+    if(!s_thread_idx_tls)
+        goto fail_tls;
+
+    s_lock = SDL_CreateMutex();
+    if(!s_lock)
+        goto fail_lock;
+
+    s_start_cond = SDL_CreateCond();
+    if(!s_start_cond)
+        goto fail_start_cond;
+
+    s_done_cond = SDL_CreateCond();
+    if(!s_done_cond)
+        goto fail_done_cond;
+
+    s_quit = false;
+    s_generation = 0;
+    s_nworkers = 0;
+
+    /* The main thread is also doing work, so leave one core for it */
+    int nworkers = MIN(MAX(SDL_GetCPUCount() - 1, 0), MAX_WORKER_THREADS);
+
+    for(int i = 0; i < nworkers; i++) {
+
+        char name[32];
+        pf_snprintf(name, sizeof(name), "worker %d", i);
+
+        s_workers[i] = SDL_CreateThread(worker_main, name, (void*)(intptr_t)(i + 1));
+        if(!s_workers[i])
+            break;
+
+        Perf_RegisterThread(SDL_GetThreadID(s_workers[i]), name);
+        s_nworkers++;
+    }
+
+    return true;
+
+fail_done_cond:
+    SDL_DestroyCond(s_start_cond);
+fail_start_cond:
+    SDL_DestroyMutex(s_lock);
+fail_lock:
+fail_tls:
+    return false;
+}
+
+void Sched_Shutdown(void)
+{
+    ASSERT_IN_MAIN_THREAD();
+
+    SDL_LockMutex(s_lock);
+    s_quit = true;
+    SDL_CondBroadcast(s_start_cond);
+    SDL_UnlockMutex(s_lock);
+
+    for(int i = 0; i < s_nworkers; i++) {
+        SDL_WaitThread(s_workers[i], NULL);
+    }
+    s_nworkers = 0;
+
+    SDL_DestroyCond(s_done_cond);
+    SDL_DestroyCond(s_start_cond);
+    SDL_DestroyMutex(s_lock);
+}
+
+int Sched_NumThreads(void)
+{
+    return s_nworkers + 1;
+}
+
+bool Sched_IsWorker(void)
+{
+    return (NULL != SDL_TLSGet(s_thread_idx_tls));
+}
+
+int Sched_CurrentThreadIdx(void)
+{
+    return (intptr_t)SDL_TLSGet(s_thread_idx_tls);
+}
+
+void Sched_ParallelFor(size_t nitems, size_t grain, sched_range_func_t func, void *arg)
+{
+    PERF_ENTER();
+    ASSERT_IN_MAIN_THREAD();
+    assert(nitems <= INT_MAX / 2);
+
+    grain = MAX(grain, 1);
+
+    /* Not worth waking up the workers */
+    if(s_nworkers == 0 || nitems <= grain) {
+        if(nitems > 0)
+            func(arg, 0, 0, nitems);
+        PERF_RETURN_VOID();
+    }
+
+    const int nthreads = s_nworkers + 1;
+    s_work.func = func;
+    s_work.arg = arg;
+    s_work.grain = grain;
+
+    for(int i = 0; i < nthreads; i++) {
+        SDL_AtomicSet(&s_work.ranges[i].next, (nitems * i) / nthreads);
+        s_work.ranges[i].end = (nitems * (i + 1)) / nthreads;
+    }
+
+    SDL_LockMutex(s_lock);
+    s_nbusy = s_nworkers;
+    s_generation++;
+    SDL_CondBroadcast(s_start_cond);
+    SDL_UnlockMutex(s_lock);
+
+    run_ranges(&s_work, 0);
+
+    SDL_LockMutex(s_lock);
+    while(s_nbusy > 0)
+        SDL_CondWait(s_done_cond, s_lock);
+    SDL_UnlockMutex(s_lock);
+
+    PERF_RETURN_VOID();
+}
+
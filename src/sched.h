@@ -0,0 +1,74 @@
+/*
+ *  This file is part of Permafrost Engine. 
+ *  Copyright (C) 2020 Eduard Permyakov 
+ *
+ *  Permafrost Engine is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Permafrost Engine is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ *  Linking this software statically or dynamically with other modules is making 
+ *  a combined work based on this software. Thus, the terms and conditions of 
+ *  the GNU General Public License cover the whole combination. 
+ *  
+ *  As a special exception, the copyright holders of Permafrost Engine give 
+ *  you permission to link Permafrost Engine with independent modules to produce 
+ *  an executable, regardless of the license terms of these independent 
+ *  modules, and to copy and distribute the resulting executable under 
+ *  terms of your choice, provided that you also meet, for each linked 
+ *  independent module, the terms and conditions of the license of that 
+ *  module. An independent module is a module which is not derived from 
+ *  or based on Permafrost Engine. If you modify Permafrost Engine, you may 
+ *  extend this exception to your version of Permafrost Engine, but you are not 
+ *  obliged to do so. If you do not wish to do so, delete this exception 
+ *  statement from your version.
+ *
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "main.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MAX_WORKER_THREADS  (64)
+
+#define ASSERT_IN_MAIN_OR_WORKER_THREAD() \
+    assert(SDL_ThreadID() == g_main_thread_id || Sched_IsWorker())
+
+/* Processes the items in the range [begin, end). 'thread_idx' is the index of the 
+ * thread executing the range, in [0, Sched_NumThreads()). It can be used to index 
+ * per-thread scratch buffers. The calling (main) thread always has index 0. 
+ */
+typedef void (*sched_range_func_t)(void *arg, int thread_idx, size_t begin, size_t end);
+
+bool Sched_Init(void);
+void Sched_Shutdown(void);
+
+/* The number of threads participating in parallel work (including the main thread) */
+int  Sched_NumThreads(void);
+bool Sched_IsWorker(void);
+/* The 'thread_idx' of the calling thread, as passed to the range functions */
+int  Sched_CurrentThreadIdx(void);
+
+/* Split the range [0, nitems) between the worker threads and the calling thread. 
+ * Each thread will claim batches of 'grain' items at a time from its' own sub-range 
+ * and then steal batches from the other threads' sub-ranges when it runs out of work. 
+ * Returns once all the items have been processed. The caller is responsible for 
+ * making sure that 'func' only touches shared state in a read-only manner for the 
+ * duration of the call. Must be called from the main thread.
+ */
+void Sched_ParallelFor(size_t nitems, size_t grain, sched_range_func_t func, void *arg);
+
+#endif
+
@@ -486,6 +486,7 @@ static void s_expose_event_constants(PyObject *module)
     PY_EXPOSE_ENUM(module, EVENT_ATTACK_START);
     PY_EXPOSE_ENUM(module, EVENT_ATTACK_END);
     PY_EXPOSE_ENUM(module, EVENT_ENTITY_DEATH);
+    PY_EXPOSE_ENUM(module, EVENT_PATH_READY);
     PY_EXPOSE_ENUM(module, EVENT_ENGINE_LAST);
 }
 
@@ -552,6 +552,8 @@ static int PyEntity_set_scale(PyEntityObject *self, PyObject *value, void *closu
         &self->ent->scale.raw[0], &self->ent->scale.raw[1], &self->ent->scale.raw[2]))
         return -1;
 
+    G_UpdateBounds(self->ent);
+
     return 0;
 }
 
@@ -573,6 +575,8 @@ static int PyEntity_set_rotation(PyEntityObject *self, PyObject *value, void *cl
         &self->ent->rotation.raw[2], &self->ent->rotation.raw[3]))
         return -1;
 
+    G_UpdateBounds(self->ent);
+
     return 0;
 }
 
@@ -59,6 +59,7 @@
 #include "../ui.h"
 #include "../session.h"
 #include "../perf.h"
+#include "../clock.h"
 
 #include <SDL.h>
 #include <stdio.h>
@@ -81,11 +82,16 @@ static PyObject *PyPf_global_event(PyObject *self, PyObject *args);
 static PyObject *PyPf_activate_camera(PyObject *self, PyObject *args);
 static PyObject *PyPf_prev_frame_ms(PyObject *self);
 static PyObject *PyPf_prev_frame_perfstats(PyObject *self);
+static PyObject *PyPf_get_peak_memory(PyObject *self);
+static PyObject *PyPf_perf_capture_begin(PyObject *self, PyObject *args, PyObject *kwargs);
+static PyObject *PyPf_perf_capture_end(PyObject *self);
+static PyObject *PyPf_perf_capture_active(PyObject *self);
 static PyObject *PyPf_get_resolution(PyObject *self);
 static PyObject *PyPf_get_native_resolution(PyObject *self);
 static PyObject *PyPf_get_basedir(PyObject *self);
 static PyObject *PyPf_get_render_info(PyObject *self);
 static PyObject *PyPf_get_nav_perfstats(PyObject *self);
+static PyObject *PyPf_get_clearpath_perfstats(PyObject *self);
 static PyObject *PyPf_get_mouse_pos(PyObject *self);
 static PyObject *PyPf_mouse_over_ui(PyObject *self);
 static PyObject *PyPf_ui_text_edit_has_focus(PyObject *self);
@@ -113,6 +119,7 @@ static PyObject *PyPf_get_minimap_size(PyObject *self);
 static PyObject *PyPf_set_minimap_size(PyObject *self, PyObject *args);
 static PyObject *PyPf_mouse_over_minimap(PyObject *self);
 static PyObject *PyPf_map_height_at_point(PyObject *self, PyObject *args);
+static PyObject *PyPf_map_pos_pathable(PyObject *self, PyObject *args);
 static PyObject *PyPf_map_pos_under_cursor(PyObject *self);
 static PyObject *PyPf_set_move_on_left_click(PyObject *self);
 static PyObject *PyPf_set_attack_on_left_click(PyObject *self);
@@ -124,6 +131,8 @@ static PyObject *PyPf_settings_delete(PyObject *self, PyObject *args);
 
 static PyObject *PyPf_get_simstate(PyObject *self);
 static PyObject *PyPf_set_simstate(PyObject *self, PyObject *args);
+static PyObject *PyPf_get_sim_ticks(PyObject *self);
+static PyObject *PyPf_run_ticks(PyObject *self, PyObject *args);
 
 static PyObject *PyPf_multiply_quaternions(PyObject *self, PyObject *args);
 static PyObject *PyPf_rand(PyObject *self, PyObject *args);
@@ -200,6 +209,25 @@ static PyMethodDef pf_module_methods[] = {
     (PyCFunction)PyPf_prev_frame_ms, METH_NOARGS,
     "Get the duration of the previous game frame in milliseconds."},
 
+    {"get_peak_memory", 
+    (PyCFunction)PyPf_get_peak_memory, METH_NOARGS,
+    "Get the peak resident memory usage of the process in bytes."},
+
+    {"perf_capture_begin", 
+    (PyCFunction)PyPf_perf_capture_begin, METH_VARARGS | METH_KEYWORDS,
+    "Start recording all profiled calls of all threads, along with the GPU timings and frame "
+    "markers, to a file at the specified path in the Chrome trace event format. The capture "
+    "starts at the next frame. If 'nframes' is non-zero, the capture ends automatically after "
+    "that many frames."},
+
+    {"perf_capture_end", 
+    (PyCFunction)PyPf_perf_capture_end, METH_NOARGS,
+    "End the current trace capture at the end of this frame."},
+
+    {"perf_capture_active", 
+    (PyCFunction)PyPf_perf_capture_active, METH_NOARGS,
+    "Returns True if a trace capture is pending or in progress."},
+
     {"prev_frame_perfstats", 
     (PyCFunction)PyPf_prev_frame_perfstats, METH_NOARGS,
     "Get a dictionary of the performance data for the previous frame."},
@@ -225,6 +253,10 @@ static PyMethodDef pf_module_methods[] = {
     (PyCFunction)PyPf_get_nav_perfstats, METH_NOARGS,
     "Returns a dictionary holding various performance couners for the navigation subsystem."},
 
+    {"get_clearpath_perfstats", 
+    (PyCFunction)PyPf_get_clearpath_perfstats, METH_NOARGS,
+    "Returns a dictionary holding the ClearPath collision avoidance counters, accumulated since the map was loaded."},
+
     {"get_mouse_pos", 
     (PyCFunction)PyPf_get_mouse_pos, METH_NOARGS,
     "Get the (x, y) cursor position on the screen."},
@@ -326,6 +358,11 @@ static PyMethodDef pf_module_methods[] = {
     "Returns the Y-dimension map height at the specified XZ coordinate. Returns None if the "
     "specified coordinate is outside the map bounds."},
 
+    {"map_pos_pathable",
+    (PyCFunction)PyPf_map_pos_pathable, METH_VARARGS,
+    "Returns True if a unit can stand at the specified XZ coordinate. Returns False if the "
+    "specified coordinate is outside the map bounds."},
+
     {"map_pos_under_cursor",
     (PyCFunction)PyPf_map_pos_under_cursor, METH_NOARGS,
     "Returns the XYZ coordinate of the point of the map underneath the cursor. Returns 'None' if "
@@ -370,6 +407,15 @@ static PyMethodDef pf_module_methods[] = {
     (PyCFunction)PyPf_set_simstate, METH_VARARGS,
     "Set the current simulation state."},
 
+    {"get_sim_ticks",
+    (PyCFunction)PyPf_get_sim_ticks, METH_NOARGS,
+    "Returns the number of 60Hz ticks the simulation clock has taken."},
+
+    {"run_ticks",
+    (PyCFunction)PyPf_run_ticks, METH_VARARGS,
+    "Advance the simulation clock by the specified number of 60Hz ticks as fast as possible (one tick per "
+    "frame), independent of the wall clock."},
+
     {"multiply_quaternions",
     (PyCFunction)PyPf_multiply_quaternions, METH_VARARGS,
     "Returns the normalized result of multiplying 2 quaternions (specified as a list of 4 floats - XYZW order)."},
@@ -630,6 +676,43 @@ static PyObject *PyPf_prev_frame_ms(PyObject *self)
     return Py_BuildValue("i", Perf_LastFrameMS());
 }
 
+static PyObject *PyPf_get_peak_memory(PyObject *self)
+{
+    return Py_BuildValue("K", (unsigned long long)Perf_PeakMemoryBytes());
+}
+
+static PyObject *PyPf_perf_capture_begin(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"path", "nframes", NULL};
+    const char *path;
+    unsigned int nframes = 0;
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "s|I", kwlist, &path, &nframes)) {
+        PyErr_SetString(PyExc_TypeError, "Arguments must be a string and an (optional) integer.");
+        return NULL;
+    }
+
+    if(!Perf_CaptureBegin(path, nframes)) {
+        PyErr_SetString(PyExc_RuntimeError, "Unable to begin the trace capture.");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *PyPf_perf_capture_end(PyObject *self)
+{
+    Perf_CaptureEnd();
+    Py_RETURN_NONE;
+}
+
+static PyObject *PyPf_perf_capture_active(PyObject *self)
+{
+    if(Perf_CaptureActive())
+        Py_RETURN_TRUE;
+    else
+        Py_RETURN_FALSE;
+}
+
 static PyObject *PyPf_prev_frame_perfstats(PyObject *self)
 {
     struct perf_info *infos[16];
@@ -781,12 +864,41 @@ static PyObject *PyPf_get_nav_perfstats(PyObject *self)
     rval |= PyDict_SetItemString(ret, "flow_max",           Py_BuildValue("i", stats.flow_max));
     rval |= PyDict_SetItemString(ret, "flow_hit_rate",      Py_BuildValue("f", stats.flow_hit_rate));
     rval |= PyDict_SetItemString(ret, "flow_invalidated",   Py_BuildValue("i", stats.flow_invalidated));
+    rval |= PyDict_SetItemString(ret, "intf_used",          Py_BuildValue("i", stats.intf_used));
+    rval |= PyDict_SetItemString(ret, "intf_max",           Py_BuildValue("i", stats.intf_max));
+    rval |= PyDict_SetItemString(ret, "intf_hit_rate",      Py_BuildValue("f", stats.intf_hit_rate));
+    rval |= PyDict_SetItemString(ret, "intf_invalidated",   Py_BuildValue("i", stats.intf_invalidated));
     rval |= PyDict_SetItemString(ret, "ffid_used",          Py_BuildValue("i", stats.ffid_used));
     rval |= PyDict_SetItemString(ret, "ffid_max",           Py_BuildValue("i", stats.ffid_max));
     rval |= PyDict_SetItemString(ret, "ffid_hit_rate",      Py_BuildValue("f", stats.ffid_hit_rate));
     rval |= PyDict_SetItemString(ret, "grid_path_used",     Py_BuildValue("i", stats.grid_path_used));
     rval |= PyDict_SetItemString(ret, "grid_path_max",      Py_BuildValue("i", stats.grid_path_max));
     rval |= PyDict_SetItemString(ret, "grid_path_hit_rate", Py_BuildValue("f", stats.grid_path_hit_rate));
+    rval |= PyDict_SetItemString(ret, "portal_travel_cost_bytes", Py_BuildValue("n", stats.portal_travel_cost_bytes));
+    assert(0 == rval);
+
+    return ret;
+}
+
+static PyObject *PyPf_get_clearpath_perfstats(PyObject *self)
+{
+    PyObject *ret = PyDict_New();
+    if(!ret) {
+        return NULL;
+    }
+
+    struct cp_stats stats;
+    G_Move_GetClearPathStats(&stats);
+    float mean_iterations = stats.solved ? (float)stats.iterations / stats.solved : 0.0f;
+
+    int rval = 0;
+    rval |= PyDict_SetItemString(ret, "solved",          Py_BuildValue("k", stats.solved));
+    rval |= PyDict_SetItemString(ret, "iterations",      Py_BuildValue("k", stats.iterations));
+    rval |= PyDict_SetItemString(ret, "mean_iterations", Py_BuildValue("f", mean_iterations));
+    rval |= PyDict_SetItemString(ret, "max_iterations",  Py_BuildValue("I", stats.max_iterations));
+    rval |= PyDict_SetItemString(ret, "degraded",        Py_BuildValue("k", stats.degraded));
+    rval |= PyDict_SetItemString(ret, "failed",          Py_BuildValue("k", stats.failed));
+    rval |= PyDict_SetItemString(ret, "ray_pairs",       Py_BuildValue("k", stats.ray_pairs));
     assert(0 == rval);
 
     return ret;
@@ -1165,6 +1277,21 @@ static PyObject *PyPf_map_height_at_point(PyObject *self, PyObject *args)
         return Py_BuildValue("f", height);
 }
 
+static PyObject *PyPf_map_pos_pathable(PyObject *self, PyObject *args)
+{
+    float x, z;
+
+    if(!PyArg_ParseTuple(args, "ff", &x, &z)) {
+        PyErr_SetString(PyExc_TypeError, "Arguments must be two floats.");
+        return NULL;
+    }
+
+    if(G_MapPositionPathable((vec2_t){x, z}))
+        Py_RETURN_TRUE;
+    else
+        Py_RETURN_FALSE;
+}
+
 static PyObject *PyPf_map_pos_under_cursor(PyObject *self)
 {
     vec3_t pos;
@@ -1366,6 +1493,24 @@ static PyObject *PyPf_set_simstate(PyObject *self, PyObject *args)
     Py_RETURN_NONE;
 }
 
+static PyObject *PyPf_get_sim_ticks(PyObject *self)
+{
+    return Py_BuildValue("K", (unsigned long long)Clock_NumTicks());
+}
+
+static PyObject *PyPf_run_ticks(PyObject *self, PyObject *args)
+{
+    unsigned long long nticks;
+
+    if(!PyArg_ParseTuple(args, "K", &nticks)) {
+        PyErr_SetString(PyExc_TypeError, "Argument must be an unsigned integer.");
+        return NULL;
+    }
+
+    Clock_RunTicks(nticks);
+    Py_RETURN_NONE;
+}
+
 static PyObject *PyPf_multiply_quaternions(PyObject *self, PyObject *args)
 {
     PyObject *q1_list, *q2_list;
@@ -1760,6 +1905,9 @@ script_opaque_t S_WrapEngineEventArg(int eventnum, void *arg)
     case EVENT_GAME_SIMSTATE_CHANGED:
         return Py_BuildValue("(i)", (intptr_t)arg);
 
+    case EVENT_PATH_READY:
+        return Py_BuildValue("(I)", (unsigned)(uintptr_t)arg);
+
     default:
         Py_RETURN_NONE;
     }
@@ -260,7 +260,9 @@ static void ui_init_font_stash(struct nk_context *ctx)
 
     Engine_FlushRenderWorkQueue();
 
-    nk_font_atlas_end(&s_atlas, nk_handle_id(R_UI_GetFontTexID()), &s_null);
+    /* No font texture gets created when running headless */
+    int font_tex = g_headless ? 0 : R_UI_GetFontTexID();
+    nk_font_atlas_end(&s_atlas, nk_handle_id(font_tex), &s_null);
     nk_style_set_font(ctx, &s_atlas.default_font->handle);
 }
 
@@ -392,6 +394,11 @@ void UI_Render(void)
     nk_clear(&s_ctx);
 }
 
+void UI_DiscardFrame(void)
+{
+    nk_clear(&s_ctx);
+}
+
 void UI_HandleEvent(SDL_Event *evt)
 {
     if(evt->type == SDL_KEYUP || evt->type == SDL_KEYDOWN) {
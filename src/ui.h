@@ -75,6 +75,9 @@ void               UI_Shutdown(void);
 void               UI_InputBegin(void);
 void               UI_InputEnd(void);
 void               UI_Render(void);
+/* Drop the current frame's UI commands without converting them for rendering. 
+ * Used in place of 'UI_Render' when running headless. */
+void               UI_DiscardFrame(void);
 void               UI_HandleEvent(SDL_Event *evt);
 void               UI_DrawText(const char *text, struct rect rect, struct rgba rgba);
 